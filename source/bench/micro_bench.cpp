@@ -0,0 +1,577 @@
+#include "engine/mesh/model.hpp"
+#include "engine/object/transform_batch.hpp"
+#include "engine/scene/slot_map.hpp"
+#include "engine/material/texture/mip_generator.hpp"
+#include "engine/device/device.hpp"
+#include "engine/utils.hpp"
+#include "engine/io/json.hpp"
+
+#include <tiny_obj_loader.h>
+#include <glm/gtc/constants.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Microbenchmarks of engine components against the code they replaced. Every case runs its candidates --repeat times on
+// the same input and reports the fastest run of each, in milliseconds, as JSON.
+//
+// Options: --case NAME (run a single case, default all), --repeat N, --output PATH ("-" for stdout, default
+// renderer_microbench.json), --grid N (quads per side of the generated vertex_dedup mesh), --transforms N (transform_batch
+// size), --objects N (slot_map size), --mip-size N (side of the mip_generator image)
+//
+// Cases:
+//   vertex_dedup     OBJ vertex deduplication, the corner table of ModelData::parseObj against hashing whole vertices in an
+//                    unordered_map. Both parse the same generated grid, once as a single shape and once split into shapes
+//                    (parseObj deduplicates those in parallel). parse_ms is tinyobj alone, the deduplication costs the rest.
+//   transform_batch  Model and normal matrices of random transforms written into interleaved instance data, filling and
+//                    computing a TransformBatch against TransformComponent::mat4()/normalMatrix() per transform.
+//   slot_map         Scene object storage, SlotMap<Object> against the unordered_map of objects owning a vector of mesh ids
+//                    it replaced: inserting, iterating (reading transforms and meshes), looking up every object by
+//                    handle/id and erasing all of them in random order.
+//   mip_generator    Full mip chain of an RGBA8 sRGB image, MipGenerator's box and Kaiser filters on one thread and on the
+//                    shared job system against the GPU time of the vkCmdBlitImage chain of Texture::generateMipmaps()
+//                    (null when no device is available). simd tells whether MipGenerator was built with SSE2.
+namespace std{
+    template <>
+    struct hash<Renderer::Model::Vertex>{
+        size_t operator()(Renderer::Model::Vertex const& vertex) const{
+            size_t seed = 0;
+            Renderer::hashCombine(seed, vertex.position, vertex.colour, vertex.normal, vertex.texCoords);
+            return seed;
+        }
+    };
+}
+
+namespace{
+    struct Options{
+        std::string caseName = "all";
+        uint32_t repeat = 5;
+        std::string output = "renderer_microbench.json";
+        uint32_t grid = 512;
+        uint32_t transforms = 100000;
+        uint32_t objects = 1000000;
+        uint32_t mipSize = 2048;
+    };
+
+    Options parseOptions(int argc, char** argv){
+        Options options{};
+        for(int i = 1; i < argc; i++){
+            std::string option = argv[i];
+            if(i + 1 >= argc)
+                throw std::runtime_error("Missing value for option: " + option);
+            std::string value = argv[++i];
+            if(option == "--case") options.caseName = value;
+            else if(option == "--repeat") options.repeat = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--output") options.output = value;
+            else if(option == "--grid") options.grid = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--transforms") options.transforms = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--objects") options.objects = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--mip-size") options.mipSize = static_cast<uint32_t>(std::stoul(value));
+            else
+                throw std::runtime_error("Unknown option: " + option);
+        }
+        if(options.repeat == 0)
+            throw std::runtime_error("Every case has to run at least once.");
+        return options;
+    }
+
+    // Fastest of several timed runs in milliseconds, for runs that need untimed setup in between
+    struct BestTime{
+        double ms = 0.0;
+        bool measured = false;
+
+        template<typename Run>
+        void time(Run&& run){
+            auto start = std::chrono::steady_clock::now();
+            run();
+            add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        // A time measured elsewhere (e.g. on the GPU)
+        void add(double time){
+            ms = measured ? std::min(ms, time) : time;
+            measured = true;
+        }
+    };
+
+    // Fastest of repeat runs in milliseconds
+    template<typename Run>
+    double bestOf(uint32_t repeat, Run&& run){
+        BestTime best;
+        for(uint32_t i = 0; i < repeat; i++)
+            best.time(run);
+        return best.ms;
+    }
+
+    // Vertex deduplication before the corner table: every corner builds its vertex, which is hashed whole
+    void deduplicateVertices(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, Renderer::Model::ModelData& data){
+        using Vertex = Renderer::Model::Vertex;
+        data.vertices.clear();
+        data.indices.clear();
+        data.bounds = Renderer::Bounds{};
+
+        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        for (const auto &shape : shapes) {
+            for (const auto &index : shape.mesh.indices) {
+                Vertex vertex{};
+                if (index.vertex_index >= 0) {
+                    vertex.position = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2],
+                    };
+                    if (!attrib.colors.empty()) {
+                        vertex.colour = {
+                            attrib.colors[3 * index.vertex_index + 0],
+                            attrib.colors[3 * index.vertex_index + 1],
+                            attrib.colors[3 * index.vertex_index + 2],
+                        };
+                    }
+                }
+                if (index.normal_index >= 0) {
+                    vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2],
+                    };
+                }
+                if (index.texcoord_index >= 0) {
+                    vertex.texCoords = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                }
+                if (uniqueVertices.count(vertex) == 0) {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(data.vertices.size());
+                    data.vertices.push_back(vertex);
+                    data.bounds.expand(vertex.position);
+                }
+                data.indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+    }
+
+    // Wavy grid of grid x grid quads with a position, normal and texcoord per grid point, rows split evenly into shapes
+    void writeGridObj(const std::string& path, uint32_t grid, uint32_t shapes){
+        std::ofstream file{path, std::ios::trunc};
+        if(!file.is_open())
+            throw std::runtime_error("Failed to open benchmark mesh: " + path);
+        for(uint32_t y = 0; y <= grid; y++){
+            for(uint32_t x = 0; x <= grid; x++){
+                float u = static_cast<float>(x) / grid, v = static_cast<float>(y) / grid;
+                float height = 0.05f * std::sin(20.f * u) * std::cos(20.f * v);
+                file << "v " << u << ' ' << height << ' ' << v << '\n';
+                file << "vn " << -std::cos(20.f * u) * std::cos(20.f * v) << " 1 " << std::sin(20.f * u) * std::sin(20.f * v) << '\n';
+                file << "vt " << u << ' ' << v << '\n';
+            }
+        }
+        uint32_t rowsPerShape = (grid + shapes - 1) / shapes;
+        for(uint32_t y = 0; y < grid; y++){
+            if(y % rowsPerShape == 0)
+                file << "o shape" << y / rowsPerShape << '\n';
+            for(uint32_t x = 0; x < grid; x++){
+                // OBJ indices start at 1, the same index addresses position, normal and texcoord
+                uint32_t a = y * (grid + 1) + x + 1, b = a + 1, c = a + grid + 1, d = c + 1;
+                file << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/' << b << ' ' << d << '/' << d << '/' << d << '\n';
+                file << "f " << a << '/' << a << '/' << a << ' ' << d << '/' << d << '/' << d << ' ' << c << '/' << c << '/' << c << '\n';
+            }
+        }
+    }
+
+    void runVertexDedup(const Options& options, std::ostream& out){
+        if(options.grid == 0)
+            throw std::runtime_error("The vertex_dedup grid needs at least one quad.");
+        std::string path = (std::filesystem::temp_directory_path() / "renderer_microbench.obj").string();
+        const uint32_t shapeCounts[] = {1, 8};
+
+        out << "{\"grid\":" << options.grid << ",\"corners\":" << 6ull * options.grid * options.grid;
+        for(uint32_t shapes : shapeCounts){
+            writeGridObj(path, options.grid, shapes);
+
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> objShapes;
+            std::vector<tinyobj::material_t> materials;
+            auto parse = [&]{
+                std::string warn, err;
+                attrib = {};
+                objShapes.clear();
+                if(!tinyobj::LoadObj(&attrib, &objShapes, &materials, &warn, &err, path.c_str()))
+                    throw std::runtime_error(warn + err);
+            };
+
+            Renderer::Model::ModelData cornerTable{}, unorderedMap{};
+            double parseTime = bestOf(options.repeat, parse);
+            double cornerTableTime = bestOf(options.repeat, [&]{ cornerTable.parseObj(path); });
+            double unorderedMapTime = bestOf(options.repeat, [&]{
+                parse();
+                deduplicateVertices(attrib, objShapes, unorderedMap);
+            });
+            // Shapes are deduplicated separately by parseObj, so the vertices on shape borders are duplicated there
+            if(shapes == 1 && (cornerTable.vertices.size() != unorderedMap.vertices.size() || cornerTable.indices != unorderedMap.indices))
+                throw std::runtime_error("vertex_dedup: the corner table and the unordered_map produced different geometry.");
+
+            out << ",\"shapes_" << shapes << "\":{\"parse_ms\":" << parseTime << ",\"corner_table_ms\":" << cornerTableTime
+                << ",\"unordered_map_ms\":" << unorderedMapTime << ",\"corner_table_vertices\":" << cornerTable.vertices.size()
+                << ",\"unordered_map_vertices\":" << unorderedMap.vertices.size() << "}";
+        }
+        out << "}";
+        std::filesystem::remove(path);
+    }
+
+    void runTransformBatch(const Options& options, std::ostream& out){
+        std::mt19937 random{1};
+        std::uniform_real_distribution<float> angle{-glm::pi<float>(), glm::pi<float>()};
+        std::uniform_real_distribution<float> scale{0.5f, 1.5f};
+        std::uniform_real_distribution<float> translation{-100.f, 100.f};
+        std::vector<Renderer::TransformComponent> transforms(options.transforms);
+        for(auto& transform : transforms){
+            transform.translation = {translation(random), translation(random), translation(random)};
+            transform.rotation = {angle(random), angle(random), angle(random)};
+            transform.scale = glm::vec3{scale(random)};
+        }
+
+        // Same layout as the render system's instance matrices
+        struct ObjectMatrices{
+            glm::mat4 modelMatrix;
+            glm::mat4 normalMatrix;
+        };
+        std::vector<ObjectMatrices> matrices(transforms.size());
+
+        double componentTime = bestOf(options.repeat, [&]{
+            for(size_t i = 0; i < transforms.size(); i++){
+                matrices[i].modelMatrix = transforms[i].mat4();
+                matrices[i].normalMatrix = glm::mat4{transforms[i].normalMatrix()};
+            }
+        });
+        Renderer::TransformBatch batch;
+        double batchTime = bestOf(options.repeat, [&]{
+            batch.resize(transforms.size());
+            for(size_t i = 0; i < transforms.size(); i++)
+                batch.set(i, transforms[i]);
+            if(!matrices.empty())
+                batch.computeMatrices(&matrices[0].modelMatrix, &matrices[0].normalMatrix, sizeof(ObjectMatrices));
+        });
+        double computeTime = bestOf(options.repeat, [&]{
+            if(!matrices.empty())
+                batch.computeMatrices(&matrices[0].modelMatrix, &matrices[0].normalMatrix, sizeof(ObjectMatrices));
+        });
+
+        out << "{\"transforms\":" << transforms.size() << ",\"transform_component_ms\":" << componentTime << ",\"transform_batch_ms\":"
+            << batchTime << ",\"transform_batch_compute_ms\":" << computeTime << "}";
+    }
+
+    // Scene objects before the slot maps, kept in an unordered_map by id
+    struct PreviousObject{
+        Renderer::TransformComponent transform{};
+        std::vector<unsigned int> meshIds;
+    };
+
+    struct SlotMapTimes{
+        BestTime insert, iterate, lookup, erase;
+
+        void write(std::ostream& out){
+            out << "{\"insert_ms\":" << insert.ms << ",\"iterate_ms\":" << iterate.ms << ",\"lookup_ms\":" << lookup.ms
+                << ",\"erase_ms\":" << erase.ms << "}";
+        }
+    };
+
+    void runSlotMap(const Options& options, std::ostream& out){
+        std::mt19937 random{1};
+        std::uniform_real_distribution<float> translation{-100.f, 100.f};
+        std::vector<Renderer::TransformComponent> transforms(options.objects);
+        for(auto& transform : transforms)
+            transform.translation = {translation(random), translation(random), translation(random)};
+        // Erase order, a permutation of the insertion order
+        std::vector<uint32_t> order(options.objects);
+        for(uint32_t i = 0; i < options.objects; i++)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), random);
+
+        // Results are summed up so that the loops can't be optimized out, both containers have to agree
+        float slotMapSum = 0.f, unorderedMapSum = 0.f;
+
+        SlotMapTimes slotMapTimes;
+        std::vector<Renderer::Handle<Renderer::Object>> handles(options.objects);
+        for(uint32_t run = 0; run < options.repeat; run++){
+            Renderer::SlotMap<Renderer::Object> objects;
+            slotMapTimes.insert.time([&]{
+                for(uint32_t i = 0; i < options.objects; i++){
+                    Renderer::Object object = Renderer::Object::createObject();
+                    object.transform = transforms[i];
+                    object.addMesh({i % 16, 0});
+                    handles[i] = objects.insert(object);
+                }
+            });
+            slotMapTimes.iterate.time([&]{
+                slotMapSum = 0.f;
+                for(auto& object : objects)
+                    slotMapSum += object.transform.translation.x + static_cast<float>(object.getMeshes()[0].index);
+            });
+            slotMapTimes.lookup.time([&]{
+                for(auto handle : handles)
+                    slotMapSum += objects[handle].transform.translation.y;
+            });
+            slotMapTimes.erase.time([&]{
+                for(uint32_t i : order)
+                    objects.erase(handles[i]);
+            });
+        }
+
+        SlotMapTimes unorderedMapTimes;
+        for(uint32_t run = 0; run < options.repeat; run++){
+            std::unordered_map<unsigned int, PreviousObject> objects;
+            unorderedMapTimes.insert.time([&]{
+                for(uint32_t i = 0; i < options.objects; i++){
+                    PreviousObject object{};
+                    object.transform = transforms[i];
+                    object.meshIds.push_back(i % 16);
+                    objects.emplace(i, std::move(object));
+                }
+            });
+            unorderedMapTimes.iterate.time([&]{
+                unorderedMapSum = 0.f;
+                for(auto& [id, object] : objects)
+                    unorderedMapSum += object.transform.translation.x + static_cast<float>(object.meshIds[0]);
+            });
+            unorderedMapTimes.lookup.time([&]{
+                for(uint32_t i = 0; i < options.objects; i++)
+                    unorderedMapSum += objects.at(i).transform.translation.y;
+            });
+            unorderedMapTimes.erase.time([&]{
+                for(uint32_t i : order)
+                    objects.erase(i);
+            });
+        }
+        // Iteration orders differ, so the float sums only agree approximately
+        if(std::abs(slotMapSum - unorderedMapSum) > 1e-3f * std::max(1.f, std::abs(slotMapSum)))
+            throw std::runtime_error("slot_map: the containers iterated different objects.");
+
+        out << "{\"objects\":" << options.objects << ",\"slot_map\":";
+        slotMapTimes.write(out);
+        out << ",\"unordered_map\":";
+        unorderedMapTimes.write(out);
+        out << "}";
+    }
+
+    // GPU time of the vkCmdBlitImage chain Texture::generateMipmaps() records, over a size x size RGBA8 sRGB image. Only
+    // the blits and their barriers are timed, the base level isn't uploaded since its contents don't change the cost.
+    // Returns a negative time if the device can't blit the format linearly or has no timestamps on its graphics queue.
+    double timeBlitChain(Renderer::Device& device, uint32_t size, uint32_t repeat){
+        const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &formatProperties);
+        if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+            return -1.0;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, families.data());
+        uint32_t validBits = families[device.getPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        if(validBits == 0)
+            return -1.0;
+        uint64_t timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device.getPhysicalDevice(), &properties);
+
+        uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(size))) + 1;
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {size, size, 1};
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        VkImage image;
+        Renderer::Allocation allocation;
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = 2;
+        VkQueryPool queryPool;
+        if(vkCreateQueryPool(device.getDevice(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timestamp query pool.");
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = image;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+
+        BestTime best;
+        for(uint32_t run = 0; run < repeat; run++){
+            VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+            vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+            // Previous contents are discarded, every level starts out as a blit destination
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = mipLevels;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, queryPool, 0);
+
+            int32_t mipWidth = static_cast<int32_t>(size), mipHeight = static_cast<int32_t>(size);
+            barrier.subresourceRange.levelCount = 1;
+            for(uint32_t level = 1; level < mipLevels; level++){
+                barrier.subresourceRange.baseMipLevel = level - 1;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                VkImageBlit blit{};
+                blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+                blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+                blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+                blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+                if(mipWidth > 1) mipWidth /= 2;
+                if(mipHeight > 1) mipHeight /= 2;
+            }
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, queryPool, 1);
+            // Waits for the queue to go idle
+            device.endSingleTimeCommands(commandBuffer);
+
+            uint64_t timestamps[2];
+            if(vkGetQueryPoolResults(device.getDevice(), queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
+                throw std::runtime_error("Failed to read the blit chain timestamps.");
+            uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+            best.add(ticks * static_cast<double>(properties.limits.timestampPeriod) / 1e6);
+        }
+
+        vkDestroyQueryPool(device.getDevice(), queryPool, nullptr);
+        vkDestroyImage(device.getDevice(), image, nullptr);
+        device.getAllocator().free(allocation);
+        return best.ms;
+    }
+
+    void runMipGenerator(const Options& options, std::ostream& out){
+        if(options.mipSize < 2)
+            throw std::runtime_error("The mip_generator image needs at least two texels per side.");
+        // Gradient, checkerboard and noise channels so neither filter sees flat colour
+        uint32_t size = options.mipSize;
+        std::mt19937 random{3};
+        std::vector<uint8_t> image(static_cast<size_t>(size) * size * 4);
+        for(uint32_t y = 0; y < size; y++){
+            for(uint32_t x = 0; x < size; x++){
+                uint8_t* texel = &image[(static_cast<size_t>(y) * size + x) * 4];
+                texel[0] = static_cast<uint8_t>(x * 7);
+                texel[1] = ((x ^ y) & 8) ? 255 : 0;
+                texel[2] = static_cast<uint8_t>(random());
+                texel[3] = 255;
+            }
+        }
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        const bool simd = true;
+#else
+        const bool simd = false;
+#endif
+        Renderer::JobSystem singleThread{1};
+        Renderer::JobSystem& shared = Renderer::JobSystem::shared();
+        out << "{\"size\":" << size << ",\"simd\":" << (simd ? "true" : "false") << ",\"threads\":" << shared.getThreadCount();
+        const std::pair<const char*, Renderer::MipGenerator::Filter> filters[] = {
+            {"box", Renderer::MipGenerator::Filter::Box},
+            {"kaiser", Renderer::MipGenerator::Filter::Kaiser},
+        };
+        for(auto [name, filter] : filters){
+            double singleThreadTime = bestOf(options.repeat, [&]{ Renderer::MipGenerator::generate(image.data(), size, size, filter, singleThread); });
+            double sharedTime = bestOf(options.repeat, [&]{ Renderer::MipGenerator::generate(image.data(), size, size, filter, shared); });
+            out << ",\"" << name << "\":{\"single_thread_ms\":" << singleThreadTime << ",\"job_system_ms\":" << sharedTime << "}";
+        }
+
+        // The CPU numbers are still useful on machines without a Vulkan device
+        double blitTime = -1.0;
+        try{
+            Renderer::Device device{};
+            blitTime = timeBlitChain(device, size, options.repeat);
+        }
+        catch(const std::exception& exception){
+            std::cerr << "mip_generator: skipping the blit chain, " << exception.what() << '\n';
+        }
+        out << ",\"gpu_blit_ms\":";
+        if(blitTime >= 0.0)
+            out << blitTime;
+        else
+            out << "null";
+        out << "}";
+    }
+
+    struct Case{
+        const char* name;
+        void (*run)(const Options& options, std::ostream& out);
+    };
+    const Case CASES[] = {
+        {"vertex_dedup", runVertexDedup},
+        {"transform_batch", runTransformBatch},
+        {"slot_map", runSlotMap},
+        {"mip_generator", runMipGenerator},
+    };
+
+    int runBenchmarks(const Options& options){
+        bool known = options.caseName == "all";
+        for(const auto& benchmark : CASES)
+            known = known || options.caseName == benchmark.name;
+        if(!known)
+            throw std::runtime_error("Unknown case: " + options.caseName);
+
+        std::ofstream file;
+        if(options.output != "-"){
+            file.open(options.output, std::ios::trunc);
+            if(!file.is_open())
+                throw std::runtime_error("Failed to open benchmark output: " + options.output);
+        }
+        std::ostream& out = options.output == "-" ? std::cout : file;
+
+        out << "{\n  \"config\": {\"case\":";
+        Renderer::JsonValue::writeString(out, options.caseName);
+        out << ",\"repeat\":" << options.repeat << "},\n  \"cases\": {";
+        bool first = true;
+        for(const auto& benchmark : CASES){
+            if(options.caseName != "all" && options.caseName != benchmark.name)
+                continue;
+            out << (first ? "\n" : ",\n") << "    \"" << benchmark.name << "\": ";
+            benchmark.run(options, out);
+            first = false;
+        }
+        out << "\n  }\n}\n";
+
+        if(options.output != "-")
+            std::cerr << "Benchmark results written to " << options.output << '\n';
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char** argv){
+    try{
+        return runBenchmarks(parseOptions(argc, argv));
+    }
+    catch(const std::exception &exception){
+        std::cerr << exception.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,341 @@
+#include "engine/device/device.hpp"
+#include "engine/renderer/renderer.hpp"
+#include "engine/systems/render_system/render_system.hpp"
+#include "engine/camera/camera.hpp"
+#include "engine/profiling/gpu_profiler.hpp"
+#include "engine/upload/upload_manager.hpp"
+#include "engine/io/json.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Headless benchmark: fills a scene with instances of the bundled models at random (seeded) transforms, flies a fixed
+// camera path around it for a fixed number of frames and writes frame times, CPU time per stage, GPU time, memory usage
+// and load time as JSON. Runs with the same options produce the same scene and camera path. Warmup frames are left out of
+// every statistic, GPU zones cover the measured frames that returned timestamps (counted in gpu_frames).
+//
+// Options: --instances N, --frames N, --warmup N, --seed N, --moving F (fraction of instances that rotate every frame),
+// --width N, --height N, --output PATH ("-" for stdout, default renderer_bench.json), --scene PATH (load a saved scene
+// instead of generating one, --instances and --seed are then ignored), --save-scene PATH (save the generated scene),
+// --texture-budget MB (texture levels the streamer may keep resident)
+namespace{
+    struct Options{
+        uint32_t instances = 10000;
+        uint32_t frames = 1000;
+        uint32_t warmupFrames = 60;
+        uint32_t seed = 1;
+        float movingFraction = 0.05f;
+        uint32_t width = 1280, height = 720;
+        std::string output = "renderer_bench.json";
+        std::string scene;
+        std::string saveScene;
+        uint32_t textureBudgetMb = static_cast<uint32_t>(Renderer::TextureStreamer::DEFAULT_BUDGET / (1024 * 1024));
+    };
+
+    Options parseOptions(int argc, char** argv){
+        Options options{};
+        for(int i = 1; i < argc; i++){
+            std::string option = argv[i];
+            if(i + 1 >= argc)
+                throw std::runtime_error("Missing value for option: " + option);
+            std::string value = argv[++i];
+            if(option == "--instances") options.instances = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--frames") options.frames = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--warmup") options.warmupFrames = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--seed") options.seed = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--moving") options.movingFraction = std::clamp(std::stof(value), 0.f, 1.f);
+            else if(option == "--width") options.width = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--height") options.height = static_cast<uint32_t>(std::stoul(value));
+            else if(option == "--output") options.output = value;
+            else if(option == "--scene") options.scene = value;
+            else if(option == "--save-scene") options.saveScene = value;
+            else if(option == "--texture-budget") options.textureBudgetMb = static_cast<uint32_t>(std::stoul(value));
+            else
+                throw std::runtime_error("Unknown option: " + option);
+        }
+        if(options.frames == 0)
+            throw std::runtime_error("At least one frame has to be measured.");
+        return options;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Average and nearest rank percentiles of a set of samples in milliseconds
+    void writeDistribution(std::ostream& out, std::vector<double> samples){
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p){
+            size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+            return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+        };
+        double total = 0.0;
+        for(double sample : samples)
+            total += sample;
+        out << "{\"average_ms\":" << total / samples.size() << ",\"p50_ms\":" << percentile(0.50) << ",\"p95_ms\":" << percentile(0.95)
+            << ",\"p99_ms\":" << percentile(0.99) << ",\"min_ms\":" << samples.front() << ",\"max_ms\":" << samples.back() << "}";
+    }
+
+    // Frames until a frame's GPU zones have surely been read back (its frame slot has been reused), well below
+    // Profiler::HISTORY_FRAMES so they are collected before the profiler drops the frame
+    constexpr uint64_t GPU_RESULT_DELAY = 16;
+
+    // GPU time of a zone over the measured frames, zones hit several times in a frame are added up like Profiler::getSummary() does
+    struct GpuZoneStats{
+        uint32_t frames = 0;
+        double totalMs = 0.0, maxMs = 0.0;
+    };
+
+    // Adds the GPU zones of a profiler frame, returns false if the frame has none (not rendered or results dropped)
+    bool addGpuFrame(uint64_t frameNumber, std::map<std::string, GpuZoneStats>& zones){
+        Renderer::Profiler::Frame frame;
+        if(!Renderer::Profiler::shared().getFrame(frameNumber, frame) || frame.gpuZones.empty())
+            return false;
+        std::map<std::string, double> frameTotals;
+        for(auto& zone : frame.gpuZones)
+            frameTotals[zone.name] += (zone.end - zone.start) / 1e6;
+        for(auto& [name, ms] : frameTotals){
+            GpuZoneStats& stats = zones[name];
+            stats.frames++;
+            stats.totalMs += ms;
+            stats.maxMs = std::max(stats.maxMs, ms);
+        }
+        return true;
+    }
+
+    // Host side stages of a frame, in the order they run
+    enum Stage{ UPDATE, ACQUIRE, RECORD_CULL, RECORD_DRAW, SUBMIT, STAGE_COUNT };
+    const char* STAGE_NAMES[STAGE_COUNT] = { "update", "acquire", "record_cull", "record_draw", "submit" };
+
+    int runBenchmark(const Options& options){
+        Renderer::Device device{};
+        Renderer::Renderer renderer{device, VkExtent2D{options.width, options.height}};
+        Renderer::RenderSystem renderSystem{device, renderer.getSwapChainRenderPass()};
+        renderSystem.setTextureBudget(static_cast<VkDeviceSize>(options.textureBudgetMb) * 1024 * 1024);
+
+        // The renderer already times frames on the GPU when the engine is built with RENDERER_PROFILING
+        std::unique_ptr<Renderer::GpuProfiler> gpuProfiler;
+        if(Renderer::GpuProfiler::getActive() == nullptr)
+            gpuProfiler = std::make_unique<Renderer::GpuProfiler>(device);
+
+        // Scene
+        std::vector<Renderer::Handle<Renderer::Object>> objects;
+        float sceneExtent = 2.f * std::cbrt(static_cast<float>(std::max(options.instances, 1u)));
+        auto loadStart = std::chrono::steady_clock::now();
+        renderSystem.initializeRenderSystem([&](Renderer::Scene& scene, Renderer::AssetLoader& assetLoader){
+            if(!options.scene.empty()){
+                scene.load(options.scene, assetLoader, device);
+                // Same camera path as a generated scene of the same bounds
+                float extent = 1.f;
+                for(auto object : scene.objects.handles()){
+                    glm::vec3 translation = glm::abs(scene.objects[object].transform.translation);
+                    extent = std::max({extent, translation.x, translation.y, translation.z});
+                    objects.push_back(object);
+                }
+                sceneExtent = extent;
+                return;
+            }
+
+            scene.loadTexturesWithSampler(assetLoader, 0);
+            scene.loadModels(assetLoader);
+
+            // One mesh per bundled model, model and texture ids follow the load order
+            Renderer::Handle<Renderer::Mesh> meshes[2];
+            for(unsigned int i = 0; i < 2; i++){
+                auto material = scene.createMaterial();
+                scene.materials[material].diffuseTextureIds.push_back(i);
+                meshes[i] = scene.createMesh();
+                scene.meshes[meshes[i]].modelId = i;
+                scene.meshes[meshes[i]].material = material;
+            }
+
+            std::mt19937 random{options.seed};
+            std::uniform_real_distribution<float> position{-sceneExtent, sceneExtent};
+            std::uniform_real_distribution<float> angle{0.f, glm::two_pi<float>()};
+            std::uniform_real_distribution<float> scale{0.5f, 1.5f};
+            std::uniform_int_distribution<int> model{0, 1};
+            objects.reserve(options.instances);
+            for(uint32_t i = 0; i < options.instances; i++){
+                auto object = scene.createObject();
+                auto& transform = scene.objects[object].transform;
+                transform.translation = {position(random), position(random), position(random)};
+                transform.rotation = {angle(random), angle(random), angle(random)};
+                transform.scale = glm::vec3{scale(random)};
+                scene.objects[object].addMesh(meshes[model(random)]);
+                objects.push_back(object);
+            }
+            if(!options.saveScene.empty())
+                scene.save(options.saveScene);
+        });
+        // Load time includes the uploads having completed
+        renderSystem.finishLoading();
+        device.getUploadManager().flush();
+        double loadTime = millisecondsSince(loadStart);
+        // Missing assets would make the results meaningless
+        if(size_t failed = renderSystem.getAssetLoader().getFailedCount(); failed > 0)
+            throw std::runtime_error(std::to_string(failed) + " asset(s) failed to load.");
+
+        Renderer::Scene& scene = renderSystem.getScene();
+        uint32_t movingCount = static_cast<uint32_t>(options.movingFraction * objects.size());
+        Renderer::Camera camera{};
+
+        std::vector<double> frameTimes;
+        std::vector<double> stageTimes[STAGE_COUNT];
+        frameTimes.reserve(options.frames);
+        for(auto& times : stageTimes)
+            times.reserve(options.frames);
+
+        // Profiler frame numbers of the measured frames, GPU zones are collected as their results come in
+        std::map<std::string, GpuZoneStats> gpuZones;
+        uint32_t gpuFrameCount = 0;
+        uint64_t nextGpuFrame = 0;
+
+        uint32_t totalFrames = options.warmupFrames + options.frames;
+        for(uint32_t frame = 0; frame < totalFrames; frame++){
+            Renderer::Profiler::shared().beginFrame();
+            bool measured = frame >= options.warmupFrames;
+            uint64_t profilerFrame = Renderer::Profiler::shared().getFrameNumber();
+            if(frame == options.warmupFrames)
+                nextGpuFrame = profilerFrame;
+            for(; measured && nextGpuFrame + GPU_RESULT_DELAY <= profilerFrame; nextGpuFrame++)
+                gpuFrameCount += addGpuFrame(nextGpuFrame, gpuZones);
+            double stages[STAGE_COUNT]{};
+            auto frameStart = std::chrono::steady_clock::now();
+
+            // One orbit around the scene over the whole run, placed by frame index so the path doesn't depend on timing
+            float orbit = glm::two_pi<float>() * frame / totalFrames;
+            float radius = 1.5f * sceneExtent + 1.f;
+            camera.setViewTarget({radius * std::cos(orbit), -0.3f * radius, radius * std::sin(orbit)}, glm::vec3{0.f});
+            camera.setPerspectiveProjection(glm::radians(90.f), renderer.getAspectRatio(), 0.1f, 4.f * radius);
+
+            auto stageStart = std::chrono::steady_clock::now();
+            renderSystem.updateAssets();
+            for(uint32_t i = 0; i < movingCount; i++){
+                scene.objects[objects[i]].transform.rotation.y += 0.01f;
+                scene.markTransformDirty(objects[i]);
+            }
+            stages[UPDATE] = millisecondsSince(stageStart);
+
+            stageStart = std::chrono::steady_clock::now();
+            VkCommandBuffer commandBuffer = renderer.beginFrame();
+            stages[ACQUIRE] = millisecondsSince(stageStart);
+            if(commandBuffer == nullptr)
+                continue;
+            int frameIndex = renderer.getFrameIndex();
+            if(gpuProfiler)
+                gpuProfiler->beginFrame(commandBuffer, frameIndex);
+
+            stageStart = std::chrono::steady_clock::now();
+            renderSystem.updateUniformBuffer(camera, frameIndex);
+            renderSystem.updateInstanceData(frameIndex);
+            renderSystem.updateTextures(frameIndex);
+            stages[UPDATE] += millisecondsSince(stageStart);
+
+            stageStart = std::chrono::steady_clock::now();
+            {
+                Renderer::GpuProfileScope cullZone{commandBuffer, "Cull pass"};
+                renderSystem.cullScene(commandBuffer, frameIndex, renderer.getPreviousDepthImageView(), renderer.getExtent());
+            }
+            stages[RECORD_CULL] = millisecondsSince(stageStart);
+
+            stageStart = std::chrono::steady_clock::now();
+            {
+                Renderer::GpuProfileScope renderZone{commandBuffer, "Render pass"};
+                renderer.beginSwapChainRenderPass(commandBuffer);
+                renderSystem.drawScene(commandBuffer, frameIndex, renderer.getRenderPassInheritance(), renderer.getExtent());
+                renderer.endSwapChainRenderPass(commandBuffer);
+            }
+            renderSystem.finishScene(commandBuffer, frameIndex);
+            stages[RECORD_DRAW] = millisecondsSince(stageStart);
+
+            stageStart = std::chrono::steady_clock::now();
+            if(gpuProfiler)
+                gpuProfiler->endFrame(commandBuffer);
+            renderer.endFrame();
+            stages[SUBMIT] = millisecondsSince(stageStart);
+
+            if(measured){
+                frameTimes.push_back(millisecondsSince(frameStart));
+                for(uint32_t stage = 0; stage < STAGE_COUNT; stage++)
+                    stageTimes[stage].push_back(stages[stage]);
+            }
+        }
+        vkDeviceWaitIdle(device.getDevice());
+        if(frameTimes.empty())
+            throw std::runtime_error("No frame could be rendered.");
+        // The last frames' results are still waiting for their slots to be reused
+        if(Renderer::GpuProfiler* profiler = Renderer::GpuProfiler::getActive())
+            profiler->flush();
+        for(uint64_t lastFrame = Renderer::Profiler::shared().getFrameNumber(); nextGpuFrame <= lastFrame; nextGpuFrame++)
+            gpuFrameCount += addGpuFrame(nextGpuFrame, gpuZones);
+
+        Renderer::MemoryAllocator::Stats memory = device.getAllocator().getStats();
+        const auto& cullStats = renderSystem.getCullStats();
+
+        std::ofstream file;
+        if(options.output != "-"){
+            file.open(options.output, std::ios::trunc);
+            if(!file.is_open())
+                throw std::runtime_error("Failed to open benchmark output: " + options.output);
+        }
+        std::ostream& out = options.output == "-" ? std::cout : file;
+
+        out << "{\n";
+        out << "  \"config\": {\"instances\":" << options.instances << ",\"frames\":" << options.frames << ",\"warmup_frames\":" << options.warmupFrames
+            << ",\"seed\":" << options.seed << ",\"moving_fraction\":" << options.movingFraction << ",\"width\":" << options.width
+            << ",\"height\":" << options.height << ",\"scene\":";
+        Renderer::JsonValue::writeString(out, options.scene);
+        out << ",\"texture_budget_mb\":" << options.textureBudgetMb << "},\n";
+        out << "  \"load_time_ms\": " << loadTime << ",\n";
+        out << "  \"frame_time\": ";
+        writeDistribution(out, frameTimes);
+        out << ",\n  \"cpu_stages\": {";
+        for(uint32_t stage = 0; stage < STAGE_COUNT; stage++){
+            out << (stage == 0 ? "\n" : ",\n") << "    \"" << STAGE_NAMES[stage] << "\": ";
+            writeDistribution(out, stageTimes[stage]);
+        }
+        // first is the index of the first measured frame in the run, count the measured frames that have GPU results
+        out << "\n  },\n  \"gpu_frames\": {\"first\":" << options.warmupFrames << ",\"count\":" << gpuFrameCount << "},\n  \"gpu\": {";
+        bool first = true;
+        for(auto& [name, zone] : gpuZones){
+            out << (first ? "\n" : ",\n") << "    \"" << name << "\": {\"average_ms\":" << zone.totalMs / zone.frames << ",\"max_ms\":" << zone.maxMs
+                << ",\"frames\":" << zone.frames << "}";
+            first = false;
+        }
+        out << "\n  },\n";
+        out << "  \"memory\": {\"bytes_reserved\":" << memory.bytesReserved << ",\"bytes_used\":" << memory.bytesUsed << ",\"block_count\":"
+            << memory.blockCount << ",\"allocation_count\":" << memory.allocationCount << ",\"dedicated_allocation_count\":"
+            << memory.dedicatedAllocationCount << ",\"fragmentation\":" << memory.fragmentation << ",\"resident_texture_bytes\":"
+            << renderSystem.getResidentTextureBytes() << "},\n";
+        out << "  \"culling\": {\"drawn\":" << cullStats.drawn << ",\"frustum_culled\":" << cullStats.frustumCulled << ",\"occlusion_culled\":"
+            << cullStats.occlusionCulled << "}\n";
+        out << "}\n";
+
+        if(options.output != "-")
+            std::cerr << "Benchmark results written to " << options.output << '\n';
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char** argv){
+    try{
+        return runBenchmark(parseOptions(argc, argv));
+    }
+    catch(const std::exception &exception){
+        std::cerr << exception.what() << '\n';
+        return EXIT_FAILURE;
+    }
+}
\ No newline at end of file
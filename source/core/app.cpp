@@ -10,9 +10,12 @@
 #include "engine/camera/camera_controller/camera_controller.hpp"
 #include "engine/material/texture/texture.hpp"
 #include "engine/material/sampler/sampler.hpp"
+#include "engine/profiling/gpu_profiler.hpp"
+#include "engine/pipeline/shader_library.hpp"
 
 namespace Application{
     App::App(){
+        device.getShaderLibrary().setHotReload(true);
         renderSystem.initializeRenderSystem();
     }
 
@@ -27,16 +30,36 @@ namespace Application{
 
         float intervalTime = 0;
         auto currentTime = std::chrono::steady_clock::now();
+#if defined(RENDERER_PROFILING)
+        bool summaryKeyDown = false, traceKeyDown = false;
+#endif
 
         while(!window.shouldClose()){
+            PROFILE_FRAME();
             glfwPollEvents();
+#if defined(RENDERER_PROFILING)
+            // F1 prints frame time percentiles and zone timings, F2 writes the recorded frames as a Chrome trace
+            bool summaryKey = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F1) == GLFW_PRESS;
+            bool traceKey = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F2) == GLFW_PRESS;
+            if(summaryKey && !summaryKeyDown)
+                Renderer::Profiler::shared().printSummary(std::cout);
+            if(traceKey && !traceKeyDown){
+                Renderer::Profiler::shared().writeChromeTrace("renderer_trace.json");
+                std::cout << "Trace written to renderer_trace.json" << '\n';
+            }
+            summaryKeyDown = summaryKey;
+            traceKeyDown = traceKey;
+#endif
             // Frametime Calculation
             auto newTime = std::chrono::steady_clock::now();
             float frameTime = std::chrono::duration<float, std::chrono::milliseconds::period>(newTime - currentTime).count();
             currentTime = newTime;
             intervalTime += frameTime;
             if(intervalTime >= 3000){
+                const auto& cullStats = renderSystem.getCullStats();
                 std::cout << "Frametime: " << frameTime << " ms" << '\n';
+                std::cout << "Instances drawn: " << cullStats.drawn << ", frustum culled: " << cullStats.frustumCulled 
+                    << ", occlusion culled: " << cullStats.occlusionCulled << '\n';
                 intervalTime = 0;
             }
 
@@ -48,16 +71,26 @@ namespace Application{
             float aspect = renderer.getAspectRatio();
             camera.setPerspectiveProjection(glm::radians(90.f), aspect, 0.1f, 100.f);
 
+            renderSystem.reloadShaders();
+            renderSystem.updateAssets();
             if (auto commandBuffer = renderer.beginFrame()) {
                 int frameIndex = renderer.getFrameIndex();
                 // Update
                 renderSystem.updateUniformBuffer(camera, frameIndex);
-                // Start Renderpass
-                renderer.beginSwapChainRenderPass(commandBuffer);
-                // Draw Objects
-                renderSystem.drawScene(commandBuffer, frameIndex);
-                // End Renderpass
-                renderer.endSwapChainRenderPass(commandBuffer);
+                renderSystem.updateInstanceData(frameIndex);
+                renderSystem.updateTextures(frameIndex);
+                // Cull (compute, has to happen before the renderpass begins)
+                renderSystem.cullScene(commandBuffer, frameIndex, renderer.getPreviousDepthImageView(), renderer.getExtent());
+                {
+                    PROFILE_GPU_SCOPE(commandBuffer, "Render pass");
+                    // Start Renderpass
+                    renderer.beginSwapChainRenderPass(commandBuffer);
+                    // Draw Objects
+                    renderSystem.drawScene(commandBuffer, frameIndex, renderer.getRenderPassInheritance(), renderer.getExtent());
+                    // End Renderpass
+                    renderer.endSwapChainRenderPass(commandBuffer);
+                }
+                renderSystem.finishScene(commandBuffer, frameIndex);
                 renderer.endFrame();
             }
         }
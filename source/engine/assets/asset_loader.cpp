@@ -0,0 +1,133 @@
+#include "asset_loader.hpp"
+
+#include "engine/upload/upload_manager.hpp"
+#include "engine/material/texture/texture_cache.hpp"
+
+#include <iostream>
+
+namespace Renderer{
+    AssetLoader::AssetLoader(Device& device, Scene& scene, JobSystem& jobSystem) : device{device}, scene{scene}, jobSystem{jobSystem},
+        textureFormat{TextureCache::getPreferredFormat(device)}, textureStreamer{device, scene}{
+        Texture::ImageData white{};
+        white.fill(1, 1, 0xffffffff);
+        placeholderTexture = std::make_shared<Texture>(device, white, PLACEHOLDER_TEXTURE_ID);
+    }
+
+    AssetLoader::~AssetLoader(){
+        // Workers still hold the file paths and write into the futures, let them finish before anything goes away
+        for(auto& model : pendingModels)
+            model.data.wait();
+        for(auto& texture : pendingTextures)
+            texture.data.wait();
+    }
+
+    AssetHandle AssetLoader::loadModel(const std::string& filepath){
+        PendingAsset<Model::ModelData> pending{};
+        pending.id = Model::reserveId();
+        pending.data = jobSystem.submit([filepath](){
+            Model::ModelData data{};
+            data.loadModel(filepath);
+            return data;
+        });
+
+        scene.modelPaths[pending.id] = filepath;
+        AssetHandle handle{pending.id, pending.ready.get_future().share()};
+        pendingModels.push_back(std::move(pending));
+        return handle;
+    }
+
+    AssetHandle AssetLoader::loadTexture(const std::string& filepath, unsigned int samplerId){
+        PendingAsset<Texture::ImageData> pending{};
+        pending.id = Texture::reserveId();
+        pending.samplerId = samplerId;
+        pending.data = jobSystem.submit([filepath, format = textureFormat](){
+            Texture::ImageData data{};
+            data.loadImage(filepath, format);
+            return data;
+        });
+
+        // The placeholder stands in under the reserved id until the real texture is created
+        scene.textures[pending.id] = placeholderTexture;
+        scene.texturePaths[pending.id] = filepath;
+
+        AssetHandle handle{pending.id, pending.ready.get_future().share()};
+        pendingTextures.push_back(std::move(pending));
+        return handle;
+    }
+
+    bool AssetLoader::update(){
+        return createFinishedAssets(false);
+    }
+
+    void AssetLoader::finishAll(){
+        createFinishedAssets(true);
+    }
+
+    bool AssetLoader::createFinishedAssets(bool wait){
+        auto isFinished = [wait](auto& pending){
+            return wait || pending.data.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+
+        std::vector<std::promise<void>> created;
+        for(size_t i = 0; i < pendingModels.size();){
+            auto& pending = pendingModels[i];
+            if(!isFinished(pending)){
+                i++;
+                continue;
+            }
+            try{
+                Model::ModelData data = pending.data.get();
+                scene.models[pending.id] = std::make_shared<Model>(*scene.geometryPool, data, pending.id);
+                created.push_back(std::move(pending.ready));
+            }
+            catch(const std::exception& e){
+                std::cout << "Failed to load model " << pending.id << ": " << e.what() << '\n';
+                failedCount++;
+                pending.ready.set_exception(std::current_exception());
+            }
+            pendingModels.erase(pendingModels.begin() + i);
+        }
+
+        for(size_t i = 0; i < pendingTextures.size();){
+            auto& pending = pendingTextures[i];
+            if(!isFinished(pending)){
+                i++;
+                continue;
+            }
+            try{
+                Texture::ImageData data = pending.data.get();
+                // Images that failed to decode are a small placeholder that isn't baked, those stay fully resident
+                std::shared_ptr<Texture> texture;
+                if(data.isBaked())
+                    texture = textureStreamer.add(std::move(data), pending.id, pending.samplerId);
+                else{
+                    texture = std::make_shared<Texture>(device, data, pending.id);
+                    texture->samplerId = pending.samplerId;
+                    failedCount++;
+                }
+                scene.textures[pending.id] = texture;
+                created.push_back(std::move(pending.ready));
+            }
+            catch(const std::exception& e){
+                std::cout << "Failed to load texture " << pending.id << ": " << e.what() << '\n';
+                failedCount++;
+                pending.ready.set_exception(std::current_exception());
+            }
+            pendingTextures.erase(pendingTextures.begin() + i);
+        }
+
+        if(created.empty())
+            return false;
+
+        // Everything created this call goes out in one upload submission. Frames submitted afterwards are ordered after it
+        // on the graphics queue, so there is no need to wait for it here.
+        UploadManager& uploader = device.getUploadManager();
+        if(wait)
+            uploader.flush();
+        else
+            uploader.submit();
+        for(auto& ready : created)
+            ready.set_value();
+        return true;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/jobs/job_system.hpp"
+#include "engine/scene/scene.hpp"
+#include "engine/material/texture/texture_streamer.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Renderer{
+    // Handle to an asset requested from the AssetLoader. The id is valid right away, ready is set once the asset has
+    // been added to the scene and its upload submitted.
+    struct AssetHandle{
+        unsigned int id;
+        std::shared_future<void> ready;
+
+        bool isReady() const { return ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+    };
+
+    // Decodes models and textures on the job system and hands the finished CPU data to the upload path on the main thread.
+    // Textures are represented by a shared placeholder until they are decoded, models simply don't exist in the scene until then.
+    // Baked textures are handed to the texture streamer, which only makes their small levels resident to begin with.
+    class AssetLoader{
+        public:
+            // Kept out of the id sequence so that requesting assets hands out the same ids as loading them directly
+            static constexpr unsigned int PLACEHOLDER_TEXTURE_ID = ~0u;
+
+            AssetLoader(Device& device, Scene& scene, JobSystem& jobSystem = JobSystem::shared());
+            ~AssetLoader();
+
+            AssetLoader(const AssetLoader&) = delete;
+            AssetLoader& operator=(const AssetLoader&) = delete;
+
+            AssetHandle loadModel(const std::string& filepath);
+            AssetHandle loadTexture(const std::string& filepath, unsigned int samplerId);
+
+            // Creates GPU resources for every finished decode and submits their uploads. Call once per frame on the main thread,
+            // returns true if any asset was added to the scene.
+            bool update();
+            // Blocks until every requested asset is in the scene
+            void finishAll();
+
+            size_t getPendingCount() { return pendingModels.size() + pendingTextures.size(); }
+            // Assets that failed to load so far: models that couldn't be parsed and textures that couldn't be decoded (those
+            // show a placeholder instead)
+            size_t getFailedCount() { return failedCount; }
+            std::shared_ptr<Texture> getPlaceholderTexture() { return placeholderTexture; }
+            TextureStreamer& getTextureStreamer() { return textureStreamer; }
+
+        private:
+            template<typename Data>
+            struct PendingAsset{
+                unsigned int id;
+                unsigned int samplerId;
+                std::future<Data> data;
+                std::promise<void> ready;
+            };
+
+            bool createFinishedAssets(bool wait);
+
+            Device& device;
+            Scene& scene;
+            JobSystem& jobSystem;
+            VkFormat textureFormat;     // Textures are baked into this format, see TextureCache
+            TextureStreamer textureStreamer;
+
+            std::vector<PendingAsset<Model::ModelData>> pendingModels;
+            std::vector<PendingAsset<Texture::ImageData>> pendingTextures;
+
+            std::shared_ptr<Texture> placeholderTexture;
+            size_t failedCount = 0;
+    };
+}
@@ -15,7 +15,7 @@ namespace Renderer{
     Buffer::~Buffer(){
         unmap();
         vkDestroyBuffer(device.getDevice(), buffer, nullptr);
-        vkFreeMemory(device.getDevice(), memory, nullptr);
+        device.getAllocator().free(allocation);
     }
 
     void Buffer::createbuffer(){
@@ -24,32 +24,42 @@ namespace Renderer{
         bufferInfo.size = bufferSize;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = sharingMode;
+        // Concurrent buffers are shared by the graphics and transfer queues, uploads write them without ownership transfers.
+        // With a single family there is nothing to share with.
+        uint32_t queueFamilies[2];
+        if(sharingMode == VK_SHARING_MODE_CONCURRENT){
+            QueueFamilyIndices indices = device.getPhysicalQueueFamilies();
+            queueFamilies[0] = indices.graphicsFamily;
+            queueFamilies[1] = indices.transferFamily;
+            if(indices.transferFamilyHasValue){
+                bufferInfo.queueFamilyIndexCount = 2;
+                bufferInfo.pQueueFamilyIndices = queueFamilies;
+            }
+            else
+                bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
 
         if(vkCreateBuffer(device.getDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
             throw std::runtime_error("Failed to create buffer.");
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device.getDevice(), buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, memoryPropertyFlags);
-
-        if (vkAllocateMemory(device.getDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
-            throw std::runtime_error("Failed to allocate vertex buffer memory.");
-        vkBindBufferMemory(device.getDevice(), buffer, memory, 0);
+        allocation = device.getAllocator().allocate(memRequirements, memoryPropertyFlags, true, this);
+        if (vkBindBufferMemory(device.getDevice(), buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+            throw std::runtime_error("Failed to bind buffer memory.");
     }
 
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset){
-        assert(buffer && memory && "Called map on buffer before create.");
-        return vkMapMemory(device.getDevice(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create.");
+        // Host visible memory is persistently mapped by the allocator, mapping just hands out a pointer into it
+        if (allocation.mapped == nullptr)
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        mapped = static_cast<char*>(allocation.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     void Buffer::unmap(){
-        if(mapped){
-            vkUnmapMemory(device.getDevice(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset){
@@ -63,45 +73,19 @@ namespace Renderer{
         }
     }
 
-    void Buffer::copyBuffer(VkBuffer dstBuffer, VkDeviceSize size){
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;
-        copyRegion.dstOffset = 0;
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, buffer, dstBuffer, 1, &copyRegion);
-
-        device.endSingleTimeCommands(commandBuffer);
-    }
-
-    void Buffer::copyBufferToImage(VkImage image, uint32_t width, uint32_t height){
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-        device.endSingleTimeCommands(commandBuffer);
+    void Buffer::readFromBuffer(void *data, VkDeviceSize size, VkDeviceSize offset){
+        assert(mapped && "Cannot read from unmapped buffer.");
+        if (size == VK_WHOLE_SIZE)
+            memcpy(data, mapped, bufferSize);
+        else {
+            char *memOffset = (char *)mapped;
+            memOffset += offset;
+            memcpy(data, memOffset, size);
+        }
     }
 
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(device.getDevice(), 1, &mappedRange);
+        return device.getAllocator().flush(allocation, size, offset);
     }
 
     VkDeviceSize Buffer::getAlignment(VkDeviceSize size, VkDeviceSize minOffsetAlignment){
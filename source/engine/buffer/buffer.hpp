@@ -19,8 +19,7 @@ namespace Renderer{
             void unmap();
             
             void writeToBuffer(void *data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
-            void copyBuffer(VkBuffer dstBuffer, VkDeviceSize size);
-            void copyBufferToImage(VkImage image, uint32_t width, uint32_t height);
+            void readFromBuffer(void *data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
             VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
             VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
@@ -31,7 +30,7 @@ namespace Renderer{
             
             void* mapped = nullptr;
             VkBuffer buffer = VK_NULL_HANDLE;
-            VkDeviceMemory memory = VK_NULL_HANDLE;
+            Allocation allocation{};
 
             VkDeviceSize bufferSize;
             VkBufferUsageFlags usage;
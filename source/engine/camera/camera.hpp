@@ -19,6 +19,7 @@ namespace Renderer{
             const glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
 
             bool enableFrustumCulling = true;
+            bool enableOcclusionCulling = true;
 
         private:
             glm::mat4 projectionMatrix{1.f};
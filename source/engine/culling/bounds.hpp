@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+namespace Renderer{
+    // Axis aligned bounding box, starts out empty (min > max) and grows with expand()
+    struct Bounds{
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{-std::numeric_limits<float>::max()};
+
+        void expand(const glm::vec3& point){
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+        void expand(const Bounds& other){
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+        glm::vec3 getExtent() const { return (max - min) * 0.5f; }
+        // Radius of the sphere around getCenter() that contains the box
+        float getRadius() const { return glm::length(getExtent()); }
+        float getSurfaceArea() const {
+            glm::vec3 size = max - min;
+            return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        bool overlaps(const Bounds& other) const {
+            return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y && min.z <= other.max.z && max.z >= other.min.z;
+        }
+        bool contains(const Bounds& other) const {
+            return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+        }
+
+        // Box around this box placed by an affine matrix (each axis of the matrix grows the box by its extent)
+        Bounds transformed(const glm::mat4& matrix) const {
+            if(isEmpty())
+                return *this;
+            glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.f));
+            glm::vec3 extent = getExtent();
+            glm::vec3 newExtent = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y + glm::abs(glm::vec3(matrix[2])) * extent.z;
+            return {center - newExtent, center + newExtent};
+        }
+
+        static Bounds merge(const Bounds& a, const Bounds& b){
+            return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+        }
+    };
+}
@@ -0,0 +1,391 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <array>
+#include <cassert>
+
+namespace Renderer{
+    namespace{
+        constexpr uint32_t SAH_BINS = 12;
+
+        // Slab test, returns the distance the ray enters the box at (or a negative value when it misses)
+        float intersectRay(const Bounds& bounds, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance){
+            float entry = 0.f;
+            float exit = maxDistance;
+            for(int axis = 0; axis < 3; axis++){
+                float near = (bounds.min[axis] - origin[axis]) * inverseDirection[axis];
+                float far = (bounds.max[axis] - origin[axis]) * inverseDirection[axis];
+                if(near > far)
+                    std::swap(near, far);
+                // NaN (origin on a slab of a parallel axis) keeps the previous values
+                entry = near > entry ? near : entry;
+                exit = far < exit ? far : exit;
+                if(entry > exit)
+                    return -1.f;
+            }
+            return entry;
+        }
+
+        glm::vec3 inverse(const glm::vec3& direction){
+            return {1.f / direction.x, 1.f / direction.y, 1.f / direction.z};
+        }
+    }
+
+    void Bvh::clear(){
+        nodes.clear();
+        root = NULL_NODE;
+        freeList = NULL_NODE;
+    }
+
+    void Bvh::build(std::span<const Item> items, std::vector<uint32_t>& proxies){
+        clear();
+        proxies.assign(items.size(), NULL_NODE);
+        if(items.empty())
+            return;
+        nodes.reserve(items.size() * 2 - 1);
+
+        std::vector<uint32_t> order(items.size());
+        std::iota(order.begin(), order.end(), 0);
+        root = buildRange(items, order, NULL_NODE, proxies);
+    }
+
+    uint32_t Bvh::buildRange(std::span<const Item> items, std::span<uint32_t> order, uint32_t parent, std::vector<uint32_t>& proxies){
+        uint32_t node = allocateNode();
+        nodes[node].parent = parent;
+
+        if(order.size() == 1){
+            const Item& item = items[order[0]];
+            nodes[node].bounds = fatten(item.bounds);
+            nodes[node].userData = item.userData;
+            proxies[order[0]] = node;
+            return node;
+        }
+
+        Bounds centroidBounds{};
+        for(auto index : order)
+            centroidBounds.expand(items[index].bounds.getCenter());
+
+        // Split along the widest centroid axis where the binned surface area cost is lowest
+        glm::vec3 centroidSize = centroidBounds.max - centroidBounds.min;
+        int axis = centroidSize.x > centroidSize.y ? (centroidSize.x > centroidSize.z ? 0 : 2) : (centroidSize.y > centroidSize.z ? 1 : 2);
+        size_t split = order.size() / 2;
+        if(centroidSize[axis] > 0.f){
+            struct Bin{
+                Bounds bounds{};
+                uint32_t count = 0;
+            };
+            std::array<Bin, SAH_BINS> bins{};
+            float binScale = SAH_BINS / centroidSize[axis];
+            auto binOf = [&](uint32_t index){
+                float offset = items[index].bounds.getCenter()[axis] - centroidBounds.min[axis];
+                return std::min(static_cast<uint32_t>(offset * binScale), SAH_BINS - 1);
+            };
+            for(auto index : order){
+                Bin& bin = bins[binOf(index)];
+                bin.bounds.expand(items[index].bounds);
+                bin.count++;
+            }
+
+            // Cost of splitting after bin i = area(left) * count(left) + area(right) * count(right)
+            std::array<float, SAH_BINS - 1> leftCosts{};
+            Bounds leftBounds{};
+            uint32_t leftCount = 0;
+            for(uint32_t i = 0; i < SAH_BINS - 1; i++){
+                leftBounds.expand(bins[i].bounds);
+                leftCount += bins[i].count;
+                leftCosts[i] = leftCount > 0 ? leftBounds.getSurfaceArea() * leftCount : 0.f;
+            }
+            Bounds rightBounds{};
+            uint32_t rightCount = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            uint32_t bestBin = 0;
+            for(uint32_t i = SAH_BINS - 1; i > 0; i--){
+                rightBounds.expand(bins[i].bounds);
+                rightCount += bins[i].count;
+                float cost = leftCosts[i - 1] + (rightCount > 0 ? rightBounds.getSurfaceArea() * rightCount : 0.f);
+                if(cost < bestCost){
+                    bestCost = cost;
+                    bestBin = i;
+                }
+            }
+
+            auto middle = std::partition(order.begin(), order.end(), [&](uint32_t index){ return binOf(index) < bestBin; });
+            size_t binnedSplit = static_cast<size_t>(middle - order.begin());
+            if(binnedSplit > 0 && binnedSplit < order.size())
+                split = binnedSplit;
+            else
+                std::nth_element(order.begin(), order.begin() + split, order.end(), [&](uint32_t a, uint32_t b){
+                    return items[a].bounds.getCenter()[axis] < items[b].bounds.getCenter()[axis];
+                });
+        }
+
+        // nodes may reallocate while building the children, don't hold references across the calls
+        uint32_t left = buildRange(items, order.subspan(0, split), node, proxies);
+        uint32_t right = buildRange(items, order.subspan(split), node, proxies);
+        nodes[node].left = left;
+        nodes[node].right = right;
+        nodes[node].bounds = Bounds::merge(nodes[left].bounds, nodes[right].bounds);
+        return node;
+    }
+
+    uint32_t Bvh::insert(const Bounds& bounds, uint32_t userData){
+        uint32_t leaf = allocateNode();
+        nodes[leaf].bounds = fatten(bounds);
+        nodes[leaf].userData = userData;
+        insertLeaf(leaf);
+        return leaf;
+    }
+
+    void Bvh::remove(uint32_t proxy){
+        assert(proxy < nodes.size() && nodes[proxy].isLeaf() && "Proxy is not a leaf of the tree.");
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    bool Bvh::update(uint32_t proxy, const Bounds& bounds){
+        assert(proxy < nodes.size() && nodes[proxy].isLeaf() && "Proxy is not a leaf of the tree.");
+        if(nodes[proxy].bounds.contains(bounds))
+            return false;
+        removeLeaf(proxy);
+        nodes[proxy].bounds = fatten(bounds);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void Bvh::insertLeaf(uint32_t leaf){
+        if(root == NULL_NODE){
+            root = leaf;
+            nodes[leaf].parent = NULL_NODE;
+            return;
+        }
+
+        // Walk down towards the sibling that grows the total surface area the least. Every node passed on the way is
+        // enlarged by the leaf (inheritedCost), descending stops when pairing with the current node is cheapest.
+        Bounds leafBounds = nodes[leaf].bounds;
+        uint32_t index = root;
+        while(!nodes[index].isLeaf()){
+            const Node& node = nodes[index];
+            float area = node.bounds.getSurfaceArea();
+            float combinedArea = Bounds::merge(node.bounds, leafBounds).getSurfaceArea();
+            float siblingCost = 2.f * combinedArea;
+            float inheritedCost = 2.f * (combinedArea - area);
+
+            auto childCost = [&](uint32_t child){
+                float mergedArea = Bounds::merge(nodes[child].bounds, leafBounds).getSurfaceArea();
+                if(nodes[child].isLeaf())
+                    return mergedArea + inheritedCost;
+                return mergedArea - nodes[child].bounds.getSurfaceArea() + inheritedCost;
+            };
+            float leftCost = childCost(node.left);
+            float rightCost = childCost(node.right);
+            if(siblingCost < leftCost && siblingCost < rightCost)
+                break;
+            index = leftCost < rightCost ? node.left : node.right;
+        }
+
+        uint32_t sibling = index;
+        uint32_t oldParent = nodes[sibling].parent;
+        uint32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].bounds = Bounds::merge(leafBounds, nodes[sibling].bounds);
+        nodes[newParent].left = sibling;
+        nodes[newParent].right = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if(oldParent == NULL_NODE)
+            root = newParent;
+        else if(nodes[oldParent].left == sibling)
+            nodes[oldParent].left = newParent;
+        else
+            nodes[oldParent].right = newParent;
+        refitAncestors(oldParent);
+    }
+
+    void Bvh::removeLeaf(uint32_t leaf){
+        if(leaf == root){
+            root = NULL_NODE;
+            return;
+        }
+
+        // The leaf's parent goes away, its sibling takes the parent's place
+        uint32_t parent = nodes[leaf].parent;
+        uint32_t grandParent = nodes[parent].parent;
+        uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        if(grandParent == NULL_NODE){
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+        }
+        else{
+            if(nodes[grandParent].left == parent)
+                nodes[grandParent].left = sibling;
+            else
+                nodes[grandParent].right = sibling;
+            nodes[sibling].parent = grandParent;
+            refitAncestors(grandParent);
+        }
+        freeNode(parent);
+        nodes[leaf].parent = NULL_NODE;
+    }
+
+    void Bvh::refitAncestors(uint32_t node){
+        while(node != NULL_NODE){
+            nodes[node].bounds = Bounds::merge(nodes[nodes[node].left].bounds, nodes[nodes[node].right].bounds);
+            node = nodes[node].parent;
+        }
+    }
+
+    void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const{
+        if(root == NULL_NODE)
+            return;
+        std::vector<uint32_t> stack{root};
+        while(!stack.empty()){
+            uint32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[index];
+
+            auto containment = frustum.classifyBounds(node.bounds);
+            if(containment == Frustum::Containment::Outside)
+                continue;
+            if(containment == Frustum::Containment::Inside || node.isLeaf()){
+                collectLeaves(index, results);
+                continue;
+            }
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    void Bvh::queryBounds(const Bounds& bounds, std::vector<uint32_t>& results) const{
+        if(root == NULL_NODE)
+            return;
+        std::vector<uint32_t> stack{root};
+        while(!stack.empty()){
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if(!node.bounds.overlaps(bounds))
+                continue;
+            if(node.isLeaf()){
+                results.push_back(node.userData);
+                continue;
+            }
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    void Bvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& results) const{
+        if(root == NULL_NODE)
+            return;
+        glm::vec3 inverseDirection = inverse(direction);
+        std::vector<uint32_t> stack{root};
+        while(!stack.empty()){
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if(intersectRay(node.bounds, origin, inverseDirection, maxDistance) < 0.f)
+                continue;
+            if(node.isLeaf()){
+                results.push_back(node.userData);
+                continue;
+            }
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    uint32_t Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance) const{
+        if(root == NULL_NODE)
+            return NULL_NODE;
+        glm::vec3 inverseDirection = inverse(direction);
+        uint32_t closest = NULL_NODE;
+        hitDistance = maxDistance;
+
+        // Nearer child is visited first, subtrees entered beyond the closest hit so far are skipped
+        std::vector<std::pair<uint32_t, float>> stack;
+        float rootEntry = intersectRay(nodes[root].bounds, origin, inverseDirection, maxDistance);
+        if(rootEntry >= 0.f)
+            stack.push_back({root, rootEntry});
+        while(!stack.empty()){
+            auto [index, entry] = stack.back();
+            stack.pop_back();
+            if(entry > hitDistance)
+                continue;
+            const Node& node = nodes[index];
+            if(node.isLeaf()){
+                closest = node.userData;
+                hitDistance = entry;
+                continue;
+            }
+            float leftEntry = intersectRay(nodes[node.left].bounds, origin, inverseDirection, hitDistance);
+            float rightEntry = intersectRay(nodes[node.right].bounds, origin, inverseDirection, hitDistance);
+            bool leftFirst = leftEntry >= 0.f && (rightEntry < 0.f || leftEntry <= rightEntry);
+            uint32_t first = leftFirst ? node.left : node.right;
+            uint32_t second = leftFirst ? node.right : node.left;
+            float firstEntry = leftFirst ? leftEntry : rightEntry;
+            float secondEntry = leftFirst ? rightEntry : leftEntry;
+            if(secondEntry >= 0.f)
+                stack.push_back({second, secondEntry});
+            if(firstEntry >= 0.f)
+                stack.push_back({first, firstEntry});
+        }
+        return closest;
+    }
+
+    float Bvh::getCost() const{
+        if(root == NULL_NODE || nodes[root].isLeaf())
+            return 0.f;
+        float rootArea = nodes[root].bounds.getSurfaceArea();
+        float total = 0.f;
+        std::vector<uint32_t> stack{root};
+        while(!stack.empty()){
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if(node.isLeaf())
+                continue;
+            total += node.bounds.getSurfaceArea();
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+        return rootArea > 0.f ? total / rootArea : 0.f;
+    }
+
+    void Bvh::collectLeaves(uint32_t node, std::vector<uint32_t>& results) const{
+        std::vector<uint32_t> stack{node};
+        while(!stack.empty()){
+            const Node& current = nodes[stack.back()];
+            stack.pop_back();
+            if(current.isLeaf()){
+                results.push_back(current.userData);
+                continue;
+            }
+            stack.push_back(current.left);
+            stack.push_back(current.right);
+        }
+    }
+
+    uint32_t Bvh::allocateNode(){
+        if(freeList != NULL_NODE){
+            uint32_t node = freeList;
+            freeList = nodes[node].left;
+            nodes[node] = Node{};
+            return node;
+        }
+        nodes.push_back(Node{});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void Bvh::freeNode(uint32_t node){
+        nodes[node].left = freeList;
+        nodes[node].right = NULL_NODE;
+        freeList = node;
+    }
+
+    Bounds Bvh::fatten(const Bounds& bounds) const{
+        if(bounds.isEmpty())
+            return bounds;
+        return {bounds.min - glm::vec3{margin}, bounds.max + glm::vec3{margin}};
+    }
+}
\ No newline at end of file
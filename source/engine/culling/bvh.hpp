@@ -0,0 +1,77 @@
+#pragma once
+
+#include "engine/culling/bounds.hpp"
+#include "engine/culling/frustum.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+namespace Renderer{
+    // Dynamic bounding volume hierarchy over axis aligned boxes, one leaf per item. build() creates the whole tree with a
+    // binned surface area heuristic, afterwards items can be inserted, removed and moved one at a time. Leaves store a
+    // box grown by a margin so small movements don't touch the tree, items leaving their box are reinserted where the
+    // surface area cost of the tree grows the least and the boxes above them are refit. Queries skip whole subtrees that are outside
+    // (and report whole subtrees that are inside) the query volume. Pure CPU, doesn't depend on the device.
+    class Bvh{
+        public:
+            static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+            struct Item{
+                Bounds bounds;
+                uint32_t userData;
+            };
+
+            Bvh(float margin = 0.1f) : margin{margin} {}
+
+            void clear();
+            // Replaces the tree, proxies receives the leaf of every item (in the same order)
+            void build(std::span<const Item> items, std::vector<uint32_t>& proxies);
+
+            // Returns the item's proxy, which stays valid until the item is removed or the tree is rebuilt
+            uint32_t insert(const Bounds& bounds, uint32_t userData);
+            void remove(uint32_t proxy);
+            // Returns true if the item left its grown box and had to be reinserted
+            bool update(uint32_t proxy, const Bounds& bounds);
+
+            // Append the userData of every item whose box the query touches
+            void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+            void queryBounds(const Bounds& bounds, std::vector<uint32_t>& results) const;
+            void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& results) const;
+            // Item whose box the ray enters first (distance in units of direction), or NULL_NODE
+            uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance) const;
+
+            uint32_t getUserData(uint32_t proxy) const { return nodes[proxy].userData; }
+            const Bounds& getBounds(uint32_t proxy) const { return nodes[proxy].bounds; }
+            bool empty() const { return root == NULL_NODE; }
+            // Sum of the surface areas of internal nodes relative to the root's, lower is a better tree
+            float getCost() const;
+
+        private:
+            struct Node{
+                Bounds bounds;
+                uint32_t parent = NULL_NODE;
+                uint32_t left = NULL_NODE;     // Next free node while the node is unused
+                uint32_t right = NULL_NODE;
+                uint32_t userData = 0;
+
+                bool isLeaf() const { return right == NULL_NODE; }
+            };
+
+            uint32_t allocateNode();
+            void freeNode(uint32_t node);
+            uint32_t buildRange(std::span<const Item> items, std::span<uint32_t> order, uint32_t parent, std::vector<uint32_t>& proxies);
+            void insertLeaf(uint32_t leaf);
+            void removeLeaf(uint32_t leaf);
+            void refitAncestors(uint32_t node);
+            void collectLeaves(uint32_t node, std::vector<uint32_t>& results) const;
+            Bounds fatten(const Bounds& bounds) const;
+
+            std::vector<Node> nodes;
+            uint32_t root = NULL_NODE;
+            uint32_t freeList = NULL_NODE;
+            float margin;
+    };
+}
\ No newline at end of file
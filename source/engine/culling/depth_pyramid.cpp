@@ -0,0 +1,228 @@
+#include "depth_pyramid.hpp"
+
+#include "engine/swap_chain/swap_chain.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+namespace Renderer{
+    DepthPyramid::DepthPyramid(Device& device, VkExtent2D extent, VkSampleCountFlagBits depthSamples) 
+    : device{device}, extent{extent}, depthSamples{depthSamples}{
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+
+        createImage();
+        createSampler();
+        createDescriptorSets();
+        createPipelines();
+    }
+
+    DepthPyramid::~DepthPyramid(){
+        depthPipeline.reset();
+        reducePipeline.reset();
+        vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device.getDevice(), descriptorSetLayout->getLayout(), nullptr);
+
+        vkDestroySampler(device.getDevice(), sampler, nullptr);
+        for(auto view : levelViews)
+            vkDestroyImageView(device.getDevice(), view, nullptr);
+        vkDestroyImageView(device.getDevice(), imageView, nullptr);
+        vkDestroyImage(device.getDevice(), image, nullptr);
+        device.getAllocator().free(imageAllocation);
+    }
+
+    void DepthPyramid::createImage(){
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageAllocation);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if(vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create depth pyramid image view.");
+
+        levelViews.resize(mipLevels);
+        for(uint32_t i = 0; i < mipLevels; i++){
+            viewInfo.subresourceRange.baseMipLevel = i;
+            viewInfo.subresourceRange.levelCount = 1;
+            if(vkCreateImageView(device.getDevice(), &viewInfo, nullptr, &levelViews[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create depth pyramid level view.");
+        }
+
+        // Culling binds the pyramid before the first build, it has to be in the general layout from the start
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        device.endSingleTimeCommands(commandBuffer);
+    }
+
+    void DepthPyramid::createSampler(){
+        // Only used with texelFetch, filtering never happens
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = static_cast<float>(mipLevels);
+
+        if(vkCreateSampler(device.getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create depth pyramid sampler.");
+    }
+
+    void DepthPyramid::createDescriptorSets(){
+        uint32_t setCount = SwapChain::MAX_FRAMES_IN_FLIGHT + mipLevels - 1;
+
+        descriptorPool = std::make_unique<DescriptorPool>(device);
+        descriptorPool->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount);
+        descriptorPool->addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount);
+        descriptorPool->buildPool(setCount);
+
+        descriptorSetLayout = std::make_unique<DescriptorSetLayout>(device);
+        descriptorSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);  // binding 0 (Input depth/level)
+        descriptorSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);          // binding 1 (Output level)
+        descriptorSetLayout->buildLayout();
+
+        // The depth attachment changes every frame and is written in build()
+        VkDescriptorImageInfo firstLevelInfo{VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+        for(uint32_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
+            descriptorPool->allocateSet(descriptorSetLayout->getLayout());
+            descriptorPool->updateSet(i, {descriptorSetLayout->writeImage(1, &firstLevelInfo)});
+        }
+
+        for(uint32_t level = 1; level < mipLevels; level++){
+            VkDescriptorImageInfo inputInfo{sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo outputInfo{VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+            descriptorPool->allocateSet(descriptorSetLayout->getLayout());
+            descriptorPool->updateSet(SwapChain::MAX_FRAMES_IN_FLIGHT + level - 1, {
+                descriptorSetLayout->writeImage(0, &inputInfo),
+                descriptorSetLayout->writeImage(1, &outputInfo),
+            });
+        }
+    }
+
+    void DepthPyramid::createPipelines(){
+        auto layout = descriptorSetLayout->getLayout();
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(PushConstants);
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &layout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create depth pyramid pipeline layout.");
+
+        depthPipeline = std::make_unique<ComputePipeline>(
+            device,
+            "hiz_depth.comp",
+            pipelineLayout
+        );
+        reducePipeline = std::make_unique<ComputePipeline>(
+            device,
+            "hiz_reduce.comp",
+            pipelineLayout
+        );
+    }
+
+    void DepthPyramid::reloadShaders(const std::vector<std::string>& changedShaders){
+        if(depthPipeline->usesShader(changedShaders))
+            depthPipeline->rebuild();
+        if(reducePipeline->usesShader(changedShaders))
+            reducePipeline->rebuild();
+    }
+
+    VkExtent2D DepthPyramid::getLevelExtent(uint32_t level){
+        return {std::max(1u, extent.width >> level), std::max(1u, extent.height >> level)};
+    }
+
+    VkDescriptorImageInfo DepthPyramid::descriptorInfo(){
+        return {sampler, imageView, VK_IMAGE_LAYOUT_GENERAL};
+    }
+
+    void DepthPyramid::dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, VkExtent2D inputSize, VkExtent2D outputSize){
+        PushConstants push{inputSize, outputSize, static_cast<uint32_t>(depthSamples)};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+        vkCmdDispatch(commandBuffer, (outputSize.width + 7) / 8, (outputSize.height + 7) / 8, 1);
+    }
+
+    void DepthPyramid::build(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView){
+        assert(supportsSampleCount(depthSamples) && "Depth pyramid can only be built from a multisampled depth attachment.");
+
+        VkDescriptorImageInfo depthInfo{sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        descriptorPool->updateSet(frameIndex, {descriptorSetLayout->writeImage(0, &depthInfo)});
+
+        // Culling of the previous frame may still be reading the pyramid, its contents are thrown away
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        depthPipeline->bind(commandBuffer);
+        dispatch(commandBuffer, descriptorPool->getSets()[frameIndex], extent, extent);
+
+        // Each level is read by the reduction of the next one
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        reducePipeline->bind(commandBuffer);
+        for(uint32_t level = 1; level < mipLevels; level++){
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.subresourceRange.levelCount = 1;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            dispatch(commandBuffer, descriptorPool->getSets()[SwapChain::MAX_FRAMES_IN_FLIGHT + level - 1], getLevelExtent(level - 1), getLevelExtent(level));
+        }
+
+        // Last level, read by culling
+        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+        barrier.subresourceRange.levelCount = 1;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
\ No newline at end of file
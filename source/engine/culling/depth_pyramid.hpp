@@ -0,0 +1,69 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/pipeline/pipeline.hpp"
+#include "engine/pipeline/descriptors/descriptors.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Renderer{
+    // Hierarchical depth (Hi-Z) pyramid built from a depth attachment, every texel holds the farthest depth of the texels
+    // it covers in the level below. Level 0 has the size of the depth attachment. The image stays in the general layout.
+    class DepthPyramid{
+        public:
+            DepthPyramid(Device& device, VkExtent2D extent, VkSampleCountFlagBits depthSamples);
+            ~DepthPyramid();
+
+            DepthPyramid(const DepthPyramid&) = delete;
+            DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+            // Only multisampled depth attachments can be reduced (the first pass reads a sampler2DMS)
+            static bool supportsSampleCount(VkSampleCountFlagBits depthSamples) { return depthSamples != VK_SAMPLE_COUNT_1_BIT; }
+
+            // Records the reduction of depthView (DEPTH_STENCIL_READ_ONLY_OPTIMAL, made visible to compute by the render pass)
+            // into the pyramid. The frame's descriptor set is rewritten, so the frame must not be in flight.
+            void build(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView);
+
+            // Whole mip chain, read with texelFetch
+            VkDescriptorImageInfo descriptorInfo();
+            VkExtent2D getExtent() { return extent; }
+            uint32_t getMipLevels() { return mipLevels; }
+
+            // Rebuilds the pipelines using any of the changed shaders, the pyramid must not be in use
+            void reloadShaders(const std::vector<std::string>& changedShaders);
+
+        private:
+            struct PushConstants{
+                VkExtent2D inputSize;
+                VkExtent2D outputSize;
+                uint32_t sampleCount;
+            };
+
+            void createImage();
+            void createSampler();
+            void createDescriptorSets();
+            void createPipelines();
+            VkExtent2D getLevelExtent(uint32_t level);
+            void dispatch(VkCommandBuffer commandBuffer, VkDescriptorSet set, VkExtent2D inputSize, VkExtent2D outputSize);
+
+            Device& device;
+            VkExtent2D extent;
+            VkSampleCountFlagBits depthSamples;
+            uint32_t mipLevels;
+
+            VkImage image = VK_NULL_HANDLE;
+            Allocation imageAllocation{};
+            VkImageView imageView = VK_NULL_HANDLE;     // All levels
+            std::vector<VkImageView> levelViews;
+            VkSampler sampler = VK_NULL_HANDLE;
+
+            // Sets 0 to MAX_FRAMES_IN_FLIGHT - 1 read the depth attachment, the following ones reduce level i into level i + 1
+            std::unique_ptr<DescriptorPool> descriptorPool;
+            std::unique_ptr<DescriptorSetLayout> descriptorSetLayout;
+
+            VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+            std::unique_ptr<ComputePipeline> depthPipeline;
+            std::unique_ptr<ComputePipeline> reducePipeline;
+    };
+}
\ No newline at end of file
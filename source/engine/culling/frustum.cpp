@@ -0,0 +1,75 @@
+#include "frustum.hpp"
+
+#include <algorithm>
+
+namespace Renderer{
+    Frustum Frustum::fromMatrix(const glm::mat4& viewProjection){
+        // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        auto row = [&](int i){
+            return glm::vec4{viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]};
+        };
+
+        Frustum frustum{};
+        frustum.planes[0] = row(3) + row(0);    // Left
+        frustum.planes[1] = row(3) - row(0);    // Right
+        frustum.planes[2] = row(3) + row(1);    // Bottom
+        frustum.planes[3] = row(3) - row(1);    // Top
+        frustum.planes[4] = row(2);             // Near (depth is zero to one)
+        frustum.planes[5] = row(3) - row(2);    // Far
+
+        for(auto& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const{
+        for(const auto& plane : planes)
+            if(glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+    bool Frustum::intersectsBounds(const Bounds& bounds) const{
+        for(const auto& plane : planes){
+            // Corner of the box furthest along the plane normal, if it is outside then so is the whole box
+            glm::vec3 positive{
+                plane.x >= 0.f ? bounds.max.x : bounds.min.x,
+                plane.y >= 0.f ? bounds.max.y : bounds.min.y,
+                plane.z >= 0.f ? bounds.max.z : bounds.min.z,
+            };
+            if(glm::dot(glm::vec3(plane), positive) + plane.w < 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    Frustum::Containment Frustum::classifyBounds(const Bounds& bounds) const{
+        Containment result = Containment::Inside;
+        for(const auto& plane : planes){
+            glm::vec3 normal{plane};
+            glm::vec3 positive{
+                plane.x >= 0.f ? bounds.max.x : bounds.min.x,
+                plane.y >= 0.f ? bounds.max.y : bounds.min.y,
+                plane.z >= 0.f ? bounds.max.z : bounds.min.z,
+            };
+            if(glm::dot(normal, positive) + plane.w < 0.f)
+                return Containment::Outside;
+            // Nearest corner, if it is behind the plane the box straddles it
+            glm::vec3 negative{
+                plane.x >= 0.f ? bounds.min.x : bounds.max.x,
+                plane.y >= 0.f ? bounds.min.y : bounds.max.y,
+                plane.z >= 0.f ? bounds.min.z : bounds.max.z,
+            };
+            if(glm::dot(normal, negative) + plane.w < 0.f)
+                result = Containment::Intersects;
+        }
+        return result;
+    }
+
+    bool Frustum::isInstanceVisible(const glm::mat4& modelMatrix, const glm::vec4& boundingSphere) const{
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(boundingSphere), 1.f));
+        // Non-uniform scale grows the sphere by the largest axis scale
+        float scale = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))});
+        return intersectsSphere(center, boundingSphere.w * scale);
+    }
+}
\ No newline at end of file
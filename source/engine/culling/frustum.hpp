@@ -0,0 +1,31 @@
+#pragma once
+
+#include "engine/culling/bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+namespace Renderer{
+    // View frustum as six inward facing planes (normal in xyz, distance in w), a point p is inside a plane when
+    // dot(plane.xyz, p) + plane.w >= 0. cull.comp runs isInstanceVisible() per instance, keep the two in sync.
+    struct Frustum{
+        enum class Containment{
+            Outside,
+            Intersects,
+            Inside
+        };
+
+        std::array<glm::vec4, 6> planes{};
+
+        // Extracts the planes of a projection * view matrix using Vulkan's zero to one depth range
+        static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+        bool intersectsSphere(const glm::vec3& center, float radius) const;
+        bool intersectsBounds(const Bounds& bounds) const;
+        // Like intersectsBounds() but also tells boxes that are completely inside apart, lets hierarchies skip testing children
+        Containment classifyBounds(const Bounds& bounds) const;
+        // Tests a model space bounding sphere (centre in xyz, radius in w) placed by modelMatrix
+        bool isInstanceVisible(const glm::mat4& modelMatrix, const glm::vec4& boundingSphere) const;
+    };
+}
\ No newline at end of file
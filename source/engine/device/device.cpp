@@ -1,5 +1,9 @@
 #include "device.hpp"
 
+#include "engine/upload/upload_manager.hpp"
+#include "engine/pipeline/pipeline_cache.hpp"
+#include "engine/pipeline/shader_library.hpp"
+
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
@@ -7,14 +11,23 @@
 #include <unordered_set>
 
 namespace Renderer{
-    Device::Device(Window& window) : window{window}{
+    Device::Device(Window& window) : window{&window}{
+        initVulkan();
+    }
+
+    Device::Device(){
         initVulkan();
     }
 
     Device::~Device(){
+        uploadManager.reset();
+        shaderLibrary.reset();
+        pipelineCache.reset();
         vkDestroyCommandPool(device, commandPool, nullptr);
+        allocator.reset();
         vkDestroyDevice(device, nullptr);
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if(surface != VK_NULL_HANDLE)
+            vkDestroySurfaceKHR(instance, surface, nullptr);
         if(Debugger::VulkanDebugger::enableValidationLayers) 
             debugger.destroyDebugUtilsMessengerEXT(instance, nullptr);
         vkDestroyInstance(instance, nullptr);
@@ -25,7 +38,11 @@ namespace Renderer{
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        createAllocator();
         createCommandPool();
+        createUploadManager();
+        createPipelineCache();
+        createShaderLibrary();
     }
 
     void Device::createInstance(){
@@ -66,16 +83,22 @@ namespace Renderer{
     }
 
     std::vector<const char*> Device::getRequiredExtensions(){
-        uint32_t count = 0;
-        const char** glfwRequiredExtensions = glfwGetRequiredInstanceExtensions(&count);
-        std::vector<const char*> extensions(glfwRequiredExtensions, glfwRequiredExtensions + count);
+        std::vector<const char*> extensions;
+        // Surface extensions are only needed when presenting, a headless instance doesn't touch GLFW at all
+        if(!isHeadless()){
+            uint32_t count = 0;
+            const char** glfwRequiredExtensions = glfwGetRequiredInstanceExtensions(&count);
+            extensions.assign(glfwRequiredExtensions, glfwRequiredExtensions + count);
+        }
         if (Debugger::VulkanDebugger::enableValidationLayers)
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         return extensions;
     }
 
     void Device::createSurface(){
-        window.createWindowSurface(instance, &surface);
+        if(isHeadless())
+            return;
+        window->createWindowSurface(instance, &surface);
     }
 
     void Device::pickPhysicalDevice(){
@@ -105,19 +128,30 @@ namespace Renderer{
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
-        bool swapChainAdequate = false;
+        bool swapChainAdequate = isHeadless();
 
-        if (extensionsSupported) {
+        if (extensionsSupported && !isHeadless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        VkPhysicalDeviceFeatures supportedFeatures;
-        vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+        VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+        supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supportedFeatures2{};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedFeatures12;
+        vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+        VkPhysicalDeviceFeatures& supportedFeatures = supportedFeatures2.features;
         bool hasRequiredFeatures = 
             supportedFeatures.samplerAnisotropy &&
             supportedFeatures.shaderSampledImageArrayDynamicIndexing && 
-            supportedFeatures.multiDrawIndirect;
+            supportedFeatures.multiDrawIndirect &&
+            supportedFeatures.fragmentStoresAndAtomics &&
+            supportedFeatures12.drawIndirectCount &&
+            supportedFeatures12.descriptorIndexing &&
+            supportedFeatures12.shaderSampledImageArrayNonUniformIndexing &&
+            supportedFeatures12.descriptorBindingPartiallyBound &&
+            supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind;
 
         return indices.isComplete() && extensionsSupported && swapChainAdequate && hasRequiredFeatures;
     }
@@ -159,8 +193,12 @@ namespace Renderer{
                 indices.graphicsFamily = i;
                 indices.graphicsFamilyHasValue = true;
             }
+            // Nothing is presented when headless, so the graphics queue stands in for the present queue
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (isHeadless())
+                presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+            else
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -169,6 +207,17 @@ namespace Renderer{
                 break;
             i++;
         }
+
+        // Prefer a dedicated DMA family (transfer only), otherwise any transfer capable family without graphics
+        for (uint32_t j = 0; j < queueFamilyCount; j++) {
+            VkQueueFlags flags = queueFamilies[j].queueFlags;
+            if (queueFamilies[j].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+                continue;
+            if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+                indices.transferFamily = j;
+                indices.transferFamilyHasValue = true;
+            }
+        }
         return indices;
     }
 
@@ -179,18 +228,27 @@ namespace Renderer{
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char*> extensions = getDeviceExtensions();
+        std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
         for (const auto& extension : availableExtensions)
             requiredExtensions.erase(extension.extensionName);
 
         return requiredExtensions.empty();
     }
 
+    std::vector<const char*> Device::getDeviceExtensions(){
+        if(isHeadless())
+            return {};
+        return deviceExtensions;
+    }
+
     void Device::createLogicalDevice(){
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+        if (indices.transferFamilyHasValue)
+            uniqueQueueFamilies.insert(indices.transferFamily);
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -207,25 +265,72 @@ namespace Renderer{
         features.fillModeNonSolid = VK_TRUE;
         features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
         features.multiDrawIndirect = VK_TRUE;
-
+        // main.frag reports the texture levels it samples for streaming
+        features.fragmentStoresAndAtomics = VK_TRUE;
+        // Baked textures are BC7 compressed where the device can sample it, see TextureCache::getPreferredFormat()
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        // Streamed textures bind and unbind their finer levels in place where the graphics queue can bind sparse memory,
+        // otherwise they are recreated whenever their resident levels change, see TextureStreamer
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        sparseResidency = supportedFeatures.sparseBinding && supportedFeatures.sparseResidencyImage2D &&
+            (queueFamilies[indices.graphicsFamily].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT);
+        features.sparseBinding = sparseResidency ? VK_TRUE : VK_FALSE;
+        features.sparseResidencyImage2D = sparseResidency ? VK_TRUE : VK_FALSE;
+
+        // Culled draws are issued with vkCmdDrawIndexedIndirectCount
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.drawIndirectCount = VK_TRUE;
+        // Bindless textures: one large, partially written texture array that is updated while bound
+        features12.descriptorIndexing = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
+        std::vector<const char*> extensions = getDeviceExtensions();
         VkDeviceCreateInfo deviceInfo = {};
         deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        deviceInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        deviceInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        deviceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        deviceInfo.ppEnabledExtensionNames = extensions.data();
         deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
         deviceInfo.pEnabledFeatures = &features;
-        deviceInfo.pNext = nullptr;
+        deviceInfo.pNext = &features12;
 
         if(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS)
             throw std::runtime_error("Failed to create logical device.");
         
         vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+        if (indices.transferFamilyHasValue)
+            vkGetDeviceQueue(device, indices.transferFamily, 0, &transferQueue);
+        else
+            transferQueue = graphicsQueue;
 
         hasRequiredExtensions();
     }
 
+    void Device::createAllocator(){
+        allocator = std::make_unique<MemoryAllocator>(device, physicalDevice);
+    }
+
+    void Device::createUploadManager(){
+        uploadManager = std::make_unique<UploadManager>(*this);
+    }
+
+    void Device::createPipelineCache(){
+        pipelineCache = std::make_unique<PipelineCache>(device, physicalDevice);
+    }
+
+    void Device::createShaderLibrary(){
+        shaderLibrary = std::make_unique<ShaderLibrary>(*this);
+    }
+
     void Device::createCommandPool(){
         QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
         VkCommandPoolCreateInfo poolInfo = {};
@@ -274,21 +379,15 @@ namespace Renderer{
         throw std::runtime_error("Failed to find supported format.");
     }
 
-    void Device::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+    void Device::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageAllocation) {
         if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
             throw std::runtime_error("Failed to create image.");
 
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-            throw std::runtime_error("Failed to allocate image memory.");
-        if (vkBindImageMemory(device, image, imageMemory, 0) != VK_SUCCESS)
+        imageAllocation = allocator->allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+        if (vkBindImageMemory(device, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS)
             throw std::runtime_error("Failed to bind image memory.");
     }
 
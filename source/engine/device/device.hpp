@@ -4,10 +4,16 @@
 
 #include "engine/window/window.hpp"
 #include "engine/debugging/vulkan_debugger.hpp"
+#include "engine/memory/memory_allocator.hpp"
 
 #include <vector>
+#include <memory>
 
 namespace Renderer{
+    class UploadManager;
+    class PipelineCache;
+    class ShaderLibrary;
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
 	    std::vector<VkSurfaceFormatKHR> formats;
@@ -15,14 +21,16 @@ namespace Renderer{
     };
 
     struct QueueFamilyIndices{
-        uint32_t graphicsFamily, presentFamily;
+        uint32_t graphicsFamily, presentFamily, transferFamily;
 	    bool graphicsFamilyHasValue = false, presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;    // Only set for a family without graphics support, optional
 	    bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
     class Device{
         public:
             Device(Window& window);
+            Device(); // Headless device, no surface or swap chain is created (frames are rendered to offscreen images)
             ~Device();
 
             // Getter Functions
@@ -34,12 +42,19 @@ namespace Renderer{
             VkCommandPool getCommandPool(){ return commandPool; }
             VkQueue getGraphicsQueue() { return graphicsQueue; }
             VkQueue getPresentQueue() { return presentQueue; }
+            VkQueue getTransferQueue() { return transferQueue; }    // Same as the graphics queue if there is no dedicated transfer family
+            MemoryAllocator& getAllocator() { return *allocator; }
+            UploadManager& getUploadManager() { return *uploadManager; }
+            PipelineCache& getPipelineCache() { return *pipelineCache; }
+            ShaderLibrary& getShaderLibrary() { return *shaderLibrary; }
             VkSampleCountFlagBits getMaxUsableSampleCount();
-            
+            bool isHeadless() { return window == nullptr; }
+            // sparseBinding and sparseResidencyImage2D are enabled and the graphics queue can bind sparse memory, see SparseImage
+            bool hasSparseResidency() { return sparseResidency; }
 
             // Other Public Functions
             VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
-            void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+            void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageAllocation);
             uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
             VkCommandBuffer beginSingleTimeCommands();
             void endSingleTimeCommands(VkCommandBuffer commandBuffer);
@@ -52,7 +67,11 @@ namespace Renderer{
             void createSurface();
             void pickPhysicalDevice();
             void createLogicalDevice();
+            void createAllocator();
             void createCommandPool();
+            void createUploadManager();
+            void createPipelineCache();
+            void createShaderLibrary();
 
             // Helper Functions
             std::vector<const char*> getRequiredExtensions();
@@ -60,20 +79,26 @@ namespace Renderer{
             SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
             QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
             bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+            std::vector<const char*> getDeviceExtensions();
             void hasRequiredExtensions();
 
             VkInstance instance;
             VkDevice device;
             VkPhysicalDevice physicalDevice;
             VkPhysicalDeviceProperties properties;
-            VkSurfaceKHR surface;
-            Window& window;
-            VkQueue graphicsQueue, presentQueue;
+            VkSurfaceKHR surface = VK_NULL_HANDLE;
+            Window* window = nullptr;
+            bool sparseResidency = false;
+            VkQueue graphicsQueue, presentQueue, transferQueue;
             VkCommandPool commandPool;
+            std::unique_ptr<MemoryAllocator> allocator;
+            std::unique_ptr<UploadManager> uploadManager;
+            std::unique_ptr<PipelineCache> pipelineCache;     // Saved to disk when the device is destroyed
+            std::unique_ptr<ShaderLibrary> shaderLibrary;
 
             Debugger::VulkanDebugger debugger;
 
-            // Expand this vector to include all needed device extensions
+            // Expand this vector to include all needed device extensions (only used when presenting to a window)
             const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     };
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "file_utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <atomic>
+#include <random>
+
+namespace Renderer{
+    uint64_t FileUtils::hash(const void* data, size_t size){
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t result = 14695981039346656037ull;
+        for(size_t i = 0; i < size; i++){
+            result ^= bytes[i];
+            result *= 1099511628211ull;
+        }
+        return result;
+    }
+
+    bool FileUtils::atomicWriteFile(const std::string& path, std::initializer_list<std::span<const std::byte>> parts){
+        std::error_code error;
+        std::string temporaryPath = getTemporaryPath(path);
+        {
+            std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+            if(!file)
+                return false;
+            for(auto part : parts)
+                file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+            if(!file){
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    std::string FileUtils::getTemporaryPath(const std::string& path){
+        // Workers may write the same cache entry at once (the same model loaded twice, a shader variant compiled by two
+        // pipelines), each gets its own file and the last rename wins. The process tag keeps separate runs apart.
+        static const uint32_t processTag = std::random_device{}();
+        static std::atomic<uint64_t> counter{0};
+        return path + ".tmp." + std::to_string(processTag) + "." + std::to_string(counter++);
+    }
+}
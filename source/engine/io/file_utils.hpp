@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <initializer_list>
+#include <cstdint>
+#include <cstddef>
+
+namespace Renderer{
+    // Helpers shared by the files the engine writes for itself (mesh, texture, shader and pipeline caches, scenes)
+    class FileUtils{
+        public:
+            // 64-bit FNV-1a
+            static uint64_t hash(const void* data, size_t size);
+
+            // Writes parts back to back into a temporary file next to path and renames it over path once it is complete,
+            // so readers (and a crash halfway through) never see a truncated file. Returns false if anything failed, path
+            // is left untouched then.
+            static bool atomicWriteFile(const std::string& path, std::initializer_list<std::span<const std::byte>> parts);
+            // Unique temporary file next to path for every call, atomicWriteFile() writes path through one. Also used for
+            // files written by other programs (glslc).
+            static std::string getTemporaryPath(const std::string& path);
+    };
+}
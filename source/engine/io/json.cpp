@@ -0,0 +1,310 @@
+#include "json.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <charconv>
+#include <cstdint>
+#include <cctype>
+#include <stdexcept>
+
+namespace Renderer{
+    class JsonValue::Parser{
+        public:
+            Parser(std::string_view text) : text{text} {}
+
+            JsonValue parseDocument(){
+                JsonValue value = parseValue(0);
+                skipWhitespace();
+                if(position != text.size())
+                    fail("Unexpected data after the value");
+                return value;
+            }
+
+        private:
+            // Deeper documents are almost certainly broken, this keeps recursion bounded
+            static constexpr int MAX_DEPTH = 256;
+
+            [[noreturn]] void fail(const std::string& message){
+                throw std::runtime_error("Failed to parse JSON: " + message + " at offset " + std::to_string(position));
+            }
+
+            void skipWhitespace(){
+                while(position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+                    position++;
+            }
+
+            bool consume(char c){
+                skipWhitespace();
+                if(position < text.size() && text[position] == c){
+                    position++;
+                    return true;
+                }
+                return false;
+            }
+
+            void expect(char c){
+                if(!consume(c))
+                    fail(std::string{"Expected '"} + c + "'");
+            }
+
+            bool consumeWord(std::string_view word){
+                if(text.substr(position, word.size()) != word)
+                    return false;
+                position += word.size();
+                return true;
+            }
+
+            JsonValue parseValue(int depth){
+                if(depth > MAX_DEPTH)
+                    fail("Nesting too deep");
+                skipWhitespace();
+                if(position >= text.size())
+                    fail("Unexpected end of input");
+
+                JsonValue value;
+                char c = text[position];
+                if(c == '{'){
+                    position++;
+                    value.type = Type::Object;
+                    if(consume('}'))
+                        return value;
+                    do{
+                        skipWhitespace();
+                        std::string key = parseString();
+                        expect(':');
+                        value.members.emplace_back(std::move(key), parseValue(depth + 1));
+                    } while(consume(','));
+                    expect('}');
+                }
+                else if(c == '['){
+                    position++;
+                    value.type = Type::Array;
+                    if(consume(']'))
+                        return value;
+                    do{
+                        value.array.push_back(parseValue(depth + 1));
+                    } while(consume(','));
+                    expect(']');
+                }
+                else if(c == '"'){
+                    value.type = Type::String;
+                    value.string = parseString();
+                }
+                else if(consumeWord("true")){
+                    value.type = Type::Bool;
+                    value.boolean = true;
+                }
+                else if(consumeWord("false"))
+                    value.type = Type::Bool;
+                else if(consumeWord("null"))
+                    value.type = Type::Null;
+                else{
+                    value.type = Type::Number;
+                    value.number = parseNumber();
+                }
+                return value;
+            }
+
+            // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, from_chars on its own would also take "01", ".5" or "1."
+            double parseNumber(){
+                size_t start = position;
+                consumeWord("-");
+                size_t integerStart = position;
+                size_t integerDigits = skipDigits();
+                if(integerDigits == 0 || (integerDigits > 1 && text[integerStart] == '0'))
+                    fail("Invalid number");
+                if(consumeWord(".") && skipDigits() == 0)
+                    fail("Invalid number");
+                if(consumeWord("e") || consumeWord("E")){
+                    if(!consumeWord("+"))
+                        consumeWord("-");
+                    if(skipDigits() == 0)
+                        fail("Invalid number");
+                }
+                double result = 0.0;
+                auto [end, error] = std::from_chars(text.data() + start, text.data() + position, result);
+                if(error != std::errc{} || end != text.data() + position)
+                    fail("Invalid number");
+                return result;
+            }
+
+            size_t skipDigits(){
+                size_t start = position;
+                while(position < text.size() && std::isdigit(static_cast<unsigned char>(text[position])))
+                    position++;
+                return position - start;
+            }
+
+            uint32_t parseHex4(){
+                if(position + 4 > text.size())
+                    fail("Invalid unicode escape");
+                uint32_t code = 0;
+                auto [end, error] = std::from_chars(text.data() + position, text.data() + position + 4, code, 16);
+                if(error != std::errc{} || end != text.data() + position + 4)
+                    fail("Invalid unicode escape");
+                position += 4;
+                return code;
+            }
+
+            void appendUtf8(std::string& out, uint32_t code){
+                if(code < 0x80)
+                    out += static_cast<char>(code);
+                else if(code < 0x800){
+                    out += static_cast<char>(0xc0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                else if(code < 0x10000){
+                    out += static_cast<char>(0xe0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                    out += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                else{
+                    out += static_cast<char>(0xf0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                    out += static_cast<char>(0x80 | (code & 0x3f));
+                }
+            }
+
+            std::string parseString(){
+                if(position >= text.size() || text[position] != '"')
+                    fail("Expected a string");
+                position++;
+                std::string result;
+                while(true){
+                    if(position >= text.size())
+                        fail("Unterminated string");
+                    char c = text[position++];
+                    if(c == '"')
+                        return result;
+                    if(static_cast<unsigned char>(c) < 0x20)
+                        fail("Unescaped control character");
+                    if(c != '\\'){
+                        result += c;
+                        continue;
+                    }
+                    if(position >= text.size())
+                        fail("Unterminated string");
+                    char escape = text[position++];
+                    switch(escape){
+                        case '"': result += '"'; break;
+                        case '\\': result += '\\'; break;
+                        case '/': result += '/'; break;
+                        case 'b': result += '\b'; break;
+                        case 'f': result += '\f'; break;
+                        case 'n': result += '\n'; break;
+                        case 'r': result += '\r'; break;
+                        case 't': result += '\t'; break;
+                        case 'u':{
+                            uint32_t code = parseHex4();
+                            // Characters past the BMP are a high surrogate followed by a low one, either on its own isn't a character
+                            if(code >= 0xdc00 && code <= 0xdfff)
+                                fail("Unpaired low surrogate");
+                            if(code >= 0xd800 && code < 0xdc00){
+                                if(!consumeWord("\\u"))
+                                    fail("Unpaired high surrogate");
+                                uint32_t low = parseHex4();
+                                if(low < 0xdc00 || low > 0xdfff)
+                                    fail("Invalid low surrogate");
+                                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            }
+                            appendUtf8(result, code);
+                            break;
+                        }
+                        default:
+                            fail("Invalid escape");
+                    }
+                }
+            }
+
+            std::string_view text;
+            size_t position = 0;
+    };
+
+    JsonValue JsonValue::parse(std::string_view text){
+        return Parser{text}.parseDocument();
+    }
+
+    JsonValue JsonValue::parseFile(const std::string& filepath){
+        std::ifstream file{filepath, std::ios::binary};
+        if(!file.is_open())
+            throw std::runtime_error("Failed to open file: " + filepath);
+        std::stringstream text;
+        text << file.rdbuf();
+        return parse(text.str());
+    }
+
+    bool JsonValue::asBool() const{
+        if(type != Type::Bool)
+            throw std::runtime_error("JSON value is not a bool.");
+        return boolean;
+    }
+
+    double JsonValue::asNumber() const{
+        if(type != Type::Number)
+            throw std::runtime_error("JSON value is not a number.");
+        return number;
+    }
+
+    const std::string& JsonValue::asString() const{
+        if(type != Type::String)
+            throw std::runtime_error("JSON value is not a string.");
+        return string;
+    }
+
+    const std::vector<JsonValue>& JsonValue::asArray() const{
+        if(type != Type::Array)
+            throw std::runtime_error("JSON value is not an array.");
+        return array;
+    }
+
+    const JsonValue* JsonValue::find(std::string_view key) const{
+        for(auto& [name, value] : members){
+            if(name == key)
+                return &value;
+        }
+        return nullptr;
+    }
+
+    double JsonValue::getNumber(std::string_view key, double fallback) const{
+        const JsonValue* value = find(key);
+        return value == nullptr ? fallback : value->asNumber();
+    }
+
+    bool JsonValue::getBool(std::string_view key, bool fallback) const{
+        const JsonValue* value = find(key);
+        return value == nullptr ? fallback : value->asBool();
+    }
+
+    void JsonValue::getFloats(std::string_view key, float* values, size_t count) const{
+        const JsonValue* value = find(key);
+        if(value == nullptr)
+            return;
+        auto& elements = value->asArray();
+        if(elements.size() != count)
+            throw std::runtime_error("JSON array \"" + std::string{key} + "\" must have " + std::to_string(count) + " elements.");
+        for(size_t i = 0; i < count; i++)
+            values[i] = static_cast<float>(elements[i].asNumber());
+    }
+
+    void JsonValue::writeString(std::ostream& out, std::string_view s){
+        out << '"';
+        for(char c : s){
+            switch(c){
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if(static_cast<unsigned char>(c) < 0x20){
+                        const char* digits = "0123456789abcdef";
+                        out << "\\u00" << digits[(c >> 4) & 0xf] << digits[c & 0xf];
+                    }
+                    else
+                        out << c;
+            }
+        }
+        out << '"';
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <ostream>
+
+namespace Renderer{
+    // Minimal JSON document for tooling formats (scene import/export), not meant for hot paths. Numbers are doubles and
+    // objects keep their members in file order.
+    class JsonValue{
+        public:
+            enum class Type{ Null, Bool, Number, String, Array, Object };
+
+            // Throws if text isn't a single valid JSON value
+            static JsonValue parse(std::string_view text);
+            static JsonValue parseFile(const std::string& filepath);
+
+            Type getType() const { return type; }
+            bool isNull() const { return type == Type::Null; }
+
+            // Typed accessors throw if the value has another type
+            bool asBool() const;
+            double asNumber() const;
+            const std::string& asString() const;
+            const std::vector<JsonValue>& asArray() const;
+
+            // Member of an object, nullptr if it is missing (or this isn't an object)
+            const JsonValue* find(std::string_view key) const;
+            // Member or fallback when it is missing
+            double getNumber(std::string_view key, double fallback) const;
+            bool getBool(std::string_view key, bool fallback) const;
+            // Fills count floats from an array member, missing members keep values as they are
+            void getFloats(std::string_view key, float* values, size_t count) const;
+
+            // Writes s as a quoted JSON string
+            static void writeString(std::ostream& out, std::string_view s);
+
+        private:
+            class Parser;
+
+            Type type = Type::Null;
+            bool boolean = false;
+            double number = 0.0;
+            std::string string;
+            std::vector<JsonValue> array;
+            std::vector<std::pair<std::string, JsonValue>> members;
+    };
+}
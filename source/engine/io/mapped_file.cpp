@@ -0,0 +1,88 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace Renderer{
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& filepath){
+        HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            return;
+        fileHandle = file;
+
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0){
+            close();
+            return;
+        }
+
+        mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mappingHandle == nullptr){
+            close();
+            return;
+        }
+
+        data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if(data == nullptr){
+            close();
+            return;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+    }
+
+    void MappedFile::close(){
+        if(data != nullptr)
+            UnmapViewOfFile(data);
+        if(mappingHandle != nullptr)
+            CloseHandle(mappingHandle);
+        if(fileHandle != nullptr)
+            CloseHandle(fileHandle);
+        data = nullptr;
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+        size = 0;
+    }
+#else
+    MappedFile::MappedFile(const std::string& filepath){
+        int file = open(filepath.c_str(), O_RDONLY);
+        if(file < 0)
+            return;
+
+        struct stat fileInfo;
+        if(fstat(file, &fileInfo) != 0 || fileInfo.st_size == 0){
+            ::close(file);
+            return;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* mapping = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if(mapping == MAP_FAILED)
+            return;
+
+        madvise(mapping, static_cast<size_t>(fileInfo.st_size), MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(mapping);
+        size = static_cast<size_t>(fileInfo.st_size);
+    }
+
+    void MappedFile::close(){
+        if(data != nullptr)
+            munmap(const_cast<uint8_t*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    MappedFile::~MappedFile(){
+        close();
+    }
+}
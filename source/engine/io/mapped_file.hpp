@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Renderer{
+    // Read-only memory mapping of a whole file, the mapping lives as long as the object
+    class MappedFile{
+        public:
+            MappedFile(const std::string& filepath);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            // False if the file doesn't exist, is empty or could not be mapped
+            bool isOpen() const { return data != nullptr; }
+            const uint8_t* getData() const { return data; }
+            size_t getSize() const { return size; }
+
+        private:
+            void close();
+
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+        #ifdef _WIN32
+            void* fileHandle = nullptr;
+            void* mappingHandle = nullptr;
+        #endif
+    };
+}
@@ -0,0 +1,102 @@
+#include "job_system.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+namespace Renderer{
+    JobSystem::JobSystem(uint32_t threadCount){
+        threadCount = std::max(threadCount, 1u);
+        workers.reserve(threadCount);
+        for(uint32_t i = 0; i < threadCount; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+
+    JobSystem::~JobSystem(){
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    JobSystem& JobSystem::shared(){
+        static JobSystem jobSystem{};
+        return jobSystem;
+    }
+
+    uint32_t JobSystem::defaultThreadCount(){
+        // Leave a core for the main (render) thread
+        uint32_t cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    void JobSystem::enqueue(std::function<void()> job){
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            jobs.push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    void JobSystem::workerLoop(){
+        while(true){
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                jobAvailable.wait(lock, [this](){ return stopping || !jobs.empty(); });
+                // Remaining jobs are still run when stopping so that no future is left without a value
+                if(jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    void JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t)>& job){
+        if(count == 0)
+            return;
+
+        // Shared with the helpers, one may only get to run after this call has returned
+        struct State{
+            std::atomic<uint32_t> nextIndex{0};
+            std::atomic<uint32_t> completed{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr exception;
+        };
+        auto state = std::make_shared<State>();
+        const std::function<void(uint32_t)>* body = &job;
+
+        auto run = [state, body, count](){
+            uint32_t index;
+            while((index = state->nextIndex.fetch_add(1)) < count){
+                try{
+                    (*body)(index);
+                }
+                catch(...){
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    if(!state->exception)
+                        state->exception = std::current_exception();
+                }
+                if(state->completed.fetch_add(1) + 1 == count){
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        uint32_t helperCount = std::min(count - 1, getThreadCount());
+        for(uint32_t i = 0; i < helperCount; i++)
+            enqueue(run);
+        run();
+
+        std::unique_lock<std::mutex> lock{state->mutex};
+        state->finished.wait(lock, [&](){ return state->completed.load() == count; });
+        if(state->exception)
+            std::rethrow_exception(state->exception);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace Renderer{
+    // Fixed size pool of worker threads for CPU work (asset decoding, mesh processing, command recording).
+    class JobSystem{
+        public:
+            JobSystem(uint32_t threadCount = defaultThreadCount());
+            ~JobSystem();
+
+            JobSystem(const JobSystem&) = delete;
+            JobSystem& operator=(const JobSystem&) = delete;
+
+            // Pool shared by the engine, created on first use
+            static JobSystem& shared();
+            static uint32_t defaultThreadCount();
+
+            // Runs job on a worker, exceptions thrown by the job are rethrown from the future's get()
+            template<typename Function>
+            std::future<std::invoke_result_t<Function>> submit(Function&& job){
+                using Result = std::invoke_result_t<Function>;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(job));
+                std::future<Result> result = task->get_future();
+                enqueue([task](){ (*task)(); });
+                return result;
+            }
+
+            // Calls job(i) for every i in [0, count) on the workers and the calling thread, returns once all calls are done.
+            // Safe to call from inside a job since the caller keeps taking indices instead of only waiting.
+            void parallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+            uint32_t getThreadCount() { return static_cast<uint32_t>(workers.size()); }
+
+        private:
+            void enqueue(std::function<void()> job);
+            void workerLoop();
+
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> jobs;
+            std::mutex mutex;
+            std::condition_variable jobAvailable;
+            bool stopping = false;
+    };
+}
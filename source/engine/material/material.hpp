@@ -14,11 +14,12 @@
 namespace Renderer{
     class Material{
         public:
+            // Laid out like std430, the render system uploads it as is
             struct MaterialProperties{
                 float opacity = 1.0f;   // Opacity of the material applied.
                 float shininess = 0.0f; // How intense specular reflections will be.
 
-                glm::vec4 diffuseColour = { 1.0f, 1.0f, 1.0f, 1.0f };   // Colour of diffuse reflections
+                alignas(16) glm::vec4 diffuseColour = { 1.0f, 1.0f, 1.0f, 1.0f };   // Colour of diffuse reflections
                 glm::vec4 specularColour = { 1.0f, 1.0f, 1.0f, 1.0f };  // Colour of specular reflections
                 glm::vec4 hue = { 1.0f, 1.0f, 1.0f, 1.0f };             // Overall hue of the material
             } properties{};
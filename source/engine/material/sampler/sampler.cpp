@@ -3,7 +3,7 @@
 #include <stdexcept>
 
 namespace Renderer{
-    Sampler::Sampler(Device& device, SamplerConfig samplerConfig, unsigned int samplerId) : device{device}, id{samplerId} {
+    Sampler::Sampler(Device& device, SamplerConfig samplerConfig, unsigned int samplerId) : device{device}, config{samplerConfig}, id{samplerId} {
         VkSamplerCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         createInfo.magFilter = samplerConfig.magFilter;
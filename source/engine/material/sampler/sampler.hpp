@@ -29,12 +29,14 @@ namespace Renderer{
             ~Sampler();
 
             unsigned int getId() { return id; }
+            const SamplerConfig& getConfig() const { return config; }
             VkSampler getSampler(){ return sampler; }
             static std::unique_ptr<Sampler> createSampler(Device& device, SamplerConfig samplerConfig);
 
         private:
             Device& device;
             VkSampler sampler;
+            SamplerConfig config;
 
             unsigned int id;
     };
@@ -0,0 +1,223 @@
+#include "block_compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace Renderer{
+    namespace{
+        // Interpolation weights of 4-bit BC7 indices, out of 64
+        constexpr int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // Mode 6 endpoints: 7 bits per channel plus one p-bit shared by the channels of an endpoint
+        struct Endpoints{
+            int colours[2][4];
+            int pBits[2];
+        };
+
+        int expand(int value, int pBit){
+            return (value << 1) | pBit;
+        }
+
+        void quantize(const float endpoint[4], int pBit, int out[4]){
+            for(int c = 0; c < 4; c++)
+                out[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - pBit) * 0.5f)), 0, 127);
+        }
+
+        // Picks the closest palette entry for every texel, returns the total squared error
+        int64_t assignIndices(const uint8_t texels[64], const Endpoints& endpoints, uint8_t indices[16]){
+            int palette[16][4];
+            for(int c = 0; c < 4; c++){
+                int e0 = expand(endpoints.colours[0][c], endpoints.pBits[0]);
+                int e1 = expand(endpoints.colours[1][c], endpoints.pBits[1]);
+                for(int i = 0; i < 16; i++)
+                    palette[i][c] = ((64 - WEIGHTS[i]) * e0 + WEIGHTS[i] * e1 + 32) >> 6;
+            }
+
+            int64_t totalError = 0;
+            for(int t = 0; t < 16; t++){
+                int bestError = std::numeric_limits<int>::max();
+                for(int i = 0; i < 16; i++){
+                    int error = 0;
+                    for(int c = 0; c < 4; c++){
+                        int difference = texels[t * 4 + c] - palette[i][c];
+                        error += difference * difference;
+                    }
+                    if(error < bestError){
+                        bestError = error;
+                        indices[t] = static_cast<uint8_t>(i);
+                    }
+                }
+                totalError += bestError;
+            }
+            return totalError;
+        }
+
+        // Tries every p-bit combination for a pair of unquantized endpoints, keeps the result if it beats bestError
+        void fitEndpoints(const uint8_t texels[64], const float low[4], const float high[4], Endpoints& best, uint8_t bestIndices[16], int64_t& bestError){
+            for(int p = 0; p < 4; p++){
+                Endpoints candidate{};
+                candidate.pBits[0] = p & 1;
+                candidate.pBits[1] = p >> 1;
+                quantize(low, candidate.pBits[0], candidate.colours[0]);
+                quantize(high, candidate.pBits[1], candidate.colours[1]);
+
+                uint8_t indices[16];
+                int64_t error = assignIndices(texels, candidate, indices);
+                if(error < bestError){
+                    bestError = error;
+                    best = candidate;
+                    std::memcpy(bestIndices, indices, 16);
+                }
+            }
+        }
+
+        // Bits are packed from the least significant bit of the first byte
+        class BitWriter{
+            public:
+                BitWriter(uint8_t* out) : out{out} { std::memset(out, 0, BlockCompression::BC7_BLOCK_SIZE); }
+
+                void write(uint32_t value, int count){
+                    for(int i = 0; i < count; i++, position++){
+                        if((value >> i) & 1)
+                            out[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+                    }
+                }
+
+            private:
+                uint8_t* out;
+                int position = 0;
+        };
+    }
+
+    size_t BlockCompression::getBc7Size(uint32_t width, uint32_t height){
+        size_t blocksX = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        size_t blocksY = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        return blocksX * blocksY * BC7_BLOCK_SIZE;
+    }
+
+    void BlockCompression::encodeBc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks){
+        uint32_t blocksX = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        uint32_t blocksY = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+        uint8_t texels[64];
+        for(uint32_t by = 0; by < blocksY; by++){
+            for(uint32_t bx = 0; bx < blocksX; bx++){
+                for(uint32_t y = 0; y < BLOCK_DIMENSION; y++){
+                    uint32_t sourceY = std::min(by * BLOCK_DIMENSION + y, height - 1);
+                    for(uint32_t x = 0; x < BLOCK_DIMENSION; x++){
+                        uint32_t sourceX = std::min(bx * BLOCK_DIMENSION + x, width - 1);
+                        std::memcpy(&texels[(y * BLOCK_DIMENSION + x) * 4], &rgba[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+                    }
+                }
+                encodeBc7Block(texels, blocks + (static_cast<size_t>(by) * blocksX + bx) * BC7_BLOCK_SIZE);
+            }
+        }
+    }
+
+    void BlockCompression::encodeBc7Block(const uint8_t texels[64], uint8_t block[BC7_BLOCK_SIZE]){
+        // Endpoints start at the extremes of the texels along their principal axis
+        float mean[4] = {};
+        for(int t = 0; t < 16; t++){
+            for(int c = 0; c < 4; c++)
+                mean[c] += texels[t * 4 + c] / 16.f;
+        }
+        float covariance[4][4] = {};
+        for(int t = 0; t < 16; t++){
+            float offset[4];
+            for(int c = 0; c < 4; c++)
+                offset[c] = texels[t * 4 + c] - mean[c];
+            for(int i = 0; i < 4; i++){
+                for(int j = 0; j < 4; j++)
+                    covariance[i][j] += offset[i] * offset[j];
+            }
+        }
+        // Power iteration from the covariance row of the channel that varies most, a fixed start vector can be orthogonal to
+        // the axis (a gradient from red to green has none of (1, 1, 1, 1) in it)
+        int widest = 0;
+        for(int c = 1; c < 4; c++){
+            if(covariance[c][c] > covariance[widest][widest])
+                widest = c;
+        }
+        float axis[4];
+        std::copy(covariance[widest], covariance[widest] + 4, axis);
+        for(int iteration = 0; iteration < 8; iteration++){
+            float next[4] = {};
+            for(int i = 0; i < 4; i++){
+                for(int j = 0; j < 4; j++)
+                    next[i] += covariance[i][j] * axis[j];
+            }
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            // Flat blocks have no axis, both endpoints end up at the mean
+            if(length < 1e-6f){
+                std::fill(axis, axis + 4, 0.f);
+                break;
+            }
+            for(int c = 0; c < 4; c++)
+                axis[c] = next[c] / length;
+        }
+        float minProjection = 0.f, maxProjection = 0.f;
+        for(int t = 0; t < 16; t++){
+            float projection = 0.f;
+            for(int c = 0; c < 4; c++)
+                projection += (texels[t * 4 + c] - mean[c]) * axis[c];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        float low[4], high[4];
+        for(int c = 0; c < 4; c++){
+            low[c] = mean[c] + axis[c] * minProjection;
+            high[c] = mean[c] + axis[c] * maxProjection;
+        }
+
+        Endpoints endpoints{};
+        uint8_t indices[16];
+        int64_t error = std::numeric_limits<int64_t>::max();
+        fitEndpoints(texels, low, high, endpoints, indices, error);
+
+        // One least squares refit of the endpoints to the chosen indices
+        if(error > 0){
+            float aa = 0.f, ab = 0.f, bb = 0.f;
+            float ax[4] = {}, bx[4] = {};
+            for(int t = 0; t < 16; t++){
+                float b = WEIGHTS[indices[t]] / 64.f;
+                float a = 1.f - b;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for(int c = 0; c < 4; c++){
+                    ax[c] += a * texels[t * 4 + c];
+                    bx[c] += b * texels[t * 4 + c];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if(std::abs(determinant) > 1e-6f){
+                for(int c = 0; c < 4; c++){
+                    low[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+                    high[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+                }
+                fitEndpoints(texels, low, high, endpoints, indices, error);
+            }
+        }
+
+        // The first index is stored with its top bit implied to be zero, swapping the endpoints makes it so
+        if(indices[0] >= 8){
+            std::swap(endpoints.colours[0], endpoints.colours[1]);
+            std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+            for(auto& index : indices)
+                index = static_cast<uint8_t>(15 - index);
+        }
+
+        BitWriter writer{block};
+        writer.write(1 << 6, 7);    // Mode 6
+        for(int c = 0; c < 4; c++){
+            writer.write(endpoints.colours[0][c], 7);
+            writer.write(endpoints.colours[1][c], 7);
+        }
+        writer.write(endpoints.pBits[0], 1);
+        writer.write(endpoints.pBits[1], 1);
+        writer.write(indices[0], 3);
+        for(int t = 1; t < 16; t++)
+            writer.write(indices[t], 4);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Renderer{
+    // CPU block compression for baked textures. BC7 is encoded in mode 6 only (one subset, RGBA endpoints with p-bits,
+    // 4-bit indices). That handles colour and alpha in every block at a fixed 8 bits per texel and keeps the encoder small,
+    // at the cost of the quality the partitioned modes reach on blocks with several distinct colours.
+    class BlockCompression{
+        public:
+            static constexpr uint32_t BLOCK_DIMENSION = 4;     // Texels per block side
+            static constexpr uint32_t BC7_BLOCK_SIZE = 16;     // Bytes per block
+
+            static size_t getBc7Size(uint32_t width, uint32_t height);
+            // Encodes width * height RGBA8 texels into getBc7Size() bytes of blocks. Blocks past the edge of the image
+            // repeat its last row and column.
+            static void encodeBc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+            static void encodeBc7Block(const uint8_t texels[64], uint8_t block[BC7_BLOCK_SIZE]);
+    };
+}
@@ -0,0 +1,202 @@
+#include "mip_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MIP_GENERATOR_SSE2
+#endif
+
+namespace Renderer{
+    namespace{
+        constexpr uint32_t BAND_ROWS = 16;      // Destination rows per job
+        constexpr float KAISER_RADIUS = 3.f;    // In source texels
+        constexpr float KAISER_BETA = 4.f;
+        constexpr int KAISER_TAPS = 6;
+        constexpr double PI = 3.14159265358979323846;
+
+        // RGBA in linear space
+#if defined(MIP_GENERATOR_SSE2)
+        using Texel = __m128;
+
+        inline Texel zero() { return _mm_setzero_ps(); }
+        inline Texel load(const float* p) { return _mm_loadu_ps(p); }
+        inline void store(float* p, Texel v) { _mm_storeu_ps(p, v); }
+        inline Texel multiplyAdd(Texel sum, Texel v, float weight) { return _mm_add_ps(sum, _mm_mul_ps(v, _mm_set1_ps(weight))); }
+        // Clamps to [0, 1] and scales colour to the sRGB table's range, alpha to 8 bits
+        inline void quantize(Texel v, int out[4]){
+            v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+            v = _mm_mul_ps(v, _mm_setr_ps(65535.f, 65535.f, 65535.f, 255.f));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvtps_epi32(v));
+        }
+#else
+        struct Texel{ float channels[4]; };
+
+        inline Texel zero() { return Texel{}; }
+        inline Texel load(const float* p) { return Texel{{p[0], p[1], p[2], p[3]}}; }
+        inline void store(float* p, Texel v) { std::copy(v.channels, v.channels + 4, p); }
+        inline Texel multiplyAdd(Texel sum, Texel v, float weight){
+            for(int c = 0; c < 4; c++)
+                sum.channels[c] += v.channels[c] * weight;
+            return sum;
+        }
+        inline void quantize(Texel v, int out[4]){
+            const float scale[4] = {65535.f, 65535.f, 65535.f, 255.f};
+            for(int c = 0; c < 4; c++)
+                out[c] = static_cast<int>(std::lround(std::clamp(v.channels[c], 0.f, 1.f) * scale[c]));
+        }
+#endif
+
+        const std::array<float, 256>& getLinearTable(){
+            static const std::array<float, 256> table = [](){
+                std::array<float, 256> values{};
+                for(int i = 0; i < 256; i++){
+                    float value = i / 255.f;
+                    values[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        // Indexed by linear colour in 16 bits, fine enough that dark values still round to the right sRGB value
+        const std::vector<uint8_t>& getSrgbTable(){
+            static const std::vector<uint8_t> table = [](){
+                std::vector<uint8_t> values(65536);
+                for(size_t i = 0; i < values.size(); i++){
+                    float value = i / 65535.f;
+                    value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+                    values[i] = static_cast<uint8_t>(std::clamp(value * 255.f + 0.5f, 0.f, 255.f));
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        double besselI0(double x){
+            double sum = 1.0, term = 1.0;
+            for(int k = 1; k < 32; k++){
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // Destination texel i reads source texels step * i + offset + k for every weight k, clamped to the edge
+        struct AxisFilter{
+            std::vector<float> weights;
+            int offset = 0;
+            uint32_t step = 2;
+        };
+
+        AxisFilter createAxisFilter(uint32_t size, MipGenerator::Filter filter){
+            AxisFilter axis{};
+            // Sides that are already 1 texel are copied
+            if(size == 1){
+                axis.weights = {1.f};
+                axis.step = 1;
+                return axis;
+            }
+            if(filter == MipGenerator::Filter::Box){
+                axis.weights = {0.5f, 0.5f};
+                return axis;
+            }
+
+            // Taps sit at half texel distances from the destination texel's centre
+            axis.offset = 1 - KAISER_TAPS / 2;
+            double total = 0.0;
+            for(int k = 0; k < KAISER_TAPS; k++){
+                double distance = k - (KAISER_TAPS - 1) / 2.0;
+                double x = distance / 2.0;      // In destination texels
+                double sinc = std::sin(PI * x) / (PI * x);
+                double ratio = distance / KAISER_RADIUS;
+                double window = besselI0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / besselI0(KAISER_BETA);
+                axis.weights.push_back(static_cast<float>(sinc * window));
+                total += sinc * window;
+            }
+            for(auto& weight : axis.weights)
+                weight = static_cast<float>(weight / total);
+            return axis;
+        }
+    }
+
+    std::vector<MipGenerator::Level> MipGenerator::generate(const uint8_t* rgba, uint32_t width, uint32_t height, Filter filter, JobSystem& jobSystem){
+        std::vector<Level> levels;
+        const uint8_t* source = rgba;
+        while(width > 1 || height > 1){
+            Level level{};
+            level.width = std::max(width / 2, 1u);
+            level.height = std::max(height / 2, 1u);
+            level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+            downsample(source, width, height, level.pixels.data(), filter, jobSystem);
+            levels.push_back(std::move(level));
+
+            source = levels.back().pixels.data();
+            width = levels.back().width;
+            height = levels.back().height;
+        }
+        return levels;
+    }
+
+    void MipGenerator::downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, Filter filter, JobSystem& jobSystem){
+        uint32_t destinationWidth = std::max(width / 2, 1u);
+        uint32_t destinationHeight = std::max(height / 2, 1u);
+        AxisFilter horizontal = createAxisFilter(width, filter);
+        AxisFilter vertical = createAxisFilter(height, filter);
+        const auto& linearTable = getLinearTable();
+        const auto& srgbTable = getSrgbTable();
+
+        uint32_t bandCount = (destinationHeight + BAND_ROWS - 1) / BAND_ROWS;
+        jobSystem.parallelFor(bandCount, [&](uint32_t band){
+            uint32_t firstRow = band * BAND_ROWS;
+            uint32_t endRow = std::min(firstRow + BAND_ROWS, destinationHeight);
+            int firstSourceRow = static_cast<int>(firstRow * vertical.step) + vertical.offset;
+            int endSourceRow = static_cast<int>((endRow - 1) * vertical.step) + vertical.offset + static_cast<int>(vertical.weights.size());
+
+            // Horizontal pass over every source row the band reads, rows past the edge repeat the last one
+            std::vector<float> linearRow(static_cast<size_t>(width) * 4);
+            std::vector<float> filteredRows(static_cast<size_t>(endSourceRow - firstSourceRow) * destinationWidth * 4);
+            for(int row = firstSourceRow; row < endSourceRow; row++){
+                const uint8_t* sourceRow = source + static_cast<size_t>(std::clamp(row, 0, static_cast<int>(height) - 1)) * width * 4;
+                for(size_t i = 0; i < static_cast<size_t>(width) * 4; i += 4){
+                    linearRow[i] = linearTable[sourceRow[i]];
+                    linearRow[i + 1] = linearTable[sourceRow[i + 1]];
+                    linearRow[i + 2] = linearTable[sourceRow[i + 2]];
+                    linearRow[i + 3] = sourceRow[i + 3] / 255.f;
+                }
+
+                float* filtered = &filteredRows[static_cast<size_t>(row - firstSourceRow) * destinationWidth * 4];
+                for(uint32_t x = 0; x < destinationWidth; x++){
+                    int first = static_cast<int>(x * horizontal.step) + horizontal.offset;
+                    Texel sum = zero();
+                    for(size_t k = 0; k < horizontal.weights.size(); k++){
+                        int column = std::clamp(first + static_cast<int>(k), 0, static_cast<int>(width) - 1);
+                        sum = multiplyAdd(sum, load(&linearRow[static_cast<size_t>(column) * 4]), horizontal.weights[k]);
+                    }
+                    store(&filtered[static_cast<size_t>(x) * 4], sum);
+                }
+            }
+
+            // Vertical pass, straight back to sRGB
+            for(uint32_t y = firstRow; y < endRow; y++){
+                int first = static_cast<int>(y * vertical.step) + vertical.offset - firstSourceRow;
+                uint8_t* destinationRow = destination + static_cast<size_t>(y) * destinationWidth * 4;
+                for(uint32_t x = 0; x < destinationWidth; x++){
+                    Texel sum = zero();
+                    for(size_t k = 0; k < vertical.weights.size(); k++)
+                        sum = multiplyAdd(sum, load(&filteredRows[(static_cast<size_t>(first + k) * destinationWidth + x) * 4]), vertical.weights[k]);
+
+                    int quantized[4];
+                    quantize(sum, quantized);
+                    uint8_t* texel = &destinationRow[static_cast<size_t>(x) * 4];
+                    texel[0] = srgbTable[quantized[0]];
+                    texel[1] = srgbTable[quantized[1]];
+                    texel[2] = srgbTable[quantized[2]];
+                    texel[3] = static_cast<uint8_t>(quantized[3]);
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "engine/jobs/job_system.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace Renderer{
+    // Builds mip chains of RGBA8 sRGB images on the CPU. Colour is filtered in linear space (alpha as is), one texel's four
+    // channels at a time with SSE2 when available. Each level is split into bands of rows that run on the job system.
+    // Every level is filtered from the one above it.
+    class MipGenerator{
+        public:
+            enum class Filter : uint32_t{
+                Box = 0,        // 2x2 average
+                Kaiser = 1,     // Kaiser windowed sinc over 6x6 texels, keeps smaller mips sharper than the box
+            };
+
+            struct Level{
+                std::vector<uint8_t> pixels;
+                uint32_t width = 0, height = 0;
+            };
+
+            // Every level after the given one, down to 1x1
+            static std::vector<Level> generate(const uint8_t* rgba, uint32_t width, uint32_t height, Filter filter,
+                JobSystem& jobSystem = JobSystem::shared());
+            // Halves each side of the image that is larger than 1, destination holds the resulting RGBA8 texels
+            static void downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, Filter filter,
+                JobSystem& jobSystem = JobSystem::shared());
+    };
+}
@@ -0,0 +1,313 @@
+#include "sparse_image.hpp"
+
+#include "engine/upload/upload_manager.hpp"
+
+#include <stdexcept>
+#include <cassert>
+#include <span>
+#include <algorithm>
+
+namespace Renderer{
+    SparseLevel::~SparseLevel(){
+        // Textures viewing the level are gone, and with them every frame in flight that sampled it (see RenderSystem). The
+        // binding is left to unbindReleasedLevels(), which can report a failure and unbinds the levels of all images at once.
+        image->releasedLevels.push_back({level, allocation});
+    }
+
+    bool SparseImage::isSupported(Device& device, VkFormat format){
+        if(!device.hasSparseResidency())
+            return false;
+        uint32_t propertyCount = 0;
+        vkGetPhysicalDeviceSparseImageFormatProperties(device.getPhysicalDevice(), format, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_TILING_OPTIMAL, &propertyCount, nullptr);
+        return propertyCount > 0;
+    }
+
+    SparseImage::SparseImage(Device& device, const Texture::ImageData& data, uint32_t startupLevel) : device{device}{
+        assert(data.isBaked() && startupLevel < data.levels.size() && "Sparse images hold baked textures.");
+        createImage(data);
+
+        vkGetImageMemoryRequirements(device.getDevice(), image, &memoryRequirements);
+        uint32_t requirementCount = 0;
+        vkGetImageSparseMemoryRequirements(device.getDevice(), image, &requirementCount, nullptr);
+        std::vector<VkSparseImageMemoryRequirements> requirements(requirementCount);
+        vkGetImageSparseMemoryRequirements(device.getDevice(), image, &requirementCount, requirements.data());
+
+        bool hasColor = false;
+        for(const auto& requirement : requirements){
+            if(requirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT){
+                colorRequirements = requirement;
+                hasColor = true;
+            }
+            if(requirement.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT){
+                metadataRequirements = requirement;
+                hasMetadata = true;
+            }
+        }
+        if(!hasColor){
+            vkDestroyImage(device.getDevice(), image, nullptr);
+            throw std::runtime_error("Failed to get the sparse memory requirements of a texture image.");
+        }
+
+        // Levels in the mip tail can only be bound together, they are all permanent
+        permanentLevel = std::min(startupLevel, colorRequirements.imageMipTailFirstLod);
+        levels.resize(permanentLevel);
+        for(uint32_t level = permanentLevel; level < std::min(colorRequirements.imageMipTailFirstLod, mipLevels); level++)
+            permanentAllocations.push_back(allocateMemory(getLevelMemorySize(level)));
+        bindLevels(permanentLevel, permanentAllocations);
+        bindMipTail();
+        uploadLevels(data, permanentLevel, mipLevels);
+    }
+
+    SparseImage::~SparseImage(){
+        // Memory bound to a destroyed image can be freed without unbinding it first
+        vkDestroyImage(device.getDevice(), image, nullptr);
+        for(auto& allocation : permanentAllocations)
+            device.getAllocator().free(allocation);
+        for(auto& released : releasedLevels)
+            device.getAllocator().free(released.allocation);
+    }
+
+    std::vector<std::shared_ptr<SparseLevel>> SparseImage::acquireLevels(const Texture::ImageData& data, uint32_t firstLevel){
+        assert(firstLevel <= permanentLevel && "Levels past the permanent level are always bound.");
+
+        // Every texture holds the levels from its first level to the permanent one, so bound levels are always a suffix
+        std::vector<std::shared_ptr<SparseLevel>> acquired(permanentLevel - firstLevel);
+        uint32_t boundLevel = permanentLevel;
+        for(; boundLevel > firstLevel; boundLevel--){
+            std::shared_ptr<SparseLevel> bound = levels[boundLevel - 1].lock();
+            // Released levels that weren't unbound yet still hold their memory and contents, they are taken back as they are
+            if(!bound){
+                auto released = std::find_if(releasedLevels.begin(), releasedLevels.end(), [&](const ReleasedLevel& r){ return r.level == boundLevel - 1; });
+                if(released == releasedLevels.end())
+                    break;
+                bound = std::make_shared<SparseLevel>(shared_from_this(), released->level, released->allocation);
+                levels[boundLevel - 1] = bound;
+                releasedLevels.erase(released);
+            }
+            acquired[boundLevel - 1 - firstLevel] = std::move(bound);
+        }
+        if(boundLevel == firstLevel)
+            return acquired;
+
+        std::vector<Allocation> allocations;
+        for(uint32_t level = firstLevel; level < boundLevel; level++)
+            allocations.push_back(allocateMemory(getLevelMemorySize(level)));
+        bindLevels(firstLevel, allocations);
+        for(uint32_t level = firstLevel; level < boundLevel; level++){
+            auto created = std::make_shared<SparseLevel>(shared_from_this(), level, allocations[level - firstLevel]);
+            levels[level] = created;
+            acquired[level - firstLevel] = std::move(created);
+        }
+        uploadLevels(data, firstLevel, boundLevel);
+        return acquired;
+    }
+
+    void SparseImage::createImage(const Texture::ImageData& data){
+        format = data.format;
+        mipLevels = static_cast<uint32_t>(data.levels.size());
+        for(const auto& level : data.levels)
+            levelExtents.push_back({level.width, level.height});
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {data.levels[0].width, data.levels[0].height, 1};
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+
+        // Levels are uploaded on the transfer queue while the graphics queue samples the others, the same as concurrent buffers
+        QueueFamilyIndices indices = device.getPhysicalQueueFamilies();
+        uint32_t queueFamilies[2] = {indices.graphicsFamily, indices.transferFamily};
+        if(indices.transferFamilyHasValue){
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = 2;
+            imageInfo.pQueueFamilyIndices = queueFamilies;
+        }
+        else
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if(vkCreateImage(device.getDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create sparse texture image.");
+    }
+
+    Allocation SparseImage::allocateMemory(VkDeviceSize size){
+        VkMemoryRequirements requirements = memoryRequirements;
+        requirements.size = size;
+        return device.getAllocator().allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    }
+
+    VkDeviceSize SparseImage::getLevelMemorySize(uint32_t level){
+        // One sparse block (memoryRequirements.alignment bytes) per granularity sized region, partial regions at the edges count
+        const VkExtent3D& granularity = colorRequirements.formatProperties.imageGranularity;
+        VkDeviceSize blocksX = (levelExtents[level].width + granularity.width - 1) / granularity.width;
+        VkDeviceSize blocksY = (levelExtents[level].height + granularity.height - 1) / granularity.height;
+        return blocksX * blocksY * memoryRequirements.alignment;
+    }
+
+    void SparseImage::bindLevels(uint32_t firstLevel, const std::vector<Allocation>& allocations){
+        if(allocations.empty())
+            return;
+        std::vector<VkSparseImageMemoryBind> binds;
+        for(uint32_t i = 0; i < allocations.size(); i++)
+            binds.push_back(getLevelBind(firstLevel + i, allocations[i]));
+
+        VkSparseImageMemoryBindInfo imageBind{};
+        imageBind.image = image;
+        imageBind.bindCount = static_cast<uint32_t>(binds.size());
+        imageBind.pBinds = binds.data();
+
+        VkBindSparseInfo bindInfo{};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bindInfo.imageBindCount = 1;
+        bindInfo.pImageBinds = &imageBind;
+        if(!submitBinding(device, bindInfo))
+            throw std::runtime_error("Failed to bind sparse texture memory.");
+    }
+
+    VkSparseImageMemoryBind SparseImage::getLevelBind(uint32_t level, const Allocation& allocation){
+        VkSparseImageMemoryBind bind{};
+        bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        bind.subresource.mipLevel = level;
+        bind.subresource.arrayLayer = 0;
+        bind.offset = {0, 0, 0};
+        bind.extent = {levelExtents[level].width, levelExtents[level].height, 1};
+        bind.memory = allocation.memory;
+        bind.memoryOffset = allocation.offset;
+        return bind;
+    }
+
+    bool SparseImage::unbindReleasedLevels(Device& device, const std::vector<SparseImage*>& images){
+        // One image bind per image with released levels, unbinding is binding VK_NULL_HANDLE memory
+        std::vector<std::vector<VkSparseImageMemoryBind>> binds;
+        std::vector<VkSparseImageMemoryBindInfo> imageBinds;
+        std::vector<SparseImage*> releasing;
+        for(SparseImage* image : images){
+            if(image->releasedLevels.empty())
+                continue;
+            auto& imageUnbinds = binds.emplace_back();
+            for(const auto& released : image->releasedLevels)
+                imageUnbinds.push_back(image->getLevelBind(released.level, Allocation{}));
+            releasing.push_back(image);
+        }
+        if(releasing.empty())
+            return true;
+        for(size_t i = 0; i < releasing.size(); i++){
+            VkSparseImageMemoryBindInfo imageBind{};
+            imageBind.image = releasing[i]->image;
+            imageBind.bindCount = static_cast<uint32_t>(binds[i].size());
+            imageBind.pBinds = binds[i].data();
+            imageBinds.push_back(imageBind);
+        }
+
+        VkBindSparseInfo bindInfo{};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bindInfo.imageBindCount = static_cast<uint32_t>(imageBinds.size());
+        bindInfo.pImageBinds = imageBinds.data();
+        if(!submitBinding(device, bindInfo))
+            return false;
+
+        for(SparseImage* image : releasing){
+            for(auto& released : image->releasedLevels)
+                device.getAllocator().free(released.allocation);
+            image->releasedLevels.clear();
+        }
+        return true;
+    }
+
+    void SparseImage::bindMipTail(){
+        std::vector<VkSparseMemoryBind> binds;
+        auto bindTail = [&](const VkSparseImageMemoryRequirements& requirements, VkSparseMemoryBindFlags flags){
+            if(requirements.imageMipTailSize == 0)
+                return;
+            Allocation allocation = allocateMemory(requirements.imageMipTailSize);
+            permanentAllocations.push_back(allocation);
+
+            VkSparseMemoryBind bind{};
+            bind.resourceOffset = requirements.imageMipTailOffset;
+            bind.size = requirements.imageMipTailSize;
+            bind.memory = allocation.memory;
+            bind.memoryOffset = allocation.offset;
+            bind.flags = flags;
+            binds.push_back(bind);
+        };
+        if(colorRequirements.imageMipTailFirstLod < mipLevels)
+            bindTail(colorRequirements, 0);
+        // Compression metadata of the image, if the implementation has any, lives in a tail of its own
+        if(hasMetadata)
+            bindTail(metadataRequirements, VK_SPARSE_MEMORY_BIND_METADATA_BIT);
+        if(binds.empty())
+            return;
+
+        VkSparseImageOpaqueMemoryBindInfo opaqueBind{};
+        opaqueBind.image = image;
+        opaqueBind.bindCount = static_cast<uint32_t>(binds.size());
+        opaqueBind.pBinds = binds.data();
+
+        VkBindSparseInfo bindInfo{};
+        bindInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+        bindInfo.imageOpaqueBindCount = 1;
+        bindInfo.pImageOpaqueBinds = &opaqueBind;
+        if(!submitBinding(device, bindInfo))
+            throw std::runtime_error("Failed to bind sparse texture memory.");
+    }
+
+    bool SparseImage::submitBinding(Device& device, const VkBindSparseInfo& bindInfo){
+        // Waited on right away so uploads and frames submitted afterwards see the new bindings without extra semaphores,
+        // and memory that was unbound can be freed
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        if(vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            return false;
+        bool bound = vkQueueBindSparse(device.getGraphicsQueue(), 1, &bindInfo, fence) == VK_SUCCESS &&
+            vkWaitForFences(device.getDevice(), 1, &fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS;
+        vkDestroyFence(device.getDevice(), fence, nullptr);
+        return bound;
+    }
+
+    void SparseImage::uploadLevels(const Texture::ImageData& data, uint32_t firstLevel, uint32_t lastLevel){
+        const auto& first = data.levels[firstLevel];
+        const auto& last = data.levels[lastLevel - 1];
+        std::span<const unsigned char> pixels = data.getPixels().subspan(first.offset, last.offset + last.size - first.offset);
+
+        std::vector<VkBufferImageCopy> regions;
+        for(uint32_t level = firstLevel; level < lastLevel; level++){
+            VkBufferImageCopy region{};
+            region.bufferOffset = data.levels[level].offset - first.offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {data.levels[level].width, data.levels[level].height, 1};
+            regions.push_back(region);
+        }
+
+        UploadManager& uploader = device.getUploadManager();
+        uploader.uploadToImage(image, lastLevel - firstLevel, pixels.data(), pixels.size(), std::move(regions), firstLevel);
+
+        // Concurrent image, the graphics queue takes it over without an ownership transfer once the batch's copies completed
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = firstLevel;
+        barrier.subresourceRange.levelCount = lastLevel - firstLevel;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(uploader.getGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
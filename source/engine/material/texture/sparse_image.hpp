@@ -0,0 +1,88 @@
+#pragma once
+
+#include "engine/material/texture/texture.hpp"
+
+#include <vector>
+#include <memory>
+
+namespace Renderer{
+    class SparseImage;
+
+    // One bound level of a SparseImage. Textures viewing the level share it, once the last of them is destroyed the level is
+    // released and unbound by the next SparseImage::unbindReleasedLevels().
+    struct SparseLevel{
+        SparseLevel(std::shared_ptr<SparseImage> image, uint32_t level, Allocation allocation) : image{std::move(image)}, level{level},
+            allocation{allocation} {}
+        ~SparseLevel();
+
+        SparseLevel(const SparseLevel&) = delete;
+        SparseLevel& operator=(const SparseLevel&) = delete;
+
+        std::shared_ptr<SparseImage> image;
+        uint32_t level;
+        Allocation allocation;
+    };
+
+    // Image holding the full mip chain of a streamed texture with sparse residency. Levels from getPermanentLevel() on (including
+    // the mip tail) are bound and uploaded when it is created and stay resident, finer levels are bound and uploaded by
+    // acquireLevels() instead of recreating the image whenever the resident levels change (see TextureStreamer).
+    class SparseImage : public std::enable_shared_from_this<SparseImage>{
+        public:
+            // The device has to support sparse residency and format has to be usable for sparse 2D textures
+            static bool isSupported(Device& device, VkFormat format);
+
+            // data has to be baked, levels from startupLevel on are made permanent (more if the mip tail starts before it)
+            SparseImage(Device& device, const Texture::ImageData& data, uint32_t startupLevel);
+            ~SparseImage();
+
+            SparseImage(const SparseImage&) = delete;
+            SparseImage& operator=(const SparseImage&) = delete;
+
+            // Returns levels firstLevel to getPermanentLevel() - 1, levels that aren't bound yet are bound and recorded into the
+            // current upload batch. They can be sampled once the batch is submitted, the same as a newly created texture.
+            std::vector<std::shared_ptr<SparseLevel>> acquireLevels(const Texture::ImageData& data, uint32_t firstLevel);
+
+            // Unbinds the levels of images released since the last call in a single sparse binding and frees their memory.
+            // Doesn't throw, returns false if the binding failed, the levels stay released and are unbound by a later call.
+            static bool unbindReleasedLevels(Device& device, const std::vector<SparseImage*>& images);
+
+            VkImage getImage() { return image; }
+            uint32_t getPermanentLevel() { return permanentLevel; }
+
+        private:
+            friend struct SparseLevel;
+
+            void createImage(const Texture::ImageData& data);
+            Allocation allocateMemory(VkDeviceSize size);
+            VkDeviceSize getLevelMemorySize(uint32_t level);
+            struct ReleasedLevel{
+                uint32_t level;
+                Allocation allocation;
+            };
+
+            // Binds whole levels, one allocation per level
+            void bindLevels(uint32_t firstLevel, const std::vector<Allocation>& allocations);
+            void bindMipTail();
+            VkSparseImageMemoryBind getLevelBind(uint32_t level, const Allocation& allocation);
+            // Binds on the graphics queue and waits until the binding has completed, returns false if it failed
+            static bool submitBinding(Device& device, const VkBindSparseInfo& bindInfo);
+            // Uploads levels firstLevel to lastLevel - 1 of data and makes them ready for sampling
+            void uploadLevels(const Texture::ImageData& data, uint32_t firstLevel, uint32_t lastLevel);
+
+            Device& device;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkFormat format;
+            uint32_t mipLevels;
+            std::vector<VkExtent2D> levelExtents;
+            VkMemoryRequirements memoryRequirements;
+            VkSparseImageMemoryRequirements colorRequirements{};
+            VkSparseImageMemoryRequirements metadataRequirements{};
+            bool hasMetadata = false;
+
+            uint32_t permanentLevel;
+            std::vector<Allocation> permanentAllocations;   // Levels from permanentLevel up to the mip tail, then the mip tail(s)
+            std::vector<std::weak_ptr<SparseLevel>> levels;     // Levels before permanentLevel, expired while unbound or released
+            std::vector<ReleasedLevel> releasedLevels;          // Still bound, waiting for unbindReleasedLevels()
+    };
+}
@@ -1,5 +1,11 @@
 #include "texture.hpp"
 
+#include "engine/upload/upload_manager.hpp"
+#include "engine/material/texture/texture_cache.hpp"
+#include "engine/material/texture/block_compression.hpp"
+#include "engine/material/texture/mip_generator.hpp"
+#include "engine/material/texture/sparse_image.hpp"
+
 // Image loading lib
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -7,95 +13,184 @@
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <array>
 
 namespace Renderer{
-    Texture::Texture(Device& device, std::string filepath, unsigned int textureId) : device{device}, textureId{textureId}{
-        createTexture(filepath);
+    Texture::Texture(Device& device, ImageData& data, unsigned int textureId, uint32_t firstLevel) : device{device}, firstLevel{firstLevel},
+        textureId{textureId}{
+        assert((firstLevel == 0 || firstLevel < data.levels.size()) && "First level is past the baked levels.");
+        createTexture(data);
+    }
+
+    Texture::Texture(Device& device, std::shared_ptr<SparseImage> image, const ImageData& data, unsigned int textureId, uint32_t firstLevel) :
+        device{device}, firstLevel{firstLevel}, textureId{textureId}, sparseImage{std::move(image)}{
+        assert(data.isBaked() && firstLevel < data.levels.size() && "First level is past the baked levels.");
+        // Coarser levels than the permanent ones are resident anyway, the view covers them all
+        sparseLevels = sparseImage->acquireLevels(data, std::min(firstLevel, sparseImage->getPermanentLevel()));
+        format = data.format;
+        textureImage = sparseImage->getImage();
+        imageExtent = {data.levels[firstLevel].width, data.levels[firstLevel].height};
+        mipLevels = static_cast<uint32_t>(data.levels.size()) - firstLevel;
+        createTextureImageView();
     }
 
     Texture::~Texture(){
-        vkDestroyImage(device.getDevice(), textureImage, nullptr);
         vkDestroyImageView(device.getDevice(), textureImageView, nullptr);
-        vkFreeMemory(device.getDevice(), textureImageMemory, nullptr);
+        // Sparse levels unbind themselves once no texture views them
+        if(sparseImage)
+            return;
+        vkDestroyImage(device.getDevice(), textureImage, nullptr);
+        device.getAllocator().free(textureImageAllocation);
     }
 
     std::unique_ptr<Texture> Texture::createTextureFromFile(Device& device, std::string filepath){
+        ImageData data{};
+        data.loadImage(filepath, TextureCache::getPreferredFormat(device));
+        return std::make_unique<Texture>(device, data, reserveId());
+    }
+
+    unsigned int Texture::reserveId(){
         static unsigned int currentId = 0;
-        return std::make_unique<Texture>(device, filepath, currentId++);
+        return currentId++;
     }
 
-    void Texture::createTexture(std::string filepath){
+    void Texture::ImageData::loadImage(const std::string& filepath, VkFormat format, MipGenerator::Filter filter){
+        if(TextureCache::load(filepath, format, filter, *this))
+            return;
+        if(!decodeImage(filepath))
+            return;
+        bake(format, filter);
+        TextureCache::save(filepath, *this);
+    }
+
+    bool Texture::ImageData::decodeImage(const std::string& filepath){
         int texWidth, texHeight, channels;
-        stbi_uc* pixels = stbi_load(filepath.c_str(), &texWidth, &texHeight, &channels, STBI_rgb_alpha);
-        if(!pixels)
+        stbi_uc* decoded = stbi_load(filepath.c_str(), &texWidth, &texHeight, &channels, STBI_rgb_alpha);
+        if(!decoded){
+            // Keep going with a visibly wrong texture rather than uploading garbage
             std::cout << "Failed to load the following image file: " << filepath << '\n';
+            fill(1, 1, 0xffff00ff);
+            return false;
+        }
+
+        width = static_cast<uint32_t>(texWidth);
+        height = static_cast<uint32_t>(texHeight);
+        pixels.assign(decoded, decoded + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(decoded);
+        return true;
+    }
+
+    void Texture::ImageData::fill(uint32_t width, uint32_t height, uint32_t rgba){
+        this->width = width;
+        this->height = height;
+        pixels.resize(static_cast<size_t>(width) * height * 4);
+        for(size_t i = 0; i < pixels.size(); i += 4){
+            pixels[i] = rgba & 0xff;
+            pixels[i + 1] = (rgba >> 8) & 0xff;
+            pixels[i + 2] = (rgba >> 16) & 0xff;
+            pixels[i + 3] = (rgba >> 24) & 0xff;
+        }
+    }
+
+    void Texture::ImageData::bake(VkFormat format, MipGenerator::Filter filter){
+        assert(!isBaked() && !mapping && "Image is already baked.");
+        if(format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_BC7_SRGB_BLOCK)
+            throw std::invalid_argument("Unsupported texture format for baking.");
+
+        std::vector<MipGenerator::Level> chain = MipGenerator::generate(pixels.data(), width, height, filter);
+        chain.insert(chain.begin(), MipGenerator::Level{std::move(pixels), width, height});
+
+        // Levels are packed back to back, aligned for buffer->image copies of either format
+        this->format = format;
+        mipFilter = filter;
+        pixels.clear();
+        levels.clear();
+        for(auto& level : chain){
+            MipLevel mip{};
+            mip.offset = (pixels.size() + TextureCache::LEVEL_ALIGNMENT - 1) & ~(TextureCache::LEVEL_ALIGNMENT - 1);
+            mip.width = level.width;
+            mip.height = level.height;
+            if(format == VK_FORMAT_BC7_SRGB_BLOCK){
+                mip.size = BlockCompression::getBc7Size(level.width, level.height);
+                pixels.resize(mip.offset + mip.size);
+                BlockCompression::encodeBc7(level.pixels.data(), level.width, level.height, pixels.data() + mip.offset);
+            }
+            else{
+                mip.size = level.pixels.size();
+                pixels.resize(mip.offset + mip.size);
+                std::memcpy(pixels.data() + mip.offset, level.pixels.data(), level.pixels.size());
+            }
+            levels.push_back(mip);
+        }
+    }
+
+    void Texture::createTexture(ImageData& data){
+        // Blitting mips needs linear filtering of the format, without it they are generated on the CPU instead
+        if(!data.isBaked() && (data.width > 1 || data.height > 1) && !supportsLinearBlit(data.format))
+            data.bake(VK_FORMAT_R8G8B8A8_SRGB);
+
+        format = data.format;
+        std::span<const unsigned char> pixels = data.getPixels();
+        if(data.isBaked()){
+            // Levels before firstLevel are left out, the rest follow it in the blob
+            imageExtent = {data.levels[firstLevel].width, data.levels[firstLevel].height};
+            mipLevels = static_cast<uint32_t>(data.levels.size()) - firstLevel;
+            pixels = pixels.subspan(data.levels[firstLevel].offset);
+        }
+        else{
+            imageExtent = {data.width, data.height};
+            mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(data.width, data.height)))) + 1;
+        }
 
-        void* pPixels = pixels;
-        imageExtent = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)};
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-        Buffer stagingBuffer{
-            device,
-            1,
-            imageSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)pPixels);
-
-        imageBuffer = std::make_unique<Buffer>(
-            device,
-            1,
-            stagingBuffer.getSize(),
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        stagingBuffer.copyBuffer(imageBuffer->getBuffer(), imageBuffer->getSize());
-
-        stbi_image_free(pixels);
-        createTextureImage();
-            transitionImageLayout(VK_FORMAT_R8G8B8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-            imageBuffer->copyBufferToImage(textureImage, imageExtent.width, imageExtent.height);
-            generateMipmaps();
+        // Baked data holds every level, decoded data only level 0 and the rest is blitted on the GPU
+        std::vector<VkBufferImageCopy> regions;
+        for(uint32_t level = 0; level < (data.isBaked() ? mipLevels : 1); level++){
+            VkBufferImageCopy region{};
+            region.bufferOffset = data.isBaked() ? data.levels[firstLevel + level].offset - data.levels[firstLevel].offset : 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = data.isBaked() ? VkExtent3D{data.levels[firstLevel + level].width, data.levels[firstLevel + level].height, 1} :
+                VkExtent3D{imageExtent.width, imageExtent.height, 1};
+            regions.push_back(region);
+        }
+
+        createTextureImage(!data.isBaked());
+        // Copied straight from staging in one go, the staging memory is reused once the upload's fence signals.
+        // Copies are recorded on the transfer queue, mip generation needs blits so it goes to the graphics queue.
+        UploadManager& uploader = device.getUploadManager();
+        uploader.uploadToImage(textureImage, mipLevels, pixels.data(), pixels.size(), std::move(regions));
+        uploader.transferImageOwnership(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+        if(data.isBaked())
+            transitionImageLayout(uploader.getGraphicsCommandBuffer(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        else
+            generateMipmaps(uploader.getGraphicsCommandBuffer());
         createTextureImageView();
     }
 
-    void Texture::createTextureImage(){
+    void Texture::createTextureImage(bool generatesMips){
         VkImageCreateInfo imageInfo = {};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+        imageInfo.format = format;
         imageInfo.extent = {imageExtent.width, imageExtent.height, 1};
         imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = 1;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        // Blits read from the image
+        if(generatesMips)
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.flags = 0;
 
-        if(vkCreateImage(device.getDevice(), &imageInfo, nullptr, &textureImage) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create image.");
-
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device.getDevice(), textureImage, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-        if (vkAllocateMemory(device.getDevice(), &allocInfo, nullptr, &textureImageMemory) != VK_SUCCESS)
-            throw std::runtime_error("Failed to allocate image memory.");
-
-        vkBindImageMemory(device.getDevice(), textureImage, textureImageMemory, 0);
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageAllocation);
     }
 
     void Texture::createTextureImageView(){
@@ -103,9 +198,10 @@ namespace Renderer{
         imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         imageViewInfo.image = textureImage;
         imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+        imageViewInfo.format = format;
         imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageViewInfo.subresourceRange.baseMipLevel = 0;
+        // Views of a sparse image skip the full chain's levels before firstLevel
+        imageViewInfo.subresourceRange.baseMipLevel = sparseImage ? firstLevel : 0;
         imageViewInfo.subresourceRange.levelCount = mipLevels;
         imageViewInfo.subresourceRange.baseArrayLayer = 0;
         imageViewInfo.subresourceRange.layerCount = 1;
@@ -114,9 +210,7 @@ namespace Renderer{
             throw std::runtime_error("Failed to create image view.");
     }
 
-    void Texture::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout){
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
+    void Texture::transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout){
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = oldLayout;
@@ -133,13 +227,7 @@ namespace Renderer{
         VkPipelineStageFlags sourceStage;
         VkPipelineStageFlags destinationStage;
 
-        if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL){
-           barrier.srcAccessMask = 0;
-           barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-           sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-           destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+        if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
             barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
             sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
@@ -149,17 +237,16 @@ namespace Renderer{
             throw std::invalid_argument("Unsupported image layout transition.");
 
         vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-        device.endSingleTimeCommands(commandBuffer);
     }
 
-    void Texture::generateMipmaps(){
+    bool Texture::supportsLinearBlit(VkFormat format){
         VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
-
-        if(!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
-            throw std::runtime_error("Texture image format does not support linear blitting.");
+        vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), format, &formatProperties);
+        return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    }
 
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+    void Texture::generateMipmaps(VkCommandBuffer commandBuffer){
+        assert(supportsLinearBlit(format) && "Texture image format does not support linear blitting.");
 
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -214,8 +301,6 @@ namespace Renderer{
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
         vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        device.endSingleTimeCommands(commandBuffer);
     }
 
     VkDescriptorImageInfo Texture::descriptorImageInfo(){
@@ -1,47 +1,98 @@
 #pragma once
 
 #include "engine/device/device.hpp"
-#include "engine/buffer/buffer.hpp"
 #include "engine/material/sampler/sampler.hpp"
+#include "engine/io/mapped_file.hpp"
+#include "engine/material/texture/mip_generator.hpp"
 
 #include <unordered_map>
 #include <memory>
+#include <span>
 
 namespace Renderer{
+    class SparseImage;
+    struct SparseLevel;
+
     class Texture{
         public: 
-            Texture(Device& device, std::string filepath, unsigned int textureId);
+            // Pixels on the CPU, loading only touches the CPU so it can run on a worker thread. Decoded images hold level 0
+            // as RGBA8 and get their mips generated on the GPU, baked images hold every level in their final format.
+            struct ImageData{
+                struct MipLevel{
+                    VkDeviceSize offset = 0;    // Into getPixels()
+                    VkDeviceSize size = 0;
+                    uint32_t width = 0, height = 0;
+                };
+
+                std::vector<unsigned char> pixels{};
+                uint32_t width = 0, height = 0;
+                VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+                std::vector<MipLevel> levels{};     // Empty unless baked
+                MipGenerator::Filter mipFilter = MipGenerator::Filter::Box;     // Filter the levels were baked with
+
+                // Set when the data comes from the texture cache, pixels stay empty and are read from the mapping
+                std::shared_ptr<MappedFile> mapping;
+                std::span<const unsigned char> mappedPixels;
+
+                std::span<const unsigned char> getPixels() const { return mapping ? mappedPixels : std::span<const unsigned char>{pixels}; }
+                bool isBaked() const { return !levels.empty(); }
+
+                // Reads the baked image from the texture cache, or decodes the source, bakes it and caches it
+                void loadImage(const std::string& filepath, VkFormat format, MipGenerator::Filter filter = MipGenerator::Filter::Kaiser);
+                // Returns false and fills in a placeholder if the file can't be decoded
+                bool decodeImage(const std::string& filepath);
+                void fill(uint32_t width, uint32_t height, uint32_t rgba);
+                // Generates every mip level of the decoded image on the CPU and encodes them into format (RGBA8 or BC7)
+                void bake(VkFormat format, MipGenerator::Filter filter = MipGenerator::Filter::Kaiser);
+            };
+
+            // Baked data can leave its finest levels out, the image then starts at firstLevel (see TextureStreamer)
+            Texture(Device& device, ImageData& data, unsigned int textureId, uint32_t firstLevel = 0);
+            // Views levels from firstLevel on of a sparse image holding the full chain, binds and uploads the ones that aren't yet
+            Texture(Device& device, std::shared_ptr<SparseImage> image, const ImageData& data, unsigned int textureId, uint32_t firstLevel);
             ~Texture();
 
             Texture(const Texture&) = delete;
             Texture &operator=(const Texture&) = delete;
 
             static std::unique_ptr<Texture> createTextureFromFile(Device& device, std::string filepath);
+            // Hands out the id the next texture will get, lets asynchronous loads be referenced before they finish
+            static unsigned int reserveId();
 
             VkImageView getTextureImageView() { return textureImageView; }
             uint32_t getMipLevels() { return mipLevels; }
+            // Level of the full chain that the image's level 0 holds
+            uint32_t getFirstLevel() { return firstLevel; }
+            VkDeviceSize getMemorySize() { return textureImageAllocation.size; }     // 0 for sparse images
             VkDescriptorImageInfo descriptorImageInfo();
             unsigned int getId() { return textureId; }
 
-            unsigned int samplerId;
+            unsigned int samplerId = 0;
 
         private:
-            void createTexture(std::string filepath);
-            void createTextureImage();
+            void createTexture(ImageData& data);
+            void createTextureImage(bool generatesMips);
             void createTextureImageView();
-            void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-            void generateMipmaps();
+            void transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
+            bool supportsLinearBlit(VkFormat format);
+            void generateMipmaps(VkCommandBuffer commandBuffer);
 
             Device& device;
 
+            VkFormat format;
             VkImage textureImage;
             VkImageView textureImageView;
-            VkDeviceMemory textureImageMemory;
+            Allocation textureImageAllocation;
             uint32_t mipLevels;
+            uint32_t firstLevel;
 
             VkExtent2D imageExtent;
-            std::unique_ptr<Buffer> imageBuffer;
 
             unsigned int textureId;
+
+            // Set for views of a sparse image, the image is shared and the levels below the permanent ones stay bound while
+            // any texture viewing them is alive
+            std::shared_ptr<SparseImage> sparseImage;
+            std::vector<std::shared_ptr<SparseLevel>> sparseLevels;
     };
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "texture_cache.hpp"
+
+#include "engine/io/file_utils.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+namespace Renderer{
+    namespace{
+        uint64_t alignOffset(uint64_t offset){
+            return (offset + TextureCache::LEVEL_ALIGNMENT - 1) & ~(TextureCache::LEVEL_ALIGNMENT - 1);
+        }
+
+        int64_t modifiedTime(const std::filesystem::path& path, std::error_code& error){
+            return static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        }
+    }
+
+    VkFormat TextureCache::getPreferredFormat(Device& device){
+        return device.findSupportedFormat({VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB}, VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    }
+
+    bool TextureCache::load(const std::string& sourcePath, VkFormat format, MipGenerator::Filter filter, Texture::ImageData& data){
+        auto cache = std::make_shared<MappedFile>(getCachePath(sourcePath));
+        if(!cache->isOpen() || cache->getSize() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, cache->getData(), sizeof(Header));
+        if(std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.version != VERSION || header.format != static_cast<uint32_t>(format) ||
+            header.mipFilter != static_cast<uint32_t>(filter))
+            return false;
+        if(header.mipLevels == 0 || header.mipLevels > MAX_MIP_LEVELS || header.pixelOffset + header.pixelSize > cache->getSize())
+            return false;
+        for(uint32_t level = 0; level < header.mipLevels; level++){
+            if(header.levelOffsets[level] + header.levelSizes[level] > header.pixelSize)
+                return false;
+        }
+
+        std::error_code error;
+        uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+        if(error || sourceSize != header.sourceSize)
+            return false;
+        int64_t sourceTime = modifiedTime(sourcePath, error);
+        if(error)
+            return false;
+        if(sourceTime != header.sourceModifiedTime){
+            MappedFile source{sourcePath};
+            if(!source.isOpen() || FileUtils::hash(source.getData(), source.getSize()) != header.sourceHash)
+                return false;
+        }
+
+        data.pixels.clear();
+        data.width = header.width;
+        data.height = header.height;
+        data.format = format;
+        data.mipFilter = filter;
+        data.levels.clear();
+        uint32_t levelWidth = header.width, levelHeight = header.height;
+        for(uint32_t level = 0; level < header.mipLevels; level++){
+            data.levels.push_back({header.levelOffsets[level], header.levelSizes[level], levelWidth, levelHeight});
+            levelWidth = std::max(levelWidth / 2, 1u);
+            levelHeight = std::max(levelHeight / 2, 1u);
+        }
+        data.mappedPixels = {cache->getData() + header.pixelOffset, header.pixelSize};
+        data.mapping = std::move(cache);
+        return true;
+    }
+
+    void TextureCache::save(const std::string& sourcePath, const Texture::ImageData& data){
+        if(!data.isBaked() || data.levels.size() > MAX_MIP_LEVELS)
+            return;
+        auto pixels = data.getPixels();
+
+        Header header{};
+        header.format = static_cast<uint32_t>(data.format);
+        header.width = data.width;
+        header.height = data.height;
+        header.mipLevels = static_cast<uint32_t>(data.levels.size());
+        header.mipFilter = static_cast<uint32_t>(data.mipFilter);
+        header.pixelOffset = alignOffset(sizeof(Header));
+        header.pixelSize = pixels.size();
+        for(uint32_t level = 0; level < header.mipLevels; level++){
+            header.levelOffsets[level] = data.levels[level].offset;
+            header.levelSizes[level] = data.levels[level].size;
+        }
+
+        std::error_code error;
+        {
+            MappedFile source{sourcePath};
+            if(!source.isOpen())
+                return;
+            header.sourceSize = source.getSize();
+            header.sourceHash = FileUtils::hash(source.getData(), source.getSize());
+        }
+        header.sourceModifiedTime = modifiedTime(sourcePath, error);
+        if(error)
+            return;
+
+        const std::byte zeros[LEVEL_ALIGNMENT] = {};
+        std::string cachePath = getCachePath(sourcePath);
+        if(!FileUtils::atomicWriteFile(cachePath, { std::as_bytes(std::span{&header, 1}), std::span{zeros, header.pixelOffset - sizeof(Header)},
+            std::as_bytes(pixels) }))
+            std::cout << "Failed to write texture cache: " << cachePath << '\n';
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "engine/material/texture/texture.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace Renderer{
+    // Baked textures (every mip level, block compressed where the device supports it), stored next to the source as
+    // <source>.texcache. Layout: Header, then the pixel blob holding the levels back to back, each aligned so that it can be
+    // uploaded straight from a memory mapping. A cache baked with another format or mip filter than requested is rebaked.
+    class TextureCache{
+        public:
+            static constexpr uint32_t VERSION = 2;
+            static constexpr uint64_t LEVEL_ALIGNMENT = 16;     // A BC7 block, also satisfies buffer->image copy offset rules
+            static constexpr uint32_t MAX_MIP_LEVELS = 16;      // Enough for 32768 texels per side
+
+            struct Header{
+                char magic[4] = {'R', 'T', 'E', 'X'};
+                uint32_t version = VERSION;
+                uint32_t format = 0;        // VkFormat
+                uint32_t width = 0, height = 0;
+                uint32_t mipLevels = 0;
+                uint32_t mipFilter = 0;     // MipGenerator::Filter
+                uint32_t padding = 0;
+
+                // Source file state when the cache was written, checked the same way as MeshCache does
+                uint64_t sourceSize = 0;
+                int64_t sourceModifiedTime = 0;
+                uint64_t sourceHash = 0;
+
+                uint64_t pixelOffset = 0;
+                uint64_t pixelSize = 0;
+                uint64_t levelOffsets[MAX_MIP_LEVELS] = {};     // Into the pixel blob
+                uint64_t levelSizes[MAX_MIP_LEVELS] = {};
+            };
+
+            // Maps the cache into data if it is still valid for the source and baked with format and filter, returns false
+            // if the image has to be decoded and baked
+            static bool load(const std::string& sourcePath, VkFormat format, MipGenerator::Filter filter, Texture::ImageData& data);
+            // Writes the cache for data baked from sourcePath, failures are reported but not fatal
+            static void save(const std::string& sourcePath, const Texture::ImageData& data);
+
+            static std::string getCachePath(const std::string& sourcePath) { return sourcePath + ".texcache"; }
+            // BC7 if the device can sample it, RGBA8 otherwise
+            static VkFormat getPreferredFormat(Device& device);
+    };
+}
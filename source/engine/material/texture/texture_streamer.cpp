@@ -0,0 +1,147 @@
+#include "texture_streamer.hpp"
+
+#include "engine/upload/upload_manager.hpp"
+#include "engine/material/texture/sparse_image.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include <iostream>
+
+namespace Renderer{
+    std::shared_ptr<Texture> TextureStreamer::add(Texture::ImageData data, unsigned int textureId, unsigned int samplerId){
+        assert(data.isBaked() && data.levels.size() <= TextureCache::MAX_MIP_LEVELS && "Only baked textures can be streamed.");
+
+        StreamedTexture streamed{};
+        streamed.samplerId = samplerId;
+        streamed.startupLevel = static_cast<uint32_t>(data.levels.size()) - 1;
+        while(streamed.startupLevel > 0 && data.levels[streamed.startupLevel - 1].width <= STARTUP_SIZE &&
+            data.levels[streamed.startupLevel - 1].height <= STARTUP_SIZE)
+            streamed.startupLevel--;
+        // Levels from the mip tail on can't be unbound, the startup levels grow to include them
+        if(SparseImage::isSupported(device, data.format)){
+            streamed.sparseImage = std::make_shared<SparseImage>(device, data, streamed.startupLevel);
+            streamed.startupLevel = std::min(streamed.startupLevel, streamed.sparseImage->getPermanentLevel());
+        }
+        streamed.residentLevel = streamed.startupLevel;
+        streamed.requestedLevel = streamed.startupLevel;
+        streamed.data = std::move(data);
+
+        // Replacing a texture that was already streamed, its levels no longer count
+        if(auto existing = textures.find(textureId); existing != textures.end()){
+            residentBytes -= getLevelBytes(existing->second, existing->second.residentLevel);
+            textures.erase(existing);
+        }
+
+        auto& texture = textures.emplace(textureId, std::move(streamed)).first->second;
+        residentBytes += getLevelBytes(texture, texture.residentLevel);
+        return createTexture(textureId, texture, texture.residentLevel);
+    }
+
+    bool TextureStreamer::update(std::span<const uint32_t> requests, uint64_t frame){
+        // Levels dropped by textures destroyed since the last update, before new ones are bound
+        std::vector<SparseImage*> sparseImages;
+        for(auto& [id, texture] : textures)
+            if(texture.sparseImage)
+                sparseImages.push_back(texture.sparseImage.get());
+        if(!SparseImage::unbindReleasedLevels(device, sparseImages))
+            std::cout << "Failed to unbind released sparse texture levels, retrying next update." << '\n';
+
+        plannedBytes = residentBytes;
+        std::vector<unsigned int> wanted;
+        for(auto& [id, texture] : textures){
+            texture.targetLevel = texture.residentLevel;
+            if(id >= requests.size() || requests[id] == NO_REQUEST)
+                continue;
+            // Sampling a level also reads the coarser ones when filtering between levels
+            texture.requestedLevel = std::min(requests[id], static_cast<uint32_t>(texture.data.levels.size()) - 1);
+            for(uint32_t level = texture.requestedLevel; level < texture.data.levels.size(); level++)
+                texture.lastUsed[level] = frame;
+            if(texture.requestedLevel < texture.residentLevel)
+                wanted.push_back(id);
+        }
+
+        // The budget may have been lowered since the last update
+        evict(0, frame);
+
+        // Textures missing the most levels first, the rest wait for the next update once enough has been uploaded
+        std::sort(wanted.begin(), wanted.end(), [this](unsigned int a, unsigned int b){
+            const auto& first = textures.at(a);
+            const auto& second = textures.at(b);
+            return first.residentLevel - first.requestedLevel > second.residentLevel - second.requestedLevel;
+        });
+        VkDeviceSize uploaded = 0;
+        for(unsigned int id : wanted){
+            auto& texture = textures.at(id);
+            // Finer levels are skipped until they fit, the texture gets as close to the request as the budget allows
+            uint32_t level = texture.requestedLevel;
+            for(; level < texture.residentLevel; level++){
+                VkDeviceSize bytes = getLevelBytes(texture, level) - getLevelBytes(texture, texture.residentLevel);
+                if((uploaded == 0 || uploaded + getLevelBytes(texture, level) <= UPLOAD_LIMIT) && evict(bytes, frame))
+                    break;
+            }
+            if(level == texture.residentLevel)
+                continue;
+            plannedBytes += getLevelBytes(texture, level) - getLevelBytes(texture, texture.residentLevel);
+            uploaded += getLevelBytes(texture, level);
+            texture.targetLevel = level;
+            if(uploaded >= UPLOAD_LIMIT)
+                break;
+        }
+
+        bool replaced = false;
+        for(auto& [id, texture] : textures){
+            if(texture.targetLevel == texture.residentLevel)
+                continue;
+            setResidentLevel(id, texture, texture.targetLevel);
+            replaced = true;
+        }
+        // Same as finished loads, frames submitted afterwards are ordered after the uploads on the graphics queue
+        if(replaced)
+            device.getUploadManager().submit();
+        return replaced;
+    }
+
+    VkDeviceSize TextureStreamer::getLevelBytes(const StreamedTexture& texture, uint32_t level){
+        VkDeviceSize bytes = 0;
+        for(; level < texture.data.levels.size(); level++)
+            bytes += texture.data.levels[level].size;
+        return bytes;
+    }
+
+    bool TextureStreamer::evict(VkDeviceSize bytes, uint64_t frame){
+        while(plannedBytes + bytes > budget){
+            // The finest planned level of each texture is its candidate, levels sampled this frame stay
+            StreamedTexture* oldest = nullptr;
+            for(auto& [id, texture] : textures){
+                if(texture.targetLevel >= texture.startupLevel || texture.lastUsed[texture.targetLevel] >= frame)
+                    continue;
+                if(!oldest || texture.lastUsed[texture.targetLevel] < oldest->lastUsed[oldest->targetLevel])
+                    oldest = &texture;
+            }
+            if(!oldest)
+                return false;
+            plannedBytes -= oldest->data.levels[oldest->targetLevel].size;
+            oldest->targetLevel++;
+        }
+        return true;
+    }
+
+    void TextureStreamer::setResidentLevel(unsigned int textureId, StreamedTexture& texture, uint32_t level){
+        scene.textures[textureId] = createTexture(textureId, texture, level);
+
+        residentBytes -= getLevelBytes(texture, texture.residentLevel);
+        residentBytes += getLevelBytes(texture, level);
+        texture.residentLevel = level;
+    }
+
+    std::shared_ptr<Texture> TextureStreamer::createTexture(unsigned int textureId, StreamedTexture& texture, uint32_t level){
+        std::shared_ptr<Texture> created;
+        if(texture.sparseImage)
+            created = std::make_shared<Texture>(device, texture.sparseImage, texture.data, textureId, level);
+        else
+            created = std::make_shared<Texture>(device, texture.data, textureId, level);
+        created->samplerId = texture.samplerId;
+        return created;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "engine/material/texture/texture.hpp"
+#include "engine/material/texture/texture_cache.hpp"
+#include "engine/scene/scene.hpp"
+
+#include <unordered_map>
+#include <array>
+#include <span>
+#include <cstdint>
+
+namespace Renderer{
+    // Keeps baked textures partially resident. Textures start with only their small levels, finer ones are brought in when
+    // main.frag reports sampling them and the least recently sampled levels are dropped again while the resident levels
+    // exceed the budget. A texture whose resident levels change is replaced in the scene, RenderSystem::updateTextures()
+    // rebinds it and keeps the old one alive until no frame in flight uses it. Where the device supports sparse residency
+    // for the format, each texture keeps one SparseImage and the replacement is a new view of it whose missing levels are
+    // bound and uploaded, dropped levels are unbound by the first update after the old view is destroyed. Otherwise the
+    // replacement is a new image with the new range, recreated from the baked data (usually the mapped texture cache).
+    class TextureStreamer{
+        public:
+            static constexpr uint32_t STARTUP_SIZE = 64;                        // Levels up to this many texels per side are always resident
+            static constexpr VkDeviceSize DEFAULT_BUDGET = 256ull * 1024 * 1024;
+            static constexpr VkDeviceSize UPLOAD_LIMIT = 8ull * 1024 * 1024;    // Bytes streamed in per update, past the first texture
+            static constexpr uint32_t NO_REQUEST = ~0u;                         // Texture wasn't sampled, atomicMin in main.frag lowers it
+
+            TextureStreamer(Device& device, Scene& scene) : device{device}, scene{scene} {}
+
+            TextureStreamer(const TextureStreamer&) = delete;
+            TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+            // Takes over the baked data of a texture and returns it with only its startup levels resident
+            std::shared_ptr<Texture> add(Texture::ImageData data, unsigned int textureId, unsigned int samplerId);
+
+            // requests[id] is the finest level of the full chain texture id was sampled at since the last update, NO_REQUEST
+            // if it wasn't sampled. frame has to grow with every call. Submits the uploads of recreated textures and returns
+            // true if any texture in the scene was replaced.
+            bool update(std::span<const uint32_t> requests, uint64_t frame);
+
+            void setBudget(VkDeviceSize bytes) { budget = bytes; }
+            VkDeviceSize getBudget() { return budget; }
+            // Bytes of the levels currently resident
+            VkDeviceSize getResidentBytes() { return residentBytes; }
+
+        private:
+            struct StreamedTexture{
+                Texture::ImageData data;
+                unsigned int samplerId = 0;
+                uint32_t residentLevel = 0;     // Finest resident level
+                uint32_t startupLevel = 0;      // Finest level that is never dropped
+                uint32_t requestedLevel = 0;    // Finest level requested by the latest update that sampled the texture
+                uint32_t targetLevel = 0;       // Planned residentLevel while an update runs
+                std::array<uint64_t, TextureCache::MAX_MIP_LEVELS> lastUsed{};  // Update each level was last sampled in
+                std::shared_ptr<SparseImage> sparseImage;   // Null if the texture is recreated instead
+            };
+
+            // Bytes of every level from level to the end of the chain
+            VkDeviceSize getLevelBytes(const StreamedTexture& texture, uint32_t level);
+            // Drops the least recently used levels not sampled in frame until bytes more fit in the budget, returns false
+            // if they don't
+            bool evict(VkDeviceSize bytes, uint64_t frame);
+            void setResidentLevel(unsigned int textureId, StreamedTexture& texture, uint32_t level);
+            std::shared_ptr<Texture> createTexture(unsigned int textureId, StreamedTexture& texture, uint32_t level);
+
+            Device& device;
+            Scene& scene;
+
+            std::unordered_map<unsigned int, StreamedTexture> textures;
+            VkDeviceSize budget = DEFAULT_BUDGET;
+            VkDeviceSize residentBytes = 0;
+            VkDeviceSize plannedBytes = 0;      // Resident bytes once the planned levels are applied
+    };
+}
@@ -0,0 +1,325 @@
+#include "memory_allocator.hpp"
+
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+namespace Renderer{
+    // A VkDeviceMemory object split up into power of two ranges, free ranges are kept per order so buddies can be merged on free
+    struct MemoryBlock{
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        uint32_t maxOrder = 0;              // size == MIN_ALLOCATION_SIZE << maxOrder
+        uint32_t memoryTypeIndex = 0;
+
+        std::vector<std::set<VkDeviceSize>> freeLists;          // Offsets of free ranges, indexed by order
+        std::unordered_map<VkDeviceSize, void*> owners;         // Offsets of live ranges and the resources using them
+        VkDeviceSize used = 0;
+        bool draining = false;
+    };
+
+    static uint32_t orderForSize(VkDeviceSize size){
+        uint32_t order = 0;
+        while ((MemoryAllocator::MIN_ALLOCATION_SIZE << order) < size)
+            order++;
+        return order;
+    }
+
+    static VkDeviceSize floorPowerOfTwo(VkDeviceSize size){
+        VkDeviceSize result = 1;
+        while (result * 2 <= size)
+            result *= 2;
+        return result;
+    }
+
+    MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize)
+    : device{device}, preferredBlockSize{preferredBlockSize}{
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+    }
+
+    MemoryAllocator::~MemoryAllocator(){
+        for (auto& pool : pools)
+            for (auto& block : pool.blocks)
+                destroyBlock(block.get());
+        for (auto& allocation : dedicatedAllocations)
+            vkFreeMemory(device, allocation.memory, nullptr);
+    }
+
+    Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, void* owner){
+        std::lock_guard<std::mutex> lock{mutex};
+        uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+        Pool& pool = getPool(memoryTypeIndex, linear);
+
+        // Buddy ranges are aligned to their own size, so rounding up to the alignment satisfies it
+        VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+        if (size > pool.blockSize / 2)
+            return allocateDedicated(requirements.size, memoryTypeIndex, owner);
+
+        uint32_t order = orderForSize(size);
+
+        MemoryBlock* block = nullptr;
+        uint32_t foundOrder = 0;
+        for (auto& candidate : pool.blocks) {
+            if (candidate->draining)
+                continue;
+            for (uint32_t k = order; k <= candidate->maxOrder; k++)
+                if (!candidate->freeLists[k].empty()) {
+                    block = candidate.get();
+                    foundOrder = k;
+                    break;
+                }
+            if (block != nullptr)
+                break;
+        }
+
+        if (block == nullptr) {
+            block = createBlock(pool);
+            foundOrder = block->maxOrder;
+        }
+
+        // Take the lowest free range and split it down to the needed order, the upper halves become free buddies
+        VkDeviceSize offset = *block->freeLists[foundOrder].begin();
+        block->freeLists[foundOrder].erase(block->freeLists[foundOrder].begin());
+        while (foundOrder > order) {
+            foundOrder--;
+            block->freeLists[foundOrder].insert(offset + (MIN_ALLOCATION_SIZE << foundOrder));
+        }
+
+        Allocation allocation{};
+        allocation.memory = block->memory;
+        allocation.offset = offset;
+        allocation.size = MIN_ALLOCATION_SIZE << order;
+        allocation.mapped = block->mapped != nullptr ? static_cast<char*>(block->mapped) + offset : nullptr;
+        allocation.block = block;
+        allocation.order = order;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        allocation.owner = owner;
+
+        block->owners[offset] = owner;
+        block->used += allocation.size;
+        return allocation;
+    }
+
+    void MemoryAllocator::free(Allocation& allocation){
+        if (allocation.memory == VK_NULL_HANDLE)
+            return;
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (allocation.block == nullptr) {
+            auto it = std::find_if(dedicatedAllocations.begin(), dedicatedAllocations.end(),
+                [&](const Allocation& other){ return other.memory == allocation.memory; });
+            assert(it != dedicatedAllocations.end() && "Freeing a dedicated allocation that was not made by this allocator.");
+            vkFreeMemory(device, allocation.memory, nullptr);
+            dedicatedAllocations.erase(it);
+            allocation = Allocation{};
+            return;
+        }
+
+        MemoryBlock* block = allocation.block;
+        block->owners.erase(allocation.offset);
+        block->used -= allocation.size;
+
+        // Merge with the buddy for as long as it is also free
+        VkDeviceSize offset = allocation.offset;
+        uint32_t order = allocation.order;
+        while (order < block->maxOrder) {
+            VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+            auto it = block->freeLists[order].find(buddy);
+            if (it == block->freeLists[order].end())
+                break;
+            block->freeLists[order].erase(it);
+            offset = std::min(offset, buddy);
+            order++;
+        }
+        block->freeLists[order].insert(offset);
+        allocation = Allocation{};
+    }
+
+    VkResult MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset){
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+
+    VkResult MemoryAllocator::invalidate(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset){
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    VkMappedMemoryRange MemoryAllocator::mappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset){
+        if (size == VK_WHOLE_SIZE)
+            size = allocation.size - offset;
+
+        // Ranges must start and end on nonCoherentAtomSize boundaries (or the end of the memory object)
+        VkDeviceSize begin = allocation.offset + offset;
+        VkDeviceSize end = begin + size;
+        begin -= begin % nonCoherentAtomSize;
+        end = ((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize) * nonCoherentAtomSize;
+
+        VkDeviceSize memorySize = allocation.block != nullptr ? allocation.block->size : allocation.size;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = begin;
+        range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+        return range;
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::getStats(){
+        std::lock_guard<std::mutex> lock{mutex};
+        Stats stats{};
+
+        for (auto& pool : pools)
+            for (auto& block : pool.blocks) {
+                stats.blockCount++;
+                stats.allocationCount += static_cast<uint32_t>(block->owners.size());
+                stats.bytesReserved += block->size;
+                stats.bytesUsed += block->used;
+                for (uint32_t k = 0; k <= block->maxOrder; k++)
+                    if (!block->freeLists[k].empty())
+                        stats.largestFreeRange = std::max(stats.largestFreeRange, MIN_ALLOCATION_SIZE << k);
+            }
+
+        for (auto& allocation : dedicatedAllocations) {
+            stats.dedicatedAllocationCount++;
+            stats.allocationCount++;
+            stats.bytesReserved += allocation.size;
+            stats.bytesUsed += allocation.size;
+        }
+
+        stats.bytesFree = stats.bytesReserved - stats.bytesUsed;
+        if (stats.bytesFree > 0)
+            stats.fragmentation = 1.f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(stats.bytesFree);
+        return stats;
+    }
+
+    std::vector<void*> MemoryAllocator::beginDefragmentation(float maxBlockUsage){
+        std::lock_guard<std::mutex> lock{mutex};
+        std::vector<void*> owners;
+
+        for (auto& pool : pools) {
+            // Never drain every block of a pool, the moved allocations need somewhere to go
+            size_t drained = 0;
+            for (auto& block : pool.blocks) {
+                float usage = static_cast<float>(block->used) / static_cast<float>(block->size);
+                if (block->used == 0 || usage > maxBlockUsage || drained + 1 >= pool.blocks.size())
+                    continue;
+                block->draining = true;
+                drained++;
+                for (auto& owner : block->owners)
+                    if (owner.second != nullptr)
+                        owners.push_back(owner.second);
+            }
+        }
+        return owners;
+    }
+
+    void MemoryAllocator::endDefragmentation(){
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            for (auto& pool : pools)
+                for (auto& block : pool.blocks)
+                    block->draining = false;
+        }
+        releaseEmptyBlocks();
+    }
+
+    void MemoryAllocator::releaseEmptyBlocks(){
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto& pool : pools) {
+            auto it = std::remove_if(pool.blocks.begin(), pool.blocks.end(), [&](std::unique_ptr<MemoryBlock>& block){
+                if (block->used != 0)
+                    return false;
+                destroyBlock(block.get());
+                return true;
+            });
+            pool.blocks.erase(it, pool.blocks.end());
+        }
+    }
+
+    MemoryAllocator::Pool& MemoryAllocator::getPool(uint32_t memoryTypeIndex, bool linear){
+        for (auto& pool : pools)
+            if (pool.memoryTypeIndex == memoryTypeIndex && pool.linear == linear)
+                return pool;
+
+        // Small heaps (integrated/BAR memory, software devices) get proportionally smaller blocks
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        VkDeviceSize blockSize = std::min(preferredBlockSize, floorPowerOfTwo(heapSize / 8));
+        blockSize = std::max(blockSize, MIN_ALLOCATION_SIZE * 1024);
+
+        Pool newPool{};
+        newPool.memoryTypeIndex = memoryTypeIndex;
+        newPool.linear = linear;
+        newPool.blockSize = floorPowerOfTwo(blockSize);
+        pools.push_back(std::move(newPool));
+        return pools.back();
+    }
+
+    MemoryBlock* MemoryAllocator::createBlock(Pool& pool){
+        auto block = std::make_unique<MemoryBlock>();
+        block->size = pool.blockSize;
+        block->maxOrder = orderForSize(pool.blockSize);
+        block->memoryTypeIndex = pool.memoryTypeIndex;
+        block->freeLists.resize(block->maxOrder + 1);
+        block->freeLists[block->maxOrder].insert(0);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block->size;
+        allocInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate device memory block.");
+
+        // Host visible blocks stay mapped for their whole lifetime, a memory object can only be mapped once
+        if (memoryProperties.memoryTypes[pool.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+                throw std::runtime_error("Failed to map device memory block.");
+
+        pool.blocks.push_back(std::move(block));
+        return pool.blocks.back().get();
+    }
+
+    void MemoryAllocator::destroyBlock(MemoryBlock* block){
+        assert(block->used == 0 && "Destroying a memory block that still has live allocations.");
+        if (block->mapped != nullptr)
+            vkUnmapMemory(device, block->memory);
+        vkFreeMemory(device, block->memory, nullptr);
+    }
+
+    Allocation MemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, void* owner){
+        Allocation allocation{};
+        allocation.size = size;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        allocation.owner = owner;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate dedicated device memory.");
+
+        if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            if (vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS)
+                throw std::runtime_error("Failed to map dedicated device memory.");
+
+        dedicatedAllocations.push_back(allocation);
+        return allocation;
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties){
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                return i;
+
+        throw std::runtime_error("Failed to find suitable memory type.");
+    }
+}
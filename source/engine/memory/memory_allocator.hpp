@@ -0,0 +1,92 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace Renderer{
+    struct MemoryBlock;
+
+    // A range of device memory handed out by the MemoryAllocator
+    struct Allocation{
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;            // Offset of the range within memory, resources must be bound at this offset
+        VkDeviceSize size = 0;              // Size of the range (at least the requested size)
+        void* mapped = nullptr;             // Host pointer to the start of the range, only set for host visible memory
+
+        MemoryBlock* block = nullptr;       // Block the range was taken from, nullptr for dedicated allocations
+        uint32_t order = 0;                 // Buddy order of the range
+        uint32_t memoryTypeIndex = 0;
+        void* owner = nullptr;              // Opaque pointer to the resource using this range, handed to defragmentation hooks
+    };
+
+    // Device level allocator, sub-allocates resources from large VkDeviceMemory blocks using a buddy system.
+    // Blocks are grouped into pools by memory type and by whether they hold linear (buffers) or optimal (images)
+    // resources so that bufferImageGranularity never has to be considered.
+    class MemoryAllocator{
+        public:
+            struct Stats{
+                uint32_t blockCount = 0;                // Number of sub-allocated blocks
+                uint32_t dedicatedAllocationCount = 0;  // Number of resources too large for a block
+                uint32_t allocationCount = 0;           // Number of live allocations (including dedicated ones)
+                VkDeviceSize bytesReserved = 0;         // Total size of all VkDeviceMemory objects
+                VkDeviceSize bytesUsed = 0;             // Bytes handed out to resources
+                VkDeviceSize bytesFree = 0;             // Bytes reserved but not handed out
+                VkDeviceSize largestFreeRange = 0;      // Largest range that can currently be handed out without a new block
+                float fragmentation = 0.f;              // 0 when all free memory is one range, approaching 1 the more it is split up
+            };
+
+            static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+            static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+            MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+            ~MemoryAllocator();
+
+            MemoryAllocator(const MemoryAllocator&) = delete;
+            MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+            // linear should be true for buffers and linearly tiled images, false for optimally tiled images
+            Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, void* owner = nullptr);
+            void free(Allocation& allocation);
+
+            // Flush/invalidate a range relative to the start of the allocation, handles nonCoherentAtomSize alignment
+            VkResult flush(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+            VkResult invalidate(const Allocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+            Stats getStats();
+
+            // Defragmentation hooks. beginDefragmentation() marks blocks at or below the given usage as draining and returns the
+            // owners of every allocation living in them. Draining blocks receive no new allocations, so owners that re-create their
+            // resource (allocate, copy, free the old allocation) move it into denser blocks. endDefragmentation() clears the flags
+            // and releases the blocks that were emptied.
+            std::vector<void*> beginDefragmentation(float maxBlockUsage = 0.25f);
+            void endDefragmentation();
+            void releaseEmptyBlocks();
+
+        private:
+            struct Pool{
+                uint32_t memoryTypeIndex;
+                bool linear;
+                VkDeviceSize blockSize;
+                std::vector<std::unique_ptr<MemoryBlock>> blocks;
+            };
+
+            Pool& getPool(uint32_t memoryTypeIndex, bool linear);
+            MemoryBlock* createBlock(Pool& pool);
+            void destroyBlock(MemoryBlock* block);
+            Allocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, void* owner);
+            uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+            VkMappedMemoryRange mappedRange(const Allocation& allocation, VkDeviceSize size, VkDeviceSize offset);
+
+            VkDevice device;
+            VkPhysicalDeviceMemoryProperties memoryProperties;
+            VkDeviceSize nonCoherentAtomSize;
+            VkDeviceSize preferredBlockSize;
+
+            std::vector<Pool> pools;
+            std::vector<Allocation> dedicatedAllocations;
+            std::mutex mutex;
+    };
+}
@@ -0,0 +1,134 @@
+#include "geometry_pool.hpp"
+
+#include "engine/upload/upload_manager.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace Renderer{
+    static constexpr VkBufferUsageFlags VERTEX_POOL_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    static constexpr VkBufferUsageFlags INDEX_POOL_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    GeometryPool::GeometryPool(Device& device, uint32_t vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity) 
+    : device{device}, vertexStride{vertexStride}, vertexRanges{vertexCapacity}, indexRanges{indexCapacity}{
+        vertexBuffer = createBuffer(static_cast<VkDeviceSize>(vertexCapacity) * vertexStride, VERTEX_POOL_USAGE);
+        indexBuffer = createBuffer(static_cast<VkDeviceSize>(indexCapacity) * sizeof(uint32_t), INDEX_POOL_USAGE);
+    }
+
+    GeometryPool::Range GeometryPool::allocate(std::span<const std::byte> vertexData, std::span<const uint32_t> indices){
+        assert(vertexData.size() % vertexStride == 0 && "Vertex data must be a whole number of vertices.");
+
+        Range range{};
+        range.vertexCount = static_cast<uint32_t>(vertexData.size() / vertexStride);
+        range.indexCount = static_cast<uint32_t>(indices.size());
+
+        if(range.vertexCount > 0){
+            if(!vertexRanges.allocate(range.vertexCount, range.firstVertex)){
+                growBuffer(vertexBuffer, vertexRanges, vertexStride, range.vertexCount, VERTEX_POOL_USAGE);
+                vertexRanges.allocate(range.vertexCount, range.firstVertex);
+            }
+            device.getUploadManager().uploadToBuffer(vertexBuffer->getBuffer(), vertexData.data(), vertexData.size(), 
+                static_cast<VkDeviceSize>(range.firstVertex) * vertexStride);
+        }
+
+        if(range.indexCount > 0){
+            if(!indexRanges.allocate(range.indexCount, range.firstIndex)){
+                growBuffer(indexBuffer, indexRanges, sizeof(uint32_t), range.indexCount, INDEX_POOL_USAGE);
+                indexRanges.allocate(range.indexCount, range.firstIndex);
+            }
+            device.getUploadManager().uploadToBuffer(indexBuffer->getBuffer(), indices.data(), indices.size_bytes(), 
+                static_cast<VkDeviceSize>(range.firstIndex) * sizeof(uint32_t));
+        }
+        return range;
+    }
+
+    void GeometryPool::free(const Range& range){
+        if(range.vertexCount > 0)
+            vertexRanges.free(range.firstVertex, range.vertexCount);
+        if(range.indexCount > 0)
+            indexRanges.free(range.firstIndex, range.indexCount);
+    }
+
+    void GeometryPool::bind(VkCommandBuffer commandBuffer){
+        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    std::unique_ptr<Buffer> GeometryPool::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage){
+        return std::make_unique<Buffer>(
+            device,
+            1,
+            size,
+            usage,
+            VK_SHARING_MODE_CONCURRENT,     // Written by the transfer queue while graphics draws from other ranges
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+    }
+
+    void GeometryPool::growBuffer(std::unique_ptr<Buffer>& buffer, RangeAllocator& ranges, uint32_t elementSize, uint32_t minCapacity, VkBufferUsageFlags usage){
+        uint32_t oldCapacity = ranges.getCapacity();
+        uint64_t newCapacity = std::max<uint64_t>(oldCapacity, 1);
+        while(newCapacity < static_cast<uint64_t>(oldCapacity) + minCapacity)
+            newCapacity *= 2;
+        if(newCapacity > UINT32_MAX)
+            throw std::runtime_error("Failed to grow geometry pool, too many elements.");
+
+        vkDeviceWaitIdle(device.getDevice());
+        auto newBuffer = createBuffer(newCapacity * elementSize, usage);
+        // Uploads recorded into the old buffer earlier in the batch are ordered before this copy
+        device.getUploadManager().copyBuffer(buffer->getBuffer(), newBuffer->getBuffer(), static_cast<VkDeviceSize>(oldCapacity) * elementSize);
+        device.getUploadManager().flush();
+
+        buffer = std::move(newBuffer);
+        ranges.grow(static_cast<uint32_t>(newCapacity));
+    }
+
+    GeometryPool::RangeAllocator::RangeAllocator(uint32_t capacity) : capacity{capacity}{
+        if(capacity > 0)
+            freeBlocks.emplace(0, capacity);
+    }
+
+    bool GeometryPool::RangeAllocator::allocate(uint32_t count, uint32_t& offset){
+        for(auto it = freeBlocks.begin(); it != freeBlocks.end(); it++){
+            if(it->second < count)
+                continue;
+            offset = it->first;
+            uint32_t remaining = it->second - count;
+            freeBlocks.erase(it);
+            if(remaining > 0)
+                freeBlocks.emplace(offset + count, remaining);
+            return true;
+        }
+        return false;
+    }
+
+    void GeometryPool::RangeAllocator::free(uint32_t offset, uint32_t count){
+        assert(offset + count <= capacity && "Freed range is outside of the pool.");
+        auto next = freeBlocks.lower_bound(offset);
+        assert((next == freeBlocks.end() || next->first >= offset + count) && "Freed range overlaps a free block.");
+
+        // Merge with the following block
+        if(next != freeBlocks.end() && next->first == offset + count){
+            count += next->second;
+            next = freeBlocks.erase(next);
+        }
+        // Merge with the preceding block
+        if(next != freeBlocks.begin()){
+            auto previous = std::prev(next);
+            if(previous->first + previous->second == offset){
+                previous->second += count;
+                return;
+            }
+        }
+        freeBlocks.emplace(offset, count);
+    }
+
+    void GeometryPool::RangeAllocator::grow(uint32_t newCapacity){
+        assert(newCapacity > capacity && "Geometry pool can only grow.");
+        uint32_t oldCapacity = capacity;
+        capacity = newCapacity;
+        free(oldCapacity, newCapacity - oldCapacity);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/buffer/buffer.hpp"
+
+#include <memory>
+#include <map>
+#include <span>
+#include <cstddef>
+
+namespace Renderer{
+    // Shared vertex and index buffers that all models are sub-allocated from, so the whole scene can be drawn with a single
+    // bind and multi-draw indirect (firstIndex/vertexOffset of each draw come from the model's range). Freed ranges are
+    // reused and the buffers grow when full. Not thread safe, use from the thread that records uploads.
+    class GeometryPool{
+        public:
+            static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 256 * 1024;
+            static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 1024 * 1024;
+
+            // Vertex and index ranges of one model, offsets are in elements
+            struct Range{
+                uint32_t firstVertex = 0;
+                uint32_t vertexCount = 0;
+                uint32_t firstIndex = 0;
+                uint32_t indexCount = 0;
+            };
+
+            GeometryPool(Device& device, uint32_t vertexStride, uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY, uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+            GeometryPool(const GeometryPool&) = delete;
+            GeometryPool& operator=(const GeometryPool&) = delete;
+
+            // Reserves ranges for the data and records its upload, vertexData holds vertexStride sized vertices
+            Range allocate(std::span<const std::byte> vertexData, std::span<const uint32_t> indices);
+            void free(const Range& range);
+
+            void bind(VkCommandBuffer commandBuffer);
+
+            VkBuffer getVertexBuffer() { return vertexBuffer->getBuffer(); }
+            VkBuffer getIndexBuffer() { return indexBuffer->getBuffer(); }
+
+        private:
+            // First fit free list over [0, capacity) keyed by offset, neighbouring free blocks are merged
+            class RangeAllocator{
+                public:
+                    RangeAllocator(uint32_t capacity);
+
+                    bool allocate(uint32_t count, uint32_t& offset);
+                    void free(uint32_t offset, uint32_t count);
+                    void grow(uint32_t newCapacity);
+
+                    uint32_t getCapacity() { return capacity; }
+
+                private:
+                    uint32_t capacity;
+                    std::map<uint32_t, uint32_t> freeBlocks;    // Offset to size
+            };
+
+            std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+            // Replaces buffer with a larger copy, waits for the device as frames in flight may still read the old one
+            void growBuffer(std::unique_ptr<Buffer>& buffer, RangeAllocator& ranges, uint32_t elementSize, uint32_t minCapacity, VkBufferUsageFlags usage);
+
+            Device& device;
+            uint32_t vertexStride;
+
+            std::unique_ptr<Buffer> vertexBuffer;
+            std::unique_ptr<Buffer> indexBuffer;
+            RangeAllocator vertexRanges;
+            RangeAllocator indexRanges;
+    };
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "engine/device/device.hpp"
 #include "engine/material/material.hpp"
+#include "engine/scene/slot_map.hpp"
 
 namespace Renderer{
     class Mesh{
@@ -16,21 +17,7 @@ namespace Renderer{
                 glm::vec4 hue = { 1.0f, 1.0f, 1.0f, 1.0f };         // Hue of the light.
             } pointLightComponent{};
 
-            using Map = std::unordered_map<unsigned int, Mesh>;
-
-            static Mesh createMesh(){
-                static unsigned int currentId = 0;
-                return Mesh{currentId++};
-            };
-
-            unsigned int getId() { return id; }
-
-            unsigned int modelId;
-            unsigned int materialId;
-
-        private:
-            Mesh(unsigned int meshId) : id{meshId} {};
-            
-            unsigned int id;
+            unsigned int modelId = 0;
+            Handle<Material> material{};
     };
 }
\ No newline at end of file
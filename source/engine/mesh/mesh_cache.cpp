@@ -0,0 +1,90 @@
+#include "mesh_cache.hpp"
+
+#include "engine/io/mapped_file.hpp"
+#include "engine/io/file_utils.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+
+namespace Renderer{
+    namespace{
+        uint64_t alignOffset(uint64_t offset){
+            return (offset + MeshCache::BLOB_ALIGNMENT - 1) & ~(MeshCache::BLOB_ALIGNMENT - 1);
+        }
+
+        int64_t modifiedTime(const std::filesystem::path& path, std::error_code& error){
+            return static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        }
+    }
+
+    bool MeshCache::load(const std::string& sourcePath, Model::ModelData& data){
+        auto cache = std::make_shared<MappedFile>(getCachePath(sourcePath));
+        if(!cache->isOpen() || cache->getSize() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, cache->getData(), sizeof(Header));
+        if(std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.version != VERSION || header.vertexSize != sizeof(Model::Vertex))
+            return false;
+        if(header.vertexOffset + static_cast<uint64_t>(header.vertexCount) * sizeof(Model::Vertex) > cache->getSize() ||
+            header.indexOffset + static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t) > cache->getSize())
+            return false;
+
+        std::error_code error;
+        uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+        if(error || sourceSize != header.sourceSize)
+            return false;
+        int64_t sourceTime = modifiedTime(sourcePath, error);
+        if(error)
+            return false;
+        if(sourceTime != header.sourceModifiedTime){
+            MappedFile source{sourcePath};
+            if(!source.isOpen() || FileUtils::hash(source.getData(), source.getSize()) != header.sourceHash)
+                return false;
+        }
+
+        const uint8_t* base = cache->getData();
+        data.vertices.clear();
+        data.indices.clear();
+        data.mappedVertices = {reinterpret_cast<const Model::Vertex*>(base + header.vertexOffset), header.vertexCount};
+        data.mappedIndices = {reinterpret_cast<const uint32_t*>(base + header.indexOffset), header.indexCount};
+        data.bounds.min = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+        data.bounds.max = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+        data.mapping = std::move(cache);
+        return true;
+    }
+
+    void MeshCache::save(const std::string& sourcePath, const Model::ModelData& data){
+        auto vertices = data.getVertices();
+        auto indices = data.getIndices();
+
+        Header header{};
+        header.vertexCount = static_cast<uint32_t>(vertices.size());
+        header.indexCount = static_cast<uint32_t>(indices.size());
+        header.vertexOffset = alignOffset(sizeof(Header));
+        header.indexOffset = alignOffset(header.vertexOffset + vertices.size_bytes());
+        for(int i = 0; i < 3; i++){
+            header.boundsMin[i] = data.bounds.min[i];
+            header.boundsMax[i] = data.bounds.max[i];
+        }
+
+        std::error_code error;
+        {
+            MappedFile source{sourcePath};
+            if(!source.isOpen())
+                return;
+            header.sourceSize = source.getSize();
+            header.sourceHash = FileUtils::hash(source.getData(), source.getSize());
+        }
+        header.sourceModifiedTime = modifiedTime(sourcePath, error);
+        if(error)
+            return;
+
+        const std::byte zeros[BLOB_ALIGNMENT] = {};
+        std::string cachePath = getCachePath(sourcePath);
+        if(!FileUtils::atomicWriteFile(cachePath, { std::as_bytes(std::span{&header, 1}), std::span{zeros, header.vertexOffset - sizeof(Header)},
+            std::as_bytes(vertices), std::span{zeros, header.indexOffset - header.vertexOffset - vertices.size_bytes()}, std::as_bytes(indices) }))
+            std::cout << "Failed to write mesh cache: " << cachePath << '\n';
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "engine/mesh/model.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace Renderer{
+    // Binary cache of processed OBJ data, stored next to the source as <source>.meshcache.
+    // Layout: Header, vertex blob, index blob. Blobs are aligned so that they can be used straight from a memory mapping.
+    class MeshCache{
+        public:
+            static constexpr uint32_t VERSION = 1;
+            static constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+            struct Header{
+                char magic[4] = {'R', 'M', 'S', 'H'};
+                uint32_t version = VERSION;
+                uint32_t vertexSize = sizeof(Model::Vertex);    // Invalidates the cache when the vertex layout changes
+                uint32_t vertexCount = 0;
+                uint32_t indexCount = 0;
+                uint32_t padding = 0;
+
+                // Source file state when the cache was written. Size and modification time are checked first, the hash only
+                // when the time differs so that touching a file doesn't force a re-parse.
+                uint64_t sourceSize = 0;
+                int64_t sourceModifiedTime = 0;
+                uint64_t sourceHash = 0;
+
+                float boundsMin[3] = {};
+                float boundsMax[3] = {};
+
+                uint64_t vertexOffset = 0;
+                uint64_t indexOffset = 0;
+            };
+
+            // Maps the cache into data if it is still valid for the source, returns false if the OBJ has to be parsed
+            static bool load(const std::string& sourcePath, Model::ModelData& data);
+            // Writes the cache for data loaded from sourcePath, failures are reported but not fatal
+            static void save(const std::string& sourcePath, const Model::ModelData& data);
+
+            static std::string getCachePath(const std::string& sourcePath) { return sourcePath + ".meshcache"; }
+    };
+}
@@ -1,41 +1,148 @@
 #include "model.hpp"
 
-#include "engine/utils.hpp"
+#include "engine/mesh/mesh_cache.hpp"
+#include "engine/jobs/job_system.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 #include <iostream>
 #include <cassert>
-#include <unordered_map>
-
-namespace std{
-    template <>
-    struct hash<Renderer::Model::Vertex>{
-        size_t operator()(Renderer::Model::Vertex const& vertex) const{
-            size_t seed = 0;
-            Renderer::hashCombine(seed, vertex.position, vertex.colour, vertex.normal, vertex.texCoords);
-            return seed;
-        }
-    };
-}
+#include <climits>
 
 namespace Renderer{
-    Model::Model(Device& device, ModelData& data, unsigned int modelId) : device{device}, modelId{modelId}{
-        createVertexBuffers(data.vertices);
-        createIndexBuffers(data.indices);
+    namespace{
+        // Open addressing (linear probing) map from an OBJ index corner (position, normal, texcoord indices) to the vertex
+        // it became. Two corners with the same triple always build the same vertex, so there is no need to hash vertex data.
+        class CornerTable{
+            public:
+                CornerTable(size_t maxEntries){
+                    size_t capacity = 16;
+                    while(capacity < maxEntries * 2)
+                        capacity <<= 1;
+                    slots.resize(capacity);
+                    mask = capacity - 1;
+                }
+
+                // Returns the vertex for the corner, or nextVertex (and sets inserted) if the corner hasn't been seen yet
+                uint32_t findOrInsert(const tinyobj::index_t& corner, uint32_t nextVertex, bool& inserted){
+                    size_t slot = hashCorner(corner) & mask;
+                    while(true){
+                        Slot& entry = slots[slot];
+                        if(entry.positionIndex == EMPTY){
+                            entry = {corner.vertex_index, corner.normal_index, corner.texcoord_index, nextVertex};
+                            inserted = true;
+                            return nextVertex;
+                        }
+                        if(entry.positionIndex == corner.vertex_index && entry.normalIndex == corner.normal_index && entry.texcoordIndex == corner.texcoord_index){
+                            inserted = false;
+                            return entry.vertex;
+                        }
+                        slot = (slot + 1) & mask;
+                    }
+                }
+
+            private:
+                static constexpr int EMPTY = INT_MIN;
+
+                struct Slot{
+                    int positionIndex = EMPTY;
+                    int normalIndex = 0;
+                    int texcoordIndex = 0;
+                    uint32_t vertex = 0;
+                };
+
+                static size_t hashCorner(const tinyobj::index_t& corner){
+                    uint64_t hash = static_cast<uint32_t>(corner.vertex_index) * 0x9e3779b97f4a7c15ull;
+                    hash ^= static_cast<uint32_t>(corner.normal_index) * 0xc2b2ae3d27d4eb4full;
+                    hash ^= static_cast<uint32_t>(corner.texcoord_index) * 0x165667b19e3779f9ull;
+                    return static_cast<size_t>(hash ^ (hash >> 29));
+                }
+
+                std::vector<Slot> slots;
+                size_t mask;
+        };
+
+        struct Geometry{
+            std::vector<Model::Vertex> vertices;
+            std::vector<uint32_t> indices;
+            Bounds bounds;
+        };
+
+        Model::Vertex buildVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index){
+            Model::Vertex vertex{};
+            if (index.vertex_index >= 0) {
+                vertex.position = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2],
+                };
+                if (!attrib.colors.empty()) {
+                    vertex.colour = {
+                        attrib.colors[3 * index.vertex_index + 0],
+                        attrib.colors[3 * index.vertex_index + 1],
+                        attrib.colors[3 * index.vertex_index + 2],
+                    };
+                }
+            }
+            if (index.normal_index >= 0) {
+                vertex.normal = {
+                    attrib.normals[3 * index.normal_index + 0],
+                    attrib.normals[3 * index.normal_index + 1],
+                    attrib.normals[3 * index.normal_index + 2],
+                };
+            }
+            if (index.texcoord_index >= 0) {
+                vertex.texCoords = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+            return vertex;
+        }
+
+        void deduplicate(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::index_t>& corners, CornerTable& table, Geometry& geometry){
+            for (const auto& corner : corners) {
+                bool inserted;
+                uint32_t vertexIndex = table.findOrInsert(corner, static_cast<uint32_t>(geometry.vertices.size()), inserted);
+                if (inserted) {
+                    geometry.vertices.push_back(buildVertex(attrib, corner));
+                    geometry.bounds.expand(geometry.vertices.back().position);
+                }
+                geometry.indices.push_back(vertexIndex);
+            }
+        }
     }
 
-    std::unique_ptr<Model> Model::createModelFromFile(Device& device, const std::string& filepath){
-        static unsigned int currentId = 0;
+    Model::Model(GeometryPool& geometryPool, ModelData& data, unsigned int modelId) : geometryPool{geometryPool}, bounds{data.bounds}, modelId{modelId}{
+        auto vertices = data.getVertices();
+        assert(vertices.size() >= 3 && "Vertex count must be at least 3.");
+        range = geometryPool.allocate(std::as_bytes(vertices), data.getIndices());
+    }
+
+    Model::~Model(){
+        geometryPool.free(range);
+    }
+
+    std::unique_ptr<Model> Model::createModelFromFile(GeometryPool& geometryPool, const std::string& filepath){
         ModelData data{};
         data.loadModel(filepath);
-        return std::make_unique<Model>(device, data, currentId++);
+        return std::make_unique<Model>(geometryPool, data, reserveId());
+    }
+
+    unsigned int Model::reserveId(){
+        static unsigned int currentId = 0;
+        return currentId++;
     }
 
     void Model::ModelData::loadModel(const std::string &filepath){
+        if(MeshCache::load(filepath, *this))
+            return;
+        parseObj(filepath);
+        MeshCache::save(filepath, *this);
+    }
+
+    void Model::ModelData::parseObj(const std::string &filepath){
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
@@ -47,116 +154,62 @@ namespace Renderer{
 
         vertices.clear();
         indices.clear();
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-        for (const auto &shape : shapes) {
-            for (const auto &index : shape.mesh.indices) {
-                Vertex vertex{};
-                if (index.vertex_index >= 0) {
-                    vertex.position = {
-                        attrib.vertices[3 * index.vertex_index + 0],
-                        attrib.vertices[3 * index.vertex_index + 1],
-                        attrib.vertices[3 * index.vertex_index + 2],
-                    };
-                    vertex.colour = {
-                        attrib.colors[3 * index.vertex_index + 0],
-                        attrib.colors[3 * index.vertex_index + 1],
-                        attrib.colors[3 * index.vertex_index + 2],
-                    };
-                }
-                if (index.normal_index >= 0) {
-                    vertex.normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2],
-                    };
-                }
-                if (index.texcoord_index >= 0) {
-                    vertex.texCoords = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                    };
-                }
-                if (uniqueVertices.count(vertex) == 0) {
-                  uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                  vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
-            }     
+        bounds = Bounds{};
+        mapping.reset();
+
+        size_t cornerCount = 0;
+        for (const auto &shape : shapes)
+            cornerCount += shape.mesh.indices.size();
+
+        // Large multi-shape meshes are deduplicated per shape in parallel. Vertices shared between shapes are duplicated
+        // then, which is rare in practice and cheaper than merging the tables.
+        constexpr size_t PARALLEL_MIN_CORNERS = 1 << 16;
+        if (shapes.size() > 1 && cornerCount >= PARALLEL_MIN_CORNERS) {
+            std::vector<Geometry> shapeGeometry(shapes.size());
+            JobSystem::shared().parallelFor(static_cast<uint32_t>(shapes.size()), [&](uint32_t i){
+                const auto& corners = shapes[i].mesh.indices;
+                CornerTable table{corners.size()};
+                shapeGeometry[i].indices.reserve(corners.size());
+                deduplicate(attrib, corners, table, shapeGeometry[i]);
+            });
+
+            size_t vertexCount = 0;
+            for (const auto& geometry : shapeGeometry)
+                vertexCount += geometry.vertices.size();
+            vertices.reserve(vertexCount);
+            indices.reserve(cornerCount);
+            for (const auto& geometry : shapeGeometry) {
+                uint32_t baseVertex = static_cast<uint32_t>(vertices.size());
+                vertices.insert(vertices.end(), geometry.vertices.begin(), geometry.vertices.end());
+                for (uint32_t index : geometry.indices)
+                    indices.push_back(baseVertex + index);
+                if (!geometry.vertices.empty())
+                    bounds.expand(geometry.bounds);
+            }
+            return;
         }
-    }
 
-    void Model::createVertexBuffers(const std::vector<Vertex> &vertices){
-        vertexCount = static_cast<uint32_t>(vertices.size());
-        assert(vertexCount >= 3 && "Vertex count must be at least 3.");
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-        Buffer stagingBuffer{
-            device, 
-            vertexCount, 
-            bufferSize, 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)vertices.data());
-
-        vertexBuffer = std::make_unique<Buffer>(
-            device,
-            vertexCount,
-            bufferSize,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-        stagingBuffer.copyBuffer(vertexBuffer->getBuffer(), bufferSize);
-    }
-
-    void Model::createIndexBuffers(const std::vector<uint32_t> &indices){
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffer = indexCount > 0;
-        if (!hasIndexBuffer)
-            return;
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-
-        Buffer stagingBuffer{
-            device,
-            indexCount,
-            bufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
+        Geometry geometry;
+        geometry.vertices.reserve(attrib.vertices.size() / 3);
+        geometry.indices.reserve(cornerCount);
+        CornerTable table{cornerCount};
+        for (const auto &shape : shapes)
+            deduplicate(attrib, shape.mesh.indices, table, geometry);
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)indices.data());
-
-        indexBuffer = std::make_unique<Buffer>(
-            device,
-            indexCount,
-            bufferSize,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-        stagingBuffer.copyBuffer(indexBuffer->getBuffer(), bufferSize);
+        vertices = std::move(geometry.vertices);
+        indices = std::move(geometry.indices);
+        bounds = geometry.bounds;
     }
 
     void Model::bind(VkCommandBuffer commandBuffer){
-        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-        if (hasIndexBuffer)
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        geometryPool.bind(commandBuffer);
     }
 
     void Model::draw(VkCommandBuffer commandBuffer){
-        if (hasIndexBuffer)
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        if (range.indexCount > 0)
+            vkCmdDrawIndexed(commandBuffer, range.indexCount, 1, range.firstIndex, getVertexOffset(), 0);
         else
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, range.vertexCount, 1, range.firstVertex, 0);
     }
 
     std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions(){
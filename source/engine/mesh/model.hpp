@@ -1,13 +1,16 @@
 #pragma once
 
-#include "engine/buffer/buffer.hpp"
+#include "engine/mesh/geometry_pool.hpp"
+#include "engine/culling/bounds.hpp"
+#include "engine/io/mapped_file.hpp"
 #include "glm/glm.hpp"
 
 #include <memory>
 #include <unordered_map>
+#include <span>
 
 namespace Renderer{
-    // Class representing a 3D model
+    // Class representing a 3D model, its vertices and indices live in a range of the shared geometry pool
     class Model{
         public:
             struct Vertex {
@@ -27,41 +30,47 @@ namespace Renderer{
             struct ModelData{
                 std::vector<Vertex> vertices{};
                 std::vector<uint32_t> indices{};
+                Bounds bounds{};
+
+                // Set when the data comes from the mesh cache, vertices and indices stay empty and are read from the mapping
+                std::shared_ptr<MappedFile> mapping;
+                std::span<const Vertex> mappedVertices;
+                std::span<const uint32_t> mappedIndices;
+
+                std::span<const Vertex> getVertices() const { return mapping ? mappedVertices : std::span<const Vertex>{vertices}; }
+                std::span<const uint32_t> getIndices() const { return mapping ? mappedIndices : std::span<const uint32_t>{indices}; }
+
+                // Loads from the binary mesh cache next to the file, the OBJ is only parsed (and the cache rewritten) when it is stale
                 void loadModel(const std::string &filepath);
+                void parseObj(const std::string &filepath);
             };
 
-            Model(Device& device, ModelData& data, unsigned int modelId);
+            Model(GeometryPool& geometryPool, ModelData& data, unsigned int modelId);
+            ~Model();
 
             Model(const Model&) = delete;
             Model &operator=(const Model&) = delete;
         
             unsigned int getId() { return modelId; }
-            static std::unique_ptr<Model> createModelFromFile(Device& device, const std::string& filepath);
+            static std::unique_ptr<Model> createModelFromFile(GeometryPool& geometryPool, const std::string& filepath);
+            // Hands out the id the next model will get, lets asynchronous loads be referenced before they finish
+            static unsigned int reserveId();
 
-            uint32_t getVertexCount() { return vertexCount; }
-            uint32_t getIndexCount() { 
-                if(hasIndexBuffer) 
-                    return indexCount; 
-                else
-                    return 0;
-            }
+            uint32_t getVertexCount() { return range.vertexCount; }
+            const Bounds& getBounds() { return bounds; }
+            uint32_t getIndexCount() { return range.indexCount; }
+            // Offsets into the pool's buffers, used as firstIndex/vertexOffset of indexed draws
+            uint32_t getFirstIndex() { return range.firstIndex; }
+            int32_t getVertexOffset() { return static_cast<int32_t>(range.firstVertex); }
 
             void bind(VkCommandBuffer commandBuffer);
             void draw(VkCommandBuffer commandBuffer);
 
         private:    
-            void createVertexBuffers(const std::vector<Vertex> &vertices);
-            void createIndexBuffers(const std::vector<uint32_t> &indices);
-
-            Device& device;
-
-            std::unique_ptr<Buffer> vertexBuffer;
-            uint32_t vertexCount;
-
-            std::unique_ptr<Buffer> indexBuffer;
-            uint32_t indexCount;
+            GeometryPool& geometryPool;
+            GeometryPool::Range range;
 
-            bool hasIndexBuffer = false;
+            Bounds bounds;
 
             unsigned int modelId;
     };
@@ -1,13 +1,13 @@
 #pragma once
 
-#include "engine/mesh/model.hpp"
-#include "engine/material/texture/texture.hpp"
-#include "engine/material/sampler/sampler.hpp"
+#include "engine/mesh/mesh.hpp"
+#include "engine/scene/slot_map.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <memory>
-#include <unordered_map>
+#include <array>
+#include <span>
+#include <cassert>
 
 namespace Renderer{
     struct TransformComponent {
@@ -21,22 +21,22 @@ namespace Renderer{
 
     class Object{
         public:
-            using Map = std::unordered_map<unsigned int, Object>;
+            static constexpr uint32_t MAX_MESHES = 8;
 
-            static Object createObject() {
-                static unsigned int currentId = 0;
-                return Object{currentId++};
-            }
+            // Objects in a scene are referenced by the handle Scene::createObject() returned
+            static Object createObject() { return Object{}; }
 
-            unsigned int getId() { return id; }
+            void addMesh(Handle<Mesh> mesh){
+                assert(meshCount < MAX_MESHES && "Object already has the maximum number of meshes.");
+                meshes[meshCount++] = mesh;
+            }
+            std::span<const Handle<Mesh>> getMeshes() const { return {meshes.data(), meshCount}; }
             
             TransformComponent transform{};
 
-            std::vector<unsigned int> meshIds;
-
         private:
-            Object(unsigned int objectId) : id{objectId} {}
-
-            unsigned int id;
+            // Stored inline so scanning objects never leaves the scene's packed object array
+            std::array<Handle<Mesh>, MAX_MESHES> meshes{};
+            uint32_t meshCount = 0;
     };
 }
\ No newline at end of file
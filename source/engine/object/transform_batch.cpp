@@ -0,0 +1,220 @@
+#include "transform_batch.hpp"
+
+#include <cmath>
+#include <array>
+#include <algorithm>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define TRANSFORM_BATCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TRANSFORM_BATCH_SSE2
+#endif
+
+namespace Renderer{
+    namespace{
+#if defined(TRANSFORM_BATCH_AVX2)
+        constexpr size_t LANES = 8;
+        using FloatLanes = __m256;
+        using IntLanes = __m256i;
+
+        inline FloatLanes load(const float* p) { return _mm256_loadu_ps(p); }
+        inline void store(float* p, FloatLanes v) { _mm256_storeu_ps(p, v); }
+        inline FloatLanes broadcast(float v) { return _mm256_set1_ps(v); }
+        inline IntLanes setInt(int v) { return _mm256_set1_epi32(v); }
+        inline FloatLanes add(FloatLanes a, FloatLanes b) { return _mm256_add_ps(a, b); }
+        inline FloatLanes sub(FloatLanes a, FloatLanes b) { return _mm256_sub_ps(a, b); }
+        inline FloatLanes mul(FloatLanes a, FloatLanes b) { return _mm256_mul_ps(a, b); }
+        inline FloatLanes bitAnd(FloatLanes a, FloatLanes b) { return _mm256_and_ps(a, b); }
+        inline FloatLanes bitAndNot(FloatLanes a, FloatLanes b) { return _mm256_andnot_ps(a, b); }
+        inline FloatLanes bitXor(FloatLanes a, FloatLanes b) { return _mm256_xor_ps(a, b); }
+        inline IntLanes toInt(FloatLanes v) { return _mm256_cvttps_epi32(v); }
+        inline FloatLanes toFloat(IntLanes v) { return _mm256_cvtepi32_ps(v); }
+        inline FloatLanes asFloat(IntLanes v) { return _mm256_castsi256_ps(v); }
+        inline IntLanes addInt(IntLanes a, IntLanes b) { return _mm256_add_epi32(a, b); }
+        inline IntLanes subInt(IntLanes a, IntLanes b) { return _mm256_sub_epi32(a, b); }
+        inline IntLanes andInt(IntLanes a, IntLanes b) { return _mm256_and_si256(a, b); }
+        inline IntLanes andNotInt(IntLanes a, IntLanes b) { return _mm256_andnot_si256(a, b); }
+        inline IntLanes equalInt(IntLanes a, IntLanes b) { return _mm256_cmpeq_epi32(a, b); }
+        inline IntLanes shiftLeft29(IntLanes v) { return _mm256_slli_epi32(v, 29); }
+#elif defined(TRANSFORM_BATCH_SSE2)
+        constexpr size_t LANES = 4;
+        using FloatLanes = __m128;
+        using IntLanes = __m128i;
+
+        inline FloatLanes load(const float* p) { return _mm_loadu_ps(p); }
+        inline void store(float* p, FloatLanes v) { _mm_storeu_ps(p, v); }
+        inline FloatLanes broadcast(float v) { return _mm_set1_ps(v); }
+        inline IntLanes setInt(int v) { return _mm_set1_epi32(v); }
+        inline FloatLanes add(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+        inline FloatLanes sub(FloatLanes a, FloatLanes b) { return _mm_sub_ps(a, b); }
+        inline FloatLanes mul(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+        inline FloatLanes bitAnd(FloatLanes a, FloatLanes b) { return _mm_and_ps(a, b); }
+        inline FloatLanes bitAndNot(FloatLanes a, FloatLanes b) { return _mm_andnot_ps(a, b); }
+        inline FloatLanes bitXor(FloatLanes a, FloatLanes b) { return _mm_xor_ps(a, b); }
+        inline IntLanes toInt(FloatLanes v) { return _mm_cvttps_epi32(v); }
+        inline FloatLanes toFloat(IntLanes v) { return _mm_cvtepi32_ps(v); }
+        inline FloatLanes asFloat(IntLanes v) { return _mm_castsi128_ps(v); }
+        inline IntLanes addInt(IntLanes a, IntLanes b) { return _mm_add_epi32(a, b); }
+        inline IntLanes subInt(IntLanes a, IntLanes b) { return _mm_sub_epi32(a, b); }
+        inline IntLanes andInt(IntLanes a, IntLanes b) { return _mm_and_si128(a, b); }
+        inline IntLanes andNotInt(IntLanes a, IntLanes b) { return _mm_andnot_si128(a, b); }
+        inline IntLanes equalInt(IntLanes a, IntLanes b) { return _mm_cmpeq_epi32(a, b); }
+        inline IntLanes shiftLeft29(IntLanes v) { return _mm_slli_epi32(v, 29); }
+#else
+        constexpr size_t LANES = 1;
+#endif
+
+#if defined(TRANSFORM_BATCH_AVX2) || defined(TRANSFORM_BATCH_SSE2)
+        // Cephes style sincosf: the angle is reduced to [-pi/4, pi/4] around the nearest multiple of pi/2 (extended
+        // precision subtraction of pi/4), then both minimax polynomials are evaluated and swapped/negated per octant.
+        // Against std::sin/std::cos the absolute error stays below 1e-7 for |angle| < 8192. The relative error is around
+        // 1.2e-7 (1-2 ulp) for results above 1e-3 but grows to about 6.6e-7 closer to the zeros of sine and cosine.
+        void sinCos(FloatLanes angle, FloatLanes& sine, FloatLanes& cosine){
+            const FloatLanes signMask = broadcast(-0.f);
+            FloatLanes sineSign = bitAnd(angle, signMask);
+            FloatLanes x = bitAndNot(signMask, angle);
+
+            // Octant, rounded up to even
+            IntLanes octant = toInt(mul(x, broadcast(1.27323954473516f)));       // 4 / pi
+            octant = andInt(addInt(octant, setInt(1)), setInt(~1));
+            FloatLanes y = toFloat(octant);
+
+            FloatLanes sineSwapSign = asFloat(shiftLeft29(andInt(octant, setInt(4))));
+            FloatLanes cosineSign = asFloat(shiftLeft29(andNotInt(subInt(octant, setInt(2)), setInt(4))));
+            FloatLanes usesSinePolynomial = asFloat(equalInt(andInt(octant, setInt(2)), setInt(0)));
+            sineSign = bitXor(sineSign, sineSwapSign);
+
+            x = sub(x, mul(y, broadcast(0.78515625f)));
+            x = sub(x, mul(y, broadcast(2.4187564849853515625e-4f)));
+            x = sub(x, mul(y, broadcast(3.77489497744594108e-8f)));
+            FloatLanes z = mul(x, x);
+
+            FloatLanes cosinePolynomial = broadcast(2.443315711809948e-5f);
+            cosinePolynomial = add(mul(cosinePolynomial, z), broadcast(-1.388731625493765e-3f));
+            cosinePolynomial = add(mul(cosinePolynomial, z), broadcast(4.166664568298827e-2f));
+            cosinePolynomial = mul(mul(cosinePolynomial, z), z);
+            cosinePolynomial = add(sub(cosinePolynomial, mul(z, broadcast(0.5f))), broadcast(1.f));
+
+            FloatLanes sinePolynomial = broadcast(-1.9515295891e-4f);
+            sinePolynomial = add(mul(sinePolynomial, z), broadcast(8.3321608736e-3f));
+            sinePolynomial = add(mul(sinePolynomial, z), broadcast(-1.6666654611e-1f));
+            sinePolynomial = add(mul(mul(sinePolynomial, z), x), x);
+
+            FloatLanes sineResult = add(bitAnd(usesSinePolynomial, sinePolynomial), bitAndNot(usesSinePolynomial, cosinePolynomial));
+            FloatLanes cosineResult = add(bitAndNot(usesSinePolynomial, sinePolynomial), bitAnd(usesSinePolynomial, cosinePolynomial));
+            sine = bitXor(sineResult, sineSign);
+            cosine = bitXor(cosineResult, cosineSign);
+        }
+#endif
+
+        // Rotation part shared by both matrices (columns of TransformComponent::mat4() before scaling)
+        struct Rotation{
+            float m[9];
+        };
+
+#if !defined(TRANSFORM_BATCH_AVX2) && !defined(TRANSFORM_BATCH_SSE2)
+        inline Rotation buildRotation(float c1, float s1, float c2, float s2, float c3, float s3){
+            return {{
+                c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1,
+                c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3,
+                c2 * s1, -s2, c1 * c2
+            }};
+        }
+#endif
+
+        inline glm::mat4& outputAt(glm::mat4* base, size_t index, size_t stride){
+            return *reinterpret_cast<glm::mat4*>(reinterpret_cast<std::byte*>(base) + index * stride);
+        }
+    }
+
+    void TransformBatch::clear(){
+        resize(0);
+    }
+
+    void TransformBatch::resize(size_t newCount){
+        count = newCount;
+        size_t padded = (count + LANES - 1) / LANES * LANES;
+        for(auto* component : {&translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ})
+            component->resize(padded, 0.f);
+        for(auto* component : {&scaleX, &scaleY, &scaleZ})
+            component->resize(padded, 1.f);
+    }
+
+    void TransformBatch::set(size_t index, const TransformComponent& transform){
+        translationX[index] = transform.translation.x;
+        translationY[index] = transform.translation.y;
+        translationZ[index] = transform.translation.z;
+        rotationX[index] = transform.rotation.x;
+        rotationY[index] = transform.rotation.y;
+        rotationZ[index] = transform.rotation.z;
+        scaleX[index] = transform.scale.x;
+        scaleY[index] = transform.scale.y;
+        scaleZ[index] = transform.scale.z;
+    }
+
+    void TransformBatch::push_back(const TransformComponent& transform){
+        resize(count + 1);
+        set(count - 1, transform);
+    }
+
+    void TransformBatch::computeMatrices(glm::mat4* modelMatrices, glm::mat4* normalMatrices, size_t stride){
+        auto writeMatrices = [&](size_t index, const Rotation& rotation){
+            glm::vec3 scale{scaleX[index], scaleY[index], scaleZ[index]};
+            glm::vec3 invScale = 1.0f / scale;
+            const float* r = rotation.m;
+
+            glm::mat4& model = outputAt(modelMatrices, index, stride);
+            model[0] = {scale.x * r[0], scale.x * r[1], scale.x * r[2], 0.f};
+            model[1] = {scale.y * r[3], scale.y * r[4], scale.y * r[5], 0.f};
+            model[2] = {scale.z * r[6], scale.z * r[7], scale.z * r[8], 0.f};
+            model[3] = {translationX[index], translationY[index], translationZ[index], 1.f};
+
+            glm::mat4& normal = outputAt(normalMatrices, index, stride);
+            normal[0] = {invScale.x * r[0], invScale.x * r[1], invScale.x * r[2], 0.f};
+            normal[1] = {invScale.y * r[3], invScale.y * r[4], invScale.y * r[5], 0.f};
+            normal[2] = {invScale.z * r[6], invScale.z * r[7], invScale.z * r[8], 0.f};
+            normal[3] = {0.f, 0.f, 0.f, 1.f};
+        };
+
+        size_t index = 0;
+#if defined(TRANSFORM_BATCH_AVX2) || defined(TRANSFORM_BATCH_SSE2)
+        // Components are padded, so the last block may run past count and only writes the valid lanes
+        for(; index < count; index += LANES){
+            FloatLanes s1, c1, s2, c2, s3, c3;
+            sinCos(load(&rotationY[index]), s1, c1);
+            sinCos(load(&rotationX[index]), s2, c2);
+            sinCos(load(&rotationZ[index]), s3, c3);
+
+            std::array<std::array<float, LANES>, 9> terms;
+            store(terms[0].data(), add(mul(c1, c3), mul(mul(s1, s2), s3)));
+            store(terms[1].data(), mul(c2, s3));
+            store(terms[2].data(), sub(mul(mul(c1, s2), s3), mul(c3, s1)));
+            store(terms[3].data(), sub(mul(mul(c3, s1), s2), mul(c1, s3)));
+            store(terms[4].data(), mul(c2, c3));
+            store(terms[5].data(), add(mul(mul(c1, c3), s2), mul(s1, s3)));
+            store(terms[6].data(), mul(c2, s1));
+            store(terms[7].data(), bitXor(s2, broadcast(-0.f)));
+            store(terms[8].data(), mul(c1, c2));
+
+            size_t valid = std::min(LANES, count - index);
+            for(size_t lane = 0; lane < valid; lane++){
+                Rotation rotation;
+                for(int term = 0; term < 9; term++)
+                    rotation.m[term] = terms[term][lane];
+                writeMatrices(index + lane, rotation);
+            }
+        }
+#else
+        for(; index < count; index++){
+            Rotation rotation = buildRotation(
+                std::cos(rotationY[index]), std::sin(rotationY[index]),
+                std::cos(rotationX[index]), std::sin(rotationX[index]),
+                std::cos(rotationZ[index]), std::sin(rotationZ[index])
+            );
+            writeMatrices(index, rotation);
+        }
+#endif
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "engine/object/object.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+namespace Renderer{
+    // Structure of arrays copy of many TransformComponents, computeMatrices() builds all of their model and normal
+    // matrices at once. Sine and cosine are evaluated once per angle (4 or 8 angles at a time with SSE2/AVX2) and shared
+    // between both matrices. Without SIMD it uses the same scalar math as TransformComponent.
+    class TransformBatch{
+        public:
+            void clear();
+            void resize(size_t count);
+            size_t size() { return count; }
+
+            void set(size_t index, const TransformComponent& transform);
+            void push_back(const TransformComponent& transform);
+
+            // Writes size() matrices of each kind, consecutive outputs are stride bytes apart so they can be written
+            // straight into interleaved structs (e.g. instance data)
+            void computeMatrices(glm::mat4* modelMatrices, glm::mat4* normalMatrices, size_t stride = sizeof(glm::mat4));
+
+        private:
+            size_t count = 0;
+            // Components are padded to a multiple of the SIMD width
+            std::vector<float> translationX, translationY, translationZ;
+            std::vector<float> rotationX, rotationY, rotationZ;
+            std::vector<float> scaleX, scaleY, scaleZ;
+    };
+}
\ No newline at end of file
@@ -52,7 +52,8 @@ namespace Renderer{
     DescriptorSetLayout::DescriptorSetLayout(Device& device) : device{device}{}
     DescriptorSetLayout::~DescriptorSetLayout(){}
 
-    void DescriptorSetLayout::addBinding(uint32_t descriptorCount, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler* pImmutableSamplers){
+    void DescriptorSetLayout::addBinding(uint32_t descriptorCount, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler* pImmutableSamplers, 
+        VkDescriptorBindingFlags flags){
         uint32_t binding = bindings.size();
         VkDescriptorSetLayoutBinding newBinding {};
         newBinding.binding = binding;
@@ -61,14 +62,30 @@ namespace Renderer{
         newBinding.stageFlags = stageFlags;
         newBinding.pImmutableSamplers = pImmutableSamplers;
         bindings.emplace(binding, newBinding);
+        bindingFlags.emplace(binding, flags);
     }
 
     void DescriptorSetLayout::buildLayout(VkDescriptorSetLayoutCreateFlags flags){
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
-        for (auto binding : bindings) 
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+        bool hasBindingFlags = false;
+        for (auto binding : bindings){
             setLayoutBindings.push_back(binding.second);
+            setLayoutBindingFlags.push_back(bindingFlags[binding.first]);
+            hasBindingFlags |= setLayoutBindingFlags.back() != 0;
+            if(setLayoutBindingFlags.back() & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+                flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        }
+
+        // Flags are matched to pBindings by position
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+
         VkDescriptorSetLayoutCreateInfo layoutInfo = {};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr;
         layoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         layoutInfo.pBindings = setLayoutBindings.data();
         layoutInfo.flags = flags;
@@ -100,4 +117,17 @@ namespace Renderer{
         newWrite.pImageInfo = imageInfo;
         return newWrite;
     }
+
+    VkWriteDescriptorSet DescriptorSetLayout::writeImages(uint32_t binding, uint32_t arrayElement, uint32_t count, VkDescriptorImageInfo* imageInfos){
+        auto &bindingDescription = bindings[binding];
+        assert(arrayElement + count <= bindingDescription.descriptorCount && "Cannot write past the end of a descriptor array.");
+        VkWriteDescriptorSet newWrite{};
+        newWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        newWrite.dstBinding = binding;
+        newWrite.dstArrayElement = arrayElement;
+        newWrite.descriptorType = bindingDescription.descriptorType;
+        newWrite.descriptorCount = count;
+        newWrite.pImageInfo = imageInfos;
+        return newWrite;
+    }
 }
\ No newline at end of file
@@ -14,16 +14,22 @@ namespace Renderer{
             ~DescriptorSetLayout();
 
             VkDescriptorSetLayout getLayout() { return layout; }
-            void addBinding(uint32_t descriptorCount, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler* pImmutableSamplers = nullptr);
+            // Bindings with VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT make the layout an update after bind one, its sets
+            // have to come from a pool built with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+            void addBinding(uint32_t descriptorCount, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler* pImmutableSamplers = nullptr, 
+                VkDescriptorBindingFlags flags = 0);
             void buildLayout(VkDescriptorSetLayoutCreateFlags flags = 0);
 
             VkWriteDescriptorSet writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
             VkWriteDescriptorSet writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+            // Writes count elements of an array binding starting at arrayElement, the rest of the array is left as it is
+            VkWriteDescriptorSet writeImages(uint32_t binding, uint32_t arrayElement, uint32_t count, VkDescriptorImageInfo* imageInfos);
 
         private:
             Device& device;
             VkDescriptorSetLayout layout;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags;
             std::vector<VkWriteDescriptorSet> writes;
         friend class DescriptorPool;
     };
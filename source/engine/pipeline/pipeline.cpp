@@ -1,26 +1,101 @@
 #include "pipeline.hpp"
 
 #include "engine/mesh/model.hpp"
+#include "engine/pipeline/pipeline_cache.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
 #include <cassert>
 
 namespace Renderer{
-    GraphicsPipeline::GraphicsPipeline(Device& device, const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo) : device{device}{
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+    void GraphicsPipelineConfigInfo::copyFrom(const GraphicsPipelineConfigInfo& source){
+        bindingDescriptions = source.bindingDescriptions;
+        attributeDescriptions = source.attributeDescriptions;
+        viewportInfo = source.viewportInfo;
+        inputAssemblyInfo = source.inputAssemblyInfo;
+        rasterizationInfo = source.rasterizationInfo;
+        colorBlendAttachment = source.colorBlendAttachment;
+        colorBlendInfo = source.colorBlendInfo;
+        depthStencilInfo = source.depthStencilInfo;
+        dynamicStateEnables = source.dynamicStateEnables;
+        dynamicStateInfo = source.dynamicStateInfo;
+        pipelineLayout = source.pipelineLayout;
+        renderPass = source.renderPass;
+        subpass = source.subpass;
+        rasterizationSamples = source.rasterizationSamples;
+
+        if(source.colorBlendInfo.pAttachments == &source.colorBlendAttachment)
+            colorBlendInfo.pAttachments = &colorBlendAttachment;
+        if(source.dynamicStateInfo.pDynamicStates == source.dynamicStateEnables.data())
+            dynamicStateInfo.pDynamicStates = dynamicStateEnables.data();
     }
 
-    GraphicsPipeline::~GraphicsPipeline(){
-        vkDestroyPipeline(device.getDevice(), graphicsPipeline, nullptr);
+    SpecializationConstants& SpecializationConstants::set(uint32_t constantId, uint32_t value){
+        for(auto& entry : entries){
+            if(entry.constantID == constantId){
+                data[entry.offset / sizeof(uint32_t)] = value;
+                return *this;
+            }
+        }
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        entries.push_back(entry);
+        data.push_back(value);
+        return *this;
+    }
+
+    SpecializationConstants& SpecializationConstants::set(uint32_t constantId, int32_t value){
+        return set(constantId, std::bit_cast<uint32_t>(value));
+    }
+
+    SpecializationConstants& SpecializationConstants::set(uint32_t constantId, float value){
+        return set(constantId, std::bit_cast<uint32_t>(value));
+    }
+
+    VkSpecializationInfo SpecializationConstants::getInfo() const{
+        VkSpecializationInfo info{};
+        info.mapEntryCount = static_cast<uint32_t>(entries.size());
+        info.pMapEntries = entries.data();
+        info.dataSize = data.size() * sizeof(uint32_t);
+        info.pData = data.data();
+        return info;
     }
 
-    void GraphicsPipeline::createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo){
+    GraphicsPipeline::GraphicsPipeline(Device& device, const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo, 
+        const SpecializationConstants& specialization, const std::vector<std::string>& defines, JobSystem& jobSystem) 
+    : device{device}, jobSystem{jobSystem}, vertFilepath{vertFilepath}, fragFilepath{fragFilepath}, defines{defines}, specialization{specialization}{
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo.");
         assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo.");
 
-        vertShaderModule = std::make_unique<ShaderModule>(device, vertFilepath);
-        fragShaderModule = std::make_unique<ShaderModule>(device, fragFilepath);
+        this->configInfo.copyFrom(configInfo);
+        creation = jobSystem.submit([this](){ createGraphicsPipeline(); }).share();
+    }
+
+    GraphicsPipeline::~GraphicsPipeline(){
+        // The job uses this object, it can't be abandoned
+        creation.wait();
+        vkDestroyPipeline(device.getDevice(), graphicsPipeline, nullptr);
+    }
+
+    bool GraphicsPipeline::usesShader(const std::vector<std::string>& shaderPaths) const{
+        return std::find(shaderPaths.begin(), shaderPaths.end(), vertFilepath) != shaderPaths.end() ||
+            std::find(shaderPaths.begin(), shaderPaths.end(), fragFilepath) != shaderPaths.end();
+    }
+
+    void GraphicsPipeline::rebuild(){
+        creation.wait();
+        vkDestroyPipeline(device.getDevice(), graphicsPipeline, nullptr);
+        graphicsPipeline = VK_NULL_HANDLE;
+        creation = jobSystem.submit([this](){ createGraphicsPipeline(); }).share();
+    }
+
+    void GraphicsPipeline::createGraphicsPipeline(){
+        vertShaderModule = device.getShaderLibrary().getModule(vertFilepath, defines);
+        fragShaderModule = device.getShaderLibrary().getModule(fragFilepath, defines);
+        VkSpecializationInfo specializationInfo = specialization.getInfo();
 
         VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -29,14 +104,14 @@ namespace Renderer{
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         shaderStages[1].module = fragShaderModule->getShaderModule();
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -51,7 +126,8 @@ namespace Renderer{
         VkPipelineMultisampleStateCreateInfo multisampleInfo{};
         multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampleInfo.sampleShadingEnable = VK_FALSE;
-        multisampleInfo.rasterizationSamples = device.getMaxUsableSampleCount();
+        multisampleInfo.rasterizationSamples = configInfo.rasterizationSamples == VK_SAMPLE_COUNT_FLAG_BITS_MAX_ENUM ? 
+            device.getMaxUsableSampleCount() : configInfo.rasterizationSamples;
         multisampleInfo.minSampleShading = 1.0f;           
         multisampleInfo.pSampleMask = nullptr;           
         multisampleInfo.alphaToCoverageEnable = VK_FALSE;
@@ -77,11 +153,12 @@ namespace Renderer{
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if(vkCreateGraphicsPipelines(device.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+        if(vkCreateGraphicsPipelines(device.getDevice(), device.getPipelineCache().getCache(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
             throw std::runtime_error("Failed to create graphics pipeline.");
     }
 
     void GraphicsPipeline::bind(VkCommandBuffer commandBuffer){
+        wait();
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }
 
@@ -148,72 +225,54 @@ namespace Renderer{
         configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
     }
 
-    ComputePipeline::ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout layout) : device{device}{    
-        createComputePipeline(compFilepath, layout);
+    ComputePipeline::ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout layout, const SpecializationConstants& specialization, 
+        const std::vector<std::string>& defines, JobSystem& jobSystem) 
+    : device{device}, jobSystem{jobSystem}, compFilepath{compFilepath}, layout{layout}, defines{defines}, specialization{specialization}{    
+        creation = jobSystem.submit([this](){ createComputePipeline(); }).share();
     }
 
     ComputePipeline::~ComputePipeline(){
+        creation.wait();
         vkDestroyPipeline(device.getDevice(), computePipeline, nullptr);
     }
 
-    void ComputePipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout layout){
-        compShaderModule = std::make_unique<ShaderModule>(device, compFilepath);
+    bool ComputePipeline::usesShader(const std::vector<std::string>& shaderPaths) const{
+        return std::find(shaderPaths.begin(), shaderPaths.end(), compFilepath) != shaderPaths.end();
+    }
+
+    void ComputePipeline::rebuild(){
+        creation.wait();
+        vkDestroyPipeline(device.getDevice(), computePipeline, nullptr);
+        computePipeline = VK_NULL_HANDLE;
+        creation = jobSystem.submit([this](){ createComputePipeline(); }).share();
+    }
+
+    void ComputePipeline::createComputePipeline(){
+        compShaderModule = device.getShaderLibrary().getModule(compFilepath, defines);
+        VkSpecializationInfo specializationInfo = specialization.getInfo();
 
         VkPipelineShaderStageCreateInfo shaderStage;
-        shaderStage.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         shaderStage.module = compShaderModule->getShaderModule();
         shaderStage.pName = "main";
         shaderStage.flags = 0;
         shaderStage.pNext = nullptr;
-        shaderStage.pSpecializationInfo = nullptr;
+        shaderStage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
 
-        VkComputePipelineCreateInfo pipelineInfo;
+        VkComputePipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         pipelineInfo.stage = shaderStage;
         pipelineInfo.layout = layout;
-        pipelineInfo.basePipelineIndex = 0;
+        pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if(vkCreateComputePipelines(device.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+        if(vkCreateComputePipelines(device.getDevice(), device.getPipelineCache().getCache(), 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
             throw std::runtime_error("Failed to create compute pipeline.");
     }
 
     void ComputePipeline::bind(VkCommandBuffer commandBuffer){
+        wait();
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
     }
-
-    ShaderModule::ShaderModule(Device& device, const std::string& filepath) : device{device}{
-        createShaderModule(readFile(filepath));
-    }
-
-    ShaderModule::~ShaderModule(){
-        vkDestroyShaderModule(device.getDevice(), shaderModule, nullptr);
-    }
-
-    std::vector<char> ShaderModule::readFile(const std::string& filepath){
-        std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
-
-        if (!file.is_open())
-            throw std::runtime_error("Failed to open file: " + filepath);
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-        
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-        return buffer;
-    }
-
-    void ShaderModule::createShaderModule(const std::vector<char>& code){
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-        if (vkCreateShaderModule(device.getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create shader module.");
-    }
 }
\ No newline at end of file
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "engine/device/device.hpp"
+#include "engine/jobs/job_system.hpp"
+#include "engine/pipeline/shader_library.hpp"
 
 #include <vector>
 #include <memory>
+#include <future>
+#include <string>
 
 namespace Renderer{
     struct GraphicsPipelineConfigInfo {
+        GraphicsPipelineConfigInfo() = default;
         GraphicsPipelineConfigInfo(const GraphicsPipelineConfigInfo&) = delete;
         GraphicsPipelineConfigInfo& operator=(const GraphicsPipelineConfigInfo&) = delete;
 
@@ -23,51 +28,98 @@ namespace Renderer{
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // Has to match the render pass, VK_SAMPLE_COUNT_FLAG_BITS_MAX_ENUM uses the device's max usable sample count
+        VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_FLAG_BITS_MAX_ENUM;
+
+        // Copies source into this config, pointers into source's own members are redirected to this config's
+        void copyFrom(const GraphicsPipelineConfigInfo& source);
     };
 
-    class ShaderModule{
+    // Values for the specialization constants (layout(constant_id = N) const) of a pipeline's shaders, given to every stage.
+    // Ids a stage doesn't declare are ignored by it, so constants can share one id space across shaders.
+    class SpecializationConstants{
         public:
-            ShaderModule(Device& device, const std::string& filepath);
-            ~ShaderModule();
+            SpecializationConstants& set(uint32_t constantId, uint32_t value);
+            SpecializationConstants& set(uint32_t constantId, int32_t value);
+            SpecializationConstants& set(uint32_t constantId, float value);
+            // Bool constants are 32 bits wide in SPIR-V
+            SpecializationConstants& set(uint32_t constantId, bool value) { return set(constantId, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE)); }
 
-            VkShaderModule getShaderModule() { return shaderModule; }
+            bool empty() const { return entries.empty(); }
+            // Points into this object, which has to outlive the pipeline creation
+            VkSpecializationInfo getInfo() const;
 
         private:
-            static std::vector<char> readFile(const std::string& filepath);
-            void createShaderModule(const std::vector<char>& code);
-
-            Device& device;
-            VkShaderModule shaderModule;
+            std::vector<VkSpecializationMapEntry> entries;
+            std::vector<uint32_t> data;
     };
 
+    // Pipelines are compiled on the job system with the device's pipeline cache, construction returns right away. bind()
+    // waits for the compilation if it hasn't finished yet, creation errors are rethrown from wait() or bind(). Shader paths
+    // are resolved by the device's ShaderLibrary, defines and specialization constants apply to every stage.
     class GraphicsPipeline{
         public:
-            GraphicsPipeline(Device& device, const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo);
+            GraphicsPipeline(Device& device, const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo, 
+                const SpecializationConstants& specialization = {}, const std::vector<std::string>& defines = {}, JobSystem& jobSystem = JobSystem::shared());
             ~GraphicsPipeline();
 
+            GraphicsPipeline(const GraphicsPipeline&) = delete;
+            GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
+
             static void defaultPipelineConfigInfo(GraphicsPipelineConfigInfo& configInfo);
+            bool isReady() const { return creation.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+            void wait() const { creation.get(); }
+            // Safe to call from several threads at once
             void bind(VkCommandBuffer commandBuffer);
 
+            // Whether one of the given shader paths (as returned by ShaderLibrary::pollChanges()) is used by this pipeline
+            bool usesShader(const std::vector<std::string>& shaderPaths) const;
+            // Compiles the pipeline again with the library's current modules, the old pipeline must no longer be in use
+            void rebuild();
+
         private:
-            void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const GraphicsPipelineConfigInfo& configInfo);
+            void createGraphicsPipeline();
 
             Device& device;
-            VkPipeline graphicsPipeline;
-            std::unique_ptr<ShaderModule> vertShaderModule, fragShaderModule;
+            JobSystem& jobSystem;
+            std::string vertFilepath, fragFilepath;
+            std::vector<std::string> defines;
+            SpecializationConstants specialization;
+            GraphicsPipelineConfigInfo configInfo;  // The caller's config may be gone by the time the job runs
+
+            VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+            std::shared_ptr<ShaderModule> vertShaderModule, fragShaderModule;
+            std::shared_future<void> creation;
     };
 
     class ComputePipeline{
         public:
-            ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout layout);
+            ComputePipeline(Device& device, const std::string& compFilepath, VkPipelineLayout layout, const SpecializationConstants& specialization = {}, 
+                const std::vector<std::string>& defines = {}, JobSystem& jobSystem = JobSystem::shared());
             ~ComputePipeline();
 
+            ComputePipeline(const ComputePipeline&) = delete;
+            ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+            bool isReady() const { return creation.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+            void wait() const { creation.get(); }
             void bind(VkCommandBuffer commandBuffer);
+
+            bool usesShader(const std::vector<std::string>& shaderPaths) const;
+            void rebuild();
         
         private:
-            void createComputePipeline(const std::string& compFilepath, VkPipelineLayout layout);
+            void createComputePipeline();
 
             Device& device;
-            VkPipeline computePipeline;
-            std::unique_ptr<ShaderModule> compShaderModule;
+            JobSystem& jobSystem;
+            std::string compFilepath;
+            VkPipelineLayout layout;
+            std::vector<std::string> defines;
+            SpecializationConstants specialization;
+
+            VkPipeline computePipeline = VK_NULL_HANDLE;
+            std::shared_ptr<ShaderModule> compShaderModule;
+            std::shared_future<void> creation;
     };
 }
\ No newline at end of file
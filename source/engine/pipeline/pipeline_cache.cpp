@@ -0,0 +1,70 @@
+#include "pipeline_cache.hpp"
+
+#include "engine/io/mapped_file.hpp"
+#include "engine/io/file_utils.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <stdexcept>
+
+namespace Renderer{
+    PipelineCache::PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filepath) : device{device}, filepath{filepath}{
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        std::vector<uint8_t> initialData = loadFile();
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = initialData.size();
+        cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+        if(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline cache.");
+    }
+
+    PipelineCache::~PipelineCache(){
+        save();
+        vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    std::vector<uint8_t> PipelineCache::loadFile(){
+        MappedFile file{filepath};
+        if(!file.isOpen() || file.getSize() < sizeof(Header))
+            return {};
+
+        Header header;
+        std::memcpy(&header, file.getData(), sizeof(Header));
+        if(std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0 || header.version != VERSION)
+            return {};
+        // Data from another GPU or driver would be rejected (or worse) by the driver, recompile instead
+        if(header.vendorId != properties.vendorID || header.deviceId != properties.deviceID || header.driverVersion != properties.driverVersion ||
+            std::memcmp(header.pipelineCacheUuid, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+            return {};
+        if(header.dataSize != file.getSize() - sizeof(Header))
+            return {};
+
+        const uint8_t* data = file.getData() + sizeof(Header);
+        if(FileUtils::hash(data, header.dataSize) != header.dataHash)
+            return {};
+        return std::vector<uint8_t>(data, data + header.dataSize);
+    }
+
+    void PipelineCache::save(){
+        size_t dataSize = 0;
+        if(vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+            return;
+        std::vector<uint8_t> data(dataSize);
+        if(vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS)
+            return;
+        data.resize(dataSize);
+
+        Header header{};
+        header.vendorId = properties.vendorID;
+        header.deviceId = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        std::memcpy(header.pipelineCacheUuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.dataSize = data.size();
+        header.dataHash = FileUtils::hash(data.data(), data.size());
+
+        if(!FileUtils::atomicWriteFile(filepath, { std::as_bytes(std::span{&header, 1}), std::as_bytes(std::span{data}) }))
+            std::cout << "Failed to write pipeline cache: " << filepath << '\n';
+    }
+}
\ No newline at end of file
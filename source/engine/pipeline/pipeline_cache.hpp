@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Renderer{
+    // VkPipelineCache persisted to disk. The file is loaded when the cache is created and only used if it was written on the
+    // same GPU and driver, it is saved again when the cache is destroyed. Layout: Header, then the data returned by
+    // vkGetPipelineCacheData(). The cache is internally synchronized, pipelines may be created with it from any thread.
+    class PipelineCache{
+        public:
+            static constexpr uint32_t VERSION = 1;
+            static constexpr const char* DEFAULT_PATH = "pipeline_cache.bin";
+
+            struct Header{
+                char magic[4] = {'R', 'P', 'L', 'C'};
+                uint32_t version = VERSION;
+                uint32_t vendorId = 0;
+                uint32_t deviceId = 0;
+                uint32_t driverVersion = 0;
+                uint8_t pipelineCacheUuid[VK_UUID_SIZE] = {};
+                uint32_t padding = 0;
+                uint64_t dataSize = 0;
+                uint64_t dataHash = 0;      // Catches files that were cut short or corrupted
+            };
+
+            PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filepath = DEFAULT_PATH);
+            ~PipelineCache();
+
+            PipelineCache(const PipelineCache&) = delete;
+            PipelineCache& operator=(const PipelineCache&) = delete;
+
+            VkPipelineCache getCache() { return cache; }
+            // Writes the cache to disk, failures are reported but not fatal
+            void save();
+
+        private:
+            // Initial data for the cache, empty if the file is missing or doesn't belong to this device
+            std::vector<uint8_t> loadFile();
+
+            VkDevice device;
+            VkPhysicalDeviceProperties properties;
+            std::string filepath;
+            VkPipelineCache cache = VK_NULL_HANDLE;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "engine/pipeline/pipeline.hpp"
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <algorithm>
+
+namespace Renderer{
+    // Lighting applied by main.frag
+    enum class LightingModel : uint32_t{
+        Unlit = 0,      // Texture color only
+        Diffuse = 1,    // Lambert term with the light at the camera
+    };
+
+    // Specialization constant ids, shared by every shader (see SpecializationConstants)
+    enum SpecializationConstantId : uint32_t{
+        SPEC_FRUSTUM_CULLING = 0,
+        SPEC_OCCLUSION_CULLING = 1,
+        SPEC_TEXTURE_COUNT = 2,
+        SPEC_LIGHTING_MODEL = 3,
+    };
+
+    // Feature toggles that are compiled into pipelines instead of being branched on in the shaders. Each set of toggles is
+    // its own pipeline, so owners only fill in the toggles their shaders use to avoid compiling identical variants.
+    struct PipelineFeatures{
+        bool frustumCulling = true;
+        bool occlusionCulling = true;
+        uint32_t textureCount = 1;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;     // Pipeline state rather than a constant
+        LightingModel lightingModel = LightingModel::Unlit;
+
+        bool operator==(const PipelineFeatures& other) const = default;
+
+        SpecializationConstants getSpecialization() const{
+            SpecializationConstants constants;
+            constants.set(SPEC_FRUSTUM_CULLING, frustumCulling)
+                .set(SPEC_OCCLUSION_CULLING, occlusionCulling)
+                .set(SPEC_TEXTURE_COUNT, textureCount)
+                .set(SPEC_LIGHTING_MODEL, static_cast<uint32_t>(lightingModel));
+            return constants;
+        }
+    };
+
+    // Pipelines of one kind specialized per PipelineFeatures, created by the factory the first time their features are
+    // requested and kept for the owner's lifetime. Switching features therefore never destroys a pipeline that frames in
+    // flight may still be using, and switching back costs nothing. Variants compile on the job system like any pipeline,
+    // prepare() starts them ahead of the frame they are needed in.
+    template<typename Pipeline>
+    class PipelineVariants{
+        public:
+            using Factory = std::function<std::unique_ptr<Pipeline>(const PipelineFeatures& features)>;
+
+            PipelineVariants() = default;
+            explicit PipelineVariants(Factory factory) : factory{std::move(factory)} {}
+
+            PipelineVariants(const PipelineVariants&) = delete;
+            PipelineVariants& operator=(const PipelineVariants&) = delete;
+            PipelineVariants(PipelineVariants&&) = default;
+            PipelineVariants& operator=(PipelineVariants&&) = default;
+
+            // Only a handful of variants exist at once, a linear search beats hashing the features
+            Pipeline& get(const PipelineFeatures& features){
+                auto found = std::find_if(variants.begin(), variants.end(), [&](const auto& variant){ return variant.first == features; });
+                if(found != variants.end())
+                    return *found->second;
+                variants.emplace_back(features, factory(features));
+                return *variants.back().second;
+            }
+            void prepare(const PipelineFeatures& features) { get(features); }
+
+            size_t size() const { return variants.size(); }
+
+            // Rebuilds the variants using any of the changed shaders, they must not be in use
+            void reloadShaders(const std::vector<std::string>& changedShaders){
+                for(auto& variant : variants){
+                    if(variant.second->usesShader(changedShaders))
+                        variant.second->rebuild();
+                }
+            }
+
+        private:
+            Factory factory;
+            std::vector<std::pair<PipelineFeatures, std::unique_ptr<Pipeline>>> variants;
+    };
+}
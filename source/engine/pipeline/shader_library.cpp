@@ -0,0 +1,209 @@
+#include "shader_library.hpp"
+
+#include "engine/io/file_utils.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <cassert>
+#include <stdexcept>
+
+namespace Renderer{
+    namespace{
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+        bool isValidDefine(const std::string& define){
+            return !define.empty() && std::all_of(define.begin(), define.end(), [](char c){
+                return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '=' || c == '.' || c == '-';
+            });
+        }
+
+        std::string quote(const std::string& text){
+            return "\"" + text + "\"";
+        }
+    }
+
+    ShaderModule::ShaderModule(Device& device, const std::vector<uint32_t>& code) : device{device}{
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size() * sizeof(uint32_t);
+        createInfo.pCode = code.data();
+
+        if (vkCreateShaderModule(device.getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create shader module.");
+    }
+
+    ShaderModule::~ShaderModule(){
+        vkDestroyShaderModule(device.getDevice(), shaderModule, nullptr);
+    }
+
+    ShaderLibrary::ShaderLibrary(Device& device, const std::string& sourceDirectory, const std::string& cacheDirectory)
+    : device{device}, sourceDirectory{sourceDirectory}, cacheDirectory{cacheDirectory}{}
+
+    std::filesystem::path ShaderLibrary::resolvePath(const std::string& path){
+        std::filesystem::path filepath{path};
+        return filepath.is_absolute() ? filepath : sourceDirectory / filepath;
+    }
+
+    std::shared_ptr<ShaderModule> ShaderLibrary::getModule(const std::string& path, const std::vector<std::string>& defines){
+        std::string key = path;
+        for(auto& define : defines){
+            assert(isValidDefine(define) && "Shader defines may only contain letters, digits and _=.-");
+            key += '\n' + define;
+        }
+
+        std::promise<std::shared_ptr<ShaderModule>> promise;
+        std::shared_future<std::shared_ptr<ShaderModule>> module;
+        Entry entry;
+        bool compileHere = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = entries.find(key);
+            if(found != entries.end())
+                module = found->second.module;
+            else{
+                // The first request compiles, requests arriving meanwhile wait for its result
+                entry = Entry{path, resolvePath(path), defines, promise.get_future().share()};
+                module = entry.module;
+                entries.emplace(key, entry);
+                compileHere = true;
+
+                std::error_code error;
+                auto time = std::filesystem::last_write_time(entry.sourcePath, error);
+                if(!error)
+                    sourceTimes.emplace(entry.sourcePath.string(), time);
+            }
+        }
+
+        if(compileHere){
+            try{
+                promise.set_value(std::make_shared<ShaderModule>(device, compile(entry.sourcePath, defines)));
+            }
+            catch(...){
+                promise.set_exception(std::current_exception());
+            }
+        }
+        return module.get();
+    }
+
+    std::vector<uint32_t> ShaderLibrary::readSpirv(const std::filesystem::path& path){
+        std::ifstream file{path, std::ios::ate | std::ios::binary};
+        if(!file.is_open())
+            throw std::runtime_error("Failed to open file: " + path.string());
+
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        if(fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+            throw std::runtime_error("Invalid SPIR-V file: " + path.string());
+        std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(code.data()), fileSize);
+        if(!file || code[0] != SPIRV_MAGIC)
+            throw std::runtime_error("Invalid SPIR-V file: " + path.string());
+        return code;
+    }
+
+    std::vector<uint32_t> ShaderLibrary::compile(const std::filesystem::path& sourcePath, const std::vector<std::string>& defines){
+        if(sourcePath.extension() == ".spv")
+            return readSpirv(sourcePath);
+
+        std::ifstream source{sourcePath, std::ios::binary};
+        if(!source.is_open())
+            throw std::runtime_error("Failed to open file: " + sourcePath.string());
+        std::stringstream sourceText;
+        sourceText << source.rdbuf();
+
+        // Everything that changes the output is hashed: cache version, compiler, defines and the source itself
+        std::string keyText = std::to_string(VERSION) + '\n' + RENDERER_GLSLC;
+        for(auto& define : defines)
+            keyText += '\n' + define;
+        keyText += '\n' + sourceText.str();
+        uint64_t hash = FileUtils::hash(keyText.data(), keyText.size());
+
+        std::stringstream cacheName;
+        cacheName << sourcePath.filename().string() << '.' << std::hex << std::setw(16) << std::setfill('0') << hash << ".spv";
+        std::filesystem::path cachePath = cacheDirectory / cacheName.str();
+
+        std::error_code error;
+        if(std::filesystem::exists(cachePath, error)){
+            try{
+                return readSpirv(cachePath);
+            }
+            catch(const std::exception&){
+                // Damaged cache entry, compile again
+            }
+        }
+
+        std::filesystem::create_directories(cacheDirectory, error);
+        // glslc writes the temporary file, it is renamed into place once it is known to be valid SPIR-V
+        std::filesystem::path temporaryPath = FileUtils::getTemporaryPath(cachePath.string());
+
+        std::string command = quote(RENDERER_GLSLC);
+        for(auto& define : defines)
+            command += " -D" + define;
+        command += " -o " + quote(temporaryPath.string()) + " " + quote(sourcePath.string());
+    #ifdef _WIN32
+        // cmd strips the outer quotes of the whole command line
+        command = quote(command);
+    #endif
+        // glslc reports the errors itself
+        if(std::system(command.c_str()) != 0){
+            std::filesystem::remove(temporaryPath, error);
+            throw std::runtime_error("Failed to compile shader: " + sourcePath.string());
+        }
+
+        std::vector<uint32_t> code = readSpirv(temporaryPath);
+        std::filesystem::rename(temporaryPath, cachePath, error);
+        if(error)
+            std::cout << "Failed to write shader cache: " << cachePath.string() << '\n';
+        return code;
+    }
+
+    std::vector<std::string> ShaderLibrary::pollChanges(){
+        std::vector<std::string> changedPaths;
+        auto now = std::chrono::steady_clock::now();
+        if(!hotReload || now - lastPoll < POLL_INTERVAL)
+            return changedPaths;
+        lastPoll = now;
+
+        // Entries of modified sources, recompiled outside of the lock
+        std::vector<std::pair<std::string, Entry>> modified;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto& [source, time] : sourceTimes){
+                std::error_code error;
+                auto newTime = std::filesystem::last_write_time(source, error);
+                if(error || newTime == time)
+                    continue;
+                time = newTime;
+                for(auto& [key, entry] : entries){
+                    if(entry.sourcePath.string() == source)
+                        modified.emplace_back(key, entry);
+                }
+            }
+        }
+
+        for(auto& [key, entry] : modified){
+            std::shared_ptr<ShaderModule> module;
+            try{
+                module = std::make_shared<ShaderModule>(device, compile(entry.sourcePath, entry.defines));
+            }
+            catch(const std::exception& exception){
+                std::cout << exception.what() << '\n';
+                continue;
+            }
+            std::promise<std::shared_ptr<ShaderModule>> promise;
+            promise.set_value(module);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                entries[key].module = promise.get_future().share();
+            }
+            if(std::find(changedPaths.begin(), changedPaths.end(), entry.path) == changedPaths.end())
+                changedPaths.push_back(entry.path);
+        }
+        return changedPaths;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+
+#ifndef RENDERER_SHADER_DIRECTORY
+    #error "RENDERER_SHADER_DIRECTORY must be set by CMake"
+#endif
+// Set by CMake when it found glslc, otherwise it has to be on the PATH
+#ifndef RENDERER_GLSLC
+    #define RENDERER_GLSLC "glslc"
+#endif
+
+namespace Renderer{
+    class ShaderModule{
+        public:
+            ShaderModule(Device& device, const std::vector<uint32_t>& code);
+            ~ShaderModule();
+
+            ShaderModule(const ShaderModule&) = delete;
+            ShaderModule& operator=(const ShaderModule&) = delete;
+
+            VkShaderModule getShaderModule() { return shaderModule; }
+
+        private:
+            Device& device;
+            VkShaderModule shaderModule;
+    };
+
+    // Compiles GLSL sources to SPIR-V with glslc and caches the results in cacheDirectory, keyed by a hash of the source and
+    // defines so a source is only compiled again once it changes. Modules are shared between everything requesting the same
+    // source with the same defines. Thread safe, pipelines request their modules from the job system.
+    class ShaderLibrary{
+        public:
+            static constexpr uint32_t VERSION = 1;      // Part of the cache key, bump to throw away cached SPIR-V
+            static constexpr const char* DEFAULT_CACHE_DIRECTORY = "shader_cache/";
+            static constexpr std::chrono::milliseconds POLL_INTERVAL{500};
+
+            ShaderLibrary(Device& device, const std::string& sourceDirectory = RENDERER_SHADER_DIRECTORY,
+                const std::string& cacheDirectory = DEFAULT_CACHE_DIRECTORY);
+
+            ShaderLibrary(const ShaderLibrary&) = delete;
+            ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+            // Module for the source at path (relative to the source directory unless absolute) compiled with defines, each
+            // being "NAME" or "NAME=VALUE". Precompiled .spv files are loaded as they are. Throws if compilation fails.
+            std::shared_ptr<ShaderModule> getModule(const std::string& path, const std::vector<std::string>& defines = {});
+
+            // Hot reload: sources of requested modules are watched while enabled
+            void setHotReload(bool enabled) { hotReload = enabled; }
+            // Recompiles the modules whose source changed on disk (checked at most every POLL_INTERVAL) and returns the paths
+            // (as passed to getModule()) that were recompiled. Pipelines using them have to be rebuilt to pick them up. Sources
+            // that fail to compile are reported and keep their previous module.
+            std::vector<std::string> pollChanges();
+
+        private:
+            struct Entry{
+                std::string path;
+                std::filesystem::path sourcePath;
+                std::vector<std::string> defines;
+                std::shared_future<std::shared_ptr<ShaderModule>> module;
+            };
+
+            std::filesystem::path resolvePath(const std::string& path);
+            std::vector<uint32_t> compile(const std::filesystem::path& sourcePath, const std::vector<std::string>& defines);
+            static std::vector<uint32_t> readSpirv(const std::filesystem::path& path);
+
+            Device& device;
+            std::filesystem::path sourceDirectory;
+            std::filesystem::path cacheDirectory;
+
+            std::mutex mutex;
+            std::unordered_map<std::string, Entry> entries;     // Keyed by path and defines
+
+            bool hotReload = false;
+            std::unordered_map<std::string, std::filesystem::file_time_type> sourceTimes;   // Keyed by resolved source path
+            std::chrono::steady_clock::time_point lastPoll{};
+    };
+}
\ No newline at end of file
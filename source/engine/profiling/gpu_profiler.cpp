@@ -0,0 +1,125 @@
+#include "gpu_profiler.hpp"
+
+#include <stdexcept>
+#include <cassert>
+
+namespace Renderer{
+    namespace{
+        // Queries 0 and 1 time the whole frame, zone i uses 2 + 2i and 3 + 2i
+        constexpr uint32_t FRAME_QUERIES = 2;
+        constexpr uint32_t QUERY_COUNT = FRAME_QUERIES + 2 * GpuProfiler::MAX_ZONES;
+    }
+
+    GpuProfiler::GpuProfiler(Device& device) : device{device}{
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device.getPhysicalDevice(), &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, families.data());
+        uint32_t validBits = families[device.getPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+        // No timestamps on the graphics queue, the profiler stays inactive and GPU scopes do nothing
+        if(validBits == 0)
+            return;
+        timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = QUERY_COUNT;
+        for(auto& frame : frames){
+            if(vkCreateQueryPool(device.getDevice(), &poolInfo, nullptr, &frame.pool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create timestamp query pool.");
+            frame.names.reserve(MAX_ZONES);
+            frame.depths.reserve(MAX_ZONES);
+        }
+        results.resize(QUERY_COUNT);
+        active = this;
+    }
+
+    GpuProfiler::~GpuProfiler(){
+        if(active == this)
+            active = nullptr;
+        for(auto& frame : frames)
+            vkDestroyQueryPool(device.getDevice(), frame.pool, nullptr);
+    }
+
+    void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+        if(active != this)
+            return;
+        currentFrame = frameIndex;
+        FrameQueries& frame = frames[frameIndex];
+        if(frame.pending)
+            readResults(frame);
+
+        frame.frameNumber = Profiler::shared().getFrameNumber();
+        frame.names.clear();
+        frame.depths.clear();
+        openZones = 0;
+        vkCmdResetQueryPool(commandBuffer, frame.pool, 0, QUERY_COUNT);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, 0);
+    }
+
+    void GpuProfiler::endFrame(VkCommandBuffer commandBuffer){
+        if(active != this)
+            return;
+        assert(openZones == 0 && "GPU zones have to end before the frame does.");
+        FrameQueries& frame = frames[currentFrame];
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, 1);
+        frame.submitTime = Profiler::shared().now();
+        frame.pending = true;
+    }
+
+    void GpuProfiler::flush(){
+        if(active != this)
+            return;
+        for(auto& frame : frames)
+            if(frame.pending)
+                readResults(frame);
+    }
+
+    uint32_t GpuProfiler::beginZone(VkCommandBuffer commandBuffer, const char* name){
+        FrameQueries& frame = frames[currentFrame];
+        if(frame.names.size() >= MAX_ZONES)
+            return UINT32_MAX;
+        uint32_t zone = static_cast<uint32_t>(frame.names.size());
+        frame.names.push_back(name);
+        frame.depths.push_back(openZones++);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, FRAME_QUERIES + 2 * zone);
+        return zone;
+    }
+
+    void GpuProfiler::endZone(VkCommandBuffer commandBuffer, uint32_t zone){
+        if(zone == UINT32_MAX)
+            return;
+        openZones--;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[currentFrame].pool, FRAME_QUERIES + 2 * zone + 1);
+    }
+
+    void GpuProfiler::readResults(FrameQueries& frame){
+        frame.pending = false;
+        uint32_t queryCount = FRAME_QUERIES + 2 * static_cast<uint32_t>(frame.names.size());
+        // The frame's fence has been waited on, results that still aren't available (e.g. the frame was never submitted
+        // after a swap chain recreation) are dropped
+        if(vkGetQueryPoolResults(device.getDevice(), frame.pool, 0, queryCount, queryCount * sizeof(uint64_t), results.data(),
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+            return;
+
+        uint64_t frameStart = results[0] & timestampMask;
+        auto toCpuTime = [&](uint64_t timestamp){
+            uint64_t ticks = ((timestamp & timestampMask) - frameStart) & timestampMask;
+            return frame.submitTime + static_cast<uint64_t>(ticks * timestampPeriod);
+        };
+
+        std::vector<Profiler::Zone> zones;
+        zones.reserve(frame.names.size() + 1);
+        zones.push_back({ "GPU frame", frame.submitTime, toCpuTime(results[1]), Profiler::GPU_THREAD, 0 });
+        for(uint32_t zone = 0; zone < frame.names.size(); zone++){
+            zones.push_back({ frame.names[zone], toCpuTime(results[FRAME_QUERIES + 2 * zone]), toCpuTime(results[FRAME_QUERIES + 2 * zone + 1]),
+                Profiler::GPU_THREAD, frame.depths[zone] + 1 });
+        }
+        Profiler::shared().addGpuZones(frame.frameNumber, zones);
+    }
+}
\ No newline at end of file
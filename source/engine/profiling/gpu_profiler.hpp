@@ -0,0 +1,88 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/swap_chain/swap_chain.hpp"
+#include "engine/profiling/profiler.hpp"
+
+#include <vector>
+#include <array>
+
+#if defined(RENDERER_PROFILING)
+    // Times the commands recorded into commandBuffer (a frame's primary command buffer) within the enclosing scope
+    #define PROFILE_GPU_SCOPE(commandBuffer, name) ::Renderer::GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__){commandBuffer, name}
+#else
+    #define PROFILE_GPU_SCOPE(commandBuffer, name) ((void)0)
+#endif
+
+namespace Renderer{
+    // Timestamp queries around GPU work, with one query pool per frame in flight. A frame's results are read back when its
+    // slot is reused (its fence has been waited on by then) and handed to Profiler::shared() for the frame they were
+    // recorded in. GPU zones are placed on the CPU timeline relative to the frame's submission since the two clocks aren't
+    // calibrated against each other. Zones may only be recorded from the thread recording the frame.
+    class GpuProfiler{
+        public:
+            static constexpr uint32_t MAX_ZONES = 32;   // Per frame, further zones aren't timed
+
+            GpuProfiler(Device& device);
+            ~GpuProfiler();
+
+            GpuProfiler(const GpuProfiler&) = delete;
+            GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+            // Profiler the GPU scopes record into, null if there is none (or timestamps aren't supported)
+            static GpuProfiler* getActive() { return active; }
+
+            // Call right after the frame's command buffer has begun and before it ends
+            void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+            void endFrame(VkCommandBuffer commandBuffer);
+            // Reads back the results of every submitted frame instead of waiting for their slots to be reused, the device
+            // has to be idle
+            void flush();
+
+            // Returns the zone's index for endZone(), UINT32_MAX if the frame ran out of queries
+            uint32_t beginZone(VkCommandBuffer commandBuffer, const char* name);
+            void endZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+        private:
+            struct FrameQueries{
+                VkQueryPool pool = VK_NULL_HANDLE;
+                uint64_t frameNumber = 0;
+                uint64_t submitTime = 0;
+                std::vector<const char*> names;
+                std::vector<uint32_t> depths;
+                bool pending = false;   // Submitted, results not read back yet
+            };
+
+            void readResults(FrameQueries& frame);
+
+            static inline GpuProfiler* active = nullptr;
+
+            Device& device;
+            double timestampPeriod;     // Nanoseconds per tick
+            uint64_t timestampMask;
+            std::array<FrameQueries, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+            uint32_t currentFrame = 0;
+            uint32_t openZones = 0;
+            std::vector<uint64_t> results;
+    };
+
+    // Zone covering the lifetime of the object, see PROFILE_GPU_SCOPE
+    class GpuProfileScope{
+        public:
+            GpuProfileScope(VkCommandBuffer commandBuffer, const char* name) : commandBuffer{commandBuffer}{
+                if(GpuProfiler* profiler = GpuProfiler::getActive())
+                    zone = profiler->beginZone(commandBuffer, name);
+            }
+            ~GpuProfileScope(){
+                if(GpuProfiler* profiler = GpuProfiler::getActive())
+                    profiler->endZone(commandBuffer, zone);
+            }
+
+            GpuProfileScope(const GpuProfileScope&) = delete;
+            GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+        private:
+            VkCommandBuffer commandBuffer;
+            uint32_t zone = UINT32_MAX;
+    };
+}
\ No newline at end of file
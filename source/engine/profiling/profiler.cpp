@@ -0,0 +1,237 @@
+#include "profiler.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include <cassert>
+
+namespace Renderer{
+    namespace{
+        // Chrome trace track ids of the tracks that aren't CPU threads
+        constexpr uint32_t GPU_TRACK = 1000;
+        constexpr uint32_t FRAME_TRACK = 1001;
+
+        struct OpenZone{
+            const char* name;
+            uint64_t start;
+        };
+
+        thread_local std::vector<OpenZone> openZones;
+        thread_local uint32_t threadIndex = UINT32_MAX;
+
+        // Nearest rank percentile of sorted values
+        double percentile(const std::vector<double>& sorted, double p){
+            size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+            return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+        }
+
+        void writeEscaped(std::ostream& out, const char* text){
+            for(; *text != '\0'; text++){
+                if(*text == '"' || *text == '\\')
+                    out << '\\';
+                out << *text;
+            }
+        }
+
+        void writeEvent(std::ostream& out, bool& first, const char* name, uint32_t track, uint64_t start, uint64_t end){
+            out << (first ? "\n" : ",\n") << "{\"name\":\"";
+            writeEscaped(out, name);
+            // Timestamps are in microseconds
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track << ",\"ts\":" << start / 1000.0 << ",\"dur\":" << (end - start) / 1000.0 << "}";
+            first = false;
+        }
+
+        void writeTrackName(std::ostream& out, bool& first, uint32_t track, const std::string& name){
+            out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track
+                << ",\"args\":{\"name\":\"" << name << "\"}}";
+            first = false;
+        }
+    }
+
+    Profiler::Profiler(){
+        epoch = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        history.reserve(HISTORY_FRAMES);
+    }
+
+    Profiler& Profiler::shared(){
+        static Profiler profiler;
+        return profiler;
+    }
+
+    uint64_t Profiler::now(){
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) - epoch;
+    }
+
+    void Profiler::beginFrame(){
+        uint64_t time = now();
+        std::lock_guard<std::mutex> lock(mutex);
+        // Frame numbers start at 1, 0 means no frame has been started yet
+        if(currentFrame.number != 0){
+            currentFrame.end = time;
+            if(history.size() < HISTORY_FRAMES)
+                history.push_back(std::move(currentFrame));
+            else{
+                history[historyHead] = std::move(currentFrame);
+                historyHead = (historyHead + 1) % HISTORY_FRAMES;
+            }
+        }
+        uint64_t number = currentFrame.number + 1;
+        currentFrame = Frame{};
+        currentFrame.number = number;
+        currentFrame.start = time;
+    }
+
+    uint64_t Profiler::getFrameNumber(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return currentFrame.number;
+    }
+
+    uint32_t Profiler::getThreadIndex(){
+        if(threadIndex == UINT32_MAX)
+            threadIndex = threadCount++;
+        return threadIndex;
+    }
+
+    void Profiler::beginZone(const char* name){
+        openZones.push_back({ name, now() });
+    }
+
+    void Profiler::endZone(){
+        assert(!openZones.empty() && "endZone() called without a matching beginZone().");
+        uint64_t end = now();
+        OpenZone zone = openZones.back();
+        openZones.pop_back();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        currentFrame.cpuZones.push_back({ zone.name, zone.start, end, getThreadIndex(), static_cast<uint32_t>(openZones.size()) });
+    }
+
+    Profiler::Frame* Profiler::findFrame(uint64_t frameNumber){
+        if(frameNumber == currentFrame.number)
+            return &currentFrame;
+        if(frameNumber > currentFrame.number)
+            return nullptr;
+        // History holds consecutive frames, the newest one being currentFrame.number - 1
+        uint64_t age = currentFrame.number - 1 - frameNumber;
+        if(age >= history.size())
+            return nullptr;
+        size_t newest = history.size() < HISTORY_FRAMES ? history.size() - 1 : (historyHead + HISTORY_FRAMES - 1) % HISTORY_FRAMES;
+        return &history[(newest + HISTORY_FRAMES - age) % HISTORY_FRAMES];
+    }
+
+    void Profiler::addGpuZones(uint64_t frameNumber, const std::vector<Zone>& zones){
+        std::lock_guard<std::mutex> lock(mutex);
+        Frame* frame = findFrame(frameNumber);
+        // Too old, already dropped from the history
+        if(frame == nullptr)
+            return;
+        frame->gpuZones.insert(frame->gpuZones.end(), zones.begin(), zones.end());
+    }
+
+    bool Profiler::getFrame(uint64_t frameNumber, Frame& frame){
+        std::lock_guard<std::mutex> lock(mutex);
+        Frame* found = findFrame(frameNumber);
+        if(found == nullptr)
+            return false;
+        frame = *found;
+        return true;
+    }
+
+    Profiler::Summary Profiler::getSummary(){
+        std::lock_guard<std::mutex> lock(mutex);
+        Summary summary{};
+        if(history.empty())
+            return summary;
+
+        struct Accumulator{
+            uint32_t count = 0;
+            double totalMs = 0.0, maxMs = 0.0;
+        };
+        std::map<std::pair<std::string, bool>, Accumulator> zoneTotals;
+        std::map<std::pair<std::string, bool>, double> frameTotals;
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(history.size());
+        for(auto& frame : history){
+            frameTimes.push_back((frame.end - frame.start) / 1e6);
+
+            // Zones hit several times in a frame are added up
+            frameTotals.clear();
+            for(auto& zone : frame.cpuZones)
+                frameTotals[{ zone.name, false }] += (zone.end - zone.start) / 1e6;
+            for(auto& zone : frame.gpuZones)
+                frameTotals[{ zone.name, true }] += (zone.end - zone.start) / 1e6;
+            for(auto& [key, ms] : frameTotals){
+                Accumulator& accumulator = zoneTotals[key];
+                accumulator.count++;
+                accumulator.totalMs += ms;
+                accumulator.maxMs = std::max(accumulator.maxMs, ms);
+            }
+        }
+
+        summary.frameCount = static_cast<uint32_t>(frameTimes.size());
+        for(double time : frameTimes)
+            summary.averageMs += time;
+        summary.averageMs /= frameTimes.size();
+        std::sort(frameTimes.begin(), frameTimes.end());
+        summary.p50Ms = percentile(frameTimes, 0.50);
+        summary.p95Ms = percentile(frameTimes, 0.95);
+        summary.p99Ms = percentile(frameTimes, 0.99);
+        summary.maxMs = frameTimes.back();
+
+        for(auto& [key, accumulator] : zoneTotals)
+            summary.zones.push_back({ key.first, key.second, accumulator.count, accumulator.totalMs / accumulator.count, accumulator.maxMs });
+        return summary;
+    }
+
+    void Profiler::printSummary(std::ostream& out){
+        Summary summary = getSummary();
+        out << std::fixed << std::setprecision(3);
+        out << "Frames: " << summary.frameCount << ", average: " << summary.averageMs << " ms, p50: " << summary.p50Ms
+            << " ms, p95: " << summary.p95Ms << " ms, p99: " << summary.p99Ms << " ms, max: " << summary.maxMs << " ms" << '\n';
+        for(auto& zone : summary.zones){
+            out << "  " << (zone.gpu ? "[GPU] " : "[CPU] ") << zone.name << ": average " << zone.averageMs << " ms, max "
+                << zone.maxMs << " ms (" << zone.count << " frames)" << '\n';
+        }
+        out << std::defaultfloat;
+    }
+
+    void Profiler::writeChromeTrace(const std::string& path){
+        std::vector<Frame> frames;
+        uint32_t threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // Oldest first
+            frames.reserve(history.size());
+            for(size_t i = 0; i < history.size(); i++)
+                frames.push_back(history[(historyHead + i) % history.size()]);
+            threads = threadCount;
+        }
+
+        std::ofstream file{path, std::ios::trunc};
+        if(!file.is_open())
+            throw std::runtime_error("Failed to open trace file: " + path);
+
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for(uint32_t thread = 0; thread < threads; thread++)
+            writeTrackName(file, first, thread, "Thread " + std::to_string(thread));
+        writeTrackName(file, first, GPU_TRACK, "GPU");
+        writeTrackName(file, first, FRAME_TRACK, "Frames");
+
+        for(auto& frame : frames){
+            std::string frameName = "Frame " + std::to_string(frame.number);
+            writeEvent(file, first, frameName.c_str(), FRAME_TRACK, frame.start, frame.end);
+            for(auto& zone : frame.cpuZones)
+                writeEvent(file, first, zone.name, zone.thread, zone.start, zone.end);
+            for(auto& zone : frame.gpuZones)
+                writeEvent(file, first, zone.name, GPU_TRACK, zone.start, zone.end);
+        }
+        file << "\n]}\n";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+
+// Profiling is compiled in with RENDERER_PROFILING (see the CMake option of the same name), without it the macros
+// expand to nothing and no profiler code runs
+#if defined(RENDERER_PROFILING)
+    #define PROFILE_CONCAT_INNER(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+    // Times the enclosing scope on the calling thread, name has to be a string literal (only the pointer is stored)
+    #define PROFILE_SCOPE(name) ::Renderer::ProfileScope PROFILE_CONCAT(profileScope, __LINE__){name}
+    // Marks the start of a new frame, call once per frame from the main thread
+    #define PROFILE_FRAME() ::Renderer::Profiler::shared().beginFrame()
+#else
+    #define PROFILE_SCOPE(name) ((void)0)
+    #define PROFILE_FRAME() ((void)0)
+#endif
+
+namespace Renderer{
+    // Collects CPU zones (and GPU zones from GpuProfiler) per frame into a ring of the last HISTORY_FRAMES frames, which
+    // can be summarized or exported as a Chrome trace (chrome://tracing or ui.perfetto.dev). Zones from any thread are
+    // accepted, times are nanoseconds since the profiler was created.
+    class Profiler{
+        public:
+            static constexpr uint32_t HISTORY_FRAMES = 256;
+            static constexpr uint32_t GPU_THREAD = UINT32_MAX;   // Thread index of GPU zones
+
+            struct Zone{
+                const char* name;
+                uint64_t start, end;
+                uint32_t thread;        // Small index assigned per thread in order of first use
+                uint32_t depth;         // Nesting level on its thread
+            };
+
+            struct Frame{
+                uint64_t number = 0;
+                uint64_t start = 0, end = 0;
+                std::vector<Zone> cpuZones;
+                std::vector<Zone> gpuZones;
+            };
+
+            struct ZoneStats{
+                std::string name;
+                bool gpu;
+                uint32_t count;         // Frames the zone showed up in
+                double averageMs, maxMs;
+            };
+
+            struct Summary{
+                uint32_t frameCount = 0;
+                double averageMs = 0.0, p50Ms = 0.0, p95Ms = 0.0, p99Ms = 0.0, maxMs = 0.0;
+                std::vector<ZoneStats> zones;   // Per frame totals of each zone
+            };
+
+            Profiler();
+
+            Profiler(const Profiler&) = delete;
+            Profiler& operator=(const Profiler&) = delete;
+
+            static Profiler& shared();
+
+            // Closes the current frame (moving it into the history) and opens the next one
+            void beginFrame();
+            uint64_t getFrameNumber();
+            uint64_t now();
+
+            void beginZone(const char* name);
+            void endZone();
+            // Attaches GPU zones to a frame that is still in the history, results arrive a few frames late
+            void addGpuZones(uint64_t frameNumber, const std::vector<Zone>& zones);
+            // Copies a frame that is still in the history (or the current one), returns false once it has been dropped
+            bool getFrame(uint64_t frameNumber, Frame& frame);
+
+            // Statistics over the completed frames in the history
+            Summary getSummary();
+            void printSummary(std::ostream& out);
+            void writeChromeTrace(const std::string& path);
+
+        private:
+            uint32_t getThreadIndex();
+            // Null if the frame isn't kept (anymore), the mutex has to be held
+            Frame* findFrame(uint64_t frameNumber);
+
+            std::mutex mutex;
+            uint64_t epoch;
+            Frame currentFrame;
+            std::vector<Frame> history;     // Ring, oldest frame at historyHead once full
+            uint32_t historyHead = 0;
+            uint32_t threadCount = 0;
+    };
+
+    // Zone covering the lifetime of the object, see PROFILE_SCOPE
+    class ProfileScope{
+        public:
+            ProfileScope(const char* name) { Profiler::shared().beginZone(name); }
+            ~ProfileScope() { Profiler::shared().endZone(); }
+
+            ProfileScope(const ProfileScope&) = delete;
+            ProfileScope& operator=(const ProfileScope&) = delete;
+    };
+}
\ No newline at end of file
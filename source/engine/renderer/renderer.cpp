@@ -4,9 +4,21 @@
 #include <array>
 
 namespace Renderer{
-    Renderer::Renderer(Device& device, Window& window) : device{device}, window{window}{
+    Renderer::Renderer(Device& device, Window& window) : device{device}, window{&window}{
         recreateSwapChain();
         createCommandBuffers();
+#if defined(RENDERER_PROFILING)
+        gpuProfiler = std::make_unique<GpuProfiler>(device);
+#endif
+    }
+
+    Renderer::Renderer(Device& device, VkExtent2D extent) : device{device}, headlessExtent{extent}{
+        assert(device.isHeadless() && "A headless renderer requires a headless device.");
+        recreateSwapChain();
+        createCommandBuffers();
+#if defined(RENDERER_PROFILING)
+        gpuProfiler = std::make_unique<GpuProfiler>(device);
+#endif
     }
 
     Renderer::~Renderer(){
@@ -14,12 +26,17 @@ namespace Renderer{
     }
 
     void Renderer::recreateSwapChain(){
-        auto extent = window.getExtent();
-        while(extent.width == 0 || extent.height == 0){
-            extent = window.getExtent();
-            glfwWaitEvents();
+        auto extent = headlessExtent;
+        if(window != nullptr){
+            extent = window->getExtent();
+            while(extent.width == 0 || extent.height == 0){
+                extent = window->getExtent();
+                glfwWaitEvents();
+            }
         }
         vkDeviceWaitIdle(device.getDevice());
+        // The new depth attachments haven't been rendered to
+        hasPreviousDepth = false;
         if(swapChain == nullptr)
             swapChain = std::make_unique<SwapChain>(device, extent);
         else{
@@ -51,6 +68,7 @@ namespace Renderer{
 
     VkCommandBuffer Renderer::beginFrame(){
         assert(!isFrameStarted && "Can't call beginFrame() while already in progress.");
+        PROFILE_SCOPE("Acquire image");
         auto result = swapChain->acquireNextImage(&currentImageIndex);
         
         if(result == VK_ERROR_OUT_OF_DATE_KHR){
@@ -68,18 +86,29 @@ namespace Renderer{
         
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
             throw std::runtime_error("Failed to begin recording command buffer.");
+#if defined(RENDERER_PROFILING)
+        gpuProfiler->beginFrame(commandBuffer, currentFrameIndex);
+#endif
         return commandBuffer;
     }
 
     void Renderer::endFrame(){
         assert(isFrameStarted && "Can't call endFrame() when frame is not in progress.");
         auto commandBuffer = getCurrentCommandBuffer();
+#if defined(RENDERER_PROFILING)
+        gpuProfiler->endFrame(commandBuffer);
+#endif
         if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
             throw std::runtime_error("Failed to end command buffer.");
 
+        PROFILE_SCOPE("Submit and present");
         auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-        if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR || window.wasWindowResized()){
-            window.resetWindowResizedFlag();
+        lastSubmittedImageIndex = currentImageIndex;
+        hasSubmittedFrame = true;
+        hasPreviousDepth = true;
+        if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR || (window != nullptr && window->wasWindowResized())){
+            if(window != nullptr)
+                window->resetWindowResizedFlag();
             recreateSwapChain();
         }
         else if(result != VK_SUCCESS)
@@ -106,18 +135,17 @@ namespace Renderer{
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-        viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        VkRect2D scissor{ {0, 0}, swapChain->getSwapChainExtent() };
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    }
+
+    VkCommandBufferInheritanceInfo Renderer::getRenderPassInheritance() const{
+        assert(isFrameStarted && "Can't get render pass inheritance if frame is not in progress");
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = swapChain->getRenderPass();
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+        return inheritanceInfo;
     }
 
     void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
@@ -125,4 +153,11 @@ namespace Renderer{
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
         vkCmdEndRenderPass(commandBuffer);
     }
+
+    void Renderer::readFrame(std::vector<uint8_t>& pixels){
+        assert(device.isHeadless() && "Frames can only be read back from a headless renderer.");
+        assert(!isFrameStarted && "Can't read back a frame while one is being recorded.");
+        assert(hasSubmittedFrame && "No frame has been submitted yet.");
+        swapChain->readImage(lastSubmittedImageIndex, pixels);
+    }
 }
\ No newline at end of file
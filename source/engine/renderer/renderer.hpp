@@ -4,6 +4,7 @@
 #include "engine/swap_chain/swap_chain.hpp"
 #include "engine/window/window.hpp"
 #include "engine/systems/render_system/render_system.hpp"
+#include "engine/profiling/gpu_profiler.hpp"
 
 #include <memory>
 #include <vector>
@@ -13,10 +14,12 @@ namespace Renderer{
     class Renderer{
         public:
             Renderer(Device& device, Window& window);
+            Renderer(Device& device, VkExtent2D extent); // Headless renderer, device must also be headless
             ~Renderer();
             
             int getCurrentFrameIndex() { return currentFrameIndex; }
             VkRenderPass getSwapChainRenderPass() { return swapChain->getRenderPass(); }
+            VkExtent2D getExtent() const { return swapChain->getSwapChainExtent(); }
             float getAspectRatio() const { return swapChain->extentAspectRatio(); }
 
             VkCommandBuffer getCurrentCommandBuffer() const {
@@ -29,12 +32,23 @@ namespace Renderer{
                 return currentFrameIndex;
             }
 
+            // Depth attachment (DEPTH_STENCIL_READ_ONLY_OPTIMAL) of the last submitted frame, null before the first frame and
+            // after the swap chain was recreated
+            VkImageView getPreviousDepthImageView() { return hasPreviousDepth ? swapChain->getDepthImageView(lastSubmittedImageIndex) : VK_NULL_HANDLE; }
+
             VkCommandBuffer beginFrame();
             void endFrame();
 
+            // The render pass is begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, its contents have to be recorded into
+            // secondary command buffers (which set their own viewport and scissor) inheriting getRenderPassInheritance()
             void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
             void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+            VkCommandBufferInheritanceInfo getRenderPassInheritance() const;
+
+            // Copies the last submitted frame to host memory as tightly packed BGRA8 pixels (headless only)
+            void readFrame(std::vector<uint8_t>& pixels);
+
         private:
             void recreateSwapChain();
             void createCommandBuffers();
@@ -42,12 +56,19 @@ namespace Renderer{
 
 
             Device& device;
-            Window& window;
+            Window* window = nullptr;
+            VkExtent2D headlessExtent{};
 
             std::unique_ptr<SwapChain> swapChain;
             std::vector<VkCommandBuffer> commandBuffers;
+#if defined(RENDERER_PROFILING)
+            std::unique_ptr<GpuProfiler> gpuProfiler;
+#endif
 
             uint32_t currentImageIndex;
+            uint32_t lastSubmittedImageIndex = 0;
+            bool hasSubmittedFrame = false;
+            bool hasPreviousDepth = false;
             int currentFrameIndex{0};
             bool isFrameStarted{false};
     };
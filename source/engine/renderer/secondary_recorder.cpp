@@ -0,0 +1,69 @@
+#include "secondary_recorder.hpp"
+
+#include <stdexcept>
+
+namespace Renderer{
+    SecondaryRecorder::SecondaryRecorder(Device& device, JobSystem& jobSystem) : device{device}, jobSystem{jobSystem}{
+        frameSlots.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+
+    SecondaryRecorder::~SecondaryRecorder(){
+        // Destroying a pool frees its command buffers
+        for(auto& slots : frameSlots)
+            for(auto& slot : slots)
+                vkDestroyCommandPool(device.getDevice(), slot.pool, nullptr);
+    }
+
+    SecondaryRecorder::TaskSlot& SecondaryRecorder::getSlot(uint32_t frameIndex, uint32_t task){
+        auto& slots = frameSlots[frameIndex];
+        while(slots.size() <= task){
+            TaskSlot slot{};
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = device.getPhysicalQueueFamilies().graphicsFamily;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            if(vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &slot.pool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create secondary command pool.");
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = slot.pool;
+            allocInfo.commandBufferCount = 1;
+            if(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &slot.commandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate secondary command buffer.");
+            slots.push_back(slot);
+        }
+        return slots[task];
+    }
+
+    void SecondaryRecorder::record(VkCommandBuffer primaryCommandBuffer, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance, 
+        uint32_t taskCount, const std::function<void(uint32_t, VkCommandBuffer)>& recordTask){
+        if(taskCount == 0)
+            return;
+
+        // Pools are created and reset on this thread, the workers only record
+        commandBuffers.resize(taskCount);
+        for(uint32_t task = 0; task < taskCount; task++){
+            TaskSlot& slot = getSlot(frameIndex, task);
+            vkResetCommandPool(device.getDevice(), slot.pool, 0);
+            commandBuffers[task] = slot.commandBuffer;
+        }
+
+        jobSystem.parallelFor(taskCount, [&](uint32_t task){
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            beginInfo.pInheritanceInfo = &inheritance;
+            if(vkBeginCommandBuffer(commandBuffers[task], &beginInfo) != VK_SUCCESS)
+                throw std::runtime_error("Failed to begin recording secondary command buffer.");
+
+            recordTask(task, commandBuffers[task]);
+
+            if(vkEndCommandBuffer(commandBuffers[task]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to end secondary command buffer.");
+        });
+
+        vkCmdExecuteCommands(primaryCommandBuffer, taskCount, commandBuffers.data());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/jobs/job_system.hpp"
+#include "engine/swap_chain/swap_chain.hpp"
+
+#include <vector>
+#include <functional>
+
+namespace Renderer{
+    // Records work split into tasks into secondary command buffers in parallel on the job system, the primary command
+    // buffer then executes them in task order inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    // Every task slot has its own command pool per frame in flight, so no pool is ever used by two threads at once and
+    // a frame's pools are reset as a whole instead of freeing buffers one by one.
+    class SecondaryRecorder{
+        public:
+            SecondaryRecorder(Device& device, JobSystem& jobSystem = JobSystem::shared());
+            ~SecondaryRecorder();
+
+            SecondaryRecorder(const SecondaryRecorder&) = delete;
+            SecondaryRecorder& operator=(const SecondaryRecorder&) = delete;
+
+            // Task count that keeps every worker and the calling thread busy
+            uint32_t getMaxParallelTasks() { return jobSystem.getThreadCount() + 1; }
+
+            // Calls recordTask(task, commandBuffer) for every task with a begun secondary command buffer that continues the
+            // render pass in inheritance, then executes them all on primaryCommandBuffer. The frame's previous command
+            // buffers must have completed (its fence waited on).
+            void record(VkCommandBuffer primaryCommandBuffer, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance, 
+                uint32_t taskCount, const std::function<void(uint32_t, VkCommandBuffer)>& recordTask);
+
+        private:
+            struct TaskSlot{
+                VkCommandPool pool = VK_NULL_HANDLE;
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            };
+
+            TaskSlot& getSlot(uint32_t frameIndex, uint32_t task);
+
+            Device& device;
+            JobSystem& jobSystem;
+
+            // Indexed by frame, then task
+            std::vector<std::vector<TaskSlot>> frameSlots;
+            std::vector<VkCommandBuffer> commandBuffers;
+    };
+}
\ No newline at end of file
@@ -1,54 +1,270 @@
 #include "scene.hpp"
 
+#include "engine/assets/asset_loader.hpp"
+#include "engine/scene/scene_file.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <stdexcept>
 #include <cassert>
 
+#ifndef RENDERER_ASSET_DIRECTORY
+    #error "RENDERER_ASSET_DIRECTORY must be set by CMake"
+#endif
+
 namespace Renderer{
     Scene::Scene(){}
 
-    void Scene::save(){
+    void Scene::save(const std::string& filepath){
+        SceneFile::Contents contents;
 
-    }
+        std::unordered_map<unsigned int, uint32_t> samplerIndices;
+        for(auto& [id, sampler] : samplers){
+            const Sampler::SamplerConfig& config = sampler->getConfig();
+            SceneFile::SamplerRecord record{};
+            record.magFilter = config.magFilter;
+            record.minFilter = config.minFilter;
+            record.addressModeU = config.addressModeU;
+            record.addressModeV = config.addressModeV;
+            record.addressModeW = config.addressModeW;
+            record.anisotropyEnable = config.anisotropyEnable;
+            record.maxAnisotropy = config.maxAnisotropy;
+            record.borderColor = config.borderColor;
+            record.unnormalizeCoordinates = config.unnormalizeCoordinates;
+            record.compareEnable = config.compareEnable;
+            record.compareOp = config.compareOp;
+            record.mipmapMode = config.mipmapMode;
+            record.mipLodBias = config.mipLodBias;
+            record.minLod = config.minLod;
+            record.maxLod = config.maxLod;
+            samplerIndices[id] = static_cast<uint32_t>(contents.samplers.size());
+            contents.samplers.push_back(record);
+        }
+
+        // Assets are written in id order so saving the same scene twice gives the same file
+        auto sortedIds = [](const std::unordered_map<unsigned int, std::string>& paths){
+            std::vector<unsigned int> ids;
+            for(auto& path : paths)
+                ids.push_back(path.first);
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        std::unordered_map<unsigned int, uint32_t> textureIndices;
+        for(unsigned int id : sortedIds(texturePaths)){
+            SceneFile::TextureRecord record{};
+            record.path = contents.addString(texturePaths[id]);
+            auto texture = textures.find(id);
+            unsigned int samplerId = texture != textures.end() && texture->second->getId() == id ? texture->second->samplerId : 0;
+            // Textures still loading don't know their sampler yet, the first one stands in
+            auto samplerIndex = samplerIndices.find(samplerId);
+            if(samplerIndex == samplerIndices.end() && samplerIndices.empty())
+                throw std::runtime_error("Cannot save textures without a sampler.");
+            record.sampler = samplerIndex != samplerIndices.end() ? samplerIndex->second : 0;
+            textureIndices[id] = static_cast<uint32_t>(contents.textures.size());
+            contents.textures.push_back(record);
+        }
+        std::unordered_map<unsigned int, uint32_t> modelIndices;
+        for(unsigned int id : sortedIds(modelPaths)){
+            modelIndices[id] = static_cast<uint32_t>(contents.models.size());
+            contents.models.push_back({contents.addString(modelPaths[id])});
+        }
 
-    void Scene::load(){
+        // Slot maps are written packed, handles become indices into the packed order
+        auto addTextureList = [&](const std::vector<unsigned int>& ids, uint32_t& first, uint32_t& count){
+            first = static_cast<uint32_t>(contents.textureReferences.size());
+            for(unsigned int id : ids){
+                auto index = textureIndices.find(id);
+                if(index != textureIndices.end())
+                    contents.textureReferences.push_back(index->second);
+            }
+            count = static_cast<uint32_t>(contents.textureReferences.size()) - first;
+        };
+        std::vector<uint32_t> materialIndices(materials.slotCount(), SceneFile::NONE);
+        auto materialValues = materials.values();
+        auto materialHandles = materials.handles();
+        for(size_t i = 0; i < materialValues.size(); i++){
+            const Material::MaterialProperties& properties = materialValues[i].properties;
+            SceneFile::MaterialRecord record{};
+            record.opacity = properties.opacity;
+            record.shininess = properties.shininess;
+            for(int c = 0; c < 4; c++){
+                record.diffuseColour[c] = properties.diffuseColour[c];
+                record.specularColour[c] = properties.specularColour[c];
+                record.hue[c] = properties.hue[c];
+            }
+            addTextureList(materialValues[i].diffuseTextureIds, record.firstDiffuseTexture, record.diffuseTextureCount);
+            addTextureList(materialValues[i].normalTextureIds, record.firstNormalTexture, record.normalTextureCount);
+            materialIndices[materialHandles[i].index] = static_cast<uint32_t>(contents.materials.size());
+            contents.materials.push_back(record);
+        }
 
+        std::vector<uint32_t> meshIndices(meshes.slotCount(), SceneFile::NONE);
+        auto meshValues = meshes.values();
+        auto meshHandles = meshes.handles();
+        for(size_t i = 0; i < meshValues.size(); i++){
+            const Mesh& mesh = meshValues[i];
+            SceneFile::MeshRecord record{};
+            auto model = modelIndices.find(mesh.modelId);
+            record.model = model != modelIndices.end() ? model->second : SceneFile::NONE;
+            record.material = materials.contains(mesh.material) ? materialIndices[mesh.material.index] : SceneFile::NONE;
+            record.emitLight = mesh.pointLightComponent.emitLight ? 1 : 0;
+            record.brightness = mesh.pointLightComponent.brightness;
+            record.width = mesh.pointLightComponent.width;
+            for(int c = 0; c < 3; c++)
+                record.lightDirection[c] = mesh.pointLightComponent.lightDirection[c];
+            for(int c = 0; c < 4; c++)
+                record.lightHue[c] = mesh.pointLightComponent.hue[c];
+            meshIndices[meshHandles[i].index] = static_cast<uint32_t>(contents.meshes.size());
+            contents.meshes.push_back(record);
+        }
+
+        contents.objects.reserve(objects.size());
+        for(auto& object : objects){
+            SceneFile::ObjectRecord record{};
+            for(int c = 0; c < 3; c++){
+                record.translation[c] = object.transform.translation[c];
+                record.rotation[c] = object.transform.rotation[c];
+                record.scale[c] = object.transform.scale[c];
+            }
+            for(auto mesh : object.getMeshes()){
+                if(meshes.contains(mesh))
+                    record.meshes[record.meshCount++] = meshIndices[mesh.index];
+            }
+            contents.objects.push_back(record);
+        }
+
+        SceneFile{std::move(contents)}.write(filepath);
     }
 
-    void Scene::loadModels(Device& device){
-        std::shared_ptr<Renderer::Model> spongebob = Renderer::Model::createModelFromFile(device, "C:/Programming/C++_Projects/renderer/source/models/spongebob.obj");
-        models[spongebob->getId()] = spongebob;
+    void Scene::load(const std::string& filepath, AssetLoader& loader, Device& device){
+        SceneFile file{filepath};
+
+        std::vector<unsigned int> samplerIds;
+        for(auto& record : file.getSamplers()){
+            Sampler::SamplerConfig config{};
+            config.magFilter = static_cast<VkFilter>(record.magFilter);
+            config.minFilter = static_cast<VkFilter>(record.minFilter);
+            config.addressModeU = static_cast<VkSamplerAddressMode>(record.addressModeU);
+            config.addressModeV = static_cast<VkSamplerAddressMode>(record.addressModeV);
+            config.addressModeW = static_cast<VkSamplerAddressMode>(record.addressModeW);
+            config.anisotropyEnable = record.anisotropyEnable;
+            config.maxAnisotropy = record.maxAnisotropy;
+            config.borderColor = static_cast<VkBorderColor>(record.borderColor);
+            config.unnormalizeCoordinates = record.unnormalizeCoordinates;
+            config.compareEnable = record.compareEnable;
+            config.compareOp = static_cast<VkCompareOp>(record.compareOp);
+            config.mipmapMode = static_cast<VkSamplerMipmapMode>(record.mipmapMode);
+            config.mipLodBias = record.mipLodBias;
+            config.minLod = record.minLod;
+            config.maxLod = record.maxLod;
+            std::shared_ptr<Sampler> sampler = Sampler::createSampler(device, config);
+            samplerIds.push_back(sampler->getId());
+            samplers[sampler->getId()] = sampler;
+        }
+
+        // Assets get fresh ids, records refer to them by index
+        std::vector<unsigned int> textureIds;
+        for(auto& record : file.getTextures())
+            textureIds.push_back(loader.loadTexture(std::string{file.getString(record.path)}, samplerIds[record.sampler]).id);
+        std::vector<unsigned int> modelIds;
+        for(auto& record : file.getModels())
+            modelIds.push_back(loader.loadModel(std::string{file.getString(record.path)}).id);
 
-        std::shared_ptr<Renderer::Model> smoothVase = Renderer::Model::createModelFromFile(device, "C:/Programming/C++_Projects/renderer/source/models/smooth_vase.obj");
-        models[smoothVase->getId()] = smoothVase;
+        auto textureReferences = file.getTextureReferences();
+        auto toTextureIds = [&](uint32_t first, uint32_t count, std::vector<unsigned int>& ids){
+            ids.reserve(count);
+            for(uint32_t i = 0; i < count; i++)
+                ids.push_back(textureIds[textureReferences[first + i]]);
+        };
+        std::vector<Handle<Material>> materialHandles;
+        materialHandles.reserve(file.getMaterials().size());
+        materials.reserve(file.getMaterials().size());
+        for(auto& record : file.getMaterials()){
+            auto handle = createMaterial();
+            Material& material = materials[handle];
+            material.properties.opacity = record.opacity;
+            material.properties.shininess = record.shininess;
+            material.properties.diffuseColour = glm::make_vec4(record.diffuseColour);
+            material.properties.specularColour = glm::make_vec4(record.specularColour);
+            material.properties.hue = glm::make_vec4(record.hue);
+            toTextureIds(record.firstDiffuseTexture, record.diffuseTextureCount, material.diffuseTextureIds);
+            toTextureIds(record.firstNormalTexture, record.normalTextureCount, material.normalTextureIds);
+            materialHandles.push_back(handle);
+        }
+
+        std::vector<Handle<Mesh>> meshHandles;
+        meshHandles.reserve(file.getMeshes().size());
+        meshes.reserve(file.getMeshes().size());
+        for(auto& record : file.getMeshes()){
+            auto handle = createMesh();
+            Mesh& mesh = meshes[handle];
+            // Meshes without a model draw nothing, the id is kept out of the range of real ones
+            mesh.modelId = record.model != SceneFile::NONE ? modelIds[record.model] : ~0u;
+            if(record.material != SceneFile::NONE)
+                mesh.material = materialHandles[record.material];
+            mesh.pointLightComponent.emitLight = record.emitLight != 0;
+            mesh.pointLightComponent.brightness = record.brightness;
+            mesh.pointLightComponent.width = record.width;
+            mesh.pointLightComponent.lightDirection = glm::make_vec3(record.lightDirection);
+            mesh.pointLightComponent.hue = glm::make_vec4(record.lightHue);
+            meshHandles.push_back(handle);
+        }
+
+        // The bulk of a large scene, reserved up front so inserting doesn't allocate
+        auto objectRecords = file.getObjects();
+        objects.reserve(objectRecords.size());
+        for(auto& record : objectRecords){
+            Object& object = objects[createObject()];
+            object.transform.translation = glm::make_vec3(record.translation);
+            object.transform.rotation = glm::make_vec3(record.rotation);
+            object.transform.scale = glm::make_vec3(record.scale);
+            for(uint32_t i = 0; i < record.meshCount; i++)
+                object.addMesh(meshHandles[record.meshes[i]]);
+        }
     }
 
-    void Scene::loadTexturesWithSampler(Device& device, unsigned int samplerId){
+    void Scene::loadModels(AssetLoader& loader){
+        loader.loadModel(RENDERER_ASSET_DIRECTORY "models/spongebob.obj");
+        loader.loadModel(RENDERER_ASSET_DIRECTORY "models/smooth_vase.obj");
+    }
+
+    void Scene::loadTexturesWithSampler(AssetLoader& loader, unsigned int samplerId){
         assert(samplers.at(samplerId) != nullptr && "No sampler with given ID exists.");
-        std::shared_ptr<Renderer::Texture> spongeTexture = Renderer::Texture::createTextureFromFile(device, "C:/Programming/C++_Projects/renderer/source/textures/spongebob/spongebob.png");
-        spongeTexture->samplerId = samplerId;
-        textures[spongeTexture->getId()] = spongeTexture;
+        loader.loadTexture(RENDERER_ASSET_DIRECTORY "textures/spongebob/spongebob.png", samplerId);
+        loader.loadTexture(RENDERER_ASSET_DIRECTORY "textures/milkyway.jpg", samplerId);
+    }
 
-        std::shared_ptr<Renderer::Texture> sampleImage = Renderer::Texture::createTextureFromFile(device, "C:/Programming/C++_Projects/renderer/source/textures/milkyway.jpg");
-        sampleImage->samplerId = samplerId;
-        textures[sampleImage->getId()] = sampleImage;
+    Handle<Object> Scene::createObject(){
+        structureChanged = true;
+        return objects.insert(Object::createObject());
     }
 
-    void Scene::createObject(){
-        Object newObject = Object::createObject();
-        objects.emplace(newObject.getId(), newObject);
+    void Scene::destroyObject(Handle<Object> object){
+        assert(objects.contains(object) && "No object with given handle exists.");
+        objects.erase(object);
+        structureChanged = true;
     }
 
-    void Scene::createMesh(){
-        Mesh newMesh = Mesh::createMesh();
-        meshes.emplace(newMesh.getId(), newMesh);
+    void Scene::markTransformDirty(Handle<Object> object){
+        assert(objects.contains(object) && "No object with given handle exists.");
+        dirtyObjects.push_back(object);
     }
 
-    void Scene::createMaterial(){
-        Material newMaterial = Material::createMaterial();
-        materials.emplace(newMaterial.getId(), newMaterial);
+    Handle<Mesh> Scene::createMesh(){
+        return meshes.insert(Mesh{});
+    }
+
+    Handle<Material> Scene::createMaterial(){
+        return materials.insert(Material::createMaterial());
     }
 
     void Scene::createSampler(Device& device, Sampler::SamplerConfig config){
         std::shared_ptr<Sampler> newSampler = Sampler::createSampler(device, config);
         samplers[newSampler->getId()] = newSampler;
     }
+
+    void Scene::createGeometryPool(Device& device){
+        geometryPool = std::make_unique<GeometryPool>(device, static_cast<uint32_t>(sizeof(Model::Vertex)));
+    }
 }
\ No newline at end of file
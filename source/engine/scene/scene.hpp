@@ -3,38 +3,65 @@
 #include "engine/object/object.hpp"
 #include "engine/mesh/mesh.hpp"
 #include "engine/mesh/model.hpp"
+#include "engine/mesh/geometry_pool.hpp"
+#include "engine/scene/slot_map.hpp"
 #include "engine/material/texture/texture.hpp"
 #include "engine/material/sampler/sampler.hpp"
 
 #include <unordered_map>
+#include <vector>
+#include <string>
 
 namespace Renderer{
+    class AssetLoader;
+
     class Scene{
         public:
             Scene();
 
-            void save();
-            void load();
+            // Writes the scene as a SceneFile (binary, or JSON for a .json path), throws on failure. Only assets requested
+            // through an AssetLoader are included since the file refers to them by path.
+            void save(const std::string& filepath);
+            // Adds the contents of a scene file to the scene: samplers are created, assets are requested from loader and
+            // objects are inserted without allocating per object. Throws if the file can't be read.
+            void load(const std::string& filepath, AssetLoader& loader, Device& device);
 
-            void loadModels(Device& device);
-            void loadTexturesWithSampler(Device& device, unsigned int samplerId);
+            // Loads are asynchronous, assets show up in models/textures once the loader has finished them
+            void loadModels(AssetLoader& loader);
+            void loadTexturesWithSampler(AssetLoader& loader, unsigned int samplerId);
 
-            void createObject();
-            void createMesh();
-            void createMaterial();
+            Handle<Object> createObject();
+            void destroyObject(Handle<Object> object);
+            // Call after changing an object's transform, its instances are re-uploaded with the next frame
+            void markTransformDirty(Handle<Object> object);
+            Handle<Mesh> createMesh();
+            Handle<Material> createMaterial();
 
             void createSampler(Device& device, Sampler::SamplerConfig config);
+            // Has to exist before any model is loaded
+            void createGeometryPool(Device& device);
 
-            // In-engine components (stuff the user will be interacting with)
-            Object::Map objects;
-            Mesh::Map meshes;
-            Material::Map materials;
+            // In-engine components (stuff the user will be interacting with), packed and referenced by handle
+            SlotMap<Object> objects;
+            SlotMap<Mesh> meshes;
+            SlotMap<Material> materials;
 
             // Samplers (created by user indirectly and can be shared between textures)
             std::unordered_map<unsigned int, std::shared_ptr<Sampler>> samplers;
 
+            // Objects whose transform changed since the render system last picked them up (may hold duplicates)
+            std::vector<Handle<Object>> dirtyObjects;
+            // Set when objects are created or destroyed, the render system rebuilds its draw commands
+            bool structureChanged = false;
+
+            // Vertices and indices of all models (declared before models so it outlives them)
+            std::unique_ptr<GeometryPool> geometryPool;
+
             // Raw assets (loaded from files the user specifies)
             std::unordered_map<unsigned int, std::shared_ptr<Model>> models;
             std::unordered_map<unsigned int, std::shared_ptr<Texture>> textures;
+            // Files assets were requested from, by asset id
+            std::unordered_map<unsigned int, std::string> modelPaths;
+            std::unordered_map<unsigned int, std::string> texturePaths;
     };
 }
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "scene_file.hpp"
+
+#include "engine/io/json.hpp"
+#include "engine/io/file_utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <cctype>
+
+namespace Renderer{
+    namespace{
+        uint64_t alignOffset(uint64_t offset){
+            return (offset + SceneFile::SECTION_ALIGNMENT - 1) & ~(SceneFile::SECTION_ALIGNMENT - 1);
+        }
+
+        // Records are read from the mapping as they are
+        template<typename T>
+        std::span<const T> mapSection(const uint8_t* base, const SceneFile::Header& header, SceneFile::Section section){
+            static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= SceneFile::SECTION_ALIGNMENT);
+            return {reinterpret_cast<const T*>(base + header.sectionOffsets[section]), header.sectionCounts[section]};
+        }
+
+        void writeFloats(std::ostream& out, const float* values, size_t count){
+            out << '[';
+            for(size_t i = 0; i < count; i++)
+                out << (i == 0 ? "" : ",") << values[i];
+            out << ']';
+        }
+
+        uint32_t getIndex(const JsonValue& value, std::string_view key, uint32_t fallback){
+            const JsonValue* member = value.find(key);
+            if(member == nullptr || member->isNull())
+                return fallback;
+            double number = member->asNumber();
+            if(number < 0.0 || number >= static_cast<double>(SceneFile::NONE) || number != static_cast<uint32_t>(number))
+                throw std::runtime_error("Invalid index for \"" + std::string{key} + "\" in scene.");
+            return static_cast<uint32_t>(number);
+        }
+
+        // Appends a JSON array of indices to references, returns its first element and count
+        std::pair<uint32_t, uint32_t> getIndexList(const JsonValue& value, std::string_view key, std::vector<uint32_t>& references){
+            uint32_t first = static_cast<uint32_t>(references.size());
+            const JsonValue* member = value.find(key);
+            if(member == nullptr)
+                return {first, 0};
+            for(auto& element : member->asArray()){
+                double number = element.asNumber();
+                if(number < 0.0 || number >= static_cast<double>(SceneFile::NONE) || number != static_cast<uint32_t>(number))
+                    throw std::runtime_error("Invalid index in \"" + std::string{key} + "\" in scene.");
+                references.push_back(static_cast<uint32_t>(number));
+            }
+            return {first, static_cast<uint32_t>(references.size()) - first};
+        }
+    }
+
+    SceneFile::StringRange SceneFile::Contents::addString(std::string_view s){
+        StringRange range{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s.size())};
+        strings += s;
+        return range;
+    }
+
+    SceneFile::SceneFile(const std::string& filepath){
+        if(isJsonPath(filepath))
+            parseJson(filepath);
+        else
+            mapBinary(filepath);
+        validate();
+    }
+
+    SceneFile::SceneFile(Contents contents) : contents{std::move(contents)}{
+        useContents();
+        validate();
+    }
+
+    bool SceneFile::isJsonPath(const std::string& filepath){
+        std::string extension = std::filesystem::path{filepath}.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        return extension == ".json";
+    }
+
+    void SceneFile::useContents(){
+        strings = contents.strings;
+        samplers = contents.samplers;
+        textures = contents.textures;
+        models = contents.models;
+        materials = contents.materials;
+        textureReferences = contents.textureReferences;
+        meshes = contents.meshes;
+        objects = contents.objects;
+    }
+
+    void SceneFile::mapBinary(const std::string& filepath){
+        mapping = std::make_unique<MappedFile>(filepath);
+        if(!mapping->isOpen() || mapping->getSize() < sizeof(Header))
+            throw std::runtime_error("Failed to open scene: " + filepath);
+
+        Header header;
+        std::memcpy(&header, mapping->getData(), sizeof(Header));
+        if(std::memcmp(header.magic, Header{}.magic, sizeof(header.magic)) != 0)
+            throw std::runtime_error("Not a scene file: " + filepath);
+        if(header.version != VERSION)
+            throw std::runtime_error("Unsupported scene version " + std::to_string(header.version) + ": " + filepath);
+
+        const size_t elementSizes[SECTION_COUNT] = { 1, sizeof(SamplerRecord), sizeof(TextureRecord), sizeof(ModelRecord), sizeof(MaterialRecord),
+            sizeof(uint32_t), sizeof(MeshRecord), sizeof(ObjectRecord) };
+        for(uint32_t section = 0; section < SECTION_COUNT; section++){
+            uint64_t offset = header.sectionOffsets[section];
+            uint64_t size = static_cast<uint64_t>(header.sectionCounts[section]) * elementSizes[section];
+            if(offset % SECTION_ALIGNMENT != 0 || offset < sizeof(Header) || offset > mapping->getSize() || size > mapping->getSize() - offset)
+                throw std::runtime_error("Scene file is damaged: " + filepath);
+        }
+        const uint8_t* base = mapping->getData();
+        if(FileUtils::hash(base + sizeof(Header), mapping->getSize() - sizeof(Header)) != header.dataHash)
+            throw std::runtime_error("Scene file is damaged: " + filepath);
+
+        strings = {reinterpret_cast<const char*>(base + header.sectionOffsets[STRINGS]), header.sectionCounts[STRINGS]};
+        samplers = mapSection<SamplerRecord>(base, header, SAMPLERS);
+        textures = mapSection<TextureRecord>(base, header, TEXTURES);
+        models = mapSection<ModelRecord>(base, header, MODELS);
+        materials = mapSection<MaterialRecord>(base, header, MATERIALS);
+        textureReferences = mapSection<uint32_t>(base, header, TEXTURE_REFERENCES);
+        meshes = mapSection<MeshRecord>(base, header, MESHES);
+        objects = mapSection<ObjectRecord>(base, header, OBJECTS);
+    }
+
+    void SceneFile::validate() const{
+        auto checkString = [&](StringRange range){
+            if(range.offset > strings.size() || range.length > strings.size() - range.offset)
+                throw std::runtime_error("Scene holds a string outside of its string table.");
+        };
+        auto checkIndex = [](uint32_t index, size_t count, const char* what){
+            if(index >= count)
+                throw std::runtime_error(std::string{"Scene refers to a missing "} + what + ".");
+        };
+        auto checkRange = [&](uint32_t first, uint32_t count){
+            if(first > textureReferences.size() || count > textureReferences.size() - first)
+                throw std::runtime_error("Scene holds a texture list outside of its texture references.");
+        };
+
+        for(auto& texture : textures){
+            checkString(texture.path);
+            checkIndex(texture.sampler, samplers.size(), "sampler");
+        }
+        for(auto& model : models)
+            checkString(model.path);
+        for(auto& material : materials){
+            checkRange(material.firstDiffuseTexture, material.diffuseTextureCount);
+            checkRange(material.firstNormalTexture, material.normalTextureCount);
+        }
+        for(uint32_t texture : textureReferences)
+            checkIndex(texture, textures.size(), "texture");
+        for(auto& mesh : meshes){
+            if(mesh.model != NONE)
+                checkIndex(mesh.model, models.size(), "model");
+            if(mesh.material != NONE)
+                checkIndex(mesh.material, materials.size(), "material");
+        }
+        for(auto& object : objects){
+            if(object.meshCount > Object::MAX_MESHES)
+                throw std::runtime_error("Scene object has more than Object::MAX_MESHES meshes.");
+            for(uint32_t i = 0; i < object.meshCount; i++)
+                checkIndex(object.meshes[i], meshes.size(), "mesh");
+        }
+    }
+
+    void SceneFile::write(const std::string& filepath) const{
+        if(isJsonPath(filepath))
+            writeJson(filepath);
+        else
+            writeBinary(filepath);
+    }
+
+    void SceneFile::writeBinary(const std::string& filepath) const{
+        Header header{};
+        const void* sectionData[SECTION_COUNT] = { strings.data(), samplers.data(), textures.data(), models.data(), materials.data(),
+            textureReferences.data(), meshes.data(), objects.data() };
+        const size_t sectionSizes[SECTION_COUNT] = { strings.size(), samplers.size_bytes(), textures.size_bytes(), models.size_bytes(),
+            materials.size_bytes(), textureReferences.size_bytes(), meshes.size_bytes(), objects.size_bytes() };
+        const size_t sectionCounts[SECTION_COUNT] = { strings.size(), samplers.size(), textures.size(), models.size(), materials.size(),
+            textureReferences.size(), meshes.size(), objects.size() };
+
+        // Sections are laid out in memory first so the hash can go into the header
+        std::vector<uint8_t> data;
+        for(uint32_t section = 0; section < SECTION_COUNT; section++){
+            if(sectionCounts[section] > UINT32_MAX)
+                throw std::runtime_error("Scene is too large to be saved.");
+            uint64_t offset = alignOffset(sizeof(Header) + data.size());
+            data.resize(offset - sizeof(Header) + sectionSizes[section]);
+            if(sectionSizes[section] > 0)
+                std::memcpy(data.data() + (offset - sizeof(Header)), sectionData[section], sectionSizes[section]);
+            header.sectionOffsets[section] = offset;
+            header.sectionCounts[section] = static_cast<uint32_t>(sectionCounts[section]);
+        }
+        header.dataHash = FileUtils::hash(data.data(), data.size());
+
+        if(!FileUtils::atomicWriteFile(filepath, { std::as_bytes(std::span{&header, 1}), std::as_bytes(std::span{data}) }))
+            throw std::runtime_error("Failed to write scene: " + filepath);
+    }
+
+    void SceneFile::writeJson(const std::string& filepath) const{
+        std::ofstream out{filepath, std::ios::trunc};
+        if(!out.is_open())
+            throw std::runtime_error("Failed to write scene: " + filepath);
+        out.precision(9);    // Round trips floats exactly
+
+        auto writeIndexList = [&](uint32_t first, uint32_t count){
+            out << '[';
+            for(uint32_t i = 0; i < count; i++)
+                out << (i == 0 ? "" : ",") << textureReferences[first + i];
+            out << ']';
+        };
+
+        out << "{\n  \"version\": " << VERSION << ",\n  \"samplers\": [";
+        for(size_t i = 0; i < samplers.size(); i++){
+            auto& sampler = samplers[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"magFilter\":" << sampler.magFilter << ",\"minFilter\":" << sampler.minFilter
+                << ",\"addressModeU\":" << sampler.addressModeU << ",\"addressModeV\":" << sampler.addressModeV << ",\"addressModeW\":" << sampler.addressModeW
+                << ",\"anisotropyEnable\":" << sampler.anisotropyEnable << ",\"maxAnisotropy\":" << sampler.maxAnisotropy << ",\"borderColor\":" << sampler.borderColor
+                << ",\"unnormalizeCoordinates\":" << sampler.unnormalizeCoordinates << ",\"compareEnable\":" << sampler.compareEnable
+                << ",\"compareOp\":" << sampler.compareOp << ",\"mipmapMode\":" << sampler.mipmapMode << ",\"mipLodBias\":" << sampler.mipLodBias
+                << ",\"minLod\":" << sampler.minLod << ",\"maxLod\":" << sampler.maxLod << "}";
+        }
+        out << "\n  ],\n  \"textures\": [";
+        for(size_t i = 0; i < textures.size(); i++){
+            out << (i == 0 ? "\n" : ",\n") << "    {\"path\":";
+            JsonValue::writeString(out, getString(textures[i].path));
+            out << ",\"sampler\":" << textures[i].sampler << "}";
+        }
+        out << "\n  ],\n  \"models\": [";
+        for(size_t i = 0; i < models.size(); i++){
+            out << (i == 0 ? "\n" : ",\n") << "    {\"path\":";
+            JsonValue::writeString(out, getString(models[i].path));
+            out << "}";
+        }
+        out << "\n  ],\n  \"materials\": [";
+        for(size_t i = 0; i < materials.size(); i++){
+            auto& material = materials[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"opacity\":" << material.opacity << ",\"shininess\":" << material.shininess << ",\"diffuseColour\":";
+            writeFloats(out, material.diffuseColour, 4);
+            out << ",\"specularColour\":";
+            writeFloats(out, material.specularColour, 4);
+            out << ",\"hue\":";
+            writeFloats(out, material.hue, 4);
+            out << ",\"diffuseTextures\":";
+            writeIndexList(material.firstDiffuseTexture, material.diffuseTextureCount);
+            out << ",\"normalTextures\":";
+            writeIndexList(material.firstNormalTexture, material.normalTextureCount);
+            out << "}";
+        }
+        out << "\n  ],\n  \"meshes\": [";
+        for(size_t i = 0; i < meshes.size(); i++){
+            auto& mesh = meshes[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"model\":";
+            if(mesh.model == NONE) out << "null"; else out << mesh.model;
+            out << ",\"material\":";
+            if(mesh.material == NONE) out << "null"; else out << mesh.material;
+            out << ",\"emitLight\":" << (mesh.emitLight ? "true" : "false") << ",\"brightness\":" << mesh.brightness << ",\"width\":" << mesh.width
+                << ",\"lightDirection\":";
+            writeFloats(out, mesh.lightDirection, 3);
+            out << ",\"lightHue\":";
+            writeFloats(out, mesh.lightHue, 4);
+            out << "}";
+        }
+        out << "\n  ],\n  \"objects\": [";
+        for(size_t i = 0; i < objects.size(); i++){
+            auto& object = objects[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"translation\":";
+            writeFloats(out, object.translation, 3);
+            out << ",\"rotation\":";
+            writeFloats(out, object.rotation, 3);
+            out << ",\"scale\":";
+            writeFloats(out, object.scale, 3);
+            out << ",\"meshes\":[";
+            for(uint32_t j = 0; j < object.meshCount; j++)
+                out << (j == 0 ? "" : ",") << object.meshes[j];
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+        if(!out)
+            throw std::runtime_error("Failed to write scene: " + filepath);
+    }
+
+    void SceneFile::parseJson(const std::string& filepath){
+        JsonValue root = JsonValue::parseFile(filepath);
+        if(root.getType() != JsonValue::Type::Object)
+            throw std::runtime_error("Scene JSON must be an object: " + filepath);
+        if(root.getNumber("version", VERSION) != VERSION)
+            throw std::runtime_error("Unsupported scene version: " + filepath);
+
+        auto getArray = [&](std::string_view key) -> const std::vector<JsonValue>&{
+            static const std::vector<JsonValue> empty;
+            const JsonValue* member = root.find(key);
+            return member == nullptr ? empty : member->asArray();
+        };
+        auto getUint = [](const JsonValue& value, std::string_view key, uint32_t fallback){
+            return static_cast<uint32_t>(value.getNumber(key, fallback));
+        };
+
+        // Missing members keep the defaults of the records
+        for(auto& value : getArray("samplers")){
+            SamplerRecord sampler{};
+            sampler.magFilter = getUint(value, "magFilter", sampler.magFilter);
+            sampler.minFilter = getUint(value, "minFilter", sampler.minFilter);
+            sampler.addressModeU = getUint(value, "addressModeU", sampler.addressModeU);
+            sampler.addressModeV = getUint(value, "addressModeV", sampler.addressModeV);
+            sampler.addressModeW = getUint(value, "addressModeW", sampler.addressModeW);
+            sampler.anisotropyEnable = getUint(value, "anisotropyEnable", sampler.anisotropyEnable);
+            sampler.maxAnisotropy = static_cast<float>(value.getNumber("maxAnisotropy", sampler.maxAnisotropy));
+            sampler.borderColor = getUint(value, "borderColor", sampler.borderColor);
+            sampler.unnormalizeCoordinates = getUint(value, "unnormalizeCoordinates", sampler.unnormalizeCoordinates);
+            sampler.compareEnable = getUint(value, "compareEnable", sampler.compareEnable);
+            sampler.compareOp = getUint(value, "compareOp", sampler.compareOp);
+            sampler.mipmapMode = getUint(value, "mipmapMode", sampler.mipmapMode);
+            sampler.mipLodBias = static_cast<float>(value.getNumber("mipLodBias", sampler.mipLodBias));
+            sampler.minLod = static_cast<float>(value.getNumber("minLod", sampler.minLod));
+            sampler.maxLod = static_cast<float>(value.getNumber("maxLod", sampler.maxLod));
+            contents.samplers.push_back(sampler);
+        }
+        for(auto& value : getArray("textures")){
+            TextureRecord texture{};
+            texture.path = contents.addString(value.find("path") == nullptr ? "" : value.find("path")->asString());
+            texture.sampler = getIndex(value, "sampler", 0);
+            contents.textures.push_back(texture);
+        }
+        for(auto& value : getArray("models")){
+            ModelRecord model{};
+            model.path = contents.addString(value.find("path") == nullptr ? "" : value.find("path")->asString());
+            contents.models.push_back(model);
+        }
+        for(auto& value : getArray("materials")){
+            MaterialRecord material{};
+            material.opacity = static_cast<float>(value.getNumber("opacity", material.opacity));
+            material.shininess = static_cast<float>(value.getNumber("shininess", material.shininess));
+            value.getFloats("diffuseColour", material.diffuseColour, 4);
+            value.getFloats("specularColour", material.specularColour, 4);
+            value.getFloats("hue", material.hue, 4);
+            std::tie(material.firstDiffuseTexture, material.diffuseTextureCount) = getIndexList(value, "diffuseTextures", contents.textureReferences);
+            std::tie(material.firstNormalTexture, material.normalTextureCount) = getIndexList(value, "normalTextures", contents.textureReferences);
+            contents.materials.push_back(material);
+        }
+        for(auto& value : getArray("meshes")){
+            MeshRecord mesh{};
+            mesh.model = getIndex(value, "model", NONE);
+            mesh.material = getIndex(value, "material", NONE);
+            mesh.emitLight = value.getBool("emitLight", false) ? 1 : 0;
+            mesh.brightness = static_cast<float>(value.getNumber("brightness", mesh.brightness));
+            mesh.width = static_cast<float>(value.getNumber("width", mesh.width));
+            value.getFloats("lightDirection", mesh.lightDirection, 3);
+            value.getFloats("lightHue", mesh.lightHue, 4);
+            contents.meshes.push_back(mesh);
+        }
+        auto& objectValues = getArray("objects");
+        contents.objects.reserve(objectValues.size());
+        for(auto& value : objectValues){
+            ObjectRecord object{};
+            value.getFloats("translation", object.translation, 3);
+            value.getFloats("rotation", object.rotation, 3);
+            value.getFloats("scale", object.scale, 3);
+            std::vector<uint32_t> meshIndices;
+            getIndexList(value, "meshes", meshIndices);
+            if(meshIndices.size() > Object::MAX_MESHES)
+                throw std::runtime_error("Scene object has more than Object::MAX_MESHES meshes.");
+            object.meshCount = static_cast<uint32_t>(meshIndices.size());
+            std::copy(meshIndices.begin(), meshIndices.end(), object.meshes);
+            contents.objects.push_back(object);
+        }
+        useContents();
+    }
+}
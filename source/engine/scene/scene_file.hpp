@@ -0,0 +1,147 @@
+#pragma once
+
+#include "engine/object/object.hpp"
+#include "engine/io/mapped_file.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+
+namespace Renderer{
+    // Versioned binary scene (.rscn), read straight from a memory mapping. Layout: Header, then one flat array per section
+    // (each aligned to SECTION_ALIGNMENT) in the order of Section. Records only hold 32-bit fields and refer to each other
+    // by index into their section, paths are ranges of the string section. Files with a .json extension hold the same
+    // records as JSON instead (see writeJson()), for tooling.
+    class SceneFile{
+        public:
+            static constexpr uint32_t VERSION = 1;
+            static constexpr uint64_t SECTION_ALIGNMENT = 16;
+            static constexpr uint32_t NONE = ~0u;       // Unset index
+
+            enum Section{ STRINGS, SAMPLERS, TEXTURES, MODELS, MATERIALS, TEXTURE_REFERENCES, MESHES, OBJECTS, SECTION_COUNT };
+
+            struct Header{
+                char magic[4] = {'R', 'S', 'C', 'N'};
+                uint32_t version = VERSION;
+                uint64_t sectionOffsets[SECTION_COUNT] = {};
+                uint32_t sectionCounts[SECTION_COUNT] = {};     // Elements, bytes for STRINGS
+                uint64_t dataHash = 0;      // Everything after the header, catches truncated or corrupted files
+            };
+
+            struct StringRange{
+                uint32_t offset = 0;
+                uint32_t length = 0;
+            };
+
+            // Sampler::SamplerConfig with its enums as 32-bit values
+            struct SamplerRecord{
+                uint32_t magFilter = 0, minFilter = 0;
+                uint32_t addressModeU = 0, addressModeV = 0, addressModeW = 0;
+                uint32_t anisotropyEnable = 0;
+                float maxAnisotropy = 0.f;
+                uint32_t borderColor = 0;
+                uint32_t unnormalizeCoordinates = 0;
+                uint32_t compareEnable = 0;
+                uint32_t compareOp = 0;
+                uint32_t mipmapMode = 0;
+                float mipLodBias = 0.f, minLod = 0.f, maxLod = 0.f;
+            };
+
+            struct TextureRecord{
+                StringRange path{};
+                uint32_t sampler = 0;       // Index into SAMPLERS
+            };
+
+            struct ModelRecord{
+                StringRange path{};
+            };
+
+            // Texture lists are ranges of TEXTURE_REFERENCES, which holds indices into TEXTURES
+            struct MaterialRecord{
+                float opacity = 1.f;
+                float shininess = 0.f;
+                float diffuseColour[4] = {1.f, 1.f, 1.f, 1.f};
+                float specularColour[4] = {1.f, 1.f, 1.f, 1.f};
+                float hue[4] = {1.f, 1.f, 1.f, 1.f};
+                uint32_t firstDiffuseTexture = 0, diffuseTextureCount = 0;
+                uint32_t firstNormalTexture = 0, normalTextureCount = 0;
+            };
+
+            struct MeshRecord{
+                uint32_t model = NONE;      // Index into MODELS
+                uint32_t material = NONE;   // Index into MATERIALS
+                uint32_t emitLight = 0;
+                float brightness = 0.f;
+                float width = 0.f;
+                float lightDirection[3] = {};
+                float lightHue[4] = {1.f, 1.f, 1.f, 1.f};
+            };
+
+            struct ObjectRecord{
+                float translation[3] = {};
+                float rotation[3] = {};
+                float scale[3] = {1.f, 1.f, 1.f};
+                uint32_t meshCount = 0;
+                uint32_t meshes[Object::MAX_MESHES] = {};    // Indices into MESHES
+            };
+
+            // Owned records, what Scene::save() fills in and what JSON is parsed into
+            struct Contents{
+                std::string strings;
+                std::vector<SamplerRecord> samplers;
+                std::vector<TextureRecord> textures;
+                std::vector<ModelRecord> models;
+                std::vector<MaterialRecord> materials;
+                std::vector<uint32_t> textureReferences;
+                std::vector<MeshRecord> meshes;
+                std::vector<ObjectRecord> objects;
+
+                StringRange addString(std::string_view s);
+            };
+
+            // Maps a binary file or parses a JSON one. Throws if it can't be read or holds out of range references, so the
+            // records of an open file can be used without further checks.
+            explicit SceneFile(const std::string& filepath);
+            explicit SceneFile(Contents contents);
+
+            SceneFile(const SceneFile&) = delete;
+            SceneFile& operator=(const SceneFile&) = delete;
+
+            std::string_view getString(StringRange range) const { return strings.substr(range.offset, range.length); }
+            std::span<const SamplerRecord> getSamplers() const { return samplers; }
+            std::span<const TextureRecord> getTextures() const { return textures; }
+            std::span<const ModelRecord> getModels() const { return models; }
+            std::span<const MaterialRecord> getMaterials() const { return materials; }
+            std::span<const uint32_t> getTextureReferences() const { return textureReferences; }
+            std::span<const MeshRecord> getMeshes() const { return meshes; }
+            std::span<const ObjectRecord> getObjects() const { return objects; }
+
+            // Writes binary or JSON depending on the extension, throws on failure
+            void write(const std::string& filepath) const;
+            void writeBinary(const std::string& filepath) const;
+            void writeJson(const std::string& filepath) const;
+
+            static bool isJsonPath(const std::string& filepath);
+
+        private:
+            void mapBinary(const std::string& filepath);
+            void parseJson(const std::string& filepath);
+            void useContents();
+            void validate() const;
+
+            std::unique_ptr<MappedFile> mapping;
+            Contents contents;      // Empty when mapped
+
+            std::string_view strings;
+            std::span<const SamplerRecord> samplers;
+            std::span<const TextureRecord> textures;
+            std::span<const ModelRecord> models;
+            std::span<const MaterialRecord> materials;
+            std::span<const uint32_t> textureReferences;
+            std::span<const MeshRecord> meshes;
+            std::span<const ObjectRecord> objects;
+    };
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cassert>
+
+namespace Renderer{
+    // Stable reference to an element of a SlotMap<T>. The generation makes handles of erased elements stale instead of
+    // silently pointing at whatever reuses the slot.
+    template<typename T>
+    struct Handle{
+        static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+        uint32_t index = INVALID_INDEX;     // Slot, stays the same for the lifetime of the element
+        uint32_t generation = 0;
+
+        bool isValid() const { return index != INVALID_INDEX; }
+        bool operator==(const Handle& other) const = default;
+    };
+
+    // Elements are kept packed in one contiguous array (in no particular order) so systems can scan them linearly,
+    // handles go through a slot table holding each element's position in that array. Erasing moves the last element
+    // into the gap, so pointers and dense indices are only valid until the next insert or erase.
+    template<typename T>
+    class SlotMap{
+        public:
+            using HandleType = Handle<T>;
+
+            HandleType insert(T value){
+                uint32_t slotIndex;
+                if(freeHead != HandleType::INVALID_INDEX){
+                    slotIndex = freeHead;
+                    freeHead = slots[slotIndex].denseIndex;
+                }
+                else{
+                    slotIndex = static_cast<uint32_t>(slots.size());
+                    slots.push_back({});
+                }
+                slots[slotIndex].denseIndex = static_cast<uint32_t>(dense.size());
+                dense.push_back(std::move(value));
+                denseHandles.push_back({slotIndex, slots[slotIndex].generation});
+                return denseHandles.back();
+            }
+
+            void erase(HandleType handle){
+                assert(contains(handle) && "Cannot erase an element that doesn't exist.");
+                Slot& slot = slots[handle.index];
+                uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+                if(slot.denseIndex != last){
+                    dense[slot.denseIndex] = std::move(dense[last]);
+                    denseHandles[slot.denseIndex] = denseHandles[last];
+                    slots[denseHandles[last].index].denseIndex = slot.denseIndex;
+                }
+                dense.pop_back();
+                denseHandles.pop_back();
+
+                slot.generation++;
+                slot.denseIndex = freeHead;
+                freeHead = handle.index;
+            }
+
+            // Makes room for count more elements, inserting them then doesn't allocate
+            void reserve(size_t count){
+                dense.reserve(dense.size() + count);
+                denseHandles.reserve(denseHandles.size() + count);
+                slots.reserve(slots.size() + count);
+            }
+
+            void clear(){
+                while(!denseHandles.empty())
+                    erase(denseHandles.back());
+            }
+
+            bool contains(HandleType handle) const {
+                return handle.index < slots.size() && slots[handle.index].generation == handle.generation 
+                    && slots[handle.index].denseIndex < dense.size() && denseHandles[slots[handle.index].denseIndex] == handle;
+            }
+
+            // Handle of the element currently in a slot (e.g. a handle index stored elsewhere), invalid if the slot is free
+            HandleType handleAt(uint32_t slotIndex) const {
+                if(slotIndex >= slots.size())
+                    return {};
+                uint32_t denseIndex = slots[slotIndex].denseIndex;
+                if(denseIndex >= dense.size() || denseHandles[denseIndex].index != slotIndex)
+                    return {};
+                return denseHandles[denseIndex];
+            }
+
+            // Returns nullptr for stale handles
+            T* find(HandleType handle) { return contains(handle) ? &dense[slots[handle.index].denseIndex] : nullptr; }
+
+            T& operator[](HandleType handle){
+                assert(contains(handle) && "No element with given handle exists.");
+                return dense[slots[handle.index].denseIndex];
+            }
+
+            size_t size() const { return dense.size(); }
+            bool empty() const { return dense.empty(); }
+            // Upper bound of handle indices, for tables indexed by slot
+            size_t slotCount() const { return slots.size(); }
+
+            // Packed elements and their handles, element i belongs to handles()[i]
+            std::span<T> values() { return dense; }
+            std::span<const HandleType> handles() const { return denseHandles; }
+
+            auto begin() { return dense.begin(); }
+            auto end() { return dense.end(); }
+
+        private:
+            struct Slot{
+                uint32_t denseIndex = 0;    // Next free slot while the slot is unused
+                uint32_t generation = 0;
+            };
+
+            std::vector<T> dense;
+            std::vector<HandleType> denseHandles;
+            std::vector<Slot> slots;
+            uint32_t freeHead = HandleType::INVALID_INDEX;
+    };
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <limits>
 #include <array>
+#include <cassert>
 
 namespace Renderer{
 
@@ -12,7 +13,7 @@ namespace Renderer{
     }
 
     SwapChain::SwapChain(Device& device, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-    : device{ device }, windowExtent{ windowExtent }, oldSwapChain{ previous } {
+    : device{ device }, windowExtent{ extent }, oldSwapChain{ previous } {
         initSwapChain();
         oldSwapChain = nullptr;
     }
@@ -27,16 +28,21 @@ namespace Renderer{
             swapChain = nullptr;
         }
 
+        for (int i = 0; i < offscreenImageAllocations.size(); i++) {
+            vkDestroyImage(device.getDevice(), swapChainImages[i], nullptr);
+            device.getAllocator().free(offscreenImageAllocations[i]);
+        }
+
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.getDevice(), colourImageViews[i], nullptr);
             vkDestroyImage(device.getDevice(), colourImages[i], nullptr);
-            vkFreeMemory(device.getDevice(), colourImageMemories[i], nullptr);
+            device.getAllocator().free(colourImageAllocations[i]);
         }
 
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.getDevice(), depthImageViews[i], nullptr);
             vkDestroyImage(device.getDevice(), depthImages[i], nullptr);
-            vkFreeMemory(device.getDevice(), depthImageMemories[i], nullptr);
+            device.getAllocator().free(depthImageAllocations[i]);
         }
 
         for(auto frameBuffer : swapChainFramebuffers)
@@ -62,6 +68,11 @@ namespace Renderer{
     }
 
     void SwapChain::createSwapChain(){
+        if(device.isHeadless()){
+            createOffscreenImages();
+            return;
+        }
+
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
         VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(swapChainSupport.formats);
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, VK_PRESENT_MODE_FIFO_KHR);
@@ -107,6 +118,33 @@ namespace Renderer{
         swapChainExtent = extent;
     }
 
+    void SwapChain::createOffscreenImages(){
+        // One image per frame in flight, so the image index always matches the current frame
+        swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        swapChainExtent = windowExtent;
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (int i = 0; i < swapChainImages.size(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = swapChainExtent.width;
+            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.flags = 0;
+            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImageAllocations[i]);
+        }
+    }
+
     void SwapChain::createImageViews() {
         VkExtent2D swapChainExtent = swapChainExtent;
         swapChainImageViews.resize(swapChainImages.size());
@@ -120,7 +158,7 @@ namespace Renderer{
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
         colourImages.resize(getImageCount());
-        colourImageMemories.resize(getImageCount());
+        colourImageAllocations.resize(getImageCount());
         colourImageViews.resize(getImageCount());
 
         for (int i = 0; i < colourImages.size(); i++) {
@@ -139,7 +177,7 @@ namespace Renderer{
             imageInfo.samples = device.getMaxUsableSampleCount();
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
-            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colourImages[i], colourImageMemories[i]);
+            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colourImages[i], colourImageAllocations[i]);
             colourImageViews[i] = createImageView(colourImages[i], swapChainColourFormat, 1, VK_IMAGE_ASPECT_COLOR_BIT); // Does not need mipmaps as we're not using this as a texture (leave at 1)
         }
     }
@@ -149,7 +187,7 @@ namespace Renderer{
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
         depthImages.resize(getImageCount());
-        depthImageMemories.resize(getImageCount());
+        depthImageAllocations.resize(getImageCount());
         depthImageViews.resize(getImageCount());
 
         for (int i = 0; i < depthImages.size(); i++) {
@@ -164,11 +202,11 @@ namespace Renderer{
             imageInfo.format = swapChainDepthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;     // Sampled by the next frame's depth pyramid build
             imageInfo.samples = device.getMaxUsableSampleCount();
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
-            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i], depthImageMemories[i]);
+            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i], depthImageAllocations[i]);
             depthImageViews[i] = createImageView(depthImages[i], swapChainDepthFormat, 1, VK_IMAGE_ASPECT_DEPTH_BIT); // Does not need mipmaps as we're not using this as a texture (leave at 1)
         }
     }
@@ -196,7 +234,7 @@ namespace Renderer{
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
         VkAttachmentReference depthAttachmentRef{};
         depthAttachmentRef.attachment = 1;
@@ -210,7 +248,8 @@ namespace Renderer{
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // Headless frames are read back instead of presented
+        colorAttachmentResolve.finalLayout = device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentResolveRef = {};
         colorAttachmentResolveRef.attachment = 2;
@@ -223,13 +262,21 @@ namespace Renderer{
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
         subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-        VkSubpassDependency dependency = {};
-        dependency.dstSubpass = 0;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        // Compute is included as the depth pyramid build of an earlier frame may still be reading the depth attachment
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        // Depth writes are made visible to the depth pyramid build of the next frame
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
         std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
         VkRenderPassCreateInfo renderPassInfo = {};
@@ -238,8 +285,8 @@ namespace Renderer{
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(device.getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
             throw std::runtime_error("Failed to create render pass.");
@@ -288,6 +335,11 @@ namespace Renderer{
     VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
         vkWaitForFences(device.getDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
 
+        if(device.isHeadless()){
+            *imageIndex = static_cast<uint32_t>(currentFrame);
+            return VK_SUCCESS;
+        }
+
         VkResult result = vkAcquireNextImageKHR(device.getDevice(), swapChain, std::numeric_limits<uint64_t>::max(), 
         imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, imageIndex);
 
@@ -304,20 +356,25 @@ namespace Renderer{
 
         VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
         VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = device.isHeadless() ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = device.isHeadless() ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(device.getDevice(), 1, &inFlightFences[currentFrame]);
         if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
             throw std::runtime_error("Failed to submit draw command buffer.");
 
+        if(device.isHeadless()){
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return VK_SUCCESS;
+        }
+
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
@@ -334,6 +391,46 @@ namespace Renderer{
         return result;
     }
 
+    void SwapChain::readImage(uint32_t imageIndex, std::vector<uint8_t>& pixels){
+        assert(device.isHeadless() && "Can only read back images from a headless swap chain.");
+        VkDeviceSize imageSize = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+
+        if(readbackBuffer == nullptr){
+            readbackBuffer = std::make_unique<Buffer>(
+                device,
+                1,
+                imageSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            readbackBuffer->map();
+        }
+
+        // Wait for the frame that rendered into this image to finish
+        if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+            vkWaitForFences(device.getDevice(), 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer->getBuffer(), 1, &region);
+
+        device.endSingleTimeCommands(commandBuffer);
+
+        pixels.resize(imageSize);
+        readbackBuffer->readFromBuffer(pixels.data(), imageSize);
+    }
+
     VkImageView SwapChain::createImageView(VkImage image, VkFormat format, uint32_t mipLevels, VkImageAspectFlagBits imageAspect) {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "engine/device/device.hpp"
+#include "engine/buffer/buffer.hpp"
+
 #include <memory>
 
 namespace Renderer{
@@ -18,6 +20,7 @@ namespace Renderer{
             size_t getImageCount() { return swapChainImages.size(); }
             VkRenderPass getRenderPass() { return renderPass; }
             VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+            VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
             float extentAspectRatio() { return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height); }
 
             // Other functions
@@ -25,12 +28,14 @@ namespace Renderer{
                 swapChain.swapChainImageFormat == swapChainImageFormat; }
             VkResult acquireNextImage(uint32_t* imageIndex);
             VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+            void readImage(uint32_t imageIndex, std::vector<uint8_t>& pixels); // Copies a rendered image to host memory (headless only)
 
         private:
             // Calls all main functions
             void initSwapChain();
             // Main Functions
             void createSwapChain();
+            void createOffscreenImages();
             void createImageViews();
             void createColourResources();
             void createDepthResources();
@@ -48,23 +53,27 @@ namespace Renderer{
             Device& device;
             VkExtent2D windowExtent;
 
-            VkSwapchainKHR swapChain;
+            VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 
             std::shared_ptr<SwapChain> oldSwapChain;
 
             std::vector<VkFramebuffer> swapChainFramebuffers;
 
             std::vector<VkImage> colourImages;
-            std::vector<VkDeviceMemory> colourImageMemories;
+            std::vector<Allocation> colourImageAllocations;
             std::vector<VkImageView> colourImageViews;
 
             std::vector<VkImage> depthImages;
-            std::vector<VkDeviceMemory> depthImageMemories;
+            std::vector<Allocation> depthImageAllocations;
             std::vector<VkImageView> depthImageViews;
 
             std::vector<VkImage> swapChainImages;
             std::vector<VkImageView> swapChainImageViews;
 
+            // When headless the "swap chain" images are owned by us rather than the presentation engine
+            std::vector<Allocation> offscreenImageAllocations;
+            std::unique_ptr<Buffer> readbackBuffer;
+
             VkFormat swapChainImageFormat;
             VkFormat swapChainDepthFormat;
             VkExtent2D swapChainExtent;
@@ -34,8 +34,8 @@ namespace Renderer{
 
         pipeline = std::make_unique<GraphicsPipeline>(
             device,
-            "C:/Programming/C++_Projects/renderer/source/shaders/material.vert",
-            "C:/Programming/C++_Projects/renderer/source/shaders/material.frag",
+            "material.vert",
+            "material.frag",
             configInfo
         );
     }
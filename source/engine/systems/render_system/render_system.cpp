@@ -1,5 +1,10 @@
 #include "render_system.hpp"
 
+#include "engine/upload/upload_manager.hpp"
+#include "engine/culling/frustum.hpp"
+#include "engine/profiling/gpu_profiler.hpp"
+#include "engine/pipeline/shader_library.hpp"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -8,18 +13,31 @@
 #include <stdexcept>
 #include <cassert>
 #include <algorithm>
+#include <limits>
 
 namespace Renderer{
+    static_assert(sizeof(RenderSystem::InstanceData) == 160, "InstanceData must match the std430 layout in the shaders.");
+    static_assert(offsetof(RenderSystem::UniformData, frustumPlanes) == 192, "UniformData must match the std140 layout in the shaders.");
+    static_assert(sizeof(RenderSystem::MaterialData) == 80, "MaterialData must match the std430 layout in main.frag.");
+    static_assert(sizeof(RenderSystem::TransformData) == 48, "TransformData must match the std430 layout in transform.comp.");
+    static_assert(SwapChain::MAX_FRAMES_IN_FLIGHT <= 8, "Pending instance updates keep one bit per frame in a uint8_t.");
+
     RenderSystem::RenderSystem(Device& device, VkRenderPass renderPass) 
     : device{device}, renderPass{renderPass}{}
 
     RenderSystem::~RenderSystem(){
         vkDestroyDescriptorSetLayout(device.getDevice(), globalSetLayout->getLayout(), nullptr);
+        vkDestroyDescriptorSetLayout(device.getDevice(), cullSetLayout->getLayout(), nullptr);
         vkDestroyPipelineLayout(device.getDevice(), pipelineLayout, nullptr);
+        vkDestroyPipelineLayout(device.getDevice(), cullPipelineLayout, nullptr);
+        if(GPU_INSTANCE_TRANSFORMS){
+            vkDestroyDescriptorSetLayout(device.getDevice(), transformSetLayout->getLayout(), nullptr);
+            vkDestroyPipelineLayout(device.getDevice(), transformPipelineLayout, nullptr);
+        }
     }
 
-    void RenderSystem::initializeRenderSystem(){
-        setupScene();
+    void RenderSystem::initializeRenderSystem(const SceneSetup& sceneSetup){
+        setupScene(sceneSetup);
         setupDescriptorSets();
 
         createGraphicsPipelineLayout();
@@ -27,13 +45,55 @@ namespace Renderer{
 
         createComputePipelineLayout();
         createComputePipeline();
+        createTransformPipeline();
 
         createIndirectCommands();
+        createMaterialBuffer();
         setupInstanceData();
+        writeDescriptorSets();
+
+        // Everything above only recorded uploads, submit them together
+        device.getUploadManager().flush();
     }
 
-    void RenderSystem::setupScene(){
-        // All of the below is temporary scene setup for testing, these actions should rather be done in a menu by the user.
+    void RenderSystem::updateAssets(){
+        PROFILE_SCOPE("Update assets");
+        bool assetsChanged = assetLoader.update();
+        if(!assetsChanged && !scene.structureChanged)
+            return;
+        rebuildDrawData();
+    }
+
+    void RenderSystem::finishLoading(){
+        assetLoader.finishAll();
+        rebuildDrawData();
+    }
+
+    void RenderSystem::reloadShaders(){
+        std::vector<std::string> changedShaders = device.getShaderLibrary().pollChanges();
+        if(changedShaders.empty())
+            return;
+        // The old pipelines may still be used by frames in flight
+        vkDeviceWaitIdle(device.getDevice());
+        if(transformPipeline && transformPipeline->usesShader(changedShaders))
+            transformPipeline->rebuild();
+        cullPipelines.reloadShaders(changedShaders);
+        renderPipelines.reloadShaders(changedShaders);
+        if(depthPyramid)
+            depthPyramid->reloadShaders(changedShaders);
+    }
+
+    void RenderSystem::rebuildDrawData(){
+        // New models and objects change the draw commands, the buffers being replaced may still be read by frames in flight
+        vkDeviceWaitIdle(device.getDevice());
+        createIndirectCommands();
+        createMaterialBuffer();
+        setupInstanceData();
+        writeDescriptorSets();
+        device.getUploadManager().submit();
+    }
+
+    void RenderSystem::setupScene(const SceneSetup& sceneSetup){
         // Diffuse texture sampler
         Sampler::SamplerConfig textureSamplerConfig{};
         textureSamplerConfig.anisotropyEnable = VK_TRUE;
@@ -41,39 +101,48 @@ namespace Renderer{
         textureSamplerConfig.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         textureSamplerConfig.maxLod = 100.f;
         scene.createSampler(device, textureSamplerConfig);
+        scene.createGeometryPool(device);
+
+        if(sceneSetup)
+            sceneSetup(scene, assetLoader);
+        else
+            setupDefaultScene();
+    }
 
+    void RenderSystem::setupDefaultScene(){
+        // All of the below is temporary scene setup for testing, these actions should rather be done in a menu by the user.
         // Load assets
-        scene.loadTexturesWithSampler(device, 0);
-        scene.loadModels(device);
+        scene.loadTexturesWithSampler(assetLoader, 0);
+        scene.loadModels(assetLoader);
 
         // spongebob material
-        scene.createMaterial();
-        scene.materials.end()->second.diffuseTextureIds.push_back(0);
+        auto spongebobMaterial = scene.createMaterial();
+        scene.materials[spongebobMaterial].diffuseTextureIds.push_back(0);
 
         // spongebob mesh
-        scene.createMesh();
-        scene.meshes.end()->second.modelId = 0; // spongebob model
-        scene.meshes.end()->second.materialId = 0; // spongebob material
+        auto spongebobMesh = scene.createMesh();
+        scene.meshes[spongebobMesh].modelId = 0; // spongebob model
+        scene.meshes[spongebobMesh].material = spongebobMaterial;
 
         // spongebob object
-        scene.createObject();
-        scene.objects.end()->second.transform.translation = {1.5f, .5f, 0.f};
-        scene.objects.end()->second.transform.rotation = {glm::radians(180.f), 0.f, 0.f};
-        scene.objects.end()->second.meshIds.push_back(0);
+        auto spongebob = scene.createObject();
+        scene.objects[spongebob].transform.translation = {1.5f, .5f, 0.f};
+        scene.objects[spongebob].transform.rotation = {glm::radians(180.f), 0.f, 0.f};
+        scene.objects[spongebob].addMesh(spongebobMesh);
 
         // sample material
-        scene.createMaterial();
-        scene.materials.end()->second.diffuseTextureIds.push_back(1);
+        auto sampleMaterial = scene.createMaterial();
+        scene.materials[sampleMaterial].diffuseTextureIds.push_back(1);
 
         // sample mesh
-        scene.createMesh();
-        scene.meshes.end()->second.modelId = 1;
-        scene.meshes.end()->second.materialId = 1;
+        auto sampleMesh = scene.createMesh();
+        scene.meshes[sampleMesh].modelId = 1;
+        scene.meshes[sampleMesh].material = sampleMaterial;
 
         // sample object
-        scene.createObject();
-        scene.objects.end()->second.transform.translation = {-.5f, .5f, 0.f};
-        scene.objects.end()->second.transform.scale = {4.f, 4.f, 4.f};
+        auto sampleObject = scene.createObject();
+        scene.objects[sampleObject].transform.translation = {-.5f, .5f, 0.f};
+        scene.objects[sampleObject].transform.scale = {4.f, 4.f, 4.f};
     }
 
     void RenderSystem::setupDescriptorSets(){
@@ -87,24 +156,125 @@ namespace Renderer{
         // Pool Setup
         globalPool = std::make_unique<DescriptorPool>(device);
         globalPool->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT);        // Uniform data
-        globalPool->buildPool(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        globalPool->addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * SwapChain::MAX_FRAMES_IN_FLIGHT);    // Instance, material data and mip requests
+        globalPool->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURES * SwapChain::MAX_FRAMES_IN_FLIGHT);   // Textures
+        globalPool->buildPool(SwapChain::MAX_FRAMES_IN_FLIGHT, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
         // Layout Setup
         globalSetLayout = std::make_unique<DescriptorSetLayout>(device);
         // Bindings are set in order of when they are added
         globalSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS);    // binding 0 (Uniform data)
+        globalSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);      // binding 1 (Instance data)
+        globalSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);    // binding 2 (Material data)
+        // binding 3 (Textures), only the elements of existing textures are written and shaders only read those
+        globalSetLayout->addBinding(MAX_TEXTURES, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, 
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+        globalSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);    // binding 4 (Mip requests)
         globalSetLayout->buildLayout();
+        boundTextures.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, {});
+
+        // Texture streaming feedback, read back on the host once the frame has completed
+        mipRequests.assign(MAX_TEXTURES, TextureStreamer::NO_REQUEST);
+        mipRequestBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (int i = 0; i < mipRequestBuffers.size(); i++) {
+            mipRequestBuffers[i] = std::make_unique<Buffer>(device, MAX_TEXTURES, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            mipRequestBuffers[i]->map();
+            mipRequestBuffers[i]->writeToBuffer(mipRequests.data());
+        }
+
+        // Culling statistics, read back on the host once the frame has completed
+        cullStatsBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (int i = 0; i < cullStatsBuffers.size(); i++) {
+            cullStatsBuffers[i] = std::make_unique<Buffer>(device, 1, sizeof(CullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_SHARING_MODE_EXCLUSIVE, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            cullStatsBuffers[i]->map();
+            CullStats emptyStats{};
+            cullStatsBuffers[i]->writeToBuffer(&emptyStats);
+        }
+
+        // Culling sets, the draw commands are only bound here
+        cullPool = std::make_unique<DescriptorPool>(device);
+        cullPool->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT);          // Uniform data
+        cullPool->addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * SwapChain::MAX_FRAMES_IN_FLIGHT);      // Instances, commands, visible commands, counts and stats
+        cullPool->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT);  // Depth pyramid
+        cullPool->buildPool(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        cullSetLayout = std::make_unique<DescriptorSetLayout>(device);
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 0 (Uniform data)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 1 (Instance data)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 2 (Draw commands)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 3 (Visible draw commands)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 4 (Draw counts)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);           // binding 5 (Cull stats)
+        cullSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);   // binding 6 (Depth pyramid)
+        cullSetLayout->buildLayout();
+
+        for(int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
+            globalPool->allocateSet(globalSetLayout->getLayout());
+            cullPool->allocateSet(cullSetLayout->getLayout());
+        }
+
+        if(!GPU_INSTANCE_TRANSFORMS)
+            return;
+        // Transform sets
+        transformPool = std::make_unique<DescriptorPool>(device);
+        transformPool->addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * SwapChain::MAX_FRAMES_IN_FLIGHT);     // Transforms, updated instances and instance data
+        transformPool->buildPool(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        transformSetLayout = std::make_unique<DescriptorSetLayout>(device);
+        transformSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);      // binding 0 (Transforms)
+        transformSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);      // binding 1 (Updated instances)
+        transformSetLayout->addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);      // binding 2 (Instance data)
+        transformSetLayout->buildLayout();
+        for(int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+            transformPool->allocateSet(transformSetLayout->getLayout());
+    }
+
+    void RenderSystem::writeDescriptorSets(){
+        // Instance and command buffers are recreated when the scene changes, nothing to point at while it's empty
+        if(instanceBuffers.empty())
+            return;
 
         for(int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
-            // Fill universal matrix buffer info
             VkDescriptorBufferInfo uniformDataInfo = uniformBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo instanceDataInfo = instanceBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo materialDataInfo = materialBuffer->descriptorInfo();
+            VkDescriptorBufferInfo drawCommandsInfo = indirectCommandsBuffer->descriptorInfo();
+            VkDescriptorBufferInfo visibleCommandsInfo = visibleCommandsBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo drawCountsInfo = drawCountBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo cullStatsInfo = cullStatsBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo mipRequestsInfo = mipRequestBuffers[i]->descriptorInfo();
 
-            // Writes list
             std::vector<VkWriteDescriptorSet> writes{
-                globalSetLayout->writeBuffer(0, &uniformDataInfo), 
+                globalSetLayout->writeBuffer(0, &uniformDataInfo),
+                globalSetLayout->writeBuffer(1, &instanceDataInfo),
+                globalSetLayout->writeBuffer(2, &materialDataInfo),
+                globalSetLayout->writeBuffer(4, &mipRequestsInfo),
             };
-
-            globalPool->allocateSet(globalSetLayout->getLayout());
             globalPool->updateSet(i, writes);
+
+            std::vector<VkWriteDescriptorSet> cullWrites{
+                cullSetLayout->writeBuffer(0, &uniformDataInfo),
+                cullSetLayout->writeBuffer(1, &instanceDataInfo),
+                cullSetLayout->writeBuffer(2, &drawCommandsInfo),
+                cullSetLayout->writeBuffer(3, &visibleCommandsInfo),
+                cullSetLayout->writeBuffer(4, &drawCountsInfo),
+                cullSetLayout->writeBuffer(5, &cullStatsInfo),
+            };
+            // The pyramid is created with the first culling pass, which writes it then
+            VkDescriptorImageInfo depthPyramidInfo{};
+            if(depthPyramid){
+                depthPyramidInfo = depthPyramid->descriptorInfo();
+                cullWrites.push_back(cullSetLayout->writeImage(6, &depthPyramidInfo));
+            }
+            cullPool->updateSet(i, cullWrites);
+
+            if(!GPU_INSTANCE_TRANSFORMS)
+                continue;
+            VkDescriptorBufferInfo transformsInfo = transformBuffers[i]->descriptorInfo();
+            VkDescriptorBufferInfo transformUpdatesInfo = transformUpdateBuffers[i]->descriptorInfo();
+            std::vector<VkWriteDescriptorSet> transformWrites{
+                transformSetLayout->writeBuffer(0, &transformsInfo),
+                transformSetLayout->writeBuffer(1, &transformUpdatesInfo),
+                transformSetLayout->writeBuffer(2, &instanceDataInfo),
+            };
+            transformPool->updateSet(i, transformWrites);
         }
     }
 
@@ -124,25 +294,53 @@ namespace Renderer{
     void RenderSystem::createGraphicsPipeline(){
         assert(pipelineLayout != nullptr && "Cannot create graphics pipeline before graphics pipeline layout.");
 
-        GraphicsPipelineConfigInfo configInfo = {};
-        GraphicsPipeline::defaultPipelineConfigInfo(configInfo);
-        configInfo.pipelineLayout = pipelineLayout;
-        configInfo.renderPass = renderPass;
-        renderPipeline = std::make_unique<GraphicsPipeline>(
-            device,
-            "C:/Programming/C++_Projects/renderer/source/spirv_shaders/main.vert.spv",
-            "C:/Programming/C++_Projects/renderer/source/spirv_shaders/main.frag.spv",
-            configInfo
-        );
+        renderPipelines = PipelineVariants<GraphicsPipeline>([this](const PipelineFeatures& features){
+            GraphicsPipelineConfigInfo configInfo = {};
+            GraphicsPipeline::defaultPipelineConfigInfo(configInfo);
+            configInfo.pipelineLayout = pipelineLayout;
+            configInfo.renderPass = renderPass;
+            configInfo.rasterizationSamples = features.samples;
+            return std::make_unique<GraphicsPipeline>(
+                device,
+                "main.vert",
+                "main.frag",
+                configInfo,
+                features.getSpecialization()
+            );
+        });
+        // Compiles alongside the compute pipelines instead of on the first frame
+        renderPipelines.prepare(getDrawFeatures());
+    }
+
+    PipelineFeatures RenderSystem::getDrawFeatures(){
+        PipelineFeatures features{};
+        features.textureCount = MAX_TEXTURES;
+        features.samples = device.getMaxUsableSampleCount();
+        features.lightingModel = lightingModel;
+        return features;
+    }
+
+    PipelineFeatures RenderSystem::getCullFeatures(bool occlusionCulling){
+        PipelineFeatures features{};
+        features.frustumCulling = enableFrustumCulling;
+        features.occlusionCulling = occlusionCulling;
+        return features;
     }
 
     void RenderSystem::createComputePipelineLayout(){
+        auto layout = cullSetLayout->getLayout();
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstants);
+
         VkPipelineLayoutCreateInfo layoutInfo = {};
         layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layoutInfo.setLayoutCount = 0;
-        layoutInfo.pSetLayouts = nullptr;
-        layoutInfo.pushConstantRangeCount = 0;
-        layoutInfo.pPushConstantRanges = nullptr;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &layout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
 
         if(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
             throw std::runtime_error("Failed to create compute pipeline layout.");
@@ -151,101 +349,552 @@ namespace Renderer{
     void RenderSystem::createComputePipeline(){
         assert(cullPipelineLayout != nullptr && "Cannot create compute pipeline before compute pipeline layout.");
 
-        cullPipeline = std::make_unique<ComputePipeline>(
+        cullPipelines = PipelineVariants<ComputePipeline>([this](const PipelineFeatures& features){
+            return std::make_unique<ComputePipeline>(
+                device,
+                "cull.comp",
+                cullPipelineLayout,
+                features.getSpecialization()
+            );
+        });
+        // The first frame has no depth to test against, later ones do
+        cullPipelines.prepare(getCullFeatures(false));
+        cullPipelines.prepare(getCullFeatures(DepthPyramid::supportsSampleCount(device.getMaxUsableSampleCount())));
+    }
+
+    void RenderSystem::createTransformPipeline(){
+        if(!GPU_INSTANCE_TRANSFORMS)
+            return;
+        auto layout = transformSetLayout->getLayout();
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(uint32_t);     // Updated instance count
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &layout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if(vkCreatePipelineLayout(device.getDevice(), &layoutInfo, nullptr, &transformPipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create transform pipeline layout.");
+
+        transformPipeline = std::make_unique<ComputePipeline>(
             device,
-            "C:/Programming/C++_Projects/renderer/source/shaders/cull.comp",
-            cullPipelineLayout
+            "transform.comp",
+            transformPipelineLayout
         );
     }
 
     void RenderSystem::createIndirectCommands(){
-        instanceCount = static_cast<uint32_t>(scene.objects.size());
-
-        // Where I left off, need to finish instanced rendering and indirect drawing + gpu-based culling
+        indirectCommands.clear();
+        instanceData.clear();
+        instanceTransforms.clear();
+        objectInstances.assign(scene.objects.slotCount(), {});
+        objectBounds.assign(scene.objects.slotCount(), {});
+        objectProxies.assign(scene.objects.slotCount(), Bvh::NULL_NODE);
+
+        // Matrices of all objects, built in one batch over the packed object array
+        auto objects = scene.objects.values();
+        auto objectHandles = scene.objects.handles();
+        transformBatch.resize(objects.size());
+        for(size_t i = 0; i < objects.size(); i++)
+            transformBatch.set(i, objects[i].transform);
+        objectMatrices.resize(objects.size());
+        if(!objects.empty())
+            transformBatch.computeMatrices(&objectMatrices[0].modelMatrix, &objectMatrices[0].normalMatrix, sizeof(ObjectMatrices));
+
+        // Every mesh of every object is an instance, its command points at the model's range of the geometry pool
         // TODO: sort through models that don't have indices and create commands for them and draw them seperately.
-        for(auto obj : scene.objects){
-            for(int i = 0; i < obj.second.meshIds.size(); i++){
-                VkDrawIndexedIndirectCommand newIndexedIndirectCommand;
-                newIndexedIndirectCommand.firstIndex = 0;
-                newIndexedIndirectCommand.instanceCount = instanceCount;
-                newIndexedIndirectCommand.firstInstance = i * instanceCount;
-                newIndexedIndirectCommand.indexCount = scene.models.at(scene.meshes.at(i).modelId)->getIndexCount();
+        for(size_t i = 0; i < objects.size(); i++){
+            auto& obj = objects[i];
+            uint32_t slot = objectHandles[i].index;
+            InstanceRange& instances = objectInstances[slot];
+            instances.first = static_cast<uint32_t>(indirectCommands.size());
+            for(auto meshHandle : obj.getMeshes()){
+                const Mesh* mesh = scene.meshes.find(meshHandle);
+                if(mesh == nullptr)
+                    continue;
+                // Models are streamed in, meshes whose model isn't loaded yet are skipped until it is
+                auto modelIt = scene.models.find(mesh->modelId);
+                if(modelIt == scene.models.end() || modelIt->second->getIndexCount() == 0)
+                    continue;
+                auto& model = modelIt->second;
+
+                // firstInstance doubles as the index into the instance buffer, culling only ever touches instanceCount
+                VkDrawIndexedIndirectCommand newIndexedIndirectCommand{};
+                newIndexedIndirectCommand.indexCount = model->getIndexCount();
+                newIndexedIndirectCommand.instanceCount = 1;
+                newIndexedIndirectCommand.firstIndex = model->getFirstIndex();
+                newIndexedIndirectCommand.vertexOffset = model->getVertexOffset();
+                newIndexedIndirectCommand.firstInstance = static_cast<uint32_t>(indirectCommands.size());
                 indirectCommands.push_back(newIndexedIndirectCommand);
+
+                const Bounds& bounds = model->getBounds();
+                InstanceData data{};
+                data.modelMatrix = objectMatrices[i].modelMatrix;
+                data.normalMatrix = objectMatrices[i].normalMatrix;
+                // Models without bounds are never culled
+                data.boundingSphere = bounds.isEmpty() ? glm::vec4{0.f, 0.f, 0.f, std::numeric_limits<float>::infinity()} : glm::vec4{bounds.getCenter(), bounds.getRadius()};
+                // Material slots are stable for the material's lifetime, the shaders index textures with them
+                data.materialId = mesh->material.index;
+                data.modelId = mesh->modelId;
+                instanceData.push_back(data);
+
+                auto& transform = obj.transform;
+                instanceTransforms.push_back({glm::vec4{transform.translation, 0.f}, glm::vec4{transform.rotation, 0.f}, glm::vec4{transform.scale, 0.f}});
+                instances.count++;
+                objectBounds[slot].expand(bounds);
             }
         }
 
-        objectCount = 0;
-        for(auto indCmd : indirectCommands)
-            objectCount += indCmd.indexCount;
+        // The object tree is rebuilt from the new bounds when it's next queried
+        objectTreeStale = true;
+        treeMovedObjects.clear();
+        // Everything is written from scratch, earlier changes are already included
+        scene.dirtyObjects.clear();
+        scene.structureChanged = false;
 
-        Buffer stagingBuffer{
+        instanceCount = static_cast<uint32_t>(indirectCommands.size());
+        uniformData.shapesToCull = instanceCount;
+
+        indirectCommandsBuffer.reset();
+        visibleCommandsBuffers.clear();
+        drawCountBuffers.clear();
+        if(indirectCommands.empty())
+            return;
+
+        indirectCommandsBuffer = std::make_unique<Buffer>(
             device,
             1,
             indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_CONCURRENT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+        device.getUploadManager().uploadToBuffer(indirectCommandsBuffer->getBuffer(), indirectCommands.data(), indirectCommandsBuffer->getSize());
+
+        // Written by the culling pass of each frame while other frames may still be drawing from theirs
+        visibleCommandsBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        drawCountBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for(int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
+            visibleCommandsBuffers[i] = std::make_unique<Buffer>(
+                device,
+                1,
+                indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+            drawCountBuffers[i] = std::make_unique<Buffer>(
+                device,
+                1,
+                getChunkCount() * sizeof(uint32_t),
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+        }
+    }
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer(indirectCommands.data());
+    void RenderSystem::createMaterialBuffer(){
+        // Indexed by slot, slots of destroyed materials are left at the defaults
+        std::vector<MaterialData> materials(std::max<size_t>(scene.materials.slotCount(), 1));
+        auto materialValues = scene.materials.values();
+        auto materialHandles = scene.materials.handles();
+        for(size_t i = 0; i < materialValues.size(); i++){
+            MaterialData& data = materials[materialHandles[i].index];
+            data.properties = materialValues[i].properties;
+            data.diffuseTextureId = getTextureSlot(materialValues[i].diffuseTextureIds);
+            data.normalTextureId = getTextureSlot(materialValues[i].normalTextureIds);
+        }
 
-        indirectCommandsBuffer = std::make_unique<Buffer>(
+        // Frames reading the old buffer were waited on by the caller
+        materialBuffer = std::make_unique<Buffer>(
             device,
             1,
-            stagingBuffer.getSize(),
-            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_SHARING_MODE_EXCLUSIVE,
+            materials.size() * sizeof(MaterialData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_CONCURRENT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
+        device.getUploadManager().uploadToBuffer(materialBuffer->getBuffer(), materials.data(), materialBuffer->getSize());
+    }
+
+    uint32_t RenderSystem::getTextureSlot(const std::vector<unsigned int>& textureIds){
+        // Only the first texture of each kind is sampled for now. Ids past the array are drawn untextured.
+        if(textureIds.empty() || textureIds[0] >= MAX_TEXTURES || !scene.textures.contains(textureIds[0]))
+            return NO_TEXTURE;
+        return textureIds[0];
+    }
+
+    void RenderSystem::updateTextures(uint32_t frameIndex){
+        // Only this frame's set is written, the fence waited on in beginFrame() covers its last use
+        auto& bound = boundTextures[frameIndex];
+
+        // Requests are relative to the levels of the textures the frame sampled, the streamer wants levels of the full chain.
+        // Slots still showing the loader's placeholder are skipped.
+        mipRequestBuffers[frameIndex]->readFromBuffer(mipRequests.data());
+        for(uint32_t slot = 0; slot < mipRequests.size(); slot++){
+            if(mipRequests[slot] == TextureStreamer::NO_REQUEST)
+                continue;
+            if(slot < bound.size() && bound[slot] && bound[slot]->getId() == slot)
+                mipRequests[slot] += bound[slot]->getFirstLevel();
+            else
+                mipRequests[slot] = TextureStreamer::NO_REQUEST;
+        }
+        assetLoader.getTextureStreamer().update(mipRequests, ++streamedFrames);
+        std::fill(mipRequests.begin(), mipRequests.end(), TextureStreamer::NO_REQUEST);
+        mipRequestBuffers[frameIndex]->writeToBuffer(mipRequests.data());
+        std::vector<uint32_t> slots;
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        imageInfos.reserve(scene.textures.size());
+        for(auto& [id, texture] : scene.textures){
+            if(id >= MAX_TEXTURES)
+                continue;
+            if(id >= bound.size())
+                bound.resize(id + 1);
+            // Loading textures are the loader's placeholder, the slot is written again once the real one replaces it
+            if(bound[id] == texture)
+                continue;
+            bound[id] = texture;
+
+            auto sampler = scene.samplers.find(texture->samplerId);
+            assert(sampler != scene.samplers.end() && "Texture refers to a sampler that doesn't exist.");
+            VkDescriptorImageInfo imageInfo = texture->descriptorImageInfo();
+            imageInfo.sampler = sampler->second->getSampler();
+            imageInfos.push_back(imageInfo);
+            slots.push_back(id);
+        }
+        if(slots.empty())
+            return;
 
-        stagingBuffer.copyBuffer(indirectCommandsBuffer->getBuffer(), indirectCommandsBuffer->getSize());
+        std::vector<VkWriteDescriptorSet> writes;
+        for(size_t i = 0; i < slots.size(); i++)
+            writes.push_back(globalSetLayout->writeImages(3, slots[i], 1, &imageInfos[i]));
+        globalPool->updateSet(frameIndex, writes);
     }
 
     void RenderSystem::setupInstanceData(){
-        instanceData.resize(objectCount);
-
-        // Info set once as for all objects as the default, this info can be updated in the updateScene() function.
-        /*for(uint32_t i = 0; i < objectCount; i++){
-            auto object = scene.objects.at(i);
-            instanceData[i].modelMatrix = object.transform.mat4();
-            instanceData[i].normalMatrix = object.transform.normalMatrix();
-            instanceData[i].translation = object.transform.translation;
-            instanceData[i].scale = object.transform.scale;
-            instanceData[i].rotation = object.transform.rotation;
-            instanceData[i].modelId = object.modelId;
-            instanceData[i].materialId = object.materialId;
-        }*/
-        // Two instance data buffers needed with duplicate data since we're double buffering
+        instanceBuffers.clear();
+        transformBuffers.clear();
+        transformUpdateBuffers.clear();
+        pendingInstanceUpdates.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, {});
+        pendingFrames.assign(instanceData.size(), 0);
+        transformUpdateCounts.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+        if(instanceData.empty())
+            return;
+
+        // One set of buffers per frame in flight, a frame's buffers are only written once its previous use has completed
+        VkDeviceSize instanceBytes = instanceData.size() * sizeof(InstanceData);
+        instanceBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
         for(int i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
-            Buffer stagingBuffer{
+            if(!GPU_INSTANCE_TRANSFORMS){
+                instanceBuffers[i] = std::make_unique<Buffer>(
+                    device,
+                    1,
+                    instanceBytes,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    VK_SHARING_MODE_EXCLUSIVE,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                );
+                instanceBuffers[i]->map();
+                instanceBuffers[i]->writeToBuffer(instanceData.data());
+                continue;
+            }
+
+            instanceBuffers[i] = std::make_unique<Buffer>(
+                device,
+                1,
+                instanceBytes,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_SHARING_MODE_CONCURRENT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            );
+            device.getUploadManager().uploadToBuffer(instanceBuffers[i]->getBuffer(), instanceData.data(), instanceBytes);
+
+            transformBuffers.push_back(std::make_unique<Buffer>(
                 device,
                 1,
-                instanceData.size() * sizeof(InstanceData),
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                instanceTransforms.size() * sizeof(TransformData),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                 VK_SHARING_MODE_EXCLUSIVE,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-            };
-
-            stagingBuffer.map();
-            stagingBuffer.writeToBuffer(instanceData.data());
+            ));
+            transformBuffers[i]->map();
+            transformBuffers[i]->writeToBuffer(instanceTransforms.data());
 
-            instanceBuffers[i] = std::make_unique<Buffer>(
+            transformUpdateBuffers.push_back(std::make_unique<Buffer>(
                 device,
                 1,
-                stagingBuffer.getSize(),
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                instanceData.size() * sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                 VK_SHARING_MODE_EXCLUSIVE,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-            );
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            ));
+            transformUpdateBuffers[i]->map();
+        }
+    }
 
-            stagingBuffer.copyBuffer(instanceBuffers[i]->getBuffer(), instanceBuffers[i]->getSize());
+    void RenderSystem::updateObjectTree(){
+        if(objectTreeStale){
+            // Rebuilt with the surface area heuristic, later movements are refit/reinserted
+            std::vector<Bvh::Item> items;
+            auto objects = scene.objects.values();
+            auto objectHandles = scene.objects.handles();
+            for(size_t i = 0; i < objects.size(); i++){
+                uint32_t slot = objectHandles[i].index;
+                if(slot < objectBounds.size() && !objectBounds[slot].isEmpty())
+                    items.push_back({objectBounds[slot].transformed(objects[i].transform.mat4()), slot});
+            }
+            std::vector<uint32_t> proxies;
+            objectTree.build(items, proxies);
+            objectProxies.assign(objectBounds.size(), Bvh::NULL_NODE);
+            for(size_t i = 0; i < items.size(); i++)
+                objectProxies[items[i].userData] = proxies[i];
+            objectTreeStale = false;
         }
+        else{
+            for(auto handle : treeMovedObjects){
+                Object* object = scene.objects.find(handle);
+                if(object != nullptr && objectProxies[handle.index] != Bvh::NULL_NODE)
+                    objectTree.update(objectProxies[handle.index], objectBounds[handle.index].transformed(object->transform.mat4()));
+            }
+        }
+        treeMovedObjects.clear();
     }
 
-    void RenderSystem::drawScene(VkCommandBuffer commandBuffer, uint32_t frameIndex){
-        renderPipeline->bind(commandBuffer);
-        vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandsBuffer->getBuffer(), 0, static_cast<uint32_t>(indirectCommands.size()), sizeof(VkDrawIndexedIndirectCommand));
+    Handle<Object> RenderSystem::raycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance){
+        updateObjectTree();
+        uint32_t slot = objectTree.raycast(origin, direction, maxDistance, hitDistance);
+        return slot == Bvh::NULL_NODE ? Handle<Object>{} : scene.objects.handleAt(slot);
+    }
+
+    void RenderSystem::queryObjects(const Frustum& frustum, std::vector<Handle<Object>>& results){
+        updateObjectTree();
+        std::vector<uint32_t> slots;
+        objectTree.queryFrustum(frustum, slots);
+        for(uint32_t slot : slots){
+            // Objects destroyed since the draw data was rebuilt are skipped
+            Handle<Object> handle = scene.objects.handleAt(slot);
+            if(handle.isValid())
+                results.push_back(handle);
+        }
+    }
+
+    void RenderSystem::markInstanceDirty(uint32_t instanceIndex){
+        uint8_t& frames = pendingFrames[instanceIndex];
+        for(uint32_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++){
+            if(!(frames & (1u << i)))
+                pendingInstanceUpdates[i].push_back(instanceIndex);
+        }
+        frames = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+    }
+
+    void RenderSystem::updateInstanceData(uint32_t frameIndex){
+        PROFILE_SCOPE("Update instances");
+        if(instanceBuffers.empty())
+            return;
+
+        movedObjects.clear();
+        transformBatch.clear();
+        for(auto handle : scene.dirtyObjects){
+            Object* object = scene.objects.find(handle);
+            if(object == nullptr || handle.index >= objectInstances.size() || objectInstances[handle.index].count == 0)
+                continue;
+            movedObjects.push_back(handle);
+            transformBatch.push_back(object->transform);
+        }
+
+        // Matrices of all moved objects are built in one batch, unless transform.comp builds them
+        if(!GPU_INSTANCE_TRANSFORMS && !movedObjects.empty()){
+            objectMatrices.resize(movedObjects.size());
+            transformBatch.computeMatrices(&objectMatrices[0].modelMatrix, &objectMatrices[0].normalMatrix, sizeof(ObjectMatrices));
+        }
+        for(size_t i = 0; i < movedObjects.size(); i++){
+            uint32_t slot = movedObjects[i].index;
+            if(!objectTreeStale && objectProxies[slot] != Bvh::NULL_NODE)
+                treeMovedObjects.push_back(movedObjects[i]);
+
+            const InstanceRange& instances = objectInstances[slot];
+            auto& transform = scene.objects[movedObjects[i]].transform;
+            TransformData packed{glm::vec4{transform.translation, 0.f}, glm::vec4{transform.rotation, 0.f}, glm::vec4{transform.scale, 0.f}};
+            for(uint32_t index = instances.first; index < instances.first + instances.count; index++){
+                if(GPU_INSTANCE_TRANSFORMS)
+                    instanceTransforms[index] = packed;
+                else{
+                    instanceData[index].modelMatrix = objectMatrices[i].modelMatrix;
+                    instanceData[index].normalMatrix = objectMatrices[i].normalMatrix;
+                }
+                markInstanceDirty(index);
+            }
+        }
+        scene.dirtyObjects.clear();
+        // Once more objects wait for a refit than there are objects, rebuilding the tree is cheaper
+        if(treeMovedObjects.size() > scene.objects.size()){
+            objectTreeStale = true;
+            treeMovedObjects.clear();
+        }
+
+        auto& pending = pendingInstanceUpdates[frameIndex];
+        transformUpdateCounts[frameIndex] = static_cast<uint32_t>(pending.size());
+        if(pending.empty())
+            return;
+
+        // Sorted so neighbouring instances are written as one range
+        std::sort(pending.begin(), pending.end());
+        for(size_t first = 0; first < pending.size();){
+            size_t last = first;
+            while(last + 1 < pending.size() && pending[last + 1] == pending[last] + 1)
+                last++;
+            uint32_t begin = pending[first];
+            uint32_t count = static_cast<uint32_t>(last - first + 1);
+            if(GPU_INSTANCE_TRANSFORMS)
+                transformBuffers[frameIndex]->writeToBuffer(&instanceTransforms[begin], count * sizeof(TransformData), begin * sizeof(TransformData));
+            else
+                instanceBuffers[frameIndex]->writeToBuffer(&instanceData[begin], count * sizeof(InstanceData), begin * sizeof(InstanceData));
+            first = last + 1;
+        }
+        if(GPU_INSTANCE_TRANSFORMS)
+            transformUpdateBuffers[frameIndex]->writeToBuffer(pending.data(), pending.size() * sizeof(uint32_t), 0);
+
+        for(auto index : pending)
+            pendingFrames[index] &= ~(1u << frameIndex);
+        pending.clear();
+    }
+
+    void RenderSystem::computeInstanceTransforms(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+        uint32_t updateCount = transformUpdateCounts[frameIndex];
+        if(!GPU_INSTANCE_TRANSFORMS || updateCount == 0)
+            return;
+        PROFILE_GPU_SCOPE(commandBuffer, "Instance transforms");
+
+        transformPipeline->bind(commandBuffer);
+        VkDescriptorSet transformSet = transformPool->getSets()[frameIndex];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, transformPipelineLayout, 0, 1, &transformSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, transformPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &updateCount);
+
+        constexpr uint32_t TRANSFORM_GROUP_SIZE = 64;  // local_size_x in transform.comp
+        vkCmdDispatch(commandBuffer, (updateCount + TRANSFORM_GROUP_SIZE - 1) / TRANSFORM_GROUP_SIZE, 1, 1);
+
+        // Culling and the vertex shader read the rebuilt matrices
+        VkMemoryBarrier transformBarrier{};
+        transformBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        transformBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        transformBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &transformBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void RenderSystem::cullScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView previousDepthView, VkExtent2D extent){
+        PROFILE_SCOPE("Record culling");
+        // The frame's fence was waited on in beginFrame(), so the last pass recorded for this frame index has completed
+        cullStatsBuffers[frameIndex]->readFromBuffer(&cullStats, sizeof(CullStats));
+
+        if(visibleCommandsBuffers.empty())
+            return;
+        PROFILE_GPU_SCOPE(commandBuffer, "Culling");
+        computeInstanceTransforms(commandBuffer, frameIndex);
+
+        VkSampleCountFlagBits depthSamples = device.getMaxUsableSampleCount();
+        if(!depthPyramid || depthPyramid->getExtent().width != extent.width || depthPyramid->getExtent().height != extent.height){
+            // Frames in flight may be culling against the pyramid being replaced
+            vkDeviceWaitIdle(device.getDevice());
+            depthPyramid = std::make_unique<DepthPyramid>(device, extent, depthSamples);
+            writeDescriptorSets();
+        }
+
+        CullPushConstants push{};
+        push.previousViewProjection = previousViewProjection;
+        push.pyramidSize = {static_cast<float>(extent.width), static_cast<float>(extent.height)};
+        bool occlusionCulling = enableOcclusionCulling && previousDepthView != VK_NULL_HANDLE && DepthPyramid::supportsSampleCount(depthSamples);
+        if(occlusionCulling){
+            PROFILE_GPU_SCOPE(commandBuffer, "Depth pyramid");
+            depthPyramid->build(commandBuffer, frameIndex, previousDepthView);
+        }
+
+        // Counters start from zero every frame. Previous reads of these buffers were by this frame's earlier submission,
+        // which the frame fence already covers.
+        vkCmdFillBuffer(commandBuffer, drawCountBuffers[frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        vkCmdFillBuffer(commandBuffer, cullStatsBuffers[frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        cullPipelines.get(getCullFeatures(occlusionCulling)).bind(commandBuffer);
+        VkDescriptorSet cullSet = cullPool->getSets()[frameIndex];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+
+        constexpr uint32_t CULL_GROUP_SIZE = 64;   // local_size_x in cull.comp
+        vkCmdDispatch(commandBuffer, (instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+        // The draw reads the compacted commands and their counts, the host reads the stats once the frame completes
+        VkMemoryBarrier cullBarrier{};
+        cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void RenderSystem::drawScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance, VkExtent2D extent){
+        if(visibleCommandsBuffers.empty())
+            return;
+        PROFILE_SCOPE("Record draws");
+
+        // Each task records a contiguous run of chunks, one indirect draw per chunk
+        uint32_t chunkCount = getChunkCount();
+        uint32_t taskCount = std::min(chunkCount, secondaryRecorder.getMaxParallelTasks());
+        VkBuffer commands = visibleCommandsBuffers[frameIndex]->getBuffer();
+        VkBuffer counts = drawCountBuffers[frameIndex]->getBuffer();
+        VkDescriptorSet globalSet = globalPool->getSets()[frameIndex];
+        // Picked before the tasks start, creating a variant isn't thread safe. The texture array is sized to MAX_TEXTURES
+        // so that the variant doesn't change as textures are added.
+        GraphicsPipeline& renderPipeline = renderPipelines.get(getDrawFeatures());
+
+        secondaryRecorder.record(commandBuffer, frameIndex, inheritance, taskCount, [&](uint32_t task, VkCommandBuffer secondary){
+            PROFILE_SCOPE("Record draw task");
+            // Dynamic state isn't inherited from the primary command buffer
+            VkViewport viewport = {};
+            viewport.width = static_cast<float>(extent.width);
+            viewport.height = static_cast<float>(extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            VkRect2D scissor{ {0, 0}, extent };
+            vkCmdSetViewport(secondary, 0, 1, &viewport);
+            vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+            renderPipeline.bind(secondary);
+            vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &globalSet, 0, nullptr);
+            // One bind for the whole scene, the commands carry each model's offsets into the pool
+            scene.geometryPool->bind(secondary);
+
+            uint32_t firstChunk = chunkCount * task / taskCount;
+            uint32_t lastChunk = chunkCount * (task + 1) / taskCount;
+            for(uint32_t chunk = firstChunk; chunk < lastChunk; chunk++){
+                uint32_t maxDraws = std::min(DRAW_CHUNK_SIZE, instanceCount - chunk * DRAW_CHUNK_SIZE);
+                vkCmdDrawIndexedIndirectCount(secondary, commands, static_cast<VkDeviceSize>(chunk) * DRAW_CHUNK_SIZE * sizeof(VkDrawIndexedIndirectCommand), 
+                    counts, chunk * sizeof(uint32_t), maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        });
+    }
+
+    void RenderSystem::finishScene(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+        // main.frag's mip requests are read by the host in updateTextures() once this frame's fence has signalled
+        VkBufferMemoryBarrier requestBarrier{};
+        requestBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        requestBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        requestBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        requestBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        requestBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        requestBarrier.buffer = mipRequestBuffers[frameIndex]->getBuffer();
+        requestBarrier.offset = 0;
+        requestBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &requestBarrier, 0, nullptr);
     }
 
     void RenderSystem::updateUniformBuffer(Camera camera, uint32_t frameIndex){
@@ -253,22 +902,18 @@ namespace Renderer{
         uniformData.projection = camera.getProjection();
         uniformData.view = camera.getView();
         uniformData.inverseView = camera.getInverseView();
-        uniformData.enableFrustumCulling = camera.enableFrustumCulling;
+        enableFrustumCulling = camera.enableFrustumCulling;
+        enableOcclusionCulling = camera.enableOcclusionCulling;
+
+        // The depth pyramid is built from what the previous frame's camera saw
+        previousViewProjection = viewProjection;
+        viewProjection = uniformData.projection * uniformData.view;
+
+        Frustum frustum = Frustum::fromMatrix(viewProjection);
+        std::copy(frustum.planes.begin(), frustum.planes.end(), uniformData.frustumPlanes);
 
         uniformBuffers[frameIndex]->writeToBuffer(&uniformData);
         uniformBuffers[frameIndex]->flush();
-
-        // TODO: move per-instance updates to the GPU as this method here is very slow when there is a large number of objects
-        // Update per-instance data
-        /*for(int i = 0; i < objectCount; i++){
-            auto object = scene.objects.at(i);
-
-            instanceData[i].modelMatrix = object.transform.mat4();
-            instanceData[i].normalMatrix = object.transform.normalMatrix();
-            
-            instanceBuffers[frameIndex]->writeToBuffer(&instanceData[i]);
-            instanceBuffers[frameIndex]->flush();
-        }*/
     }
 
     size_t RenderSystem::padUniformBufferSize(size_t originalSize){
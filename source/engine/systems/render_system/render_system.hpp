@@ -2,62 +2,164 @@
 #include "engine/device/device.hpp"
 
 #include "engine/pipeline/pipeline.hpp"
+#include "engine/pipeline/pipeline_variants.hpp"
 #include "engine/pipeline/descriptors/descriptors.hpp"
 #include "engine/swap_chain/swap_chain.hpp"
 #include "engine/buffer/buffer.hpp"
 #include "engine/camera/camera.hpp"
 #include "engine/scene/scene.hpp"
+#include "engine/assets/asset_loader.hpp"
+#include "engine/culling/depth_pyramid.hpp"
+#include "engine/culling/bvh.hpp"
+#include "engine/object/transform_batch.hpp"
+#include "engine/renderer/secondary_recorder.hpp"
 
 #include <memory>
+#include <functional>
 
 namespace Renderer{
     class RenderSystem{
         public:
+            // Model and normal matrices of moved instances are built by transform.comp from their packed translation,
+            // rotation and scale, the host only writes 48 bytes per changed instance. Otherwise they're built on the host.
+            static constexpr bool GPU_INSTANCE_TRANSFORMS = true;
+            // Instances per indirect draw, culling compacts and counts each chunk separately so chunks can be recorded into
+            // different secondary command buffers. Matches DRAW_CHUNK_SIZE in cull.comp.
+            static constexpr uint32_t DRAW_CHUNK_SIZE = 4096;
+            // Size of the bindless texture array, texture ids index it directly. Devices with descriptor indexing allow at
+            // least 500000 update after bind sampled images per stage.
+            static constexpr uint32_t MAX_TEXTURES = 4096;
+            static constexpr uint32_t NO_TEXTURE = ~0u;
+
+            // Matches the std430 InstanceData struct in main.vert and cull.comp
             struct InstanceData{
                 glm::mat4 modelMatrix{1.f};
                 glm::mat4 normalMatrix{1.f};
+                glm::vec4 boundingSphere{0.f};      // Model space centre (xyz) and radius (w) used for culling
+
+                uint32_t materialId = 0;
+                uint32_t modelId = 0;
+                uint32_t padding[2]{};
+            };
 
-                glm::vec3 translation;
-                glm::vec3 scale;
-                glm::vec3 rotation;
+            // Matches the std430 MaterialData struct in main.frag, indexed by InstanceData::materialId
+            struct MaterialData{
+                Material::MaterialProperties properties{};
+                uint32_t diffuseTextureId = NO_TEXTURE;     // Slot in the texture array
+                uint32_t normalTextureId = NO_TEXTURE;
+                uint32_t padding[2]{};
+            };
 
-                unsigned int materialId;
-                unsigned int modelId;
+            // Matches the std430 TransformData struct in transform.comp, w components are unused
+            struct TransformData{
+                glm::vec4 translation{0.f};
+                glm::vec4 rotation{0.f};
+                glm::vec4 scale{1.f};
             };
 
+            // Instance counts of a culling pass
+            struct CullStats{
+                uint32_t frustumCulled = 0;
+                uint32_t occlusionCulled = 0;
+                uint32_t drawn = 0;
+            };
+
+            // Matches the std140 sceneUbo block in the shaders
             struct UniformData{
                 glm::mat4 projection{1.f};
                 glm::mat4 view{1.f};
                 glm::mat4 inverseView{1.f};
 
-                bool enableFrustumCulling;
-
-                glm::vec4 frustumPlanes[6];
-                glm::vec4 frustumCorners[8];
-                uint32_t shapesToCull;
+                glm::vec4 frustumPlanes[6]{};
+                glm::vec4 frustumCorners[8]{};
+                uint32_t shapesToCull = 0;
             } uniformData;
 
+            // Fills the scene once the sampler and geometry pool exist, samplers are expected to be created through the scene
+            using SceneSetup = std::function<void(Scene& scene, AssetLoader& assetLoader)>;
+
             RenderSystem(Device& device, VkRenderPass renderPass);
             ~RenderSystem();
 
-            void initializeRenderSystem();
+            // Sets up the default test scene when no sceneSetup is given
+            void initializeRenderSystem(const SceneSetup& sceneSetup = {});
+            // Adds assets that finished loading to the scene, call once per frame before recording
+            void updateAssets();
+            // Blocks until every requested asset is loaded and in the draw commands
+            void finishLoading();
+            // Rebuilds the pipelines whose shaders were edited on disk (see ShaderLibrary::setHotReload()), call once per
+            // frame before recording
+            void reloadShaders();
 
             void updateUniformBuffer(Camera camera, uint32_t frameIndex);
-            void drawScene(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+            // Writes the instances of objects marked with Scene::markTransformDirty() into this frame's instance buffers,
+            // only changed instances are touched. Call once per frame before cullScene().
+            void updateInstanceData(uint32_t frameIndex);
+            // Streams texture levels in and out based on the levels main.frag sampled when this frame last ran, then points
+            // this frame's texture array at the textures created or replaced since. Call once per frame before drawScene().
+            // Adding textures only writes their array elements, sets are never rebuilt.
+            void updateTextures(uint32_t frameIndex);
+            // Records the culling passes that fill this frame's draw commands, must be called outside of a render pass.
+            // Instances are tested against the frustum, then against a depth pyramid built from the previous frame's depth
+            // attachment (previousDepthView, null when there is none).
+            void cullScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView previousDepthView, VkExtent2D extent);
+            // Records the draws into secondary command buffers in parallel and executes them, the render pass of inheritance
+            // has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+            void drawScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance, VkExtent2D extent);
+            // Records what has to follow the draws once their render pass has ended, call once per frame after drawScene()
+            void finishScene(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+            // Lighting of the scene's pipeline, switching compiles the variant the first time it's used
+            void setLightingModel(LightingModel model) { lightingModel = model; }
+
+            // Bytes of texture levels the streamer may keep resident, see TextureStreamer
+            void setTextureBudget(VkDeviceSize bytes) { assetLoader.getTextureStreamer().setBudget(bytes); }
+            VkDeviceSize getResidentTextureBytes() { return assetLoader.getTextureStreamer().getResidentBytes(); }
+
+            // CPU queries over the world space boxes of objects with loaded models (e.g. picking). Moved objects are only
+            // refit into the tree when it's queried, created and destroyed objects show up once the draw data was rebuilt.
+            // raycastObjects() returns the object whose box the ray enters first (distance in units of direction), or an
+            // invalid handle.
+            Handle<Object> raycastObjects(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& hitDistance);
+            void queryObjects(const Frustum& frustum, std::vector<Handle<Object>>& results);
+
+            // Counts of the most recent culling pass the GPU has finished (a few frames behind)
+            const CullStats& getCullStats() { return cullStats; }
+
+            Scene& getScene() { return scene; }
+            AssetLoader& getAssetLoader() { return assetLoader; }
 
         private:
-            void setupScene();
+            void setupScene(const SceneSetup& sceneSetup);
+            void setupDefaultScene();
+            // Recreates the draw commands and instance data after assets or objects were added
+            void rebuildDrawData();
             void setupDescriptorSets();
+            void writeDescriptorSets();
 
             void createGraphicsPipelineLayout();
             void createGraphicsPipeline();
+            // Toggles the scene's draw and culling pipelines are specialized for this frame
+            PipelineFeatures getDrawFeatures();
+            PipelineFeatures getCullFeatures(bool occlusionCulling);
 
             void createComputePipelineLayout();
             void createComputePipeline();
+            void createTransformPipeline();
 
             void createIndirectCommands();
+            // Rebuilds objectTree after the draw data changed, otherwise refits the objects moved since the last query
+            void updateObjectTree();
+            // Properties of every material slot, rewritten whenever the draw data is
+            void createMaterialBuffer();
+            uint32_t getTextureSlot(const std::vector<unsigned int>& textureIds);
             void setupInstanceData();
+            // Queues an instance to be rewritten in every frame's buffers
+            void markInstanceDirty(uint32_t instanceIndex);
+            void computeInstanceTransforms(VkCommandBuffer commandBuffer, uint32_t frameIndex);
             
+            uint32_t getChunkCount() { return (instanceCount + DRAW_CHUNK_SIZE - 1) / DRAW_CHUNK_SIZE; }
+
             size_t padUniformBufferSize(size_t originalSize);
             uint32_t maxMiplevels();
 
@@ -65,27 +167,100 @@ namespace Renderer{
             VkRenderPass renderPass;
 
             Scene scene;
+            AssetLoader assetLoader{device, scene};
+            SecondaryRecorder secondaryRecorder{device};
 
-            std::unique_ptr<GraphicsPipeline> renderPipeline;
+            PipelineVariants<GraphicsPipeline> renderPipelines;
             VkPipelineLayout pipelineLayout;
+            LightingModel lightingModel = LightingModel::Unlit;
 
-            std::unique_ptr<ComputePipeline> cullPipeline;
+            PipelineVariants<ComputePipeline> cullPipelines;
             VkPipelineLayout cullPipelineLayout;
 
+            // Per frame instance data, persistently mapped when the host builds the matrices. With GPU_INSTANCE_TRANSFORMS
+            // they're device local and written by transform.comp from the mapped transformBuffers instead.
             std::vector<std::unique_ptr<Buffer>> instanceBuffers;
-            
             std::vector<InstanceData> instanceData;
+            std::vector<TransformData> instanceTransforms;
+            // Instances of an object are consecutive, indexed by the object's handle index
+            struct InstanceRange{
+                uint32_t first = 0;
+                uint32_t count = 0;
+            };
+            std::vector<InstanceRange> objectInstances;
+            std::vector<Bounds> objectBounds;       // Model space box around an object's loaded meshes
+            std::vector<uint32_t> objectProxies;    // Leaf of each object in objectTree
+
+            // Leaves carry the object's handle index. Only brought up to date by updateObjectTree() when queried.
+            Bvh objectTree;
+            bool objectTreeStale = true;                // Rebuilt from every object on the next query
+            std::vector<Handle<Object>> treeMovedObjects;   // Refit on the next query (may hold duplicates)
+
+            // Instances each frame's buffers still have to pick up, pendingFrames holds one bit per frame so an instance is
+            // only queued once per frame no matter how often it moves in between
+            std::vector<std::vector<uint32_t>> pendingInstanceUpdates;
+            std::vector<uint8_t> pendingFrames;
+
+            // Host built matrices of a batch of objects (all of them, or the ones that moved this frame)
+            struct ObjectMatrices{
+                glm::mat4 modelMatrix;
+                glm::mat4 normalMatrix;
+            };
+            TransformBatch transformBatch;
+            std::vector<Handle<Object>> movedObjects;   // Objects in transformBatch
+            std::vector<ObjectMatrices> objectMatrices;
+
+            std::vector<std::unique_ptr<Buffer>> transformBuffers;         // TransformData of every instance
+            std::vector<std::unique_ptr<Buffer>> transformUpdateBuffers;   // Indices of the instances transform.comp rebuilds
+            std::vector<uint32_t> transformUpdateCounts;
 
+            std::unique_ptr<ComputePipeline> transformPipeline;
+            VkPipelineLayout transformPipelineLayout = VK_NULL_HANDLE;
+            std::unique_ptr<DescriptorPool> transformPool;
+            std::unique_ptr<DescriptorSetLayout> transformSetLayout;
+
+            // Matches the push constants in cull.comp
+            struct CullPushConstants{
+                glm::mat4 previousViewProjection{1.f};      // Camera the depth pyramid was rendered with
+                glm::vec2 pyramidSize{0.f};
+            };
+
+            // One command per instance, read by the culling pass which compacts the visible ones of each chunk to the front
+            // of the chunk in each frame's visibleCommandsBuffers and counts them in drawCountBuffers. All models share the
+            // scene's geometry pool, so every chunk is drawn by a single indirect draw.
             std::unique_ptr<Buffer> indirectCommandsBuffer;
             std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
 
+            std::vector<std::unique_ptr<Buffer>> visibleCommandsBuffers;
+            std::vector<std::unique_ptr<Buffer>> drawCountBuffers;
+            std::vector<std::unique_ptr<Buffer>> cullStatsBuffers;     // Host visible CullStats
+            CullStats cullStats{};
+
+            std::unique_ptr<DepthPyramid> depthPyramid;
+            glm::mat4 viewProjection{1.f};
+            glm::mat4 previousViewProjection{1.f};
+            bool enableFrustumCulling = true;
+            bool enableOcclusionCulling = true;
+
+            // Material properties indexed by material slot, read by main.frag
+            std::unique_ptr<Buffer> materialBuffer;
+            // Textures each frame's set points at, they're kept alive until that frame's set is pointed elsewhere
+            std::vector<std::vector<std::shared_ptr<Texture>>> boundTextures;
+            // Host visible, finest level main.frag sampled of each texture slot relative to the bound texture (atomicMin,
+            // TextureStreamer::NO_REQUEST when unsampled). Read and reset once the frame has completed.
+            std::vector<std::unique_ptr<Buffer>> mipRequestBuffers;
+            std::vector<uint32_t> mipRequests;
+            uint64_t streamedFrames = 0;
+
             std::unique_ptr<DescriptorPool> globalPool;
             std::unique_ptr<DescriptorSetLayout> globalSetLayout;
 
+            std::unique_ptr<DescriptorPool> cullPool;
+            std::unique_ptr<DescriptorSetLayout> cullSetLayout;
+
             std::vector<std::unique_ptr<Buffer>> uniformBuffers;
             uint32_t latestBinding = 0;
 
-            uint32_t instanceCount;
-            uint32_t objectCount;
+            uint32_t instanceCount = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,390 @@
+#include "upload_manager.hpp"
+
+#include "engine/profiling/profiler.hpp"
+
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+
+namespace Renderer{
+    UploadManager::UploadManager(Device& device, VkDeviceSize ringSize) : device{device}, ringSize{ringSize}{
+        QueueFamilyIndices indices = device.getPhysicalQueueFamilies();
+        dedicatedTransfer = indices.transferFamilyHasValue;
+        graphicsFamily = indices.graphicsFamily;
+        transferFamily = dedicatedTransfer ? indices.transferFamily : indices.graphicsFamily;
+
+        createCommandPools();
+        createBatches();
+
+        stagingRing = std::make_unique<Buffer>(
+            device,
+            1,
+            ringSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_SHARING_MODE_EXCLUSIVE,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        );
+        stagingRing->map();
+    }
+
+    UploadManager::~UploadManager(){
+        flush();
+        for(auto& batch : batches){
+            vkDestroyFence(device.getDevice(), batch.fence, nullptr);
+            if(batch.transferComplete != VK_NULL_HANDLE)
+                vkDestroySemaphore(device.getDevice(), batch.transferComplete, nullptr);
+        }
+        vkDestroyCommandPool(device.getDevice(), transferCommandPool, nullptr);
+        if(graphicsCommandPool != VK_NULL_HANDLE)
+            vkDestroyCommandPool(device.getDevice(), graphicsCommandPool, nullptr);
+    }
+
+    void UploadManager::createCommandPools(){
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = transferFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if(vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create transfer command pool.");
+
+        if(!dedicatedTransfer)
+            return;
+        poolInfo.queueFamilyIndex = graphicsFamily;
+        if(vkCreateCommandPool(device.getDevice(), &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create upload graphics command pool.");
+    }
+
+    void UploadManager::createBatches(){
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for(auto& batch : batches){
+            allocInfo.commandPool = transferCommandPool;
+            if(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &batch.transferCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate transfer command buffer.");
+            if(vkCreateFence(device.getDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create upload fence.");
+
+            if(!dedicatedTransfer){
+                batch.graphicsCommandBuffer = batch.transferCommandBuffer;
+                continue;
+            }
+            allocInfo.commandPool = graphicsCommandPool;
+            if(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &batch.graphicsCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate upload graphics command buffer.");
+            if(vkCreateSemaphore(device.getDevice(), &semaphoreInfo, nullptr, &batch.transferComplete) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create upload semaphore.");
+        }
+    }
+
+    void UploadManager::beginBatch(){
+        if(recording)
+            return;
+        // Batches are reused round robin, so when all of them are in flight the oldest one owns the slot we need
+        if(pendingBatches.size() == MAX_BATCHES_IN_FLIGHT)
+            wait(batches[pendingBatches.front()].ticket);
+
+        Batch& batch = batches[currentBatch];
+        vkResetFences(device.getDevice(), 1, &batch.fence);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+        if(vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("Failed to begin recording transfer command buffer.");
+        if(dedicatedTransfer){
+            vkResetCommandBuffer(batch.graphicsCommandBuffer, 0);
+            if(vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS)
+                throw std::runtime_error("Failed to begin recording upload graphics command buffer.");
+        }
+
+        batch.ticket = nextTicket++;
+        batch.ringBytes = 0;
+        recording = true;
+    }
+
+    void UploadManager::retireBatch(){
+        assert(!pendingBatches.empty() && "No submitted upload batch to retire.");
+        Batch& batch = batches[pendingBatches.front()];
+        pendingBatches.pop_front();
+
+        // Batches that staged nothing don't know where the ring is, their head may predate a reset of the empty ring
+        if(batch.ringBytes > 0){
+            ringTail = batch.ringHead;
+            ringUsed -= batch.ringBytes;
+        }
+        batch.overflowBuffers.clear();
+        lastCompletedTicket = batch.ticket;
+    }
+
+    bool UploadManager::allocateStaging(VkDeviceSize size, VkDeviceSize& offset){
+        if(ringUsed == 0)
+            ringHead = ringTail = 0;
+        else if(ringUsed == ringSize)
+            return false;
+
+        VkDeviceSize alignedHead = (ringHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+        VkDeviceSize consumed;
+        if(ringHead >= ringTail){
+            // Free space is [head, end) followed by [0, tail)
+            if(alignedHead + size <= ringSize){
+                offset = alignedHead;
+                consumed = alignedHead - ringHead + size;
+            }
+            else if(size <= ringTail){
+                offset = 0;
+                consumed = ringSize - ringHead + size;
+            }
+            else
+                return false;
+        }
+        else{
+            if(alignedHead + size > ringTail)
+                return false;
+            offset = alignedHead;
+            consumed = alignedHead - ringHead + size;
+        }
+
+        ringHead = offset + size;
+        ringUsed += consumed;
+        batches[currentBatch].ringBytes += consumed;
+        return true;
+    }
+
+    VkBuffer UploadManager::stage(const void* data, VkDeviceSize size, VkDeviceSize& offset){
+        beginBatch();
+        if(size > ringSize){
+            auto overflowBuffer = std::make_unique<Buffer>(
+                device,
+                1,
+                size,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_SHARING_MODE_EXCLUSIVE,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            overflowBuffer->map();
+            overflowBuffer->writeToBuffer(const_cast<void*>(data), size);
+            VkBuffer buffer = overflowBuffer->getBuffer();
+            offset = 0;
+            batches[currentBatch].overflowBuffers.push_back(std::move(overflowBuffer));
+            return buffer;
+        }
+
+        // Ring is full, submit what this batch staged so far or wait for the oldest batch to give its staging memory back
+        while(!allocateStaging(size, offset)){
+            if(batches[currentBatch].ringBytes > 0)
+                submit();
+            else
+                wait(batches[pendingBatches.front()].ticket);
+            beginBatch();
+        }
+        stagingRing->writeToBuffer(const_cast<void*>(data), size, offset);
+        return stagingRing->getBuffer();
+    }
+
+    void UploadManager::uploadToBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset){
+        VkBufferCopy copyRegion{};
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = size;
+        VkBuffer srcBuffer = stage(data, size, copyRegion.srcOffset);
+
+        Batch& batch = batches[currentBatch];
+        vkCmdCopyBuffer(batch.transferCommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    }
+
+    void UploadManager::uploadToImage(VkImage image, uint32_t mipLevels, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions,
+        uint32_t baseMipLevel){
+        // Staged first, staging may submit the batch and the layout transition has to be in the batch holding the copies
+        VkDeviceSize stagingOffset;
+        VkBuffer srcBuffer = stage(data, size, stagingOffset);
+        for(auto& region : regions)
+            region.bufferOffset += stagingOffset;
+
+        Batch& batch = batches[currentBatch];
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseMipLevel;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(batch.transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    void UploadManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size){
+        beginBatch();
+        Batch& batch = batches[currentBatch];
+        recordTransferReadBarrier(batch.transferCommandBuffer);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = 0;
+        copyRegion.dstOffset = 0;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(batch.transferCommandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    }
+
+    void UploadManager::copyBufferToImage(VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height){
+        beginBatch();
+        Batch& batch = batches[currentBatch];
+        recordTransferReadBarrier(batch.transferCommandBuffer);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+
+        vkCmdCopyBufferToImage(batch.transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    void UploadManager::transferImageOwnership(VkImage image, VkImageLayout layout, uint32_t mipLevels){
+        if(!dedicatedTransfer)
+            return;
+        beginBatch();
+        Batch& batch = batches[currentBatch];
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = layout;
+        barrier.newLayout = layout;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        // Release on the transfer queue
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        // Acquire on the graphics queue, the batch's semaphore orders it after the release
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    VkCommandBuffer UploadManager::getTransferCommandBuffer(){
+        beginBatch();
+        return batches[currentBatch].transferCommandBuffer;
+    }
+
+    VkCommandBuffer UploadManager::getGraphicsCommandBuffer(){
+        beginBatch();
+        return batches[currentBatch].graphicsCommandBuffer;
+    }
+
+    void UploadManager::recordTransferReadBarrier(VkCommandBuffer commandBuffer){
+        // Earlier copies in the batch may have written the source
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    uint64_t UploadManager::submit(){
+        PROFILE_SCOPE("Upload submit");
+        if(!recording)
+            return lastSubmittedTicket;
+        Batch& batch = batches[currentBatch];
+
+        // Make everything the batch wrote visible to the frames that follow. Buffers are concurrent, so with a dedicated
+        // transfer queue the semaphore and this barrier are all the graphics queue needs; images are handed over explicitly.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        if(vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to record transfer command buffer.");
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+        if(dedicatedTransfer){
+            if(vkEndCommandBuffer(batch.graphicsCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to record upload graphics command buffer.");
+
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch.transferComplete;
+            if(vkQueueSubmit(device.getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit transfer command buffer.");
+
+            // The graphics half waits on the transfer half, so its fence covers the whole batch
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            VkSubmitInfo graphicsSubmitInfo{};
+            graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            graphicsSubmitInfo.waitSemaphoreCount = 1;
+            graphicsSubmitInfo.pWaitSemaphores = &batch.transferComplete;
+            graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+            graphicsSubmitInfo.commandBufferCount = 1;
+            graphicsSubmitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+            if(vkQueueSubmit(device.getGraphicsQueue(), 1, &graphicsSubmitInfo, batch.fence) != VK_SUCCESS)
+                throw std::runtime_error("Failed to submit upload graphics command buffer.");
+        }
+        else if(vkQueueSubmit(device.getTransferQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit transfer command buffer.");
+
+        batch.ringHead = ringHead;
+        pendingBatches.push_back(currentBatch);
+        lastSubmittedTicket = batch.ticket;
+        currentBatch = (currentBatch + 1) % MAX_BATCHES_IN_FLIGHT;
+        recording = false;
+        return lastSubmittedTicket;
+    }
+
+    bool UploadManager::isComplete(uint64_t ticket){
+        while(!pendingBatches.empty() && vkGetFenceStatus(device.getDevice(), batches[pendingBatches.front()].fence) == VK_SUCCESS)
+            retireBatch();
+        return ticket <= lastCompletedTicket;
+    }
+
+    void UploadManager::wait(uint64_t ticket){
+        if(recording && ticket > lastSubmittedTicket)
+            submit();
+        while(lastCompletedTicket < ticket && !pendingBatches.empty()){
+            vkWaitForFences(device.getDevice(), 1, &batches[pendingBatches.front()].fence, VK_TRUE, UINT64_MAX);
+            retireBatch();
+        }
+    }
+
+    void UploadManager::flush(){
+        PROFILE_SCOPE("Upload flush");
+        wait(submit());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "engine/device/device.hpp"
+#include "engine/buffer/buffer.hpp"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <array>
+
+namespace Renderer{
+    // Batches host->device uploads into as few submissions as possible. Data is copied into a persistently mapped staging
+    // ring and the copies are recorded into one command buffer per batch, which is submitted on the dedicated transfer
+    // queue when the device has one. Completion is tracked per batch with a fence, callers get a ticket from submit().
+    // Not thread safe, record uploads from the thread that owns the device.
+    class UploadManager{
+        public:
+            static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32ull * 1024 * 1024;
+            static constexpr uint32_t MAX_BATCHES_IN_FLIGHT = 3;
+            static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;   // Satisfies buffer->image copy offset rules for all formats used
+
+            UploadManager(Device& device, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+            ~UploadManager();
+
+            UploadManager(const UploadManager&) = delete;
+            UploadManager& operator=(const UploadManager&) = delete;
+
+            // Copies data into the staging ring and records a copy into dstBuffer, the data can be freed once this returns.
+            // Buffers written here (or by copyBuffer()) have to be created with VK_SHARING_MODE_CONCURRENT, see Buffer: writes
+            // may cover part of a buffer the graphics queue is using, which ownership transfers of exclusive buffers can't do.
+            void uploadToBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+            // Copies data into the staging ring and records the regions' copies straight into image, region buffer offsets
+            // are relative to data. The image's mipLevels from baseMipLevel on go from UNDEFINED to TRANSFER_DST_OPTIMAL first
+            // and are left in that layout. The data can be freed once this returns.
+            void uploadToImage(VkImage image, uint32_t mipLevels, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions,
+                uint32_t baseMipLevel = 0);
+            // Device to device copies recorded into the current batch, srcBuffer may have been written earlier in the same batch
+            void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+            void copyBufferToImage(VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height);
+
+            // Hands an image written on the transfer queue over to the graphics queue, layout is kept as is. Commands recorded
+            // into the graphics command buffer afterwards may use the image. Does nothing without a dedicated transfer queue.
+            void transferImageOwnership(VkImage image, VkImageLayout layout, uint32_t mipLevels);
+
+            // Command buffers of the current batch. Graphics work (blits, layout transitions for sampling) runs after all of the
+            // batch's transfers have completed. Both are the same command buffer without a dedicated transfer queue.
+            // Handles are only valid until the next upload, which may submit the batch if the staging ring is full.
+            VkCommandBuffer getTransferCommandBuffer();
+            VkCommandBuffer getGraphicsCommandBuffer();
+
+            // Submits the current batch and returns its ticket, returns the last submitted ticket if nothing was recorded
+            uint64_t submit();
+            bool isComplete(uint64_t ticket);
+            void wait(uint64_t ticket);
+            // Submits the current batch and waits for everything to complete
+            void flush();
+
+            bool hasDedicatedTransferQueue() { return dedicatedTransfer; }
+
+        private:
+            struct Batch{
+                VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+                VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+                VkFence fence = VK_NULL_HANDLE;
+                VkSemaphore transferComplete = VK_NULL_HANDLE;
+
+                uint64_t ticket = 0;
+                VkDeviceSize ringBytes = 0;         // Staging ring bytes consumed by this batch (including padding)
+                VkDeviceSize ringHead = 0;          // Ring head once the batch was submitted, the tail moves here when it completes
+                std::vector<std::unique_ptr<Buffer>> overflowBuffers;   // Staging for uploads larger than the ring
+            };
+
+            void createCommandPools();
+            void createBatches();
+            void beginBatch();
+            void retireBatch();
+            bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+            // Copies data into the ring (or an overflow buffer if it doesn't fit) of the current batch, returns the buffer
+            VkBuffer stage(const void* data, VkDeviceSize size, VkDeviceSize& offset);
+            void recordTransferReadBarrier(VkCommandBuffer commandBuffer);
+
+            Device& device;
+
+            bool dedicatedTransfer = false;
+            uint32_t transferFamily, graphicsFamily;
+            VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+            VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+
+            std::unique_ptr<Buffer> stagingRing;
+            VkDeviceSize ringSize;
+            VkDeviceSize ringHead = 0, ringTail = 0, ringUsed = 0;
+
+            std::array<Batch, MAX_BATCHES_IN_FLIGHT> batches;
+            std::deque<uint32_t> pendingBatches;    // Submitted batches, oldest first
+            uint32_t currentBatch = 0;
+            bool recording = false;
+
+            uint64_t nextTicket = 1;
+            uint64_t lastSubmittedTicket = 0;
+            uint64_t lastCompletedTicket = 0;
+    };
+}
\ No newline at end of file
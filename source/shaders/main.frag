@@ -1,30 +1,72 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 inFragColor;
 layout(location = 1) in vec3 inFragPosWorld;
 layout(location = 2) in vec3 inFragNormalWorld;
 layout(location = 3) in vec2 inFragTexCoord;
+layout(location = 4) flat in uint inMaterialId;
 
 layout(location = 0) out vec4 outColor;
 
+// Specialized per pipeline variant (see PipelineFeatures)
+layout(constant_id = 2) const uint TEXTURE_COUNT = 1;
+layout(constant_id = 3) const uint LIGHTING_MODEL = 0;    // LightingModel
+const uint LIGHTING_UNLIT = 0;
+const uint LIGHTING_DIFFUSE = 1;
+
+// Matches RenderSystem::NO_TEXTURE
+const uint NO_TEXTURE = 0xffffffffu;
+
+// Matches RenderSystem::MaterialData
+struct MaterialData{
+  float opacity;
+  float shininess;
+  vec4 diffuseColour;
+  vec4 specularColour;
+  vec4 hue;
+  uint diffuseTextureId;
+  uint normalTextureId;
+};
+
 layout(set = 0, binding = 0) uniform sceneUbo{
   mat4 projection;
   mat4 view;
   mat4 inverseView;
 } globalUBO;
 
-layout(set = 0, binding = 1) uniform modelDubo{
-  mat4 modelMatrix;
-  mat4 normalMatrix;
-  uint textureIndex;
-} model;
+layout(std430, set = 0, binding = 2) readonly buffer materialBuffer{
+  MaterialData materials[];
+};
 
-layout(set = 0, binding = 2) uniform sampler texSampler;
-layout(set = 0, binding = 3) uniform texture2D textures[1];
+// Bindless, indexed by texture id. Only the elements of existing textures are written.
+layout(set = 0, binding = 3) uniform sampler2D textures[TEXTURE_COUNT];
+
+// Finest level sampled of each texture, relative to the levels it has resident. Read by TextureStreamer.
+layout(std430, set = 0, binding = 4) buffer mipRequestBuffer{
+  uint mipRequests[];
+};
 
 void main(){
-    vec3 cameraPosWorld = globalUBO.inverseView[3].xyz;
-    vec3 viewDirection = normalize(cameraPosWorld - inFragPosWorld);
+    MaterialData material = materials[inMaterialId];
+    outColor = material.diffuseColour * material.hue;
+    outColor.a *= material.opacity;
+    // Materials of different draws can meet in one subgroup
+    if(material.diffuseTextureId != NO_TEXTURE){
+        outColor *= texture(textures[nonuniformEXT(material.diffuseTextureId)], inFragTexCoord);
+
+        // The level is queried by the whole quad, only one pixel in every 4x4 block reports it to keep the atomics down.
+        // Magnified textures ask for level 0, requests past the resident ones are what the streamer loads next.
+        float lod = textureQueryLod(textures[nonuniformEXT(material.diffuseTextureId)], inFragTexCoord).y;
+        if((uint(gl_FragCoord.x) & 3u) == 0u && (uint(gl_FragCoord.y) & 3u) == 0u)
+            atomicMin(mipRequests[material.diffuseTextureId], uint(max(floor(lod), 0.0)));
+    }
 
-    outColor = texture(sampler2D(textures[model.textureIndex], texSampler), inFragTexCoord);
+    if(LIGHTING_MODEL == LIGHTING_DIFFUSE){
+        // Headlight: lit from the camera, with a little ambient so back faces aren't black
+        vec3 cameraPosWorld = globalUBO.inverseView[3].xyz;
+        vec3 viewDirection = normalize(cameraPosWorld - inFragPosWorld);
+        float diffuse = max(dot(normalize(inFragNormalWorld), viewDirection), 0.0);
+        outColor.rgb *= 0.15 + 0.85 * diffuse;
+    }
 }
\ No newline at end of file
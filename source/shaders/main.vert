@@ -9,6 +9,15 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragTexCoord;
+layout(location = 4) flat out uint fragMaterialId;
+
+struct InstanceData{
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  vec4 boundingSphere;
+  uint materialId;
+  uint modelId;
+};
 
 layout(set = 0, binding = 0) uniform sceneUbo{
   mat4 projection;
@@ -16,17 +25,18 @@ layout(set = 0, binding = 0) uniform sceneUbo{
   mat4 inverseView;
 } globalUBO;
 
-layout(set = 0, binding = 1) uniform modelDubo{
-  mat4 modelMatrix;
-  mat4 normalMatrix;
-  uint textureIndex;
-} model;
+// Each draw command covers a single instance, its firstInstance is the index into this buffer
+layout(std430, set = 0, binding = 1) readonly buffer instanceBuffer{
+  InstanceData instances[];
+};
 
 void main(){
-  vec4 positionWorld = model.modelMatrix * vec4(inPosition, 1.0);
+  InstanceData instance = instances[gl_InstanceIndex];
+  vec4 positionWorld = instance.modelMatrix * vec4(inPosition, 1.0);
   gl_Position = globalUBO.projection * globalUBO.view * positionWorld;
-  fragNormalWorld = normalize(mat3(model.normalMatrix) * inNormal);
+  fragNormalWorld = normalize(mat3(instance.normalMatrix) * inNormal);
   fragPosWorld = positionWorld.xyz;
   fragColor = inColor;
   fragTexCoord = inTexCoord;
+  fragMaterialId = instance.materialId;
 }
\ No newline at end of file
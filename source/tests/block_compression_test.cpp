@@ -0,0 +1,226 @@
+#include "engine/material/texture/block_compression.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Decodes what BlockCompression::encodeBc7() writes with a mode 6 decoder written from the BC7 format description and
+// checks the reconstruction. Flat blocks have to come back within the endpoint quantization (one step of 8 bits), blocks
+// whose texels lie on a line in RGBA (colour and alpha gradients) within half the widest gap between palette weights
+// (5/64 of the line's extent) plus that quantization. The anchor texel's index is stored without its top bit, so every
+// stored index, the anchor's included, has to be the closest palette entry of the decoded endpoints.
+namespace{
+    constexpr uint32_t RANDOM_BLOCKS = 2000;
+    constexpr int QUANTIZATION_ERROR = 1;
+    constexpr double WIDEST_WEIGHT_GAP = 5.0 / 64.0;
+
+    // Interpolation weights of 4-bit indices
+    constexpr int WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    std::mt19937 generator{5};
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t index){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "block " << index << ": " << message << '\n';
+    }
+
+    int uniform(int min, int max){
+        return std::uniform_int_distribution<int>{min, max}(generator);
+    }
+
+    struct DecodedBlock{
+        bool isMode6 = false;
+        int endpoints[2][4] = {};
+        int indices[16] = {};
+        uint8_t texels[64] = {};
+    };
+
+    // Bits are read from the least significant bit of the first byte on
+    uint32_t readBits(const uint8_t block[16], int& position, int count){
+        uint32_t value = 0;
+        for(int i = 0; i < count; i++, position++)
+            value |= static_cast<uint32_t>((block[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+
+    int interpolate(int e0, int e1, int index){
+        return ((64 - WEIGHTS[index]) * e0 + WEIGHTS[index] * e1 + 32) >> 6;
+    }
+
+    DecodedBlock decodeMode6(const uint8_t block[16]){
+        DecodedBlock decoded{};
+        int position = 0;
+        // The mode is the number of zero bits before the first set one
+        if(readBits(block, position, 7) != 1u << 6)
+            return decoded;
+        decoded.isMode6 = true;
+        for(int c = 0; c < 4; c++){
+            decoded.endpoints[0][c] = static_cast<int>(readBits(block, position, 7)) << 1;
+            decoded.endpoints[1][c] = static_cast<int>(readBits(block, position, 7)) << 1;
+        }
+        int pBit0 = static_cast<int>(readBits(block, position, 1));
+        int pBit1 = static_cast<int>(readBits(block, position, 1));
+        for(int c = 0; c < 4; c++){
+            decoded.endpoints[0][c] |= pBit0;
+            decoded.endpoints[1][c] |= pBit1;
+        }
+        // The anchor index has an implicit zero top bit
+        decoded.indices[0] = static_cast<int>(readBits(block, position, 3));
+        for(int t = 1; t < 16; t++)
+            decoded.indices[t] = static_cast<int>(readBits(block, position, 4));
+        for(int t = 0; t < 16; t++){
+            for(int c = 0; c < 4; c++)
+                decoded.texels[t * 4 + c] = static_cast<uint8_t>(interpolate(decoded.endpoints[0][c], decoded.endpoints[1][c], decoded.indices[t]));
+        }
+        return decoded;
+    }
+
+    int squaredDistance(const uint8_t* texel, const DecodedBlock& decoded, int index){
+        int distance = 0;
+        for(int c = 0; c < 4; c++){
+            int difference = texel[c] - interpolate(decoded.endpoints[0][c], decoded.endpoints[1][c], index);
+            distance += difference * difference;
+        }
+        return distance;
+    }
+
+    // Encodes and decodes texels, returns the largest per channel error
+    int roundTrip(const uint8_t texels[64], uint32_t index){
+        uint8_t block[16];
+        Renderer::BlockCompression::encodeBc7Block(texels, block);
+        DecodedBlock decoded = decodeMode6(block);
+        check(decoded.isMode6, "block isn't mode 6", index);
+        if(!decoded.isMode6)
+            return 255;
+
+        for(int t = 0; t < 16; t++){
+            int best = squaredDistance(&texels[t * 4], decoded, 0);
+            for(int i = 1; i < 16; i++)
+                best = std::min(best, squaredDistance(&texels[t * 4], decoded, i));
+            check(squaredDistance(&texels[t * 4], decoded, decoded.indices[t]) == best,
+                t == 0 ? "anchor index isn't the closest palette entry, endpoints weren't swapped" : "index isn't the closest palette entry", index);
+        }
+
+        int maxError = 0;
+        for(int i = 0; i < 64; i++)
+            maxError = std::max(maxError, std::abs(texels[i] - decoded.texels[i]));
+        return maxError;
+    }
+
+    // Texels spread along the line from start to end, extent is the line's largest channel difference
+    int lineBound(const int start[4], const int end[4]){
+        int extent = 0;
+        for(int c = 0; c < 4; c++)
+            extent = std::max(extent, std::abs(end[c] - start[c]));
+        return static_cast<int>(std::ceil(extent * WIDEST_WEIGHT_GAP / 2.0)) + QUANTIZATION_ERROR + 1;
+    }
+
+    void fillLine(uint8_t texels[64], const int start[4], const int end[4], const float positions[16]){
+        for(int t = 0; t < 16; t++){
+            for(int c = 0; c < 4; c++)
+                texels[t * 4 + c] = static_cast<uint8_t>(std::lround(start[c] + (end[c] - start[c]) * positions[t]));
+        }
+    }
+}
+
+int main(){
+    uint8_t texels[64];
+    uint32_t blockIndex = 0;
+
+    // Flat blocks, including the extremes
+    int flatError = 0;
+    for(uint32_t i = 0; i < RANDOM_BLOCKS; i++, blockIndex++){
+        uint8_t colour[4] = {static_cast<uint8_t>(uniform(0, 255)), static_cast<uint8_t>(uniform(0, 255)),
+            static_cast<uint8_t>(uniform(0, 255)), static_cast<uint8_t>(uniform(0, 255))};
+        if(i < 2)
+            std::fill(colour, colour + 4, static_cast<uint8_t>(i * 255));
+        for(int t = 0; t < 16; t++)
+            std::copy(colour, colour + 4, &texels[t * 4]);
+        int error = roundTrip(texels, blockIndex);
+        flatError = std::max(flatError, error);
+        check(error <= QUANTIZATION_ERROR, "flat block is off by more than the endpoint quantization", blockIndex);
+    }
+
+    // Gradients across the block in colour, alpha or both, starting from either end so the anchor texel sits at the low
+    // and at the high end of the palette
+    int gradientError = 0;
+    for(uint32_t i = 0; i < RANDOM_BLOCKS; i++, blockIndex++){
+        int start[4], end[4];
+        int kind = i % 3;
+        for(int c = 0; c < 4; c++){
+            bool varies = kind == 0 ? c < 3 : kind == 1 ? c == 3 : true;
+            start[c] = uniform(0, 255);
+            end[c] = varies ? uniform(0, 255) : start[c];
+        }
+        float positions[16];
+        bool diagonal = (i / 3) % 2 == 0;
+        for(int t = 0; t < 16; t++)
+            positions[t] = diagonal ? ((t % 4) + (t / 4)) / 6.f : (t % 4) / 3.f;
+        fillLine(texels, start, end, positions);
+        int error = roundTrip(texels, blockIndex);
+        gradientError = std::max(gradientError, error);
+        check(error <= lineBound(start, end), "gradient block exceeds the palette spacing bound", blockIndex);
+    }
+
+    // Cut-out alpha: two colours with alpha 0 and 255 in a random pattern, the endpoints can hold both exactly
+    for(uint32_t i = 0; i < RANDOM_BLOCKS / 4; i++, blockIndex++){
+        int start[4] = {uniform(0, 255), uniform(0, 255), uniform(0, 255), 0};
+        int end[4] = {uniform(0, 255), uniform(0, 255), uniform(0, 255), 255};
+        float positions[16];
+        for(int t = 0; t < 16; t++)
+            positions[t] = static_cast<float>(uniform(0, 1));
+        fillLine(texels, start, end, positions);
+        check(roundTrip(texels, blockIndex) <= QUANTIZATION_ERROR + 1, "cut-out alpha block isn't reproduced", blockIndex);
+    }
+
+    // Noise has no bound, it still has to be a valid block whose indices are the best for its endpoints
+    for(uint32_t i = 0; i < RANDOM_BLOCKS / 4; i++, blockIndex++){
+        for(auto& channel : texels)
+            channel = static_cast<uint8_t>(uniform(0, 255));
+        roundTrip(texels, blockIndex);
+    }
+
+    // Images whose size isn't a multiple of the block repeat the last row and column into the padding. The image is a
+    // diagonal gradient, so with its padding every block still lies on one line.
+    const uint32_t width = 7, height = 5;
+    const int imageStart[4] = {20, 240, 60, 255}, imageEnd[4] = {230, 10, 180, 100};
+    std::vector<uint8_t> image(width * height * 4);
+    for(uint32_t y = 0; y < height; y++){
+        for(uint32_t x = 0; x < width; x++){
+            for(int c = 0; c < 4; c++)
+                image[(y * width + x) * 4 + c] = static_cast<uint8_t>(std::lround(imageStart[c] + (imageEnd[c] - imageStart[c]) * static_cast<float>(x + y) / static_cast<float>(width + height - 2)));
+        }
+    }
+    size_t size = Renderer::BlockCompression::getBc7Size(width, height);
+    check(size == 2 * 2 * Renderer::BlockCompression::BC7_BLOCK_SIZE, "unexpected compressed size", blockIndex);
+    std::vector<uint8_t> blocks(size);
+    Renderer::BlockCompression::encodeBc7(image.data(), width, height, blocks.data());
+    for(uint32_t by = 0; by < 2; by++){
+        for(uint32_t bx = 0; bx < 2; bx++){
+            DecodedBlock decoded = decodeMode6(&blocks[(by * 2 + bx) * 16]);
+            check(decoded.isMode6, "image block isn't mode 6", blockIndex);
+            for(uint32_t t = 0; t < 16; t++){
+                uint32_t x = std::min(bx * 4 + t % 4, width - 1);
+                uint32_t y = std::min(by * 4 + t / 4, height - 1);
+                for(int c = 0; c < 4; c++){
+                    int difference = std::abs(image[(y * width + x) * 4 + c] - decoded.texels[t * 4 + c]);
+                    check(difference <= lineBound(imageStart, imageEnd), "image texel or its edge padding is decoded wrongly", blockIndex);
+                }
+            }
+        }
+    }
+
+    std::cout << "max error flat " << flatError << ", gradients " << gradientError << " over " << blockIndex << " blocks\n";
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
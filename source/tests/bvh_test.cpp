@@ -0,0 +1,150 @@
+#include "engine/culling/bvh.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Builds a Bvh over random boxes, applies random removes, reinserts and moves, then compares box, ray, raycast and
+// frustum queries against brute force over the boxes the tree reports storing for each item.
+namespace{
+    constexpr uint32_t ITEM_COUNT = 2000;
+    constexpr uint32_t OPERATION_COUNT = 3000;
+    constexpr uint32_t QUERY_COUNT = 200;
+    constexpr float RAY_LENGTH = 200.f;
+
+    std::mt19937 generator{3};
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t query){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "query " << query << ": " << message << '\n';
+    }
+
+    float uniform(float min, float max){
+        return std::uniform_real_distribution<float>{min, max}(generator);
+    }
+
+    Renderer::Bounds randomBox(){
+        glm::vec3 center{uniform(-50.f, 50.f), uniform(-50.f, 50.f), uniform(-50.f, 50.f)};
+        glm::vec3 extent{uniform(0.1f, 3.f), uniform(0.1f, 3.f), uniform(0.1f, 3.f)};
+        return {center - extent, center + extent};
+    }
+
+    // Slab test, returns the entry distance or a negative value on a miss
+    float intersectRay(const Renderer::Bounds& bounds, const glm::vec3& origin, const glm::vec3& direction){
+        float entryDistance = 0.f, exitDistance = RAY_LENGTH;
+        for(int axis = 0; axis < 3; axis++){
+            float first = (bounds.min[axis] - origin[axis]) / direction[axis];
+            float second = (bounds.max[axis] - origin[axis]) / direction[axis];
+            entryDistance = std::max(entryDistance, std::min(first, second));
+            exitDistance = std::min(exitDistance, std::max(first, second));
+            if(entryDistance > exitDistance)
+                return -1.f;
+        }
+        return entryDistance;
+    }
+}
+
+int main(){
+    std::vector<Renderer::Bvh::Item> items;
+    for(uint32_t i = 0; i < ITEM_COUNT; i++)
+        items.push_back({randomBox(), i});
+    Renderer::Bvh tree;
+    std::vector<uint32_t> proxies;
+    tree.build(items, proxies);
+    std::cout << "Cost after build: " << tree.getCost() << '\n';
+
+    // Boxes the leaves were grown to, queries report everything touching those
+    std::vector<bool> alive(ITEM_COUNT, true);
+    std::vector<Renderer::Bounds> stored(ITEM_COUNT);
+    for(uint32_t i = 0; i < ITEM_COUNT; i++)
+        stored[i] = tree.getBounds(proxies[i]);
+
+    for(uint32_t operation = 0; operation < OPERATION_COUNT; operation++){
+        uint32_t i = generator() % ITEM_COUNT;
+        if(!alive[i]){
+            items[i].bounds = randomBox();
+            proxies[i] = tree.insert(items[i].bounds, i);
+            alive[i] = true;
+        }
+        else if(generator() % 3 == 0){
+            tree.remove(proxies[i]);
+            alive[i] = false;
+            continue;
+        }
+        else{
+            glm::vec3 offset{uniform(-1.f, 1.f), uniform(-1.f, 1.f), uniform(-1.f, 1.f)};
+            items[i].bounds.min += offset;
+            items[i].bounds.max += offset;
+            tree.update(proxies[i], items[i].bounds);
+        }
+        stored[i] = tree.getBounds(proxies[i]);
+        check(stored[i].contains(items[i].bounds) && tree.getUserData(proxies[i]) == i, "leaf doesn't hold its item", operation);
+    }
+    std::cout << "Cost after " << OPERATION_COUNT << " operations: " << tree.getCost() << '\n';
+
+    for(uint32_t query = 0; query < QUERY_COUNT; query++){
+        Renderer::Bounds box = randomBox();
+        box.max += glm::vec3{10.f};
+        std::vector<uint32_t> results;
+        tree.queryBounds(box, results);
+        std::sort(results.begin(), results.end());
+        std::vector<uint32_t> expected;
+        for(uint32_t i = 0; i < ITEM_COUNT; i++)
+            if(alive[i] && stored[i].overlaps(box))
+                expected.push_back(i);
+        check(results == expected, "queryBounds differs from brute force", query);
+
+        glm::vec3 origin{uniform(-60.f, 60.f), uniform(-60.f, 60.f), uniform(-60.f, 60.f)};
+        glm::vec3 direction = glm::normalize(glm::vec3{uniform(-1.f, 1.f), uniform(-1.f, 1.f), uniform(-1.f, 1.f)});
+        uint32_t nearest = Renderer::Bvh::NULL_NODE;
+        float nearestDistance = RAY_LENGTH;
+        for(uint32_t i = 0; i < ITEM_COUNT; i++){
+            float distance = alive[i] ? intersectRay(stored[i], origin, direction) : -1.f;
+            if(distance >= 0.f && distance < nearestDistance){
+                nearest = i;
+                nearestDistance = distance;
+            }
+        }
+        float hitDistance = 0.f;
+        uint32_t hit = tree.raycast(origin, direction, RAY_LENGTH, hitDistance);
+        if(nearest == Renderer::Bvh::NULL_NODE)
+            check(hit == Renderer::Bvh::NULL_NODE, "raycast hit although no box is on the ray", query);
+        else
+            check(hit != Renderer::Bvh::NULL_NODE && std::abs(hitDistance - nearestDistance) <= 1e-4f, "raycast missed the nearest box", query);
+        results.clear();
+        tree.queryRay(origin, direction, RAY_LENGTH, results);
+        check(nearest == Renderer::Bvh::NULL_NODE || std::find(results.begin(), results.end(), nearest) != results.end(),
+            "queryRay misses the nearest box", query);
+
+        // Frustum of the six planes of a random cube
+        glm::vec3 center{uniform(-40.f, 40.f), uniform(-40.f, 40.f), uniform(-40.f, 40.f)};
+        float halfSize = uniform(2.f, 30.f);
+        Renderer::Frustum frustum;
+        frustum.planes = {
+            glm::vec4{1.f, 0.f, 0.f, halfSize - center.x}, glm::vec4{-1.f, 0.f, 0.f, halfSize + center.x},
+            glm::vec4{0.f, 1.f, 0.f, halfSize - center.y}, glm::vec4{0.f, -1.f, 0.f, halfSize + center.y},
+            glm::vec4{0.f, 0.f, 1.f, halfSize - center.z}, glm::vec4{0.f, 0.f, -1.f, halfSize + center.z}
+        };
+        results.clear();
+        tree.queryFrustum(frustum, results);
+        std::sort(results.begin(), results.end());
+        expected.clear();
+        for(uint32_t i = 0; i < ITEM_COUNT; i++)
+            if(alive[i] && frustum.intersectsBounds(stored[i]))
+                expected.push_back(i);
+        check(results == expected, "queryFrustum differs from brute force", query);
+    }
+
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+#include "engine/culling/frustum.hpp"
+#include "engine/camera/camera.hpp"
+#include "engine/object/object.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Checks the CPU reference of the cull.comp test. Frustum::fromMatrix() of a Camera perspective projection (zero to one
+// depth) has to give the planes of the view space frustum worked out by hand, and intersectsSphere()/isInstanceVisible()
+// have to agree with a brute force signed distance test against those planes for spheres inside, outside, straddling
+// every plane and with an infinite radius.
+namespace{
+    constexpr float FOVY = 1.0471976f;      // 60 degrees
+    constexpr float ASPECT = 16.f / 9.f;
+    constexpr float NEAR_DISTANCE = 0.5f;
+    constexpr float FAR_DISTANCE = 200.f;
+    constexpr float PLANE_TOLERANCE = 1e-5f;
+    constexpr float MARGIN = 1e-3f;         // Random spheres this close to touching a plane are skipped, float rounding decides them
+    constexpr uint32_t RANDOM_COUNT = 20000;
+
+    std::mt19937 generator{7};
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t index){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "case " << index << ": " << message << '\n';
+    }
+
+    float uniform(float min, float max){
+        return std::uniform_real_distribution<float>{min, max}(generator);
+    }
+
+    // Inward facing view space planes in the order fromMatrix() documents: left, right, bottom, top, near, far.
+    // The camera looks down +z, x' = x / (aspect * tan(fovy / 2)) and y' = y / tan(fovy / 2) have to stay within [-z, z].
+    std::array<glm::vec4, 6> expectedPlanes(){
+        float scaleX = 1.f / (ASPECT * std::tan(FOVY / 2.f));
+        float scaleY = 1.f / std::tan(FOVY / 2.f);
+        std::array<glm::vec4, 6> planes{
+            glm::vec4{scaleX, 0.f, 1.f, 0.f},
+            glm::vec4{-scaleX, 0.f, 1.f, 0.f},
+            glm::vec4{0.f, scaleY, 1.f, 0.f},
+            glm::vec4{0.f, -scaleY, 1.f, 0.f},
+            glm::vec4{0.f, 0.f, 1.f, -NEAR_DISTANCE},
+            glm::vec4{0.f, 0.f, -1.f, FAR_DISTANCE},
+        };
+        for(auto& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+        return planes;
+    }
+
+    // Brute force reference, the smallest signed distance of a view space point to the planes
+    float minDistance(const std::array<glm::vec4, 6>& planes, const glm::vec3& point){
+        float distance = std::numeric_limits<float>::infinity();
+        for(const auto& plane : planes)
+            distance = std::min(distance, glm::dot(glm::vec3(plane), point) + plane.w);
+        return distance;
+    }
+}
+
+int main(){
+    const std::array<glm::vec4, 6> viewPlanes = expectedPlanes();
+
+    Renderer::Camera camera;
+    camera.setPerspectiveProjection(FOVY, ASPECT, NEAR_DISTANCE, FAR_DISTANCE);
+
+    // Looking down +z from the origin, view space is world space and the planes can be compared directly
+    Renderer::Frustum frustum = Renderer::Frustum::fromMatrix(camera.getProjection() * camera.getView());
+    for(uint32_t i = 0; i < 6; i++){
+        glm::vec4 difference = frustum.planes[i] - viewPlanes[i];
+        check(glm::length(glm::vec3(difference)) <= PLANE_TOLERANCE && std::abs(difference.w) <= PLANE_TOLERANCE * FAR_DISTANCE,
+            "plane differs from the expected frustum plane", i);
+    }
+
+    // For every plane a point on it that is well inside the other five, spheres are moved along the plane's inward normal
+    // so they go from fully outside through touching to fully inside
+    const glm::vec3 pointsOnPlanes[6]{
+        {-ASPECT * std::tan(FOVY / 2.f) * 50.f, 0.f, 50.f},
+        {ASPECT * std::tan(FOVY / 2.f) * 50.f, 0.f, 50.f},
+        {0.f, -std::tan(FOVY / 2.f) * 50.f, 50.f},
+        {0.f, std::tan(FOVY / 2.f) * 50.f, 50.f},
+        {0.f, 0.f, NEAR_DISTANCE},
+        {0.f, 0.f, FAR_DISTANCE},
+    };
+    const float radius = 0.25f;
+    const float offsets[]{-3.f * radius, -1.01f * radius, -0.99f * radius, 0.f, 0.5f * radius, 1.01f * radius};
+    for(uint32_t plane = 0; plane < 6; plane++){
+        glm::vec3 normal{viewPlanes[plane]};
+        for(float offset : offsets){
+            glm::vec3 center = pointsOnPlanes[plane] + normal * offset;
+            bool expected = offset >= -radius;
+            check(frustum.intersectsSphere(center, radius) == expected, "sphere against a single plane is misclassified", plane);
+            check((minDistance(viewPlanes, center) >= -radius) == expected, "reference disagrees on a single plane sphere", plane);
+            check(frustum.intersectsSphere(center, std::numeric_limits<float>::infinity()), "infinite sphere is culled", plane);
+        }
+        // Touching counts as visible, a tiny sphere centred on the plane is kept whichever way the centre rounds
+        check(frustum.intersectsSphere(pointsOnPlanes[plane], MARGIN), "sphere centred on the plane is culled", plane);
+    }
+    check(frustum.intersectsSphere(glm::vec3{0.f, 0.f, 100.f}, 1.f), "sphere in the middle is culled", 0);
+    check(!frustum.intersectsSphere(glm::vec3{0.f, 0.f, -100.f}, 1.f), "sphere behind the camera is visible", 0);
+    check(frustum.intersectsSphere(glm::vec3{0.f, 0.f, -100.f}, std::numeric_limits<float>::infinity()),
+        "infinite sphere behind the camera is culled", 0);
+    check(frustum.intersectsSphere(glm::vec3{0.f, 0.f, -100.f}, 1000.f), "sphere containing the frustum is culled", 0);
+
+    // Random instances seen by a moved and rotated camera. The view matrix is rigid, so distances to the view space planes
+    // are distances in world space too.
+    camera.setViewDirection(glm::vec3{10.f, -5.f, 3.f}, glm::vec3{1.f, 0.5f, 2.f});
+    frustum = Renderer::Frustum::fromMatrix(camera.getProjection() * camera.getView());
+    uint32_t visibleCount = 0, testedCount = 0;
+    for(uint32_t i = 0; i < RANDOM_COUNT; i++){
+        Renderer::TransformComponent transform{};
+        transform.translation = {uniform(-150.f, 150.f), uniform(-150.f, 150.f), uniform(-150.f, 250.f)};
+        transform.rotation = {uniform(-3.f, 3.f), uniform(-3.f, 3.f), uniform(-3.f, 3.f)};
+        transform.scale = {uniform(0.1f, 5.f), uniform(0.1f, 5.f), uniform(0.1f, 5.f)};
+        glm::vec4 boundingSphere{uniform(-2.f, 2.f), uniform(-2.f, 2.f), uniform(-2.f, 2.f), uniform(0.f, 10.f)};
+        glm::mat4 model = transform.mat4();
+
+        glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(boundingSphere), 1.f));
+        float worldRadius = boundingSphere.w * std::max({std::abs(transform.scale.x), std::abs(transform.scale.y), std::abs(transform.scale.z)});
+        float distance = minDistance(viewPlanes, glm::vec3(camera.getView() * glm::vec4(center, 1.f)));
+        if(std::abs(distance + worldRadius) < MARGIN)
+            continue;
+        bool expected = distance >= -worldRadius;
+        testedCount++;
+        visibleCount += expected;
+        check(frustum.intersectsSphere(center, worldRadius) == expected, "random sphere is misclassified", i);
+        check(frustum.isInstanceVisible(model, boundingSphere) == expected, "random instance is misclassified", i);
+        check(frustum.isInstanceVisible(model, glm::vec4{glm::vec3(boundingSphere), std::numeric_limits<float>::infinity()}),
+            "instance with an infinite bounding sphere is culled", i);
+    }
+    // Both outcomes have to be exercised for the comparison to mean anything
+    check(visibleCount > testedCount / 20 && visibleCount < testedCount - testedCount / 20, "random instances are not mixed", 0);
+
+    std::cout << visibleCount << " of " << testedCount << " random instances visible\n";
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#include "engine/material/texture/mip_generator.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Compares MipGenerator::generate() with the box filter against a scalar reference that converts to linear space with the
+// exact sRGB curve in double precision, averages each 2x2 footprint (the last row or column of an odd side isn't read,
+// sides of one texel are copied) and converts back. Each level is checked against the reference applied to the level
+// the generator produced before it, so the 8-bit rounding of one level doesn't carry into the next. Sizes are odd, one
+// texel wide or tall and taller than one band of rows. Flat images have to stay flat with both filters.
+namespace{
+    constexpr int TOLERANCE = 1;        // 8-bit steps, the generator goes through lookup tables
+
+    struct Size{
+        uint32_t width, height;
+    };
+
+    constexpr Size SIZES[]{ {1, 1}, {2, 1}, {1, 7}, {7, 1}, {3, 3}, {5, 3}, {13, 9}, {33, 40}, {255, 3}, {64, 37} };
+
+    std::mt19937 generator{3};
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t index){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "image " << index << ": " << message << '\n';
+    }
+
+    double toLinear(uint8_t value){
+        double v = value / 255.0;
+        return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    }
+
+    uint8_t toSrgb(double value){
+        value = std::clamp(value, 0.0, 1.0);
+        value = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+        return static_cast<uint8_t>(std::lround(value * 255.0));
+    }
+
+    std::vector<uint8_t> referenceBox(const std::vector<uint8_t>& source, uint32_t width, uint32_t height){
+        uint32_t destinationWidth = std::max(width / 2, 1u);
+        uint32_t destinationHeight = std::max(height / 2, 1u);
+        uint32_t footprintX = width == 1 ? 1 : 2;
+        uint32_t footprintY = height == 1 ? 1 : 2;
+        std::vector<uint8_t> destination(static_cast<size_t>(destinationWidth) * destinationHeight * 4);
+        for(uint32_t y = 0; y < destinationHeight; y++){
+            for(uint32_t x = 0; x < destinationWidth; x++){
+                double sums[4] = {};
+                for(uint32_t sy = 0; sy < footprintY; sy++){
+                    for(uint32_t sx = 0; sx < footprintX; sx++){
+                        const uint8_t* texel = &source[((static_cast<size_t>(y) * footprintY + sy) * width + x * footprintX + sx) * 4];
+                        for(int c = 0; c < 3; c++)
+                            sums[c] += toLinear(texel[c]);
+                        sums[3] += texel[3] / 255.0;
+                    }
+                }
+                double count = footprintX * footprintY;
+                uint8_t* texel = &destination[(static_cast<size_t>(y) * destinationWidth + x) * 4];
+                for(int c = 0; c < 3; c++)
+                    texel[c] = toSrgb(sums[c] / count);
+                texel[3] = static_cast<uint8_t>(std::lround(std::clamp(sums[3] / count, 0.0, 1.0) * 255.0));
+            }
+        }
+        return destination;
+    }
+
+    int maxDifference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b){
+        int difference = 0;
+        for(size_t i = 0; i < std::min(a.size(), b.size()); i++)
+            difference = std::max(difference, std::abs(a[i] - b[i]));
+        return difference;
+    }
+}
+
+int main(){
+    std::uniform_int_distribution<int> channel{0, 255};
+    int maxError = 0;
+    uint32_t levelCount = 0;
+
+    for(uint32_t i = 0; i < std::size(SIZES); i++){
+        auto [width, height] = SIZES[i];
+        std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+        for(auto& value : image)
+            value = static_cast<uint8_t>(channel(generator));
+
+        std::vector<Renderer::MipGenerator::Level> levels = Renderer::MipGenerator::generate(image.data(), width, height, Renderer::MipGenerator::Filter::Box);
+        uint32_t expectedCount = 0;
+        for(uint32_t w = width, h = height; w > 1 || h > 1; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+            expectedCount++;
+        check(levels.size() == expectedCount, "wrong number of levels", i);
+
+        std::vector<uint8_t> source = image;
+        uint32_t sourceWidth = width, sourceHeight = height;
+        for(auto& level : levels){
+            check(level.width == std::max(sourceWidth / 2, 1u) && level.height == std::max(sourceHeight / 2, 1u), "wrong level size", i);
+            check(level.pixels.size() == static_cast<size_t>(level.width) * level.height * 4, "wrong level pixel count", i);
+            if(level.width != std::max(sourceWidth / 2, 1u) || level.height != std::max(sourceHeight / 2, 1u))
+                break;
+
+            int error = maxDifference(level.pixels, referenceBox(source, sourceWidth, sourceHeight));
+            maxError = std::max(maxError, error);
+            check(error <= TOLERANCE, "level differs from the scalar linear space box filter", i);
+            levelCount++;
+
+            source = level.pixels;
+            sourceWidth = level.width;
+            sourceHeight = level.height;
+        }
+    }
+
+    // Weights of both filters sum to one, a flat image keeps its colour down to 1x1
+    const Renderer::MipGenerator::Filter filters[]{ Renderer::MipGenerator::Filter::Box, Renderer::MipGenerator::Filter::Kaiser };
+    for(uint32_t i = 0; i < std::size(SIZES); i++){
+        auto [width, height] = SIZES[i];
+        const uint8_t colour[4] = {static_cast<uint8_t>(channel(generator)), static_cast<uint8_t>(channel(generator)),
+            static_cast<uint8_t>(channel(generator)), static_cast<uint8_t>(channel(generator))};
+        std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+        for(size_t t = 0; t < image.size(); t += 4)
+            std::copy(colour, colour + 4, &image[t]);
+        for(auto filter : filters){
+            for(auto& level : Renderer::MipGenerator::generate(image.data(), width, height, filter)){
+                for(size_t t = 0; t < level.pixels.size(); t += 4){
+                    for(int c = 0; c < 4; c++)
+                        check(std::abs(level.pixels[t + c] - colour[c]) <= TOLERANCE, "flat image doesn't stay flat", i);
+                }
+            }
+        }
+    }
+
+    std::cout << levelCount << " levels, max error " << maxError << '\n';
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
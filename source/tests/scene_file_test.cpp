@@ -0,0 +1,360 @@
+#include "engine/scene/scene_file.hpp"
+#include "engine/io/json.hpp"
+#include "engine/io/file_utils.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <cstdlib>
+
+// Saves a small scene as binary and as JSON and loads it back, every record has to come back unchanged. Truncated and
+// corrupted binary files and records referring past their sections have to be rejected when the file is opened. The JSON
+// parser is checked on its own for escapes (surrogate pairs included) and the number grammar.
+namespace{
+    using Renderer::SceneFile;
+    using Renderer::JsonValue;
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t index){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "case " << index << ": " << message << '\n';
+    }
+
+    bool throws(const std::function<void()>& function){
+        try{
+            function();
+        }
+        catch(const std::runtime_error&){
+            return true;
+        }
+        return false;
+    }
+
+    // Records only hold 32-bit fields, so comparing their bytes compares every field
+    template<typename T>
+    bool sameRecords(std::span<const T> a, std::span<const T> b){
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+    }
+
+    std::vector<char> readFile(const std::filesystem::path& path){
+        std::ifstream in{path, std::ios::binary};
+        return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    }
+
+    void writeFile(const std::filesystem::path& path, const char* data, size_t size){
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        out.write(data, static_cast<std::streamsize>(size));
+    }
+
+    // Paths with characters JSON has to escape, floats that need all 9 digits and unset indices
+    SceneFile::Contents makeContents(){
+        SceneFile::Contents contents;
+        SceneFile::SamplerRecord sampler{};
+        sampler.magFilter = 1;
+        sampler.addressModeU = 2;
+        sampler.anisotropyEnable = 1;
+        sampler.maxAnisotropy = 16.f;
+        sampler.maxLod = 1000.f;
+        sampler.mipLodBias = -0.1f;
+        contents.samplers = {sampler, SceneFile::SamplerRecord{}};
+
+        contents.textures.push_back({contents.addString("textures/brick \"old\".png"), 0});
+        contents.textures.push_back({contents.addString("textures\\back\tslash\n.png"), 1});
+        contents.textures.push_back({contents.addString("textures/caf\xc3\xa9_\xf0\x9f\x98\x80.png"), 1});
+        contents.models.push_back({contents.addString("models/cube.obj")});
+        contents.models.push_back({contents.addString("")});
+
+        SceneFile::MaterialRecord plain{};
+        SceneFile::MaterialRecord textured{};
+        textured.opacity = 0.3f;
+        textured.shininess = 1.0e-7f;
+        textured.diffuseColour[1] = 0.123456789f;
+        textured.hue[3] = -3.4e38f;
+        contents.textureReferences = {2, 0, 1};
+        textured.firstDiffuseTexture = 0;
+        textured.diffuseTextureCount = 2;
+        textured.firstNormalTexture = 2;
+        textured.normalTextureCount = 1;
+        contents.materials = {plain, textured};
+
+        SceneFile::MeshRecord mesh{};
+        mesh.model = 0;
+        mesh.material = 1;
+        SceneFile::MeshRecord light{};
+        light.emitLight = 1;
+        light.brightness = 2.5f;
+        light.width = 0.7f;
+        light.lightDirection[0] = 0.577350269f;
+        light.lightHue[2] = 0.1f;
+        contents.meshes = {mesh, light, SceneFile::MeshRecord{1, SceneFile::NONE}};
+
+        SceneFile::ObjectRecord object{};
+        object.translation[0] = -12.75f;
+        object.rotation[1] = 3.14159274f;
+        object.scale[2] = 0.01f;
+        object.meshCount = 2;
+        object.meshes[0] = 0;
+        object.meshes[1] = 1;
+        SceneFile::ObjectRecord full{};
+        full.meshCount = Renderer::Object::MAX_MESHES;
+        for(uint32_t i = 0; i < full.meshCount; i++)
+            full.meshes[i] = i % 3;
+        contents.objects = {object, full, SceneFile::ObjectRecord{}};
+        return contents;
+    }
+
+    void checkSameTextureList(const SceneFile& a, uint32_t firstA, const SceneFile& b, uint32_t firstB, uint32_t count, uint32_t index){
+        for(uint32_t i = 0; i < count; i++)
+            check(a.getTextureReferences()[firstA + i] == b.getTextureReferences()[firstB + i], "texture list differs", index);
+    }
+
+    // Binary files keep every record as it is. JSON rebuilds the string table and the texture reference lists per material,
+    // so paths and texture lists are compared by their contents.
+    void checkSameScene(const SceneFile& a, const SceneFile& b, bool exactReferences, uint32_t index){
+        check(sameRecords(a.getSamplers(), b.getSamplers()), "samplers differ", index);
+        check(sameRecords(a.getMeshes(), b.getMeshes()), "meshes differ", index);
+        check(sameRecords(a.getObjects(), b.getObjects()), "objects differ", index);
+        check(a.getTextures().size() == b.getTextures().size() && a.getModels().size() == b.getModels().size() &&
+            a.getMaterials().size() == b.getMaterials().size(), "section sizes differ", index);
+        for(size_t i = 0; i < std::min(a.getTextures().size(), b.getTextures().size()); i++){
+            check(a.getString(a.getTextures()[i].path) == b.getString(b.getTextures()[i].path), "texture path differs", index);
+            check(a.getTextures()[i].sampler == b.getTextures()[i].sampler, "texture sampler differs", index);
+        }
+        for(size_t i = 0; i < std::min(a.getModels().size(), b.getModels().size()); i++)
+            check(a.getString(a.getModels()[i].path) == b.getString(b.getModels()[i].path), "model path differs", index);
+        if(exactReferences){
+            check(sameRecords(a.getTextures(), b.getTextures()) && sameRecords(a.getModels(), b.getModels()), "path records differ", index);
+            check(sameRecords(a.getMaterials(), b.getMaterials()), "materials differ", index);
+            check(sameRecords(a.getTextureReferences(), b.getTextureReferences()), "texture references differ", index);
+            return;
+        }
+        for(size_t i = 0; i < std::min(a.getMaterials().size(), b.getMaterials().size()); i++){
+            const auto& x = a.getMaterials()[i];
+            const auto& y = b.getMaterials()[i];
+            check(x.opacity == y.opacity && x.shininess == y.shininess && std::memcmp(x.diffuseColour, y.diffuseColour, sizeof(x.diffuseColour)) == 0 &&
+                std::memcmp(x.specularColour, y.specularColour, sizeof(x.specularColour)) == 0 && std::memcmp(x.hue, y.hue, sizeof(x.hue)) == 0,
+                "material values differ", index);
+            check(x.diffuseTextureCount == y.diffuseTextureCount && x.normalTextureCount == y.normalTextureCount, "material texture counts differ", index);
+            if(x.diffuseTextureCount == y.diffuseTextureCount)
+                checkSameTextureList(a, x.firstDiffuseTexture, b, y.firstDiffuseTexture, x.diffuseTextureCount, index);
+            if(x.normalTextureCount == y.normalTextureCount)
+                checkSameTextureList(a, x.firstNormalTexture, b, y.firstNormalTexture, x.normalTextureCount, index);
+        }
+    }
+
+    bool parses(std::string_view text){
+        return !throws([&]{ JsonValue::parse(text); });
+    }
+
+    void checkString(std::string_view json, std::string_view expected, uint32_t index){
+        std::string parsed;
+        check(!throws([&]{ parsed = JsonValue::parse(json).asString(); }) && parsed == expected, "string escape is decoded wrongly", index);
+    }
+
+    void checkNumber(std::string_view json, double expected, uint32_t index){
+        double parsed = 0.0;
+        check(!throws([&]{ parsed = JsonValue::parse(json).asNumber(); }) && parsed == expected, "number is parsed wrongly", index);
+    }
+
+    void checkJsonParser(){
+        checkString(R"("plain")", "plain", 0);
+        checkString(R"("\"\\\/\b\f\n\r\t")", "\"\\/\b\f\n\r\t", 1);
+        checkString(R"("Aé€")", "A\xc3\xa9\xe2\x82\xac", 2);
+        checkString(R"("😀 𝄞")", "\xf0\x9f\x98\x80 \xf0\x9d\x84\x9e", 3);
+        checkString("\"caf\xc3\xa9\"", "caf\xc3\xa9", 4);
+
+        // Surrogates have to come as a high one followed by a low one
+        const char* invalidStrings[]{ R"("\ud83d")", R"("\ud83dx")", R"("\ud83dA")", R"("\ud83d\ud83d")", R"("\ude00")",
+            R"("\ude00\ud83d")", R"("\u12")", R"("\u12g4")", R"("\x")", "\"unterminated", "\"raw\nnewline\"", "\"raw\ttab\"" };
+        for(uint32_t i = 0; i < std::size(invalidStrings); i++)
+            check(!parses(invalidStrings[i]), "invalid string is accepted", 100 + i);
+
+        // writeString() output parses back to the same bytes, every control character included
+        std::string everything;
+        for(int c = 1; c < 128; c++)
+            everything += static_cast<char>(c);
+        everything += "\xc3\xa9\xf0\x9f\x98\x80";
+        std::ostringstream written;
+        JsonValue::writeString(written, everything);
+        checkString(written.str(), everything, 5);
+
+        checkNumber("0", 0.0, 10);
+        checkNumber("-0", -0.0, 11);
+        checkNumber("12", 12.0, 12);
+        checkNumber("-3.25", -3.25, 13);
+        checkNumber("1e3", 1000.0, 14);
+        checkNumber("1E+3", 1000.0, 15);
+        checkNumber("2.5e-3", 2.5e-3, 16);
+        checkNumber("0.1", 0.1, 17);
+        checkNumber(" 1.7976931348623157e308 ", 1.7976931348623157e308, 18);
+        check(JsonValue::parse("[1,-2.5,3e1]").asArray().size() == 3, "number array is parsed wrongly", 19);
+
+        const char* invalidNumbers[]{ "01", "-01", ".5", "1.", "+1", "-", "1e", "1e+", "--1", "1.e3", "0x10", "1e999", "NaN", "Infinity", "-Infinity", "1 2" };
+        for(uint32_t i = 0; i < std::size(invalidNumbers); i++)
+            check(!parses(invalidNumbers[i]), "invalid number is accepted", 200 + i);
+    }
+
+    // Every way a record can point outside its section, each has to be rejected when the scene is opened
+    void checkInvalidIndices(){
+        const std::function<void(SceneFile::Contents&)> breakers[]{
+            [](SceneFile::Contents& c){ c.textures[0].sampler = static_cast<uint32_t>(c.samplers.size()); },
+            [](SceneFile::Contents& c){ c.textures[1].path.offset = static_cast<uint32_t>(c.strings.size()); c.textures[1].path.length = 1; },
+            [](SceneFile::Contents& c){ c.models[0].path.length = static_cast<uint32_t>(c.strings.size()) + 1; },
+            [](SceneFile::Contents& c){ c.models[0].path = {~0u, 2}; },
+            [](SceneFile::Contents& c){ c.textureReferences[1] = static_cast<uint32_t>(c.textures.size()); },
+            [](SceneFile::Contents& c){ c.materials[1].firstNormalTexture = static_cast<uint32_t>(c.textureReferences.size()); },
+            [](SceneFile::Contents& c){ c.materials[1].diffuseTextureCount = ~0u; },
+            [](SceneFile::Contents& c){ c.meshes[0].model = static_cast<uint32_t>(c.models.size()); },
+            [](SceneFile::Contents& c){ c.meshes[1].material = static_cast<uint32_t>(c.materials.size()); },
+            [](SceneFile::Contents& c){ c.objects[0].meshes[1] = static_cast<uint32_t>(c.meshes.size()); },
+            [](SceneFile::Contents& c){ c.objects[1].meshCount = Renderer::Object::MAX_MESHES + 1; },
+        };
+        for(uint32_t i = 0; i < std::size(breakers); i++){
+            SceneFile::Contents contents = makeContents();
+            breakers[i](contents);
+            check(throws([&]{ SceneFile{std::move(contents)}; }), "out of range record is accepted", 300 + i);
+        }
+    }
+
+    void checkInvalidJson(const std::filesystem::path& directory){
+        const char* invalidScenes[]{
+            R"({"samplers":[{}],"textures":[{"path":"a.png","sampler":1}]})",
+            R"({"samplers":[{}],"textures":[{"path":"a.png","sampler":-1}]})",
+            R"({"samplers":[{}],"textures":[{"path":"a.png","sampler":0.5}]})",
+            R"({"meshes":[{"model":0}]})",
+            R"({"meshes":[{"material":4294967295}]})",
+            R"({"meshes":[{}],"objects":[{"meshes":[0,1]}]})",
+            R"({"meshes":[{}],"objects":[{"meshes":[0,0,0,0,0,0,0,0,0]}]})",
+            R"({"textures":[],"materials":[{"diffuseTextures":[0]}]})",
+            R"({"version":2})",
+            R"([])",
+            R"({"samplers":[{}],"textures":[{"path":"\ud83d","sampler":0}]})",
+        };
+        const std::filesystem::path path = directory / "invalid.json";
+        for(uint32_t i = 0; i < std::size(invalidScenes); i++){
+            writeFile(path, invalidScenes[i], std::strlen(invalidScenes[i]));
+            check(throws([&]{ SceneFile{path.string()}; }), "invalid JSON scene is accepted", 400 + i);
+        }
+        const char* minimal = R"({"meshes":[{"model":null,"material":null}],"objects":[{"meshes":[0]}]})";
+        writeFile(path, minimal, std::strlen(minimal));
+        check(!throws([&]{ SceneFile{path.string()}; }), "minimal JSON scene is rejected", 450);
+    }
+
+    void checkDamagedBinary(const std::filesystem::path& directory, const std::vector<char>& file){
+        const std::filesystem::path path = directory / "damaged.rscn";
+        auto rejects = [&](const std::vector<char>& data){
+            writeFile(path, data.data(), data.size());
+            return throws([&]{ SceneFile{path.string()}; });
+        };
+
+        writeFile(path, file.data(), file.size());
+        check(!throws([&]{ SceneFile{path.string()}; }), "undamaged copy is rejected", 500);
+
+        // Truncated anywhere, including within the header and right after it
+        const size_t lengths[]{ 0, 4, sizeof(SceneFile::Header) - 1, sizeof(SceneFile::Header), sizeof(SceneFile::Header) + 1, file.size() / 2, file.size() - 1 };
+        for(uint32_t i = 0; i < std::size(lengths); i++)
+            check(rejects(std::vector<char>(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(lengths[i]))), "truncated file is accepted", 510 + i);
+        std::vector<char> extended = file;
+        extended.push_back(0);
+        check(rejects(extended), "file with trailing data is accepted", 520);
+
+        // A flipped bit anywhere in the data breaks the hash
+        for(size_t offset = sizeof(SceneFile::Header); offset < file.size(); offset += 7){
+            std::vector<char> damaged = file;
+            damaged[offset] ^= 0x10;
+            check(rejects(damaged), "corrupted data is accepted", static_cast<uint32_t>(600 + offset));
+        }
+
+        // Header fields that aren't covered by the hash are checked on their own
+        SceneFile::Header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        auto withHeader = [&](const std::function<void(SceneFile::Header&)>& change){
+            SceneFile::Header changed = header;
+            change(changed);
+            std::vector<char> data = file;
+            std::memcpy(data.data(), &changed, sizeof(changed));
+            return data;
+        };
+        check(rejects(withHeader([](SceneFile::Header& h){ h.magic[3] = 'X'; })), "wrong magic is accepted", 530);
+        check(rejects(withHeader([](SceneFile::Header& h){ h.version++; })), "wrong version is accepted", 531);
+        check(rejects(withHeader([](SceneFile::Header& h){ h.dataHash ^= 1; })), "wrong hash is accepted", 532);
+        check(rejects(withHeader([&](SceneFile::Header& h){ h.sectionOffsets[SceneFile::OBJECTS] = file.size() + SceneFile::SECTION_ALIGNMENT; })),
+            "section past the end is accepted", 533);
+        check(rejects(withHeader([](SceneFile::Header& h){ h.sectionOffsets[SceneFile::MESHES] += 4; })), "misaligned section is accepted", 534);
+        check(rejects(withHeader([](SceneFile::Header& h){ h.sectionOffsets[SceneFile::STRINGS] = 0; })), "section inside the header is accepted", 535);
+        check(rejects(withHeader([](SceneFile::Header& h){ h.sectionCounts[SceneFile::OBJECTS] = ~0u; })), "oversized section is accepted", 536);
+
+        // Out of range indices with a matching hash, as a buggy writer would produce them, are caught by validation
+        std::vector<char> badIndex = file;
+        size_t meshOffset = header.sectionOffsets[SceneFile::MESHES];
+        uint32_t missingModel = 100;
+        std::memcpy(badIndex.data() + meshOffset + offsetof(SceneFile::MeshRecord, model), &missingModel, sizeof(missingModel));
+        header.dataHash = Renderer::FileUtils::hash(badIndex.data() + sizeof(header), badIndex.size() - sizeof(header));
+        std::memcpy(badIndex.data(), &header, sizeof(header));
+        check(rejects(badIndex), "out of range index in a binary file is accepted", 540);
+    }
+}
+
+int main(){
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "renderer_scene_file_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::string binaryPath = (directory / "scene.rscn").string();
+    const std::string jsonPath = (directory / "scene.json").string();
+
+    checkJsonParser();
+    checkInvalidIndices();
+    checkInvalidJson(directory);
+
+    try{
+        SceneFile original{makeContents()};
+
+        original.write(binaryPath);
+        SceneFile binary{binaryPath};
+        checkSameScene(original, binary, true, 0);
+
+        original.write(jsonPath);
+        SceneFile json{jsonPath};
+        checkSameScene(original, json, false, 1);
+
+        // Back to binary from JSON and through JSON again, nothing may drift
+        json.write(binaryPath);
+        SceneFile fromJson{binaryPath};
+        checkSameScene(json, fromJson, true, 2);
+        fromJson.write(jsonPath);
+        checkSameScene(original, SceneFile{jsonPath}, false, 3);
+
+        // Empty scenes have empty sections at the end of the file
+        SceneFile empty{SceneFile::Contents{}};
+        const std::string emptyPath = (directory / "empty.rscn").string();
+        empty.write(emptyPath);
+        SceneFile emptyLoaded{emptyPath};
+        check(emptyLoaded.getObjects().empty() && emptyLoaded.getTextures().empty(), "empty scene isn't empty after loading", 4);
+
+        original.write(binaryPath);
+        checkDamagedBinary(directory, readFile(binaryPath));
+        check(throws([&]{ SceneFile{(directory / "missing.rscn").string()}; }), "missing file is accepted", 5);
+    }
+    catch(const std::exception& e){
+        std::cerr << e.what() << '\n';
+        failures++;
+    }
+
+    std::filesystem::remove_all(directory);
+    std::cout << "scene file round trips done\n";
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#include "engine/scene/slot_map.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+
+// Runs random inserts and erases on a SlotMap against a plain map of live handles. Every handle ever returned is kept:
+// live ones have to find their own value, erased ones have to be rejected even after their slot was reused. The packed
+// array, handleAt() and iteration are checked after every batch of swap-removes.
+namespace{
+    constexpr uint32_t OPERATION_COUNT = 20000;
+    constexpr uint32_t CHECK_INTERVAL = 500;
+
+    struct Item{
+        uint32_t id;
+        std::string name;   // Owns memory, so moving into the erased element's place is exercised
+    };
+
+    using ItemHandle = Renderer::Handle<Item>;
+
+    std::mt19937 generator{11};
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, uint32_t operation){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "operation " << operation << ": " << message << '\n';
+    }
+
+    uint64_t key(ItemHandle handle){
+        return (static_cast<uint64_t>(handle.generation) << 32) | handle.index;
+    }
+
+    // Every live element is reachable through its handle, the packed arrays and handleAt() agree with each other and
+    // free slots report no handle
+    void checkConsistency(Renderer::SlotMap<Item>& map, const std::unordered_map<uint64_t, uint32_t>& live, uint32_t operation){
+        check(map.size() == live.size(), "size differs from the live handle count", operation);
+        check(map.values().size() == map.handles().size(), "packed values and handles differ in size", operation);
+
+        std::vector<bool> slotUsed(map.slotCount(), false);
+        for(size_t i = 0; i < map.handles().size(); i++){
+            ItemHandle handle = map.handles()[i];
+            auto found = live.find(key(handle));
+            check(found != live.end(), "packed array holds a handle that isn't live", operation);
+            if(found == live.end())
+                continue;
+            check(map.values()[i].id == found->second && map.values()[i].name == std::to_string(found->second),
+                "packed value doesn't belong to its handle", operation);
+            check(map.handleAt(handle.index) == handle, "handleAt() doesn't return the slot's handle", operation);
+            check(map.find(handle) == &map.values()[i], "handle doesn't point at its packed element", operation);
+            check(handle.index < slotUsed.size() && !slotUsed[handle.index], "slot is used twice", operation);
+            if(handle.index < slotUsed.size())
+                slotUsed[handle.index] = true;
+        }
+        for(uint32_t slot = 0; slot < slotUsed.size(); slot++)
+            if(!slotUsed[slot])
+                check(!map.handleAt(slot).isValid(), "handleAt() of a free slot is valid", operation);
+        check(!map.handleAt(static_cast<uint32_t>(map.slotCount())).isValid(), "handleAt() past the slots is valid", operation);
+
+        uint64_t iteratedSum = 0, expectedSum = 0;
+        size_t iterated = 0;
+        for(auto& item : map){
+            iteratedSum += item.id;
+            iterated++;
+        }
+        for(auto& [handleKey, id] : live)
+            expectedSum += id;
+        check(iterated == live.size() && iteratedSum == expectedSum, "iteration doesn't visit exactly the live elements", operation);
+    }
+}
+
+int main(){
+    Renderer::SlotMap<Item> map;
+    std::unordered_map<uint64_t, uint32_t> live;    // Handle key to id
+    std::vector<ItemHandle> liveHandles;
+    std::vector<ItemHandle> staleHandles;
+    uint32_t nextId = 0;
+
+    // Default handles and handles into an empty map point at nothing
+    check(!ItemHandle{}.isValid() && !map.contains(ItemHandle{}), "default handle is valid", 0);
+    check(!map.contains(ItemHandle{0, 0}) && map.find(ItemHandle{0, 0}) == nullptr, "handle into an empty map is found", 0);
+
+    // Erasing and inserting again reuses the slot with a new generation, the old handle stays rejected
+    {
+        ItemHandle first = map.insert({nextId, std::to_string(nextId)});
+        live[key(first)] = nextId++;
+        ItemHandle second = map.insert({nextId, std::to_string(nextId)});
+        live[key(second)] = nextId++;
+        map.erase(first);
+        live.erase(key(first));
+        ItemHandle reused = map.insert({nextId, std::to_string(nextId)});
+        live[key(reused)] = nextId++;
+        check(reused.index == first.index, "erased slot isn't reused", 0);
+        check(reused.generation != first.generation, "reused slot keeps its generation", 0);
+        check(!map.contains(first) && map.find(first) == nullptr, "stale handle is accepted after its slot was reused", 0);
+        check(map.find(reused) != nullptr && map.find(reused)->id == live[key(reused)], "reused slot's handle finds the wrong value", 0);
+        check(map.find(second) != nullptr && map.find(second)->id == live[key(second)], "other handle lost its value", 0);
+        // Same slot with a generation that was never handed out
+        check(!map.contains({reused.index, reused.generation + 5}), "handle with a future generation is accepted", 0);
+        check(!map.contains({static_cast<uint32_t>(map.slotCount()), 0}), "handle past the slots is accepted", 0);
+        staleHandles.push_back(first);
+        liveHandles = {second, reused};
+        checkConsistency(map, live, 0);
+    }
+
+    std::uniform_int_distribution<int> percent{0, 99};
+    for(uint32_t operation = 1; operation <= OPERATION_COUNT; operation++){
+        // Grows early and shrinks late, so slots are reused under both a growing and a shrinking map
+        int insertChance = operation < OPERATION_COUNT / 2 ? 60 : 40;
+        if(liveHandles.empty() || percent(generator) < insertChance){
+            ItemHandle handle = map.insert({nextId, std::to_string(nextId)});
+            check(!live.contains(key(handle)), "insert returned a live handle", operation);
+            live[key(handle)] = nextId++;
+            liveHandles.push_back(handle);
+        }
+        else{
+            size_t victim = std::uniform_int_distribution<size_t>{0, liveHandles.size() - 1}(generator);
+            ItemHandle handle = liveHandles[victim];
+            map.erase(handle);
+            live.erase(key(handle));
+            liveHandles[victim] = liveHandles.back();
+            liveHandles.pop_back();
+            staleHandles.push_back(handle);
+            check(!map.contains(handle) && map.find(handle) == nullptr, "erased handle is still accepted", operation);
+        }
+
+        if(operation % CHECK_INTERVAL != 0)
+            continue;
+        checkConsistency(map, live, operation);
+        for(ItemHandle handle : liveHandles)
+            check(map.contains(handle) && map.find(handle)->id == live[key(handle)], "live handle finds the wrong value", operation);
+        for(ItemHandle handle : staleHandles)
+            check(!map.contains(handle) && map.find(handle) == nullptr, "stale handle is accepted", operation);
+    }
+
+    map.clear();
+    live.clear();
+    checkConsistency(map, live, OPERATION_COUNT);
+    for(ItemHandle handle : liveHandles)
+        check(!map.contains(handle), "handle is accepted after clear()", OPERATION_COUNT);
+
+    std::cout << nextId << " inserts, " << staleHandles.size() << " erases over " << map.slotCount() << " slots\n";
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
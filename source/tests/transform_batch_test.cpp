@@ -0,0 +1,95 @@
+#include "engine/object/transform_batch.hpp"
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+// Checks TransformBatch::computeMatrices() against TransformComponent::mat4() and normalMatrix(). The SIMD sine/cosine
+// differs from std::sin/std::cos by less than 1e-7 absolute, the nine rotation terms multiply up to three of them, so every
+// element has to be within TOLERANCE of the reference relative to the scale of its column.
+namespace{
+    constexpr float TOLERANCE = 1e-6f;
+
+    int failures = 0;
+
+    void check(bool condition, const char* message, size_t index){
+        if(condition)
+            return;
+        if(failures++ < 10)
+            std::cerr << "transform " << index << ": " << message << '\n';
+    }
+
+    // Interleaved like instance data, so the stride is exercised too
+    struct Output{
+        glm::mat4 model;
+        glm::mat4 normal;
+        float padding[4];
+    };
+
+    void compare(std::vector<Renderer::TransformComponent>& transforms, Renderer::TransformBatch& batch, float& maxError){
+        std::vector<Output> outputs(batch.size());
+        batch.computeMatrices(&outputs[0].model, &outputs[0].normal, sizeof(Output));
+
+        for(size_t i = 0; i < transforms.size(); i++){
+            glm::mat4 model = transforms[i].mat4();
+            glm::mat3 normal = transforms[i].normalMatrix();
+            for(int column = 0; column < 3; column++){
+                float scale = std::abs(transforms[i].scale[column]);
+                for(int row = 0; row < 3; row++){
+                    float modelError = std::abs(outputs[i].model[column][row] - model[column][row]) / scale;
+                    float normalError = std::abs(outputs[i].normal[column][row] - normal[column][row]) * scale;
+                    maxError = std::max({maxError, modelError, normalError});
+                    check(modelError <= TOLERANCE, "model matrix rotation/scale differs", i);
+                    check(normalError <= TOLERANCE, "normal matrix rotation/scale differs", i);
+                }
+                check(outputs[i].model[column][3] == 0.f && outputs[i].normal[column][3] == 0.f, "w row is not zero", i);
+                check(outputs[i].normal[3][column] == 0.f, "normal matrix has a translation", i);
+            }
+            check(outputs[i].model[3] == model[3], "translation differs", i);
+            check(outputs[i].normal[3][3] == 1.f, "normal matrix w is not one", i);
+        }
+    }
+}
+
+int main(){
+    std::mt19937 random{1};
+    std::uniform_real_distribution<float> angle{-100.f, 100.f};
+    std::uniform_real_distribution<float> scale{0.1f, 5.f};
+    std::uniform_real_distribution<float> translation{-100.f, 100.f};
+
+    // Not a multiple of the SIMD width, the last block is partial
+    constexpr size_t COUNT = 1003;
+    std::vector<Renderer::TransformComponent> transforms(COUNT);
+    Renderer::TransformBatch batch;
+    for(size_t i = 0; i < COUNT; i++){
+        auto& transform = transforms[i];
+        transform.translation = {translation(random), translation(random), translation(random)};
+        transform.rotation = {angle(random), angle(random), angle(random)};
+        transform.scale = {scale(random), scale(random), scale(random)};
+        batch.push_back(transform);
+    }
+    // Identity, octant boundaries and negative scales
+    transforms[0].rotation = glm::vec3{0.f};
+    transforms[1].rotation = {glm::radians(90.f), glm::radians(-180.f), glm::radians(360.f)};
+    transforms[2].rotation = {glm::radians(45.f), glm::radians(135.f), glm::radians(-225.f)};
+    transforms[3].scale = {-1.f, 2.f, -0.5f};
+    for(size_t i = 0; i < 4; i++)
+        batch.set(i, transforms[i]);
+
+    float maxError = 0.f;
+    compare(transforms, batch, maxError);
+
+    // Shrinking and reusing the batch only computes the remaining transforms
+    transforms.resize(5);
+    batch.resize(5);
+    compare(transforms, batch, maxError);
+
+    std::cout << "Largest error relative to the column scale: " << maxError << " (tolerance " << TOLERANCE << ")\n";
+    if(failures > 0){
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}